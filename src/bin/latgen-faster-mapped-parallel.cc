@@ -48,6 +48,7 @@ int main(int argc, char *argv[]) {
     Timer timer;
     bool allow_partial = false;
     BaseFloat acoustic_scale = 0.1;
+    int32 batch_size = 1;
     LatticeFasterDecoderConfig config;
     TaskSequencerConfig sequencer_config; // has --num-threads option
 
@@ -59,6 +60,11 @@ int main(int argc, char *argv[]) {
 
     po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
     po.Register("allow-partial", &allow_partial, "If true, produce output even if end state was not reached.");
+    po.Register("batch-size", &batch_size, "Number of utterances each thread "
+                "decodes together, advancing them frame by frame in lockstep "
+                "so they share the cached parts of the decoding graph.  Only "
+                "applies if there is a single decoding graph.  Note: memory "
+                "use grows with num-threads-total times batch-size.");
     
     po.Read(argc, argv);
 
@@ -66,6 +72,8 @@ int main(int argc, char *argv[]) {
       po.PrintUsage();
       exit(1);
     }
+    if (batch_size < 1)
+      KALDI_ERR << "--batch-size must be at least 1.";
 
     std::string model_in_filename = po.GetArg(1),
         fst_in_str = po.GetArg(2),
@@ -98,14 +106,18 @@ int main(int argc, char *argv[]) {
     double tot_like = 0.0;
     kaldi::int64 frame_count = 0;
     int num_success = 0, num_fail = 0;
-    VectorFst<StdArc> *decode_fst = NULL; // only used if there is a single
-                                          // decoding graph.
+    fst::Fst<StdArc> *decode_fst = NULL; // only used if there is a single
+                                         // decoding graph.
     
     TaskSequencer<DecodeUtteranceLatticeFasterClass> sequencer(sequencer_config);
+    // batch_sequencer is only used if batch_size > 1.
+    TaskSequencer<DecodeUtteranceLatticeFasterBatchClass> batch_sequencer(
+        sequencer_config);
+    std::vector<DecodeUtteranceLatticeFasterClass*> batch;
     if (ClassifyRspecifier(fst_in_str, NULL, NULL) == kNoRspecifier) {
       SequentialBaseFloatMatrixReader loglike_reader(feature_rspecifier);
       // Input FST is just one FST, not a table of FSTs.
-      decode_fst = fst::ReadFstKaldi(fst_in_str);
+      decode_fst = fst::ReadFstKaldiGeneric(fst_in_str);
 
       {
         for (; !loglike_reader.Done(); loglike_reader.Next()) {
@@ -131,9 +143,20 @@ int main(int argc, char *argv[]) {
                   &words_writer, &compact_lattice_writer, &lattice_writer,
                   &tot_like, &frame_count, &num_success, &num_fail, NULL);
 
-          sequencer.Run(task); // takes ownership of "task",
-          // and will delete it when done.
+          if (batch_size == 1) {
+            sequencer.Run(task); // takes ownership of "task",
+            // and will delete it when done.
+          } else {
+            batch.push_back(task);
+            if (batch.size() == static_cast<size_t>(batch_size)) {
+              batch_sequencer.Run(
+                  new DecodeUtteranceLatticeFasterBatchClass(batch));
+              batch.clear();
+            }
+          }
         }
+        if (!batch.empty())  // the last, partial batch.
+          batch_sequencer.Run(new DecodeUtteranceLatticeFasterBatchClass(batch));
       }
     } else { // We have different FSTs for different utterances.
       SequentialTableReader<fst::VectorFstHolder> fst_reader(fst_in_str);
@@ -169,14 +192,18 @@ int main(int argc, char *argv[]) {
       }
     }
     sequencer.Wait();
+    batch_sequencer.Wait();
 
     if (decode_fst != NULL) delete decode_fst;
       
     double elapsed = timer.Elapsed();
-    KALDI_LOG << "Decoded with " << sequencer_config.num_threads << " threads.";
+    KALDI_LOG << "Decoded with " << sequencer_config.num_threads << " threads"
+              << " and batch size " << batch_size << ".";
     KALDI_LOG << "Time taken "<< elapsed
               << "s: real-time factor per thread assuming 100 frames/sec is "
               << (sequencer_config.num_threads*elapsed*100.0/frame_count);
+    KALDI_LOG << "Overall throughput was " << (frame_count / elapsed)
+              << " frames per second.";
     KALDI_LOG << "Done " << num_success << " utterances, failed for "
               << num_fail;
     KALDI_LOG << "Overall log-likelihood per frame is " << (tot_like/frame_count) << " over "
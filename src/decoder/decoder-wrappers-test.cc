@@ -0,0 +1,188 @@
+// decoder/decoder-wrappers-test.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fstream>
+#include <sstream>
+#include <unistd.h>  // for unlink.
+
+#include "decoder/decoder-wrappers.h"
+#include "decoder/decodable-matrix.h"
+#include "base/timer.h"
+
+namespace kaldi {
+
+// Returns a graph with "num_pdfs" pdfs: state 0 goes to state 1 on any pdf,
+// state 1 has a self-loop on any pdf and an epsilon arc back to state 0, and
+// state 1 is final.  Words are output on the arcs out of state 0.
+fst::VectorFst<fst::StdArc> *CreateLoopGraph(int32 num_pdfs) {
+  typedef fst::StdArc Arc;
+  fst::VectorFst<Arc> *fst = new fst::VectorFst<Arc>;
+  fst->AddState();
+  fst->AddState();
+  fst->SetStart(0);
+  fst->SetFinal(1, Arc::Weight(RandUniform()));
+  for (int32 pdf = 1; pdf <= num_pdfs; pdf++) {
+    fst->AddArc(0, Arc(pdf, pdf, Arc::Weight(RandUniform()), 1));
+    fst->AddArc(1, Arc(pdf, 0, Arc::Weight(RandUniform()), 1));
+  }
+  fst->AddArc(1, Arc(0, 0, Arc::Weight(RandUniform()), 0));
+  return fst;
+}
+
+// Returns the contents of a file, for comparing the archives written.
+std::string ReadFileContents(const std::string &filename) {
+  std::ifstream is(filename.c_str());
+  std::ostringstream os;
+  os << is.rdbuf();
+  return os.str();
+}
+
+// Decodes random log-likelihoods for "num_utts" utterances, writing the
+// lattices to "wspecifier", with the given batch size (batch_size == 0 means
+// use operator () of each DecodeUtteranceLatticeFasterClass).  Returns the
+// time taken.
+double DecodeUtterances(const fst::Fst<fst::StdArc> &fst,
+                        const std::vector<Matrix<BaseFloat> > &loglikes,
+                        int32 batch_size, const std::string &wspecifier) {
+  TransitionModel trans_model;  // not used, as we don't determinize.
+  LatticeFasterDecoderConfig config;
+  Int32VectorWriter alignment_writer, words_writer;
+  CompactLatticeWriter compact_lattice_writer;
+  LatticeWriter lattice_writer(wspecifier);
+  double tot_like = 0.0;
+  int64 frame_count = 0;
+  int32 num_done = 0, num_err = 0, num_partial = 0;
+
+  Timer timer;
+  std::vector<DecodeUtteranceLatticeFasterClass*> batch;
+  for (size_t i = 0; i < loglikes.size(); i++) {
+    std::ostringstream utt;
+    utt << "utt" << i;
+    DecodeUtteranceLatticeFasterClass *task =
+        new DecodeUtteranceLatticeFasterClass(
+            new LatticeFasterDecoder(fst, config),
+            new DecodableMatrixScaled(loglikes[i], 1.0),
+            trans_model, NULL, utt.str(), 1.0, false, true,
+            &alignment_writer, &words_writer, &compact_lattice_writer,
+            &lattice_writer, &tot_like, &frame_count, &num_done, &num_err,
+            &num_partial);
+    if (batch_size == 0) {
+      (*task)();
+      delete task;
+    } else {
+      batch.push_back(task);
+      if (batch.size() == static_cast<size_t>(batch_size) ||
+          i + 1 == loglikes.size()) {
+        DecodeUtteranceLatticeFasterBatchClass batch_task(batch);
+        batch_task();
+        batch.clear();
+      }
+    }
+  }
+  KALDI_ASSERT(num_done == static_cast<int32>(loglikes.size()) &&
+               num_err == 0);
+  return timer.Elapsed();
+}
+
+// Checks that decoding in lockstep batches gives the same lattices as
+// decoding one utterance at a time, and logs the time taken by each.
+void UnitTestBatchDecoding() {
+  int32 num_pdfs = 10 + Rand() % 100, num_utts = 1 + Rand() % 20,
+      batch_size = 1 + Rand() % 8;
+  fst::VectorFst<fst::StdArc> *fst = CreateLoopGraph(num_pdfs);
+  std::vector<Matrix<BaseFloat> > loglikes(num_utts);
+  for (int32 i = 0; i < num_utts; i++) {
+    // Column zero is unused, as the pdf indexes in the graph are one-based.
+    loglikes[i].Resize(1 + Rand() % 200, num_pdfs + 1);
+    loglikes[i].SetRandn();
+  }
+  double unbatched_time = DecodeUtterances(*fst, loglikes, 0,
+                                           "ark,t:tmp.lats.1"),
+      batched_time = DecodeUtterances(*fst, loglikes, batch_size,
+                                      "ark,t:tmp.lats.2");
+  KALDI_LOG << "Decoding " << num_utts << " utterances took "
+            << unbatched_time << "s one at a time and " << batched_time
+            << "s with batch size " << batch_size;
+  KALDI_ASSERT(ReadFileContents("tmp.lats.1") ==
+               ReadFileContents("tmp.lats.2"));
+  unlink("tmp.lats.1");
+  unlink("tmp.lats.2");
+  delete fst;
+}
+
+// Checks that when every token dies before the end of the utterance, the
+// utterance is counted as failed (with --allow-partial=true) rather than
+// giving an error, whether it is decoded alone or as part of a batch.
+void UnitTestNoSurvivingTokens() {
+  typedef fst::StdArc Arc;
+  // From the final state there are no arcs, so every token dies after the
+  // first frame.
+  fst::VectorFst<Arc> fst;
+  fst.AddState();
+  fst.AddState();
+  fst.SetStart(0);
+  fst.SetFinal(1, Arc::Weight::One());
+  fst.AddArc(0, Arc(1, 1, Arc::Weight::One(), 1));
+  Matrix<BaseFloat> loglikes(3, 2);
+
+  LatticeFasterDecoderConfig config;
+  {
+    LatticeFasterDecoder decoder(fst, config);
+    DecodableMatrixScaled decodable(loglikes, 1.0);
+    KALDI_ASSERT(!decoder.Decode(&decodable) &&
+                 !decoder.TracebackAvailable());
+  }
+
+  TransitionModel trans_model;
+  Int32VectorWriter alignment_writer, words_writer;
+  CompactLatticeWriter compact_lattice_writer;
+  LatticeWriter lattice_writer;
+  int32 num_done = 0, num_err = 0, num_partial = 0;
+  for (int32 batched = 0; batched < 2; batched++) {
+    std::vector<DecodeUtteranceLatticeFasterClass*> tasks;
+    for (int32 i = 0; i < 2; i++)
+      tasks.push_back(new DecodeUtteranceLatticeFasterClass(
+          new LatticeFasterDecoder(fst, config),
+          new DecodableMatrixScaled(loglikes, 1.0),
+          trans_model, NULL, "utt", 1.0, false, true,
+          &alignment_writer, &words_writer, &compact_lattice_writer,
+          &lattice_writer, NULL, NULL, &num_done, &num_err, &num_partial));
+    if (batched) {
+      DecodeUtteranceLatticeFasterBatchClass batch_task(tasks);
+      batch_task();
+    } else {
+      for (size_t i = 0; i < tasks.size(); i++) {
+        (*tasks[i])();
+        delete tasks[i];
+      }
+    }
+  }
+  KALDI_ASSERT(num_done == 0 && num_err == 4);
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 5; i++)
+    UnitTestBatchDecoding();
+  UnitTestNoSurvivingTokens();
+  std::cout << "Test OK.\n";
+  return 0;
+}
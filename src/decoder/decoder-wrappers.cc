@@ -60,11 +60,29 @@ DecodeUtteranceLatticeFasterClass::DecodeUtteranceLatticeFasterClass(
 
 void DecodeUtteranceLatticeFasterClass::operator () () {
   // Decoding and lattice determinization happens here.
+  bool decoded = decoder_->Decode(decodable_);
+  ProcessLattice(decoded);
+}
+
+bool DecodeUtteranceLatticeFasterClass::AdvanceDecoding() {
+  if (decodable_->IsLastFrame(decoder_->NumFramesDecoded() - 1))
+    return false;
+  decoder_->AdvanceDecoding(decodable_, 1);
+  return true;
+}
+
+void DecodeUtteranceLatticeFasterClass::FinishDecoding() {
+  decoder_->FinalizeDecoding();
+  // As in Decode(), this fails if all the tokens were pruned away.
+  ProcessLattice(decoder_->TracebackAvailable());
+}
+
+void DecodeUtteranceLatticeFasterClass::ProcessLattice(bool decoded) {
   computed_ = true; // Just means this function was called-- a check on the
   // calling code.
   success_ = true;
   using fst::VectorFst;
-  if (!decoder_->Decode(decodable_)) {
+  if (!decoded) {
     KALDI_WARN << "Failed to decode file " << utt_;
     success_ = false;
   }
@@ -193,6 +211,31 @@ DecodeUtteranceLatticeFasterClass::~DecodeUtteranceLatticeFasterClass() {
 }
 
 
+void DecodeUtteranceLatticeFasterBatchClass::operator () () {
+  for (size_t i = 0; i < tasks_.size(); i++)
+    tasks_[i]->InitDecoding();
+  // "active" is the list of indexes of utterances not yet fully decoded.
+  std::vector<size_t> active(tasks_.size());
+  for (size_t i = 0; i < tasks_.size(); i++)
+    active[i] = i;
+  while (!active.empty()) {
+    size_t num_active = 0;
+    for (size_t j = 0; j < active.size(); j++) {
+      if (tasks_[active[j]]->AdvanceDecoding())
+        active[num_active++] = active[j];
+      else
+        tasks_[active[j]]->FinishDecoding();
+    }
+    active.resize(num_active);
+  }
+}
+
+DecodeUtteranceLatticeFasterBatchClass::~DecodeUtteranceLatticeFasterBatchClass() {
+  for (size_t i = 0; i < tasks_.size(); i++)
+    delete tasks_[i];  // this does the output.
+}
+
+
 // Takes care of output.  Returns true on success.
 bool DecodeUtteranceLatticeFaster(
     LatticeFasterDecoder &decoder, // not const but is really an input.
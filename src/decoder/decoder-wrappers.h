@@ -140,7 +140,24 @@ class DecodeUtteranceLatticeFasterClass {
       int32 *num_partial);  // If partial decode (final-state not reached), increments this.
   void operator () (); // The decoding happens here.
   ~DecodeUtteranceLatticeFasterClass(); // Output happens here.
+
+  // The following three functions are an alternative to operator (), used by
+  // DecodeUtteranceLatticeFasterBatchClass to decode several utterances in
+  // lockstep.  Call InitDecoding(), then AdvanceDecoding() until it returns
+  // false, then FinishDecoding().  They require the decodable object to
+  // support NumFramesReady().
+  void InitDecoding() { decoder_->InitDecoding(); }
+  // Decodes one more frame; returns false (and does nothing) if all the frames
+  // have already been decoded.
+  bool AdvanceDecoding();
+  // Finalizes the decoding and does the same lattice processing as operator ().
+  void FinishDecoding();
  private:
+  // Called at the end of operator () and FinishDecoding(), with "decoded" set
+  // to true if any traceback is available; it gets and determinizes the
+  // lattice.
+  void ProcessLattice(bool decoded);
+
   // The following variables correspond to inputs:
   LatticeFasterDecoder *decoder_;
   DecodableInterface *decodable_;
@@ -168,6 +185,28 @@ class DecodeUtteranceLatticeFasterClass {
   Lattice *lat_; // Stored output, if determinize_ == false.
 };
 
+/// This class decodes a batch of utterances, each given as a
+/// DecodeUtteranceLatticeFasterClass object, in a single thread.  Rather than
+/// decoding the utterances one after the other, it advances all their decoders
+/// one frame at a time, so that the decoders, which usually share a decoding
+/// graph, visit the same frequently used parts of the graph (e.g. the states
+/// around silence and the language-model backoff states) close together in
+/// time, and those parts of the graph tend to stay in the cache.  This is for
+/// use with TaskSequencer, e.g. in latgen-faster-mapped-parallel with
+/// --batch-size > 1.  The output happens in the destructor, in the order in
+/// which the utterances were given.
+class DecodeUtteranceLatticeFasterBatchClass {
+ public:
+  // Takes ownership of the pointers in "tasks".
+  explicit DecodeUtteranceLatticeFasterBatchClass(
+      const std::vector<DecodeUtteranceLatticeFasterClass*> &tasks):
+      tasks_(tasks) { }
+  void operator () (); // The decoding happens here.
+  ~DecodeUtteranceLatticeFasterBatchClass(); // Output happens here.
+ private:
+  std::vector<DecodeUtteranceLatticeFasterClass*> tasks_;
+};
+
 // This function DecodeUtteranceLatticeSimple is used in several decoders, and
 // we have moved it here.  Note: this is really "binary-level" code as it
 // involves table readers and writers; we've just put it here as there is no
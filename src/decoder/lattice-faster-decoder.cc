@@ -64,7 +64,9 @@ void LatticeFasterDecoder::InitDecoding() {
   StateId start_state = fst_.Start();
   KALDI_ASSERT(start_state != fst::kNoStateId);
   active_toks_.resize(1);
-  Token *start_tok = new Token(0.0, 0.0, NULL, NULL);
+  token_allocator_.ResetStats();
+  link_allocator_.ResetStats();
+  Token *start_tok = NewToken(0.0, 0.0, NULL, NULL);
   active_toks_[0].toks = start_tok;
   toks_.Insert(start_state, start_tok);
   num_toks_++;
@@ -93,7 +95,7 @@ bool LatticeFasterDecoder::Decode(DecodableInterface *decodable) {
 
   // Returns true if we have any kind of traceback available (not necessarily
   // to the end state; query ReachedFinal() for that).
-  return !active_toks_.empty() && active_toks_.back().toks != NULL;
+  return TracebackAvailable();
 }
 
 
@@ -243,7 +245,7 @@ inline LatticeFasterDecoder::Token *LatticeFasterDecoder::FindOrAddToken(
     // tokens on the currently final frame have zero extra_cost
     // as any of them could end up
     // on the winning path.
-    Token *new_tok = new Token (tot_cost, extra_cost, NULL, toks);
+    Token *new_tok = NewToken(tot_cost, extra_cost, NULL, toks);
     // NULL: no forward links yet
     toks = new_tok;
     num_toks_++;
@@ -316,7 +318,7 @@ void LatticeFasterDecoder::PruneForwardLinks(
           ForwardLink *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          DeleteForwardLink(link);
           link = next_link;  // advance link but leave prev_link the same.
           *links_pruned = true;
         } else {   // keep the link and update the tok_extra_cost if needed.
@@ -403,7 +405,7 @@ void LatticeFasterDecoder::PruneForwardLinksFinal() {
           ForwardLink *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          DeleteForwardLink(link);
           link = next_link; // advance link but leave prev_link the same.
         } else { // keep the link and update the tok_extra_cost if needed.
           if (link_extra_cost < 0.0) { // this is just a precaution.
@@ -432,6 +434,14 @@ void LatticeFasterDecoder::PruneForwardLinksFinal() {
   } // while changed
 }
 
+BaseFloat LatticeFasterDecoder::BytesAllocatedPerFrame() const {
+  int64 num_bytes =
+      token_allocator_.NumAllocations() * token_allocator_.ObjectSize() +
+      link_allocator_.NumAllocations() * link_allocator_.ObjectSize();
+  int32 num_frames = NumFramesDecoded();
+  return num_bytes / static_cast<BaseFloat>(num_frames > 0 ? num_frames : 1);
+}
+
 BaseFloat LatticeFasterDecoder::FinalRelativeCost() const {
   if (!decoding_finalized_) {
     BaseFloat relative_cost;
@@ -462,7 +472,7 @@ void LatticeFasterDecoder::PruneTokensForFrame(int32 frame_plus_one) {
       // excise tok from list and delete tok.
       if (prev_tok != NULL) prev_tok->next = tok->next;
       else toks = tok->next;
-      delete tok;
+      DeleteToken(tok);
       num_toks_--;
     } else {  // fetch next Token
       prev_tok = tok;
@@ -588,6 +598,9 @@ void LatticeFasterDecoder::FinalizeDecoding() {
   PruneTokensForFrame(0);
   KALDI_VLOG(4) << "pruned tokens from " << num_toks_begin
                 << " to " << num_toks_;
+  KALDI_VLOG(3) << "Allocated " << BytesAllocatedPerFrame() << " bytes of "
+                << "tokens and links per frame; " << BytesReserved()
+                << " bytes reserved.";
 }
 
 /// Gets the weight cutoff.  Also counts the active tokens.
@@ -735,8 +748,8 @@ void LatticeFasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
           // NULL: no change indicator needed
 
           // Add ForwardLink from tok to next_tok (put on head of list tok->links)
-          tok->links = new ForwardLink(next_tok, arc.ilabel, arc.olabel,
-                                       graph_cost, ac_cost, tok->links);
+          tok->links = NewForwardLink(next_tok, arc.ilabel, arc.olabel,
+                                      graph_cost, ac_cost, tok->links);
         }
       } // for all arcs
     }
@@ -787,8 +800,7 @@ void LatticeFasterDecoder::ProcessNonemitting() {
     // because we're about to regenerate them.  This is a kind
     // of non-optimality (remember, this is the simple decoder),
     // but since most states are emitting it's not a huge issue.
-    tok->DeleteForwardLinks(); // necessary when re-visiting
-    tok->links = NULL;
+    DeleteForwardLinks(tok); // necessary when re-visiting
     for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
          !aiter.Done();
          aiter.Next()) {
@@ -802,8 +814,8 @@ void LatticeFasterDecoder::ProcessNonemitting() {
           Token *new_tok = FindOrAddToken(arc.nextstate, frame + 1, tot_cost,
                                           &changed);
 
-          tok->links = new ForwardLink(new_tok, 0, arc.olabel,
-                                       graph_cost, 0, tok->links);
+          tok->links = NewForwardLink(new_tok, 0, arc.olabel,
+                                      graph_cost, 0, tok->links);
 
           // "changed" tells us whether the new token has a different
           // cost from before, or is new [if so, add into queue].
@@ -827,9 +839,9 @@ void LatticeFasterDecoder::ClearActiveTokens() { // a cleanup routine, at utt en
     // Delete all tokens alive on this frame, and any forward
     // links they may have.
     for (Token *tok = active_toks_[i].toks; tok != NULL; ) {
-      tok->DeleteForwardLinks();
+      DeleteForwardLinks(tok);
       Token *next_tok = tok->next;
-      delete tok;
+      DeleteToken(tok);
       num_toks_--;
       tok = next_tok;
     }
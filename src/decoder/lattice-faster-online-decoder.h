@@ -28,6 +28,7 @@
 
 #include "util/stl-utils.h"
 #include "util/hash-list.h"
+#include "util/slab-allocator.h"
 #include "fst/fstlib.h"
 #include "itf/decodable-itf.h"
 #include "fstext/fstext-lib.h"
@@ -185,6 +186,19 @@ class LatticeFasterOnlineDecoder {
 
   inline int32 NumFramesDecoded() const { return active_toks_.size() - 1; }
 
+  /// Returns the number of bytes of tokens and forward-links allocated while
+  /// decoding the current utterance, divided by the number of frames decoded.
+  /// (Tokens and links come from slab allocators owned by this object, which
+  /// reuse freed memory within and across utterances, so this measures
+  /// allocation activity rather than growth in memory use).
+  BaseFloat BytesAllocatedPerFrame() const;
+
+  /// Returns the total memory, in bytes, currently held for tokens and
+  /// forward-links, including memory that is free for reuse.
+  size_t BytesReserved() const {
+    return token_allocator_.BytesReserved() + link_allocator_.BytesReserved();
+  }
+
  private:
   // ForwardLinks are the links from a token to a token on the next frame.
   // or sometimes on the current frame (for input-epsilon links).
@@ -232,17 +246,39 @@ class LatticeFasterOnlineDecoder {
                  Token *next, Token *backpointer):
         tot_cost(tot_cost), extra_cost(extra_cost), links(links), next(next),
         backpointer(backpointer) { }
-    inline void DeleteForwardLinks() {
-      ForwardLink *l = links, *m;
-      while (l != NULL) {
-        m = l->next;
-        delete l;
-        l = m;
-      }
-      links = NULL;
-    }
   };
 
+  // Tokens and ForwardLinks are allocated and freed only through the following
+  // functions, which use token_allocator_ and link_allocator_ rather than
+  // new and delete.
+  inline Token *NewToken(BaseFloat tot_cost, BaseFloat extra_cost,
+                         ForwardLink *links, Token *next,
+                         Token *backpointer) {
+    return new (token_allocator_.Allocate()) Token(tot_cost, extra_cost,
+                                                   links, next, backpointer);
+  }
+  inline void DeleteToken(Token *tok) { token_allocator_.Free(tok); }
+  inline ForwardLink *NewForwardLink(Token *next_tok, Label ilabel,
+                                     Label olabel, BaseFloat graph_cost,
+                                     BaseFloat acoustic_cost,
+                                     ForwardLink *next) {
+    return new (link_allocator_.Allocate()) ForwardLink(
+        next_tok, ilabel, olabel, graph_cost, acoustic_cost, next);
+  }
+  inline void DeleteForwardLink(ForwardLink *link) {
+    link_allocator_.Free(link);
+  }
+  // Deletes all the forward links of "tok".
+  inline void DeleteForwardLinks(Token *tok) {
+    ForwardLink *l = tok->links, *m;
+    while (l != NULL) {
+      m = l->next;
+      DeleteForwardLink(l);
+      l = m;
+    }
+    tok->links = NULL;
+  }
+
   // head of per-frame list of Tokens (list is in topological order),
   // and something saying whether we ever pruned it using PruneForwardLinks.
   struct TokenList {
@@ -360,6 +396,11 @@ class LatticeFasterOnlineDecoder {
   int32 num_toks_; // current total #toks allocated...
   bool warned_;
 
+  // The allocators for tokens and forward-links; they are kept for the
+  // lifetime of the decoder so their memory is reused across utterances.
+  SlabAllocator<Token> token_allocator_;
+  SlabAllocator<ForwardLink> link_allocator_;
+
   /// decoding_finalized_ is true if someone called FinalizeDecoding().  [note,
   /// calling this is optional].  If true, it's forbidden to decode more.  Also,
   /// if this is set, then the output of ComputeFinalCosts() is in the next
@@ -112,6 +112,7 @@ struct FrameExtractionOptions {
   std::string window_type;  // e.g. Hamming window
   bool round_to_power_of_two;
   bool snip_edges;
+  int32 max_feature_vectors;  // Only used by online feature extraction.
   // Maybe "hamming", "rectangular", "povey", "hanning"
   // "povey" is a window I made to be similar to Hamming but to go to zero at the
   // edges, it's pow((0.5 - 0.5*cos(n/N*2*pi)), 0.85)
@@ -125,7 +126,8 @@ struct FrameExtractionOptions {
       remove_dc_offset(true),
       window_type("povey"),
       round_to_power_of_two(true),
-      snip_edges(true){ }
+      snip_edges(true),
+      max_feature_vectors(-1) { }
 
   void Register(OptionsItf *po) {
     po->Register("sample-frequency", &samp_freq,
@@ -147,6 +149,10 @@ struct FrameExtractionOptions {
                  "completely fit in the file, and the number of frames depends on the "
                  "frame-length.  If false, the number of frames depends only on the "
                  "frame-shift, and we reflect the data at the ends.");
+    po->Register("max-feature-vectors", &max_feature_vectors,
+                 "Memory optimization for online feature extraction.  If > 0, "
+                 "only the most recent (at least) this many feature vectors "
+                 "are kept, and earlier ones are discarded.");
   }
   int32 WindowShift() const {
     return static_cast<int32>(samp_freq * 0.001 * frame_shift_ms);
@@ -249,6 +249,78 @@ void TestOnlinePlp() {
   }
 }
 
+void TestComputeFeaturesInChunks() {
+  std::ifstream is("../feat/test_data/test.wav", std::ios::binary);
+  WaveData wave;
+  wave.Read(is);
+  SubVector<BaseFloat> waveform(wave.Data(), 0);
+
+  MfccOptions op;
+  op.frame_opts.dither = 0.0;
+  op.frame_opts.samp_freq = wave.SampFreq();
+  BaseFloat vtln_warp = (Rand() % 2 == 0 ? 1.0 : 0.9);
+  Mfcc mfcc(op);
+  Matrix<BaseFloat> mfcc_feats;
+  mfcc.Compute(waveform, vtln_warp, &mfcc_feats, NULL);
+
+  for (int32 i = 0; i < 5; i++) {
+    int32 chunk_length = 1 + Rand() % 5000;
+    std::ifstream is2("../feat/test_data/test.wav", std::ios::binary);
+    WaveStreamReader reader;
+    reader.Open(is2);
+    KALDI_ASSERT(reader.NumChannels() == 1 &&
+                 reader.NumSamples() == waveform.Dim());
+    Matrix<BaseFloat> chunked_feats;
+    ComputeFeaturesInChunks<Mfcc>(op, vtln_warp, 0, chunk_length, &reader,
+                                  &chunked_feats);
+    KALDI_ASSERT(reader.Done());
+    AssertEqual(mfcc_feats, chunked_feats);
+  }
+
+  {
+    // A header that claims about 2^31 bytes of data, as for corrupt files, must
+    // not make us allocate the output for that many frames up front.
+    std::ifstream is2("../feat/test_data/test.wav", std::ios::binary);
+    std::ostringstream contents;
+    contents << is2.rdbuf();
+    std::string bytes = contents.str();
+    KALDI_ASSERT(bytes.size() > 44 && bytes.compare(36, 4, "data") == 0);
+    uint32 data_size = 0x7FFFFF00, riff_size = data_size + 36;
+    for (int32 i = 0; i < 4; i++) {  // The sizes are little-endian.
+      bytes[4 + i] = static_cast<char>((riff_size >> (8 * i)) & 0xFF);
+      bytes[40 + i] = static_cast<char>((data_size >> (8 * i)) & 0xFF);
+    }
+    std::istringstream is3(bytes);
+    WaveStreamReader reader;
+    reader.Open(is3);
+    KALDI_ASSERT(reader.NumSamples() > 1000 * waveform.Dim());
+    Matrix<BaseFloat> chunked_feats;
+    ComputeFeaturesInChunks<Mfcc>(op, vtln_warp, 0, 1 + Rand() % 5000,
+                                  &reader, &chunked_feats);
+    KALDI_ASSERT(reader.Done());
+    AssertEqual(mfcc_feats, chunked_feats);
+  }
+
+  // Check that with max_feature_vectors set, the most recent frames are
+  // still correct.
+  MfccOptions op2(op);
+  op2.frame_opts.max_feature_vectors = 10;
+  OnlineMfcc online_mfcc(op2, vtln_warp);
+  int32 chunk_length = 1 + Rand() % 2000;
+  Vector<BaseFloat> frame(mfcc.Dim()), ref_frame(mfcc.Dim());
+  for (int32 start = 0; start < waveform.Dim(); start += chunk_length) {
+    int32 this_length = std::min(chunk_length, waveform.Dim() - start);
+    online_mfcc.AcceptWaveform(wave.SampFreq(),
+                               waveform.Range(start, this_length));
+    int32 num_ready = online_mfcc.NumFramesReady();
+    for (int32 t = std::max(0, num_ready - 10); t < num_ready; t++) {
+      online_mfcc.GetFrame(t, &frame);
+      ref_frame.CopyFromVec(mfcc_feats.Row(t));
+      AssertEqual(frame, ref_frame);
+    }
+  }
+}
+
 void TestOnlineTransform() {
   std::ifstream is("../feat/test_data/test.wav");
   WaveData wave;
@@ -390,6 +462,7 @@ int main() {
     TestOnlineSpliceFrames();
     TestOnlineMfcc();
     TestOnlinePlp();
+    TestComputeFeaturesInChunks();
     TestOnlineTransform();
     TestOnlineAppendFeature();
   }
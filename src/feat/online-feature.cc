@@ -30,7 +30,11 @@ void OnlineGenericBaseFeature<C>::GetFrame(int32 frame,
                                            VectorBase<BaseFloat> *feat) {
   KALDI_ASSERT(frame >= 0 && frame < num_frames_);
   KALDI_ASSERT(feat->Dim() == Dim());
-  feat->CopyFromVec(features_.Row(frame));
+  if (frame < first_frame_)
+    KALDI_ERR << "Frame " << frame << " has been discarded (only the last "
+              << max_feature_vectors_ << " frames are kept; see the option "
+              << "--max-feature-vectors)";
+  feat->CopyFromVec(features_.Row(frame - first_frame_));
 };
 
 template<class C>
@@ -40,8 +44,10 @@ bool OnlineGenericBaseFeature<C>::IsLastFrame(int32 frame) const {
 
 template<class C>
 OnlineGenericBaseFeature<C>::OnlineGenericBaseFeature(
-    const typename C::Options &opts)
-    :mfcc_or_plp_(opts), input_finished_(false), num_frames_(0),
+    const typename C::Options &opts, BaseFloat vtln_warp)
+    :mfcc_or_plp_(opts), vtln_warp_(vtln_warp), first_frame_(0),
+    max_feature_vectors_(opts.frame_opts.max_feature_vectors),
+    input_finished_(false), num_frames_(0),
     sampling_frequency_(opts.frame_opts.samp_freq) { }
 
 template<class C>
@@ -73,26 +79,38 @@ void OnlineGenericBaseFeature<C>::AcceptWaveform(BaseFloat sampling_rate,
   waveform_remainder_.Resize(0);
 
   Matrix<BaseFloat> feats;
-  BaseFloat vtln_warp = 1.0;  // We don't support VTLN warping in this wrapper.
-  mfcc_or_plp_.Compute(wave_to_use, vtln_warp, &feats, &waveform_remainder_);
+  mfcc_or_plp_.Compute(wave_to_use, vtln_warp_, &feats, &waveform_remainder_);
 
   if (feats.NumRows() == 0) {
     // Presumably we got a very small waveform and could output no whole
     // features.  The waveform will have been appended to waveform_remainder_.
     return;
   }
-  int32 new_num_frames = num_frames_ + feats.NumRows();
+  if (max_feature_vectors_ > 0 &&
+      num_frames_ - first_frame_ >= 2 * max_feature_vectors_) {
+    // Discard all but the last max_feature_vectors_ frames, by moving them to
+    // the start of features_.  We wait till we have twice that many frames, so
+    // that the cost of the copying is small per frame.
+    int32 num_keep = max_feature_vectors_,
+        num_discard = num_frames_ - first_frame_ - num_keep;
+    for (int32 i = 0; i < num_keep; i++)
+      features_.Row(i).CopyFromVec(features_.Row(num_discard + i));
+    first_frame_ += num_discard;
+  }
+  int32 new_num_frames = num_frames_ + feats.NumRows(),
+      new_num_stored = new_num_frames - first_frame_;
   BaseFloat increase_ratio = 1.5;  // This is a tradeoff between memory and
                                    // compute; it's the factor by which we
                                    // increase the memory used each time.
-  if (new_num_frames > features_.NumRows()) {
-    int32 new_num_rows = std::max<int32>(new_num_frames,
+  if (new_num_stored > features_.NumRows()) {
+    int32 new_num_rows = std::max<int32>(new_num_stored,
                                          features_.NumRows() * increase_ratio);
     // Increase the size of the features_ matrix and copy over any existing
     // data.
     features_.Resize(new_num_rows, Dim(), kCopyData);
   }
-  features_.Range(num_frames_, feats.NumRows(), 0, Dim()).CopyFromMat(feats);
+  features_.Range(num_frames_ - first_frame_, feats.NumRows(),
+                  0, Dim()).CopyFromMat(feats);
   num_frames_ = new_num_frames;
 }
 
@@ -100,6 +118,163 @@ void OnlineGenericBaseFeature<C>::AcceptWaveform(BaseFloat sampling_rate,
 template class OnlineGenericBaseFeature<Mfcc>;
 template class OnlineGenericBaseFeature<Plp>;
 template class OnlineGenericBaseFeature<Fbank>;
+template class OnlineGenericBaseFeature<TiFbank>;
+
+
+template<class C>
+void ComputeFeaturesInChunks(const typename C::Options &opts,
+                             BaseFloat vtln_warp,
+                             int32 channel,
+                             int32 chunk_length,
+                             WaveStreamReader *wave,
+                             Matrix<BaseFloat> *output) {
+  KALDI_ASSERT(chunk_length > 0 && channel >= 0 &&
+               channel < wave->NumChannels());
+  if (!opts.frame_opts.snip_edges)
+    KALDI_ERR << "Computing features in chunks requires --snip-edges=true";
+  if (wave->NumSamples() > std::numeric_limits<int32>::max())
+    KALDI_ERR << "Wave file is too long (" << wave->NumSamples()
+              << " samples).";
+
+  typename C::Options online_opts(opts);
+  // The frames are copied out as soon as they are ready, so the online
+  // feature object has no need to keep them.
+  online_opts.frame_opts.max_feature_vectors = 1;
+  OnlineGenericBaseFeature<C> feature(online_opts, vtln_warp);
+
+  // We don't size the output from the header, as for corrupt files it may
+  // claim about 2^31 bytes; instead we double its size as the frames arrive
+  // (never going beyond what the header says), and trim it at the end.
+  int32 num_frames = NumFrames(wave->NumSamples(), opts.frame_opts),
+      num_done = 0;
+  output->Resize(0, 0);
+  Matrix<BaseFloat> chunk(wave->NumChannels(), chunk_length, kUndefined);
+  int32 num_samp;
+  while ((num_samp = wave->Read(&chunk)) > 0) {
+    feature.AcceptWaveform(wave->SampFreq(),
+                           SubVector<BaseFloat>(chunk, channel).Range(
+                               0, num_samp));
+    int32 num_ready = feature.NumFramesReady();
+    KALDI_ASSERT(num_ready <= num_frames);
+    if (num_ready > output->NumRows()) {
+      int32 new_num_rows = std::max<int32>(
+          num_ready, std::min<int64>(num_frames,
+                                     2 * static_cast<int64>(output->NumRows())));
+      output->Resize(new_num_rows, feature.Dim(), kCopyData);
+    }
+    for (; num_done < num_ready; num_done++) {
+      SubVector<BaseFloat> frame(*output, num_done);
+      feature.GetFrame(num_done, &frame);
+    }
+  }
+  feature.InputFinished();
+  if (num_done == 0)
+    output->Resize(0, 0);
+  else if (num_done < output->NumRows())
+    output->Resize(num_done, output->NumCols(), kCopyData);
+}
+
+template
+void ComputeFeaturesInChunks<Mfcc>(const MfccOptions &opts,
+                                   BaseFloat vtln_warp, int32 channel,
+                                   int32 chunk_length, WaveStreamReader *wave,
+                                   Matrix<BaseFloat> *output);
+template
+void ComputeFeaturesInChunks<Plp>(const PlpOptions &opts,
+                                  BaseFloat vtln_warp, int32 channel,
+                                  int32 chunk_length, WaveStreamReader *wave,
+                                  Matrix<BaseFloat> *output);
+template
+void ComputeFeaturesInChunks<Fbank>(const FbankOptions &opts,
+                                    BaseFloat vtln_warp, int32 channel,
+                                    int32 chunk_length, WaveStreamReader *wave,
+                                    Matrix<BaseFloat> *output);
+template
+void ComputeFeaturesInChunks<TiFbank>(const TiFbankOptions &opts,
+                                      BaseFloat vtln_warp, int32 channel,
+                                      int32 chunk_length,
+                                      WaveStreamReader *wave,
+                                      Matrix<BaseFloat> *output);
+
+
+void SequentialFeatureWaveReader::Register(OptionsItf *po) {
+  po->Register("chunk-length", &chunk_length_secs_, "If > 0, read each wave "
+               "file in chunks of this many seconds and compute the features "
+               "as we go, so that the whole waveform is never in memory (for "
+               "long recordings).  Requires an scp wav-rspecifier and "
+               "--snip-edges=true.");
+}
+
+bool SequentialFeatureWaveReader::Open(const std::string &wav_rspecifier) {
+  if (InChunks())
+    return chunk_reader_.Open(wav_rspecifier);
+  else
+    return reader_.Open(wav_rspecifier);
+}
+
+bool SequentialFeatureWaveReader::Done() {
+  return (InChunks() ? chunk_reader_.Done() : reader_.Done());
+}
+
+std::string SequentialFeatureWaveReader::Key() {
+  return (InChunks() ? chunk_reader_.Key() : reader_.Key());
+}
+
+void SequentialFeatureWaveReader::Next() {
+  if (InChunks())
+    chunk_reader_.Next();
+  else
+    reader_.Next();
+}
+
+BaseFloat SequentialFeatureWaveReader::Duration() {
+  return (InChunks() ? chunk_reader_.Value().Duration() :
+          reader_.Value().Duration());
+}
+
+BaseFloat SequentialFeatureWaveReader::SampFreq() {
+  return (InChunks() ? chunk_reader_.Value().SampFreq() :
+          reader_.Value().SampFreq());
+}
+
+int32 SequentialFeatureWaveReader::NumChannels() {
+  return (InChunks() ? chunk_reader_.Value().NumChannels() :
+          reader_.Value().Data().NumRows());
+}
+
+template<class C>
+void SequentialFeatureWaveReader::Compute(const typename C::Options &opts,
+                                          C *computer, BaseFloat vtln_warp,
+                                          int32 channel,
+                                          Matrix<BaseFloat> *features) {
+  if (InChunks()) {
+    WaveStreamReader &wave = chunk_reader_.Value();
+    int32 chunk_length = std::max<int32>(1, chunk_length_secs_ *
+                                         wave.SampFreq());
+    ComputeFeaturesInChunks<C>(opts, vtln_warp, channel, chunk_length,
+                               &wave, features);
+  } else {
+    SubVector<BaseFloat> waveform(reader_.Value().Data(), channel);
+    computer->Compute(waveform, vtln_warp, features, NULL);
+  }
+}
+
+template
+void SequentialFeatureWaveReader::Compute<Mfcc>(
+    const MfccOptions &opts, Mfcc *computer, BaseFloat vtln_warp,
+    int32 channel, Matrix<BaseFloat> *features);
+template
+void SequentialFeatureWaveReader::Compute<Plp>(
+    const PlpOptions &opts, Plp *computer, BaseFloat vtln_warp,
+    int32 channel, Matrix<BaseFloat> *features);
+template
+void SequentialFeatureWaveReader::Compute<Fbank>(
+    const FbankOptions &opts, Fbank *computer, BaseFloat vtln_warp,
+    int32 channel, Matrix<BaseFloat> *features);
+template
+void SequentialFeatureWaveReader::Compute<TiFbank>(
+    const TiFbankOptions &opts, TiFbank *computer, BaseFloat vtln_warp,
+    int32 channel, Matrix<BaseFloat> *features);
 
 
 OnlineCmvnState::OnlineCmvnState(const OnlineCmvnState &other):
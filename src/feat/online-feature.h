@@ -34,6 +34,8 @@
 #include "feat/feature-mfcc.h"
 #include "feat/feature-plp.h"
 #include "feat/feature-fbank.h"
+#include "feat/feature-ti-fbank.h"
+#include "feat/wave-reader.h"
 #include "itf/online-feature-itf.h"
 
 namespace kaldi {
@@ -56,12 +58,17 @@ class OnlineGenericBaseFeature: public OnlineBaseFeature {
   // decode of some data.
   virtual bool IsLastFrame(int32 frame) const;
   virtual int32 NumFramesReady() const { return num_frames_; }
+
+  // Note: if opts.frame_opts.max_feature_vectors > 0, frames before
+  // NumFramesReady() - max_feature_vectors may have been discarded, and it is
+  // an error to ask for them.
   virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat);
 
   //
   // Next, functions that are not in the interface.
   //
-  explicit OnlineGenericBaseFeature(const typename C::Options &opts);
+  explicit OnlineGenericBaseFeature(const typename C::Options &opts,
+                                    BaseFloat vtln_warp = 1.0);
 
   // This would be called from the application, when you get
   // more wave data.  Note: the sampling_rate is only provided so
@@ -80,8 +87,18 @@ class OnlineGenericBaseFeature: public OnlineBaseFeature {
  private:
   C mfcc_or_plp_;  // class that does the MFCC or PLP computation
 
-  // features_ is the Mfcc or Plp or Fbank features that we have already computed.
+  // The VTLN warping factor passed to the Compute() function of C.
+  BaseFloat vtln_warp_;
+
+  // features_ is the Mfcc or Plp or Fbank features that we have already
+  // computed; row i of it is frame first_frame_ + i.  first_frame_ is zero
+  // unless we are discarding old frames because of the max_feature_vectors
+  // option.
   Matrix<BaseFloat> features_;
+  int32 first_frame_;
+
+  // The max_feature_vectors option (if <= 0, we keep all frames).
+  int32 max_feature_vectors_;
 
   // True if the user has called "InputFinished()"
   bool input_finished_;
@@ -105,6 +122,70 @@ class OnlineGenericBaseFeature: public OnlineBaseFeature {
 typedef OnlineGenericBaseFeature<Mfcc> OnlineMfcc;
 typedef OnlineGenericBaseFeature<Plp> OnlinePlp;
 typedef OnlineGenericBaseFeature<Fbank> OnlineFbank;
+typedef OnlineGenericBaseFeature<TiFbank> OnlineTiFbank;
+
+
+/// This function computes features for one channel of a wave file a chunk at a
+/// time, for long recordings where we don't want to have the whole waveform in
+/// memory.  It reads "chunk_length" samples at a time from "wave" (which should
+/// have just been opened), passes them to an OnlineGenericBaseFeature<C> (which
+/// keeps only the most recent frames), and copies the frames to "output" as
+/// they become ready; "output" grows as the frames arrive, and is not sized
+/// from the (possibly bogus) number of samples in the header.  The features
+/// are the same as those from C::Compute() on the whole waveform (apart from
+/// the randomness of dithering), which requires
+/// opts.frame_opts.snip_edges == true.  Will throw on error.
+template<class C>
+void ComputeFeaturesInChunks(const typename C::Options &opts,
+                             BaseFloat vtln_warp,
+                             int32 channel,
+                             int32 chunk_length,
+                             WaveStreamReader *wave,
+                             Matrix<BaseFloat> *output);
+
+
+/// This class reads the wave files for the feature extraction programs
+/// (compute-mfcc-feats and so on).  By default it reads each file whole, like
+/// SequentialTableReader<WaveHolder>; with the --chunk-length option it only
+/// reads the header of each file (which requires an "scp:" rspecifier, see
+/// SequentialWaveStreamReader), and Compute() then reads the data a chunk at a
+/// time using ComputeFeaturesInChunks().
+class SequentialFeatureWaveReader {
+ public:
+  SequentialFeatureWaveReader(): chunk_length_secs_(0.0) { }
+
+  /// Registers the --chunk-length option.
+  void Register(OptionsItf *po);
+
+  /// Call this after the options have been read.  Returns false on error.
+  bool Open(const std::string &wav_rspecifier);
+
+  bool Done();
+  std::string Key();
+  void Next();
+
+  /// These give information about the current wave file.  They will throw if
+  /// it cannot be read.
+  BaseFloat Duration();
+  BaseFloat SampFreq();
+  int32 NumChannels();
+
+  /// Computes features for channel "channel" of the current wave file, with
+  /// computer->Compute() on the whole waveform, or in chunks if --chunk-length
+  /// was given ("opts" should be the options "computer" was created with).
+  /// Will throw on error.
+  template<class C>
+  void Compute(const typename C::Options &opts, C *computer,
+               BaseFloat vtln_warp, int32 channel,
+               Matrix<BaseFloat> *features);
+
+ private:
+  bool InChunks() const { return chunk_length_secs_ > 0.0; }
+
+  BaseFloat chunk_length_secs_;
+  SequentialTableReader<WaveHolder> reader_;  // Used if !InChunks().
+  SequentialWaveStreamReader chunk_reader_;  // Used if InChunks().
+};
 
 
 /// This class takes a Matrix<BaseFloat> and wraps it as an
@@ -20,17 +20,18 @@
 // limitations under the License.
 
 #include <cstdio>
+#include <limits>
 #include <sstream>
 #include <vector>
 
 #include "feat/wave-reader.h"
 #include "base/kaldi-error.h"
 #include "base/kaldi-utils.h"
+#include "util/kaldi-table.h"
 
 namespace kaldi {
 
-// static
-void WaveData::Expect4ByteTag(std::istream &is, const char *expected) {
+static void Expect4ByteTag(std::istream &is, const char *expected) {
   char tmp[5];
   tmp[4] = '\0';
   is.read(tmp, 4);
@@ -40,7 +41,7 @@ void WaveData::Expect4ByteTag(std::istream &is, const char *expected) {
     KALDI_ERR << "WaveData: expected " << expected << ", got " << tmp;
 }
 
-uint32 WaveData::ReadUint32(std::istream &is, bool swap) {
+static uint32 ReadUint32(std::istream &is, bool swap) {
   union {
     char result[4];
     uint32 ans;
@@ -54,7 +55,7 @@ uint32 WaveData::ReadUint32(std::istream &is, bool swap) {
 }
 
 
-uint16 WaveData::ReadUint16(std::istream &is, bool swap) {
+static uint16 ReadUint16(std::istream &is, bool swap) {
   union {
     char result[2];
     int16 ans;
@@ -67,8 +68,7 @@ uint16 WaveData::ReadUint16(std::istream &is, bool swap) {
   return u.ans;
 }
 
-// static
-void WaveData::Read4ByteTag(std::istream &is, char *dest) {
+static void Read4ByteTag(std::istream &is, char *dest) {
   is.read(dest, 4);
   if (is.fail())
     KALDI_ERR << "WaveData: expected 4-byte chunk-name, got read errror";
@@ -105,8 +105,11 @@ void WaveData::WriteUint16(std::ostream &os, int16 i) {
 
 
 
-void WaveData::Read(std::istream &is) {
-  data_.Resize(0, 0);  // clear the data.
+void WaveStreamReader::Open(std::istream &is) {
+  is_ = NULL;
+  samples_read_ = 0;
+  num_samples_ = 0;
+  extra_bytes_ = 0;
 
   char tmp[5];
   tmp[4] = '\0';
@@ -148,7 +151,6 @@ void WaveData::Read(std::istream &is) {
 
   if (num_channels <= 0)
     KALDI_ERR << "WaveData: no channels present";
-  samp_freq_ = static_cast<BaseFloat>(sample_rate);
   if (bits_per_sample != 8 && bits_per_sample != 16 && bits_per_sample != 32)
     KALDI_ERR << "WaveData: bits_per_sample is " << bits_per_sample;
   if (byte_rate != sample_rate * bits_per_sample/8 * num_channels)
@@ -200,79 +202,162 @@ void WaveData::Read(std::istream &is) {
               << " + " << data_chunk_size << " bytes "
               << "(we do not support reading multiple data chunks).";
   }
+  if (data_chunk_size == 0)
+    KALDI_ERR << "WaveData: empty file (no data)";
+
+  is_ = &is;
+  samp_freq_ = static_cast<BaseFloat>(sample_rate);
+  num_channels_ = num_channels;
+  bytes_per_sample_ = bits_per_sample / 8;
+  swap_ = swap;
+  num_samples_ = data_chunk_size / block_align;
+  // Any bytes of an incomplete sample at the end are read and ignored.
+  extra_bytes_ = data_chunk_size % block_align;
+}
 
-  std::vector<char*> data_pointer_vec;
-  std::vector<int> data_size_vec;
-  uint32 num_bytes_read = 0;
-  for (int32 remain_chunk_size = data_chunk_size; remain_chunk_size > 0;
-       remain_chunk_size -= kBlockSize) {
-    int32 this_block_size = remain_chunk_size;
-    if (kBlockSize < remain_chunk_size)
-      this_block_size = kBlockSize;
-    char *block_data_vec = new char[this_block_size];
-    is.read(block_data_vec, this_block_size);
-    num_bytes_read += is.gcount();
-    data_size_vec.push_back(is.gcount());
-    data_pointer_vec.push_back(block_data_vec);
-    if (num_bytes_read < this_block_size)
+int32 WaveStreamReader::Read(MatrixBase<BaseFloat> *data) {
+  KALDI_ASSERT(is_ != NULL && data->NumRows() == num_channels_);
+  int32 block_align = num_channels_ * bytes_per_sample_,
+      max_block_samples = std::max<int32>(1, kBlockSize / block_align),
+      num_wanted = std::min<int64>(data->NumCols(),
+                                   num_samples_ - samples_read_),
+      num_filled = 0;
+  BaseFloat *data_out = data->Data();
+  MatrixIndexT stride = data->Stride();
+
+  while (num_filled < num_wanted) {
+    int32 this_num = std::min(max_block_samples, num_wanted - num_filled);
+    buffer_.resize(this_num * block_align);
+    is_->read(&(buffer_[0]), this_num * block_align);
+    int32 bytes_read = is_->gcount(),
+        this_num_read = bytes_read / block_align;
+    const char *data_ptr = &(buffer_[0]);
+    for (int32 i = num_filled; i < num_filled + this_num_read; i++) {
+      for (int32 j = 0; j < num_channels_; j++) {
+        switch (bytes_per_sample_) {
+          case 1:
+            data_out[j * stride + i] = *data_ptr;
+            data_ptr++;
+            break;
+          case 2:
+            {
+              int16 k = *reinterpret_cast<const uint16*>(data_ptr);
+              if (swap_)
+                KALDI_SWAP2(k);
+              data_out[j * stride + i] =  k;
+              data_ptr += 2;
+              break;
+            }
+          case 4:
+            {
+              int32 k = *reinterpret_cast<const uint32*>(data_ptr);
+              if (swap_)
+                KALDI_SWAP4(k);
+              data_out[j * stride + i] =  k;
+              data_ptr += 4;
+              break;
+            }
+          default:
+            KALDI_ERR << "bytes per sample is " << bytes_per_sample_;  // already checked this.
+        }
+      }
+    }
+    num_filled += this_num_read;
+    samples_read_ += this_num_read;
+    if (this_num_read < this_num) {  // The stream ended early.
+      KALDI_WARN << "Read fewer samples than specified in the header: "
+                 << samples_read_ << " < " << num_samples_;
+      num_samples_ = samples_read_;
+      extra_bytes_ = 0;
       break;
+    }
   }
-
-  std::vector<char> chunk_data_vec(num_bytes_read);
-  uint32 data_address = 0;
-  for (int i = 0; i < data_pointer_vec.size(); i++) {
-    memcpy(&(chunk_data_vec[data_address]), data_pointer_vec[i],
-           data_size_vec[i]);
-    delete[] data_pointer_vec[i];
-    data_address += data_size_vec[i];
+  if (samples_read_ == num_samples_ && extra_bytes_ != 0) {
+    is_->ignore(extra_bytes_);
+    extra_bytes_ = 0;
   }
+  return num_filled;
+}
+
+
+void WaveData::Read(std::istream &is) {
+  // The number of samples we allocate space for before we start reading; see
+  // below.
+  const int32 kInitialSamples = 1 << 20;
+  data_.Resize(0, 0);  // clear the data.
 
-  char *data_ptr = &(chunk_data_vec[0]);
-  if (num_bytes_read == 0 && num_bytes_read != data_chunk_size) {
+  WaveStreamReader reader;
+  reader.Open(is);
+  samp_freq_ = reader.SampFreq();
+  // We read straight into data_, without any intermediate copy of the whole
+  // file.  We don't size it from the header up front, as for piped data or
+  // corrupt files the header may claim about 2^31 bytes; instead we start with
+  // at most kInitialSamples samples, double the size as it fills up, and trim
+  // it at the end.
+  int32 num_chan = reader.NumChannels(), num_samp = 0;
+  data_.Resize(num_chan, std::min<int64>(reader.NumSamples(), kInitialSamples),
+               kUndefined);
+  while (!reader.Done()) {
+    if (num_samp == data_.NumCols()) {
+      int64 new_size = std::min<int64>(reader.NumSamples(),
+                                       2 * static_cast<int64>(num_samp));
+      if (new_size > std::numeric_limits<MatrixIndexT>::max())
+        KALDI_ERR << "WaveData: file is too long (" << reader.NumSamples()
+                  << " samples according to header).";
+      data_.Resize(num_chan, new_size, kCopyData);
+    }
+    SubMatrix<BaseFloat> rest(data_, 0, num_chan, num_samp,
+                              data_.NumCols() - num_samp);
+    num_samp += reader.Read(&rest);
+  }
+  if (num_samp == 0)
     KALDI_ERR << "WaveData: failed to read data chunk (read no bytes)";
-  } else if (num_bytes_read != data_chunk_size) {
-    KALDI_ASSERT(num_bytes_read < data_chunk_size);
-    KALDI_WARN << "Read fewer bytes than specified in the header: "
-               << num_bytes_read << " < " << data_chunk_size;    
+  if (num_samp < data_.NumCols())
+    data_.Resize(num_chan, num_samp, kCopyData);
+}
+
+
+std::string SequentialWaveStreamReader::Key() const {
+  KALDI_ASSERT(!Done());
+  return script_[index_].first;
+}
+
+bool SequentialWaveStreamReader::Open(const std::string &wav_rspecifier) {
+  std::string script_rxfilename;
+  RspecifierType rs = ClassifyRspecifier(wav_rspecifier, &script_rxfilename,
+                                         NULL);
+  if (rs != kScriptRspecifier) {
+    KALDI_WARN << "Reading wave files in pieces requires a script-file "
+               << "(scp:) rspecifier, got " << wav_rspecifier;
+    return false;
   }
-  
-  if (data_chunk_size == 0)
-    KALDI_ERR << "WaveData: empty file (no data)";
-  
-  uint32 num_samp = num_bytes_read / block_align;
-  data_.Resize(num_channels, num_samp);
-  for (uint32 i = 0; i < num_samp; i++) {
-    for (uint32 j = 0; j < num_channels; j++) {
-      switch (bits_per_sample) {
-        case 8:
-          data_(j, i) = *data_ptr;
-          data_ptr++;
-          break;
-        case 16:
-          {
-            int16 k = *reinterpret_cast<uint16*>(data_ptr);
-            if (swap)
-              KALDI_SWAP2(k);
-            data_(j, i) =  k;
-            data_ptr += 2;
-            break;
-          }
-        case 32:
-          {
-            int32 k = *reinterpret_cast<uint32*>(data_ptr);
-            if (swap)
-              KALDI_SWAP4(k);
-            data_(j, i) =  k;
-            data_ptr += 4;
-            break;
-          }
-        default:
-          KALDI_ERR << "bits per sample is " << bits_per_sample;  // already checked this.
-      }
-    }
+  script_.clear();
+  index_ = 0;
+  opened_ = false;
+  return ReadScriptFile(script_rxfilename, true, &script_);
+}
+
+WaveStreamReader &SequentialWaveStreamReader::Value() {
+  KALDI_ASSERT(!Done());
+  if (!opened_) {
+    const std::string &rxfilename = script_[index_].second;
+    if (!input_.Open(rxfilename))  // wave files have no binary-mode header.
+      KALDI_ERR << "Failed to open wave file "
+                << PrintableRxfilename(rxfilename);
+    reader_.Open(input_.Stream());
+    opened_ = true;
   }
+  return reader_;
 }
 
+void SequentialWaveStreamReader::Next() {
+  KALDI_ASSERT(!Done());
+  if (opened_) {
+    input_.Close();
+    opened_ = false;
+  }
+  index_++;
+}
 
 // Write 16-bit PCM.
 
@@ -44,10 +44,12 @@
 #define KALDI_FEAT_WAVE_READER_H_
 
 #include <cstring>
+#include <vector>
 
 #include "base/kaldi-types.h"
 #include "matrix/kaldi-vector.h"
 #include "matrix/kaldi-matrix.h"
+#include "util/kaldi-io.h"
 
 
 namespace kaldi {
@@ -89,20 +91,68 @@ class WaveData {
     samp_freq_ = 0.0;
   }
 
+  void Swap(WaveData *other) {
+    data_.Swap(&(other->data_));
+    std::swap(samp_freq_, other->samp_freq_);
+  }
+
  private:
-  static const uint32 kBlockSize = 1048576;  // 1024 * 1024, use 1M bytes
   Matrix<BaseFloat> data_;
   BaseFloat samp_freq_;
-  static void Expect4ByteTag(std::istream &is, const char *expected);
-  uint32 ReadUint32(std::istream &is, bool swap);
-  uint16 ReadUint16(std::istream &is, bool swap);
-  static void Read4ByteTag(std::istream &is, char *dest);
 
   static void WriteUint32(std::ostream &os, int32 i);
   static void WriteUint16(std::ostream &os, int16 i);
 };
 
 
+/// This class reads a wave file from a stream a piece at a time, so that long
+/// recordings can be processed without holding all of the samples in memory.
+/// WaveData::Read() uses it too.
+class WaveStreamReader {
+ public:
+  WaveStreamReader(): is_(NULL), samp_freq_(0.0), num_channels_(0),
+                      bytes_per_sample_(0), swap_(false), num_samples_(0),
+                      samples_read_(0), extra_bytes_(0) { }
+
+  /// Reads the header of the wave file, and leaves "is" positioned at the
+  /// start of the samples.  Will throw on error.  "is" should be opened in
+  /// binary mode, and must stay valid while we call Read().
+  void Open(std::istream &is);
+
+  BaseFloat SampFreq() const { return samp_freq_; }
+
+  int32 NumChannels() const { return num_channels_; }
+
+  /// Returns the number of samples (per channel) according to the header.
+  int64 NumSamples() const { return num_samples_; }
+
+  /// Returns the duration in seconds according to the header.
+  BaseFloat Duration() const { return num_samples_ / samp_freq_; }
+
+  /// Reads the next samples into "data", which must have NumChannels() rows;
+  /// fills up to data->NumCols() samples and returns the number filled, which
+  /// will be less only at the end of the data (it will warn if the stream ends
+  /// before the header said it should).  Will throw on read errors.
+  int32 Read(MatrixBase<BaseFloat> *data);
+
+  /// Returns true once all samples have been read.
+  bool Done() const { return samples_read_ == num_samples_; }
+
+ private:
+  static const uint32 kBlockSize = 1048576;  // 1024 * 1024, use 1M bytes
+
+  std::istream *is_;
+  BaseFloat samp_freq_;
+  int32 num_channels_;
+  int32 bytes_per_sample_;
+  bool swap_;
+  int64 num_samples_;
+  int64 samples_read_;
+  int32 extra_bytes_;  // Bytes after the last whole sample, to skip at the end.
+  std::vector<char> buffer_;  // Raw data of at most kBlockSize bytes.
+};
+
+
 
 
 // Holder class for .wav files that enables us to read (but not write)
@@ -130,6 +180,8 @@ class WaveHolder {
 
   void Clear() { t_.Clear(); }
 
+  void Swap(WaveHolder *other) { t_.Swap(&(other->t_)); }
+
   const T &Value() { return t_; }
 
   WaveHolder &operator = (const WaveHolder &other) {
@@ -156,6 +208,40 @@ class WaveHolder {
 };
 
 
+
+/// This class iterates over the wave files listed in a script file, like
+/// SequentialTableReader<WaveHolder> with a "scp:" rspecifier, but instead of
+/// reading each file into memory it opens it and gives access to a
+/// WaveStreamReader positioned after the header.  It is used by the feature
+/// extraction programs when processing long recordings in chunks.  Only "scp:"
+/// rspecifiers are accepted, as a file inside an archive cannot be read a piece
+/// at a time without reading what comes after it.
+class SequentialWaveStreamReader {
+ public:
+  SequentialWaveStreamReader(): index_(0), opened_(false) { }
+
+  /// Reads the script file; returns false on error.
+  bool Open(const std::string &wav_rspecifier);
+
+  bool Done() const { return index_ >= script_.size(); }
+
+  std::string Key() const;
+
+  /// Opens the wave file for the current key and reads its header.  Will
+  /// throw on error (the caller may catch this and call Next()).
+  WaveStreamReader &Value();
+
+  void Next();
+
+ private:
+  std::vector<std::pair<std::string, std::string> > script_;
+  size_t index_;
+  Input input_;
+  WaveStreamReader reader_;
+  bool opened_;  // True if input_ and reader_ are open for the current key.
+};
+
+
 }  // namespace kaldi
 
 #endif  // KALDI_FEAT_WAVE_READER_H_
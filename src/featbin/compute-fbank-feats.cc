@@ -21,6 +21,7 @@
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "feat/feature-fbank.h"
+#include "feat/online-feature.h"
 #include "feat/wave-reader.h"
 
 
@@ -45,6 +46,8 @@ int main(int argc, char *argv[]) {
 
     // Register the option struct
     fbank_opts.Register(&po);
+    SequentialFeatureWaveReader reader;
+    reader.Register(&po);
     // Register the options
     po.Register("output-format", &output_format, "Format of the output files [kaldi, htk]");
     po.Register("subtract-mean", &subtract_mean, "Subtract mean of each feature file [CMS]; not recommended to do it this way. ");
@@ -71,7 +74,9 @@ int main(int argc, char *argv[]) {
 
     Fbank fbank(fbank_opts);
 
-    SequentialTableReader<WaveHolder> reader(wav_rspecifier);
+    if (!reader.Open(wav_rspecifier))
+      KALDI_ERR << "Could not open wave files from rspecifier "
+                << wav_rspecifier;
     BaseFloatMatrixWriter kaldi_writer;  // typedef to TableWriter<something>.
     TableWriter<HtkMatrixHolder> htk_writer;
 
@@ -97,13 +102,13 @@ int main(int argc, char *argv[]) {
     for (; !reader.Done(); reader.Next()) {
       num_utts++;
       std::string utt = reader.Key();
-      const WaveData &wave_data = reader.Value();
-      if (wave_data.Duration() < min_duration) {
+      BaseFloat duration = reader.Duration();
+      if (duration < min_duration) {
         KALDI_WARN << "File: " << utt << " is too short ("
-                   << wave_data.Duration() << " sec): producing no output.";
+                   << duration << " sec): producing no output.";
         continue;
       }
-      int32 num_chan = wave_data.Data().NumRows(), this_chan = channel;
+      int32 num_chan = reader.NumChannels(), this_chan = channel;
       {  // This block works out the channel (0=left, 1=right...)
         KALDI_ASSERT(num_chan > 0);  // should have been caught in
         // reading code if no channels.
@@ -132,16 +137,16 @@ int main(int argc, char *argv[]) {
       } else {
         vtln_warp_local = vtln_warp;
       }
-      if (fbank_opts.frame_opts.samp_freq != wave_data.SampFreq())
+      if (fbank_opts.frame_opts.samp_freq != reader.SampFreq())
         KALDI_ERR << "Sample frequency mismatch: you specified "
                   << fbank_opts.frame_opts.samp_freq << " but data has "
-                  << wave_data.SampFreq() << " (use --sample-frequency "
+                  << reader.SampFreq() << " (use --sample-frequency "
                   << "option).  Utterance is " << utt;
 
-      SubVector<BaseFloat> waveform(wave_data.Data(), this_chan);
       Matrix<BaseFloat> features;
       try {
-        fbank.Compute(waveform, vtln_warp_local, &features, NULL);
+        reader.Compute(fbank_opts, &fbank, vtln_warp_local, this_chan,
+                       &features);
       } catch (...) {
         KALDI_WARN << "Failed to compute features for utterance "
                    << utt;
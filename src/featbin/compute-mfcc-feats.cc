@@ -21,6 +21,7 @@
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "feat/feature-mfcc.h"
+#include "feat/online-feature.h"
 #include "feat/wave-reader.h"
 
 int main(int argc, char *argv[]) {
@@ -44,6 +45,8 @@ int main(int argc, char *argv[]) {
 
     // Register the MFCC option struct
     mfcc_opts.Register(&po);
+    SequentialFeatureWaveReader reader;
+    reader.Register(&po);
 
     // Register the options
     po.Register("output-format", &output_format, "Format of the output "
@@ -74,7 +77,9 @@ int main(int argc, char *argv[]) {
 
     Mfcc mfcc(mfcc_opts);
 
-    SequentialTableReader<WaveHolder> reader(wav_rspecifier);
+    if (!reader.Open(wav_rspecifier))
+      KALDI_ERR << "Could not open wave files from rspecifier "
+                << wav_rspecifier;
     BaseFloatMatrixWriter kaldi_writer;  // typedef to TableWriter<something>.
     TableWriter<HtkMatrixHolder> htk_writer;
 
@@ -100,13 +105,13 @@ int main(int argc, char *argv[]) {
     for (; !reader.Done(); reader.Next()) {
       num_utts++;
       std::string utt = reader.Key();
-      const WaveData &wave_data = reader.Value();
-      if (wave_data.Duration() < min_duration) {
+      BaseFloat duration = reader.Duration();
+      if (duration < min_duration) {
         KALDI_WARN << "File: " << utt << " is too short ("
-                   << wave_data.Duration() << " sec): producing no output.";
+                   << duration << " sec): producing no output.";
         continue;
       }
-      int32 num_chan = wave_data.Data().NumRows(), this_chan = channel;
+      int32 num_chan = reader.NumChannels(), this_chan = channel;
       {  // This block works out the channel (0=left, 1=right...)
         KALDI_ASSERT(num_chan > 0);  // should have been caught in
         // reading code if no channels.
@@ -135,16 +140,16 @@ int main(int argc, char *argv[]) {
       } else {
         vtln_warp_local = vtln_warp;
       }
-      if (mfcc_opts.frame_opts.samp_freq != wave_data.SampFreq())
+      if (mfcc_opts.frame_opts.samp_freq != reader.SampFreq())
         KALDI_ERR << "Sample frequency mismatch: you specified "
                   << mfcc_opts.frame_opts.samp_freq << " but data has "
-                  << wave_data.SampFreq() << " (use --sample-frequency "
+                  << reader.SampFreq() << " (use --sample-frequency "
                   << "option).  Utterance is " << utt;
 
-      SubVector<BaseFloat> waveform(wave_data.Data(), this_chan);
       Matrix<BaseFloat> features;
       try {
-        mfcc.Compute(waveform, vtln_warp_local, &features, NULL);
+        reader.Compute(mfcc_opts, &mfcc, vtln_warp_local, this_chan,
+                       &features);
       } catch (...) {
         KALDI_WARN << "Failed to compute features for utterance "
                    << utt;
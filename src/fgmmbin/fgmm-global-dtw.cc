@@ -1,4 +1,4 @@
-// ivectorbin/ivector-compute-distance.cc
+// fgmmbin/fgmm-global-dtw.cc
 
 // Copyright 2013  Daniel Povey
 
@@ -18,54 +18,143 @@
 // limitations under the License.
 
 
+#include <list>
+
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
-#include "gmm/am-diag-gmm.h"
-#include "hmm/posterior.h"
-#include "base/kaldi-math.h"
+#include "hmm/posterior-dtw.h"
+#include "thread/kaldi-mutex.h"
+#include "thread/kaldi-task-sequence.h"
 
-using std::pair;
-using std::vector;
 using namespace kaldi;
 
-double post_distance(const vector<pair<int,float> > &post1, const vector<pair<int,float> > &post2) {
-  double score = 0;
-  for (int i = 0; i < post1.size(); i++) {
-    for (int j = 0; j < post2.size(); j++) {
-      if (post1[i].first == post2[j].first)
-        score += post1[i].second * post2[j].second;
+// The posteriors of the utterances of one table, in the form that
+// PosteriorDtwDistance() needs.  Each is set up the first time it appears in a
+// trial and kept, as utterances usually appear in many trials, but only the
+// "max_size" most recently used ones that are not in use by a trial are kept.
+class DtwUtteranceCache {
+ public:
+  DtwUtteranceCache(RandomAccessPosteriorReader *reader, int32 max_size):
+      reader_(reader), max_size_(max_size) { }
+
+  // Returns the posteriors of utterance "key", or NULL if it is not present or
+  // its posteriors are empty.  If not NULL, it stays valid until Release() is
+  // called for it.  Only to be called from one thread.
+  const PosteriorDtwUtterance *Acquire(const std::string &key) {
+    mutex_.Lock();
+    MapType::iterator iter = map_.find(key);
+    if (iter != map_.end()) {
+      lru_.splice(lru_.begin(), lru_, iter->second.lru_pos);
+    } else {
+      // The reader is only used from this thread.
+      mutex_.Unlock();
+      if (!reader_->HasKey(key) || reader_->Value(key).empty())
+        return NULL;
+      PosteriorDtwUtterance *utt =
+          new PosteriorDtwUtterance(reader_->Value(key));
+      mutex_.Lock();
+      lru_.push_front(key);
+      Entry entry;
+      entry.utt = utt;
+      entry.num_users = 0;
+      entry.lru_pos = lru_.begin();
+      iter = map_.insert(std::make_pair(key, entry)).first;
     }
+    iter->second.num_users++;
+    const PosteriorDtwUtterance *ans = iter->second.utt;
+    Evict();
+    mutex_.Unlock();
+    return ans;
   }
-  if (score == 0)
-    return kMinLogDiffDouble;
-  else
-    return std::log(score);
-}
-
 
-double posts_distance(const Posterior & post1, const Posterior & post2) {
-  double mismatchPenalty = 0;
-  int numFrames1 = post1.size();
-  int numFrames2 = post2.size();
-  Matrix<double> bestPath (numFrames1, numFrames2);
-  bestPath(0,0) = post_distance(post1[0], post2[0]);
-  for (int i = 1; i < numFrames1; i++) {
-    bestPath(i,0) = post_distance(post1[i], post2[0]) + bestPath(i-1,0) + mismatchPenalty;
+  // Says that a trial no longer uses utterance "key"; may be called from any
+  // thread.
+  void Release(const std::string &key) {
+    mutex_.Lock();
+    MapType::iterator iter = map_.find(key);
+    KALDI_ASSERT(iter != map_.end() && iter->second.num_users > 0);
+    iter->second.num_users--;
+    Evict();
+    mutex_.Unlock();
   }
-  for (int j = 1; j < numFrames2; j++) {
-    bestPath(0,j) = post_distance(post1[0], post2[j]) + bestPath(0, j-1) + mismatchPenalty;
+
+  ~DtwUtteranceCache() {
+    for (MapType::iterator iter = map_.begin(); iter != map_.end(); ++iter)
+      delete iter->second.utt;
   }
-  for (int i = 1; i < numFrames1; i++) {
-    for (int j = 1; j < numFrames2; j++) {
-      double path1Score = bestPath(i,j-1) + mismatchPenalty; // horizontal path
-      double path2Score = bestPath(i-1,j) + mismatchPenalty; // vertical path
-      double path3Score = bestPath(i-1,j-1); // diagnoal path
-      double bestScore = LogAdd(LogAdd(path1Score, path2Score), path3Score);
-      bestPath(i,j) = bestScore + post_distance(post1[i],post2[j]);
+
+ private:
+  struct Entry {
+    PosteriorDtwUtterance *utt;
+    int32 num_users;  // The number of trials in progress that use it.
+    std::list<std::string>::iterator lru_pos;
+  };
+  typedef unordered_map<std::string, Entry, StringHasher> MapType;
+
+  // Deletes the least recently used utterances that are not in use, while
+  // there are more than max_size_.  Called with mutex_ held.
+  void Evict() {
+    std::list<std::string>::iterator pos = lru_.end();
+    while (map_.size() > static_cast<size_t>(max_size_) &&
+           pos != lru_.begin()) {
+      --pos;
+      MapType::iterator iter = map_.find(*pos);
+      if (iter->second.num_users == 0) {
+        delete iter->second.utt;
+        map_.erase(iter);
+        pos = lru_.erase(pos);
+      }
     }
   }
-  return bestPath(numFrames1-1, numFrames2-1);
-}
+
+  RandomAccessPosteriorReader *reader_;
+  int32 max_size_;
+  Mutex mutex_;
+  MapType map_;
+  std::list<std::string> lru_;  // Keys in map_, most recently used first.
+};
+
+
+// Scores one trial; the output happens in the destructor, so the trials are
+// written in order when run by TaskSequencer.  The destructor also releases
+// the utterances, which must have been acquired from "cache1" and "cache2".
+class DtwTask {
+ public:
+  DtwTask(const PosteriorDtwOptions &opts, const std::string &key1,
+          const std::string &key2, const PosteriorDtwUtterance &utt1,
+          const PosteriorDtwUtterance &utt2, DtwUtteranceCache *cache1,
+          DtwUtteranceCache *cache2, std::ostream *os, double *tot_score):
+      opts_(opts), key1_(key1), key2_(key2), utt1_(utt1), utt2_(utt2),
+      cache1_(cache1), cache2_(cache2), os_(os), tot_score_(tot_score),
+      score_(0.0) { }
+
+  void operator () () {
+    double distance = PosteriorDtwDistance(utt1_, utt2_, opts_);
+    if (opts_.subsequence)
+      score_ = distance / utt1_.NumFrames();
+    else
+      score_ = distance / ((utt1_.NumFrames() + utt2_.NumFrames()) / 2);
+  }
+
+  ~DtwTask() {
+    *tot_score_ += score_;
+    *os_ << key1_ << ' ' << key2_ << ' ' << score_ << std::endl;
+    cache1_->Release(key1_);
+    cache2_->Release(key2_);
+  }
+
+ private:
+  const PosteriorDtwOptions &opts_;
+  std::string key1_;
+  std::string key2_;
+  const PosteriorDtwUtterance &utt1_;
+  const PosteriorDtwUtterance &utt2_;
+  DtwUtteranceCache *cache1_;
+  DtwUtteranceCache *cache2_;
+  std::ostream *os_;
+  double *tot_score_;
+  BaseFloat score_;
+};
 
 
 int main(int argc, char *argv[]) {
@@ -80,6 +169,8 @@ int main(int argc, char *argv[]) {
         "<key1> <key2> [<distance>]\n"
         "(if either key could not be found, the distance field in the output\n"
         "will be absent, and this program will print a warning)\n"
+        "With --subsequence=true, <key1> is a query that is searched for\n"
+        "anywhere in <key2>, as for query-by-example search.\n"
         "\n"
         "Usage:  fgmm-global-dtw [options] <trials-in> "
         "<post-rspecifier> <post2-rspecifier> <scores-out>\n"
@@ -87,6 +178,14 @@ int main(int argc, char *argv[]) {
         " fgmm-global-dtw trials ark:post.ark ark:post2.ark trials.scored\n";
     
     ParseOptions po(usage);
+    PosteriorDtwOptions dtw_opts;
+    TaskSequencerConfig sequencer_config;
+    int32 cache_size = 1000;
+    dtw_opts.Register(&po);
+    po.Register("cache-size", &cache_size, "Maximum number of utterances of "
+                "each table whose posteriors are kept between trials (more "
+                "may be kept while in use by trials in progress)");
+    sequencer_config.Register(&po);
     
     po.Read(argc, argv);
     
@@ -112,7 +211,11 @@ int main(int argc, char *argv[]) {
     Output ko(scores_wxfilename, binary);
     double sum = 0.0;
 
+    // These must outlive "sequencer".
+    DtwUtteranceCache utt1_cache(&post1_reader, cache_size),
+        utt2_cache(&post2_reader, cache_size);
     std::string line;
+    TaskSequencer<DtwTask> sequencer(sequencer_config);
     while (std::getline(ki.Stream(), line)) {
       std::vector<std::string> fields;
       SplitStringToVector(line, " \t\n\r", true, &fields);
@@ -131,17 +234,26 @@ int main(int argc, char *argv[]) {
         num_err++;
         continue;
       }
-      const Posterior &post1 = post1_reader.Value(key1),
-          &post2 = post2_reader.Value(key2);
-      // The following will crash if the dimensions differ, but
-      // they would likely also differ for all the posts so it's probably
-      // best to just crash.
-      BaseFloat score = posts_distance(post1, post2) / ((post1.size()+post2.size())/2);
-      sum += score;
+      const PosteriorDtwUtterance *utt1 = utt1_cache.Acquire(key1);
+      if (utt1 == NULL) {
+        KALDI_WARN << "Empty posteriors for trial " << key1 << ' ' << key2;
+        num_err++;
+        continue;
+      }
+      const PosteriorDtwUtterance *utt2 = utt2_cache.Acquire(key2);
+      if (utt2 == NULL) {
+        KALDI_WARN << "Empty posteriors for trial " << key1 << ' ' << key2;
+        utt1_cache.Release(key1);
+        num_err++;
+        continue;
+      }
+      sequencer.Run(new DtwTask(dtw_opts, key1, key2, *utt1, *utt2,
+                                &utt1_cache, &utt2_cache, &(ko.Stream()),
+                                &sum));
       num_done++;
-      ko.Stream() << key1 << ' ' << key2 << ' ' << score << std::endl;
     }
-    
+    sequencer.Wait();
+
     if (num_done != 0) {
       BaseFloat mean = sum / num_done;
       KALDI_LOG << "Mean distance was " << mean ;
@@ -0,0 +1,69 @@
+// fstbin/fstmakemapped.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "fst/fstlib.h"
+#include "fstext/fstext-utils.h"
+#include "fstext/mapped-fst.h"
+
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace fst;
+    using kaldi::int32;
+
+    const char *usage =
+        "Convert an FST (e.g. a decoding graph HCLG.fst) to the read-only\n"
+        "\"mapped\" format, which decoding programs such as gmm-latgen-faster\n"
+        "can mmap instead of reading into memory, so that all the decoding jobs\n"
+        "on a machine share one copy of the graph.  The output should be an\n"
+        "ordinary file.  Symbol tables are not preserved.\n"
+        "\n"
+        "Usage:  fstmakemapped [in.fst] out.fst\n"
+        "E.g.:  fstmakemapped exp/tri3/graph/HCLG.fst exp/tri3/graph/HCLG.mapped.fst\n";
+
+    ParseOptions po(usage);
+    po.Read(argc, argv);
+
+    if (po.NumArgs() < 1 || po.NumArgs() > 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string fst_in_filename = (po.NumArgs() == 2 ? po.GetArg(1) : ""),
+        fst_out_filename = po.GetArg(po.NumArgs());
+
+    if (ClassifyWxfilename(fst_out_filename) != kFileOutput)
+      KALDI_WARN << "Writing mapped FST to something other than an ordinary "
+                 << "file; it will not be possible to mmap it.";
+
+    VectorFst<StdArc> *fst = ReadFstKaldi(fst_in_filename);
+    WriteMappedFst(*fst, fst_out_filename);
+    KALDI_LOG << "Wrote mapped FST with " << fst->NumStates() << " states to "
+              << PrintableWxfilename(fst_out_filename);
+    delete fst;
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
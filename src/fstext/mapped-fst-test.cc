@@ -0,0 +1,79 @@
+// fstext/mapped-fst-test.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "fstext/mapped-fst.h"
+#include "fstext/rand-fst.h"
+#include "fstext/fstext-utils.h"
+
+namespace fst {
+
+static void TestMappedFst() {
+  typedef StdArc Arc;
+  VectorFst<Arc> *fst = RandFst<Arc>();
+  ArcSort(fst, ILabelCompare<Arc>());
+
+  std::string filename = "tmpf";
+  WriteMappedFst(*fst, filename);
+  KALDI_ASSERT(MappedFst::IsMappedFstFile(filename));
+
+  MappedFst *mapped = MappedFst::Read(filename);
+  KALDI_ASSERT(mapped != NULL);
+  KALDI_ASSERT(mapped->NumStates() == fst->NumStates());
+  KALDI_ASSERT(mapped->Start() == fst->Start());
+  KALDI_ASSERT(mapped->Properties(kILabelSorted, false) == kILabelSorted);
+  for (StateIterator<MappedFst> siter(*mapped); !siter.Done(); siter.Next()) {
+    Arc::StateId s = siter.Value();
+    KALDI_ASSERT(mapped->NumInputEpsilons(s) == fst->NumInputEpsilons(s));
+    KALDI_ASSERT(mapped->NumOutputEpsilons(s) == fst->NumOutputEpsilons(s));
+  }
+  {  // Converting back to a VectorFst should give the same FST.
+    VectorFst<Arc> fst2(*mapped);
+    KALDI_ASSERT(Equal(*fst, fst2));
+  }
+  {  // Copies share the data, and remain valid after the original is deleted.
+    MappedFst *copy = mapped->Copy();
+    delete mapped;
+    VectorFst<Arc> fst2(*copy);
+    KALDI_ASSERT(Equal(*fst, fst2));
+    delete copy;
+  }
+  {  // The generic reader should accept both formats.
+    Fst<Arc> *fst2 = ReadFstKaldiGeneric(filename);
+    KALDI_ASSERT(fst2->Type() == "mapped");
+    KALDI_ASSERT(Equal(*fst, VectorFst<Arc>(*fst2)));
+    delete fst2;
+    WriteFstKaldi(*fst, filename);
+    KALDI_ASSERT(!MappedFst::IsMappedFstFile(filename));
+    fst2 = ReadFstKaldiGeneric(filename);
+    KALDI_ASSERT(fst2->Type() == "vector");
+    KALDI_ASSERT(Equal(*fst, VectorFst<Arc>(*fst2)));
+    delete fst2;
+  }
+  std::remove(filename.c_str());
+  delete fst;
+}
+
+}  // end namespace fst
+
+int main() {
+  for (int i = 0; i < 10; i++)
+    fst::TestMappedFst();
+  std::cout << "Test OK\n";
+}
@@ -0,0 +1,241 @@
+// fstext/mapped-fst.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "fstext/mapped-fst.h"
+#include "fstext/fstext-utils.h"
+#include "util/kaldi-io.h"
+
+namespace fst {
+
+static const char kMappedFstMagic[8] = { 'K', 'M', 'A', 'P', 'F', 'S', 'T',
+                                         '\0' };
+static const int32 kMappedFstVersion = 1;
+
+struct MappedFst::Region {
+  char *data;
+  size_t size;
+  bool mapped;  // true if "data" came from mmap, false if from new [].
+  int32 ref_count;
+};
+
+
+MappedFst::MappedFst(Region *region): region_(region) {
+  const Header *header = reinterpret_cast<const Header*>(region->data);
+  start_ = header->start;
+  num_states_ = header->num_states;
+  properties_ = header->properties;
+  states_ = reinterpret_cast<const State*>(region->data + sizeof(Header));
+  arcs_ = reinterpret_cast<const Arc*>(region->data + sizeof(Header) +
+                                       sizeof(State) * header->num_states);
+}
+
+MappedFst::~MappedFst() {
+  if (--region_->ref_count == 0)
+    FreeRegion(region_);
+}
+
+void MappedFst::FreeRegion(Region *region) {
+#ifndef _MSC_VER
+  if (region->mapped) {
+    if (munmap(region->data, region->size) != 0)
+      KALDI_WARN << "Error unmapping FST: " << strerror(errno);
+  } else {
+    delete [] region->data;
+  }
+#else
+  delete [] region->data;
+#endif
+  delete region;
+}
+
+const std::string &MappedFst::Type() const {
+  static const std::string type = "mapped";
+  return type;
+}
+
+MappedFst *MappedFst::Copy(bool safe) const {
+  // The data is read-only, so even a "safe" copy can share it.
+  region_->ref_count++;
+  return new MappedFst(region_);
+}
+
+bool MappedFst::IsMappedFstFile(const std::string &filename) {
+  if (kaldi::ClassifyRxfilename(filename) != kaldi::kFileInput)
+    return false;
+  FILE *f = fopen(filename.c_str(), "rb");
+  if (f == NULL) return false;
+  char magic[sizeof(kMappedFstMagic)];
+  bool ans = (fread(magic, 1, sizeof(magic), f) == sizeof(magic) &&
+              memcmp(magic, kMappedFstMagic, sizeof(magic)) == 0);
+  fclose(f);
+  return ans;
+}
+
+MappedFst *MappedFst::Read(const std::string &filename) {
+  if (kaldi::ClassifyRxfilename(filename) != kaldi::kFileInput) {
+    KALDI_WARN << "Mapped FSTs can only be read from ordinary files, not "
+               << kaldi::PrintableRxfilename(filename);
+    return NULL;
+  }
+  Region *region = new Region;
+  region->ref_count = 1;
+#ifndef _MSC_VER
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    KALDI_WARN << "Could not open " << filename << ": " << strerror(errno);
+    delete region;
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(Header)) {
+    KALDI_WARN << "Mapped FST file " << filename << " is too small or could "
+               << "not be stat'ed.";
+    close(fd);
+    delete region;
+    return NULL;
+  }
+  region->size = st.st_size;
+  void *data = mmap(NULL, region->size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);  // the mapping stays valid after the descriptor is closed.
+  if (data == MAP_FAILED) {
+    KALDI_WARN << "Could not mmap " << filename << ": " << strerror(errno);
+    delete region;
+    return NULL;
+  }
+  region->data = static_cast<char*>(data);
+  region->mapped = true;
+#else
+  // No mmap available; fall back to reading the whole file into memory.
+  FILE *f = fopen(filename.c_str(), "rb");
+  if (f == NULL) {
+    KALDI_WARN << "Could not open " << filename;
+    delete region;
+    return NULL;
+  }
+  fseek(f, 0, SEEK_END);
+  region->size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  region->data = new char[region->size];
+  region->mapped = false;
+  size_t size_read = fread(region->data, 1, region->size, f);
+  fclose(f);
+  if (size_read != region->size || region->size < sizeof(Header)) {
+    KALDI_WARN << "Error reading mapped FST from " << filename;
+    delete [] region->data;
+    delete region;
+    return NULL;
+  }
+#endif
+  const Header *header = reinterpret_cast<const Header*>(region->data);
+  bool ok = true;
+  if (memcmp(header->magic, kMappedFstMagic, sizeof(kMappedFstMagic)) != 0) {
+    KALDI_WARN << "File " << filename << " is not a mapped FST (bad magic).";
+    ok = false;
+  } else if (header->version != kMappedFstVersion) {
+    KALDI_WARN << "Mapped FST " << filename << " has unsupported version "
+               << header->version;
+    ok = false;
+  } else if (region->size != sizeof(Header) +
+             sizeof(State) * header->num_states +
+             sizeof(Arc) * header->num_arcs) {
+    KALDI_WARN << "Mapped FST " << filename << " has size " << region->size
+               << ", inconsistent with its header (truncated file?)";
+    ok = false;
+  }
+  if (!ok) {
+    FreeRegion(region);
+    return NULL;
+  }
+  return new MappedFst(region);
+}
+
+
+void WriteMappedFst(const ExpandedFst<StdArc> &fst,
+                    std::string wxfilename) {
+  typedef StdArc Arc;
+  typedef Arc::StateId StateId;
+  if (wxfilename == "") wxfilename = "-";  // interpret "" as stdout.
+
+  MappedFst::Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMappedFstMagic, sizeof(kMappedFstMagic));
+  header.version = kMappedFstVersion;
+  header.start = fst.Start();
+  header.num_states = fst.NumStates();
+  header.num_arcs = 0;
+  // Compute all the properties now, so the reader never has to.
+  header.properties = fst.Properties(kTrinaryProperties, true) | kExpanded;
+
+  std::vector<MappedFst::State> states(header.num_states);
+  for (StateId s = 0; s < header.num_states; s++) {
+    MappedFst::State &state = states[s];
+    memset(&state, 0, sizeof(state));
+    state.final = fst.Final(s).Value();
+    state.num_arcs = fst.NumArcs(s);
+    state.num_input_epsilons = fst.NumInputEpsilons(s);
+    state.num_output_epsilons = fst.NumOutputEpsilons(s);
+    state.arc_offset = header.num_arcs;
+    header.num_arcs += state.num_arcs;
+  }
+
+  bool binary = true, write_header = false;
+  kaldi::Output ko(wxfilename, binary, write_header);
+  std::ostream &os = ko.Stream();
+  os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  if (!states.empty())
+    os.write(reinterpret_cast<const char*>(&(states[0])),
+             sizeof(MappedFst::State) * states.size());
+  std::vector<Arc> arcs;
+  for (StateId s = 0; s < header.num_states; s++) {
+    arcs.clear();
+    for (ArcIterator<ExpandedFst<Arc> > aiter(fst, s); !aiter.Done();
+         aiter.Next())
+      arcs.push_back(aiter.Value());
+    if (!arcs.empty())
+      os.write(reinterpret_cast<const char*>(&(arcs[0])),
+               sizeof(Arc) * arcs.size());
+  }
+  if (!os.good() || !ko.Close())
+    KALDI_ERR << "Error writing mapped FST to "
+              << kaldi::PrintableWxfilename(wxfilename);
+}
+
+
+Fst<StdArc> *ReadFstKaldiGeneric(std::string rxfilename) {
+  if (MappedFst::IsMappedFstFile(rxfilename)) {
+    MappedFst *ans = MappedFst::Read(rxfilename);
+    if (ans == NULL)
+      KALDI_ERR << "Could not read mapped FST from " << rxfilename;
+    return ans;
+  }
+  return ReadFstKaldi(rxfilename);
+}
+
+}  // namespace fst
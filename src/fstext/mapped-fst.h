@@ -0,0 +1,160 @@
+// fstext/mapped-fst.h
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_FSTEXT_MAPPED_FST_H_
+#define KALDI_FSTEXT_MAPPED_FST_H_
+
+#include <string>
+#include <fst/fstlib.h>
+#include <fst/fst-decl.h>
+
+namespace fst {
+
+/*
+   MappedFst is a read-only FST on StdArc whose states and arcs are stored in
+   one contiguous block of memory, with a layout similar to OpenFst's ConstFst:
+   a fixed-size header, then an array of states, then all the arcs packed
+   together in state order.  When read from an ordinary file it is mmap'ed
+   rather than copied into memory, so loading it is nearly instantaneous and
+   all the processes on a machine that decode with the same graph (e.g. the
+   jobs of gmm-latgen-faster) share a single copy of it in the page cache.
+
+   The on-disk format is written by WriteMappedFst(), e.g. via the program
+   fstmakemapped.  It is in the machine's native byte order, and symbol tables
+   are not stored.  Decoders only need the Fst<StdArc> interface, so programs
+   that read decoding graphs should call ReadFstKaldiGeneric(), which accepts
+   either this format or the normal OpenFst format.
+*/
+class MappedFst: public ExpandedFst<StdArc> {
+ public:
+  typedef StdArc Arc;
+  typedef Arc::Weight Weight;
+  typedef Arc::StateId StateId;
+
+  /// Reads a MappedFst from a file in the format written by WriteMappedFst().
+  /// "filename" must be an actual file, not a pipe or a file with an offset.
+  /// Returns NULL on error.
+  static MappedFst *Read(const std::string &filename);
+
+  /// Returns true if "filename" is an ordinary file that starts with the
+  /// MappedFst magic string.  Does not print any errors.
+  static bool IsMappedFstFile(const std::string &filename);
+
+  virtual StateId Start() const { return start_; }
+
+  virtual Weight Final(StateId s) const { return Weight(states_[s].final); }
+
+  virtual StateId NumStates() const { return num_states_; }
+
+  virtual size_t NumArcs(StateId s) const { return states_[s].num_arcs; }
+
+  virtual size_t NumInputEpsilons(StateId s) const {
+    return states_[s].num_input_epsilons;
+  }
+
+  virtual size_t NumOutputEpsilons(StateId s) const {
+    return states_[s].num_output_epsilons;
+  }
+
+  /// The properties are computed when the FST is written, so they are all
+  /// known and "test" has no effect.
+  virtual uint64 Properties(uint64 mask, bool test) const {
+    return properties_ & mask;
+  }
+
+  virtual const std::string &Type() const;
+
+  /// Copying is cheap: the copy shares the underlying memory.
+  virtual MappedFst *Copy(bool safe = false) const;
+
+  virtual const SymbolTable *InputSymbols() const { return NULL; }
+
+  virtual const SymbolTable *OutputSymbols() const { return NULL; }
+
+  virtual void InitStateIterator(StateIteratorData<Arc> *data) const {
+    data->base = NULL;
+    data->nstates = num_states_;
+  }
+
+  /// Gives the arc iterator direct access to the arcs, so iterating
+  /// over them involves no copying or virtual function calls.
+  virtual void InitArcIterator(StateId s, ArcIteratorData<Arc> *data) const {
+    data->base = NULL;
+    data->arcs = arcs_ + states_[s].arc_offset;
+    data->narcs = states_[s].num_arcs;
+    data->ref_count = NULL;
+  }
+
+  virtual ~MappedFst();
+
+  // The following structs describe the on-disk (and in-memory) layout;
+  // they are public only so that WriteMappedFst() can use them.
+  struct Header {
+    char magic[8];
+    int32 version;
+    int32 start;
+    int64 num_states;
+    int64 num_arcs;
+    uint64 properties;
+  };
+  struct State {
+    float final;
+    int32 num_arcs;
+    int32 num_input_epsilons;
+    int32 num_output_epsilons;
+    int64 arc_offset;  // index of first arc of this state in the arc array.
+  };
+
+ private:
+  // Region is the block of memory that holds the FST; it is shared between
+  // copies of the FST and freed when the last of them is destroyed.
+  struct Region;
+
+  explicit MappedFst(Region *region);
+
+  static void FreeRegion(Region *region);
+
+  Region *region_;
+  StateId start_;
+  StateId num_states_;
+  uint64 properties_;
+  const State *states_;
+  const Arc *arcs_;
+
+  MappedFst &operator = (const MappedFst &other);  // Disallow.
+  MappedFst(const MappedFst &other);  // Disallow (use Copy()).
+};
+
+
+/// Writes "fst" in the format read by MappedFst::Read().  "wxfilename" is a
+/// Kaldi extended filename, but to get the benefits of mmap-ing, it should be
+/// an ordinary file.  Throws on error.
+void WriteMappedFst(const ExpandedFst<StdArc> &fst,
+                    std::string wxfilename);
+
+/// Reads an FST for use in decoding, where only the Fst<StdArc> interface is
+/// required.  If "rxfilename" is an ordinary file written by WriteMappedFst(),
+/// it is memory-mapped and a MappedFst is returned; otherwise this does the
+/// same as ReadFstKaldi() and returns a VectorFst.  Throws on error.  The
+/// caller owns the returned object.
+Fst<StdArc> *ReadFstKaldiGeneric(std::string rxfilename);
+
+}  // namespace fst
+
+#endif  // KALDI_FSTEXT_MAPPED_FST_H_
@@ -18,6 +18,7 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <vector>
 using std::vector;
 
@@ -32,6 +33,13 @@ BaseFloat DecodableAmDiagGmmUnmapped::LogLikelihoodZeroBased(
   KALDI_ASSERT(static_cast<size_t>(state) < static_cast<size_t>(NumIndices()) &&
                "Likely graph/model mismatch, e.g. using wrong HCLG.fst");
 
+  if (frame_block_size_ > 1) {
+    int32 start = block_start_[state];
+    if (start != -1 && frame >= start && frame < start + frame_block_size_)
+      return block_cache_(state, frame - start);
+    return ComputeBlock(frame, state);
+  }
+
   if (log_like_cache_[state].hit_time == frame) {
     return log_like_cache_[state].log_like;  // return cached value, if found
   }
@@ -71,6 +79,54 @@ BaseFloat DecodableAmDiagGmmUnmapped::LogLikelihoodZeroBased(
   return log_sum;
 }
 
+BaseFloat DecodableAmDiagGmmUnmapped::ComputeBlock(int32 frame, int32 state) {
+  const DiagGmm &pdf = acoustic_model_.GetPdf(state);
+  if (pdf.Dim() != feature_matrix_.NumCols()) {
+    KALDI_ERR << "Dim mismatch: data dim = "  << feature_matrix_.NumCols()
+        << " vs. model dim = " << pdf.Dim();
+  }
+  if (!pdf.valid_gconsts()) {
+    KALDI_ERR << "State "  << (state)  << ": Must call ComputeGconsts() "
+        "before computing likelihood.";
+  }
+  int32 num_frames = std::min(frame_block_size_, NumFramesReady() - frame),
+      dim = feature_matrix_.NumCols();
+  SubMatrix<BaseFloat> data(feature_matrix_, frame, num_frames, 0, dim),
+      data_sq(feats_squared_, frame, num_frames, 0, dim),
+      loglikes(block_loglikes_, 0, num_frames, 0, pdf.NumGauss());
+  pdf.LogLikelihoods(data, data_sq, &loglikes);
+
+  for (int32 i = 0; i < num_frames; i++) {
+    BaseFloat log_sum = loglikes.Row(i).LogSumExp(log_sum_exp_prune_);
+    if (KALDI_ISNAN(log_sum) || KALDI_ISINF(log_sum))
+      KALDI_ERR << "Invalid answer (overflow or invalid variances/features?)";
+    block_cache_(state, i) = log_sum;
+  }
+  block_start_[state] = frame;
+  return block_cache_(state, 0);
+}
+
+void DecodableAmDiagGmmUnmapped::SetFrameBlockSize(int32 block_size) {
+  KALDI_ASSERT(block_size >= 1);
+  frame_block_size_ = block_size;
+  if (block_size == 1) {
+    feats_squared_.Resize(0, 0);
+    block_cache_.Resize(0, 0);
+    block_loglikes_.Resize(0, 0);
+    block_start_.clear();
+    return;
+  }
+  feats_squared_ = feature_matrix_;
+  feats_squared_.ApplyPow(2.0);
+  int32 num_pdfs = acoustic_model_.NumPdfs(), max_gauss = 0;
+  for (int32 pdf = 0; pdf < num_pdfs; pdf++)
+    max_gauss = std::max(max_gauss, acoustic_model_.GetPdf(pdf).NumGauss());
+  block_cache_.Resize(num_pdfs, block_size, kUndefined);
+  block_loglikes_.Resize(block_size, max_gauss, kUndefined);
+  block_start_.clear();
+  block_start_.resize(num_pdfs, -1);
+}
+
 void DecodableAmDiagGmmUnmapped::ResetLogLikeCache() {
   if (static_cast<int32>(log_like_cache_.size()) != acoustic_model_.NumPdfs()) {
     log_like_cache_.resize(acoustic_model_.NumPdfs());
@@ -78,6 +134,7 @@ void DecodableAmDiagGmmUnmapped::ResetLogLikeCache() {
   vector<LikelihoodCacheRecord>::iterator it = log_like_cache_.begin(),
       end = log_like_cache_.end();
   for (; it != end; ++it) { it->hit_time = -1; }
+  std::fill(block_start_.begin(), block_start_.end(), -1);
 }
 
 
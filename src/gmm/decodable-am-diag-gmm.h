@@ -53,7 +53,7 @@ class DecodableAmDiagGmmUnmapped : public DecodableInterface {
                              BaseFloat log_sum_exp_prune = -1.0):
     acoustic_model_(am), feature_matrix_(feats),
     previous_frame_(-1), log_sum_exp_prune_(log_sum_exp_prune), 
-    data_squared_(feats.NumCols()) {
+    data_squared_(feats.NumCols()), frame_block_size_(1) {
     ResetLogLikeCache();
   }
 
@@ -72,6 +72,17 @@ class DecodableAmDiagGmmUnmapped : public DecodableInterface {
     return (frame == NumFramesReady() - 1);
   }
 
+  /// If you call this with block_size > 1, then the first time a pdf is
+  /// needed on a frame t, its likelihoods for frames t through
+  /// t + block_size - 1 are computed together (using matrix-matrix rather
+  /// than matrix-vector products, which is a lot faster) and cached.  This
+  /// trades some wasted computation on pdfs that get pruned away for much
+  /// better use of the CPU; block sizes of around 4 to 16 are reasonable.
+  /// The default, 1, gives the original frame-by-frame behavior.  This only
+  /// affects LogLikelihoodZeroBased() of this class, not of derived classes
+  /// that override it.
+  void SetFrameBlockSize(int32 block_size);
+
  protected:
   void ResetLogLikeCache();
   virtual BaseFloat LogLikelihoodZeroBased(int32 frame, int32 state_index);
@@ -88,8 +99,20 @@ class DecodableAmDiagGmmUnmapped : public DecodableInterface {
   };
   std::vector<LikelihoodCacheRecord> log_like_cache_;
  private:
+  // Computes the likelihoods of pdf "state" for a block of frames starting
+  // at "frame", caches them and returns the likelihood for "frame".
+  BaseFloat ComputeBlock(int32 frame, int32 state);
+
   Vector<BaseFloat> data_squared_;  ///< Cache for fast likelihood calculation
 
+  // The following are only used if frame_block_size_ > 1.
+  int32 frame_block_size_;
+  Matrix<BaseFloat> feats_squared_;  // elementwise square of feature_matrix_.
+  // block_cache_(s, i) is the likelihood of pdf s on frame
+  // block_start_[s] + i, if block_start_[s] != -1.
+  Matrix<BaseFloat> block_cache_;
+  std::vector<int32> block_start_;
+  Matrix<BaseFloat> block_loglikes_;  // temporary, frames by Gaussians.
 
   KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableAmDiagGmmUnmapped);
 };
@@ -0,0 +1,131 @@
+// gmm/diag-gmm-speed-test.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gmm/diag-gmm.h"
+#include "gmm/am-diag-gmm.h"
+#include "gmm/decodable-am-diag-gmm.h"
+#include "gmm/model-test-common.h"
+#include "base/timer.h"
+
+namespace kaldi {
+
+// Compares per-frame likelihood computation for a single GMM with the
+// version that does a block of frames at once.
+static void UnitTestDiagGmmLogLikelihoodsSpeed() {
+  int32 dim = 40, num_gauss = 16, num_frames = 1000;
+  DiagGmm gmm;
+  unittest::InitRandDiagGmm(dim, num_gauss, &gmm);
+  Matrix<BaseFloat> feats(num_frames, dim);
+  feats.SetRandn();
+
+  Matrix<BaseFloat> loglikes1(num_frames, num_gauss);
+  {
+    Timer t;
+    for (int32 iter = 0; iter < 10; iter++) {
+      Vector<BaseFloat> loglikes;
+      for (int32 t = 0; t < num_frames; t++) {
+        gmm.LogLikelihoods(feats.Row(t), &loglikes);
+        loglikes1.Row(t).CopyFromVec(loglikes);
+      }
+    }
+    KALDI_LOG << "For dim = " << dim << ", num-gauss = " << num_gauss
+              << ", per-frame LogLikelihoods took " << t.Elapsed()
+              << " seconds.";
+  }
+  Matrix<BaseFloat> feats_sq(feats);
+  feats_sq.ApplyPow(2.0);
+  std::vector<int32> block_sizes;
+  block_sizes.push_back(4);
+  block_sizes.push_back(8);
+  block_sizes.push_back(16);
+  for (size_t i = 0; i < block_sizes.size(); i++) {
+    int32 block_size = block_sizes[i];
+    Matrix<BaseFloat> loglikes2(num_frames, num_gauss);
+    Timer t;
+    for (int32 iter = 0; iter < 10; iter++) {
+      for (int32 start = 0; start < num_frames; start += block_size) {
+        int32 n = std::min(block_size, num_frames - start);
+        SubMatrix<BaseFloat> loglikes(loglikes2, start, n, 0, num_gauss);
+        gmm.LogLikelihoods(feats.Range(start, n, 0, dim),
+                           feats_sq.Range(start, n, 0, dim), &loglikes);
+      }
+    }
+    KALDI_LOG << "For dim = " << dim << ", num-gauss = " << num_gauss
+              << ", block size " << block_size << ", LogLikelihoods took "
+              << t.Elapsed() << " seconds.";
+    KALDI_ASSERT(loglikes1.ApproxEqual(loglikes2, 0.001));
+  }
+}
+
+// Compares DecodableAmDiagGmmUnmapped with and without frame blocks, with a
+// fraction of the pdfs active on each frame as in decoding.
+static void UnitTestDecodableBlockSpeed() {
+  int32 dim = 40, num_gauss = 16, num_pdfs = 500, num_frames = 300,
+      num_active = 100;
+  AmDiagGmm am;
+  for (int32 p = 0; p < num_pdfs; p++) {
+    DiagGmm gmm;
+    unittest::InitRandDiagGmm(dim, num_gauss, &gmm);
+    am.AddPdf(gmm);
+  }
+  Matrix<BaseFloat> feats(num_frames, dim);
+  feats.SetRandn();
+
+  // The active pdfs drift slowly over time, which is roughly what happens
+  // in decoding.
+  std::vector<std::vector<int32> > active(num_frames);
+  for (int32 t = 0; t < num_frames; t++) {
+    int32 offset = t / 10;
+    for (int32 i = 0; i < num_active; i++)
+      active[t].push_back((offset + i * 5) % num_pdfs);
+  }
+
+  std::vector<int32> block_sizes;
+  block_sizes.push_back(1);
+  block_sizes.push_back(4);
+  block_sizes.push_back(8);
+  block_sizes.push_back(16);
+  std::vector<BaseFloat> ref;
+  for (size_t i = 0; i < block_sizes.size(); i++) {
+    Timer timer;
+    DecodableAmDiagGmmUnmapped decodable(am, feats);
+    decodable.SetFrameBlockSize(block_sizes[i]);
+    std::vector<BaseFloat> ans;
+    for (int32 t = 0; t < num_frames; t++)
+      for (int32 j = 0; j < num_active; j++)
+        ans.push_back(decodable.LogLikelihood(t, active[t][j] + 1));
+    KALDI_LOG << "For " << num_pdfs << " pdfs, " << num_active
+              << " active per frame, frame block size " << block_sizes[i]
+              << ", decodable took " << timer.Elapsed() << " seconds.";
+    if (i == 0) {
+      ref = ans;
+    } else {
+      for (size_t k = 0; k < ans.size(); k++)
+        KALDI_ASSERT(ApproxEqual(ans[k], ref[k], 0.001));
+    }
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  kaldi::UnitTestDiagGmmLogLikelihoodsSpeed();
+  kaldi::UnitTestDecodableBlockSpeed();
+  std::cout << "Test OK.\n";
+}
@@ -561,6 +561,25 @@ void DiagGmm::LogLikelihoods(const MatrixBase<BaseFloat> &data,
   loglikes->AddMatMat(-0.5, data_sq, kNoTrans, inv_vars_, kTrans, 1.0);
 }
 
+void DiagGmm::LogLikelihoods(const MatrixBase<BaseFloat> &data,
+                             const MatrixBase<BaseFloat> &data_sq,
+                             MatrixBase<BaseFloat> *loglikes) const {
+  KALDI_ASSERT(data.NumRows() != 0 &&
+               loglikes->NumRows() == data.NumRows() &&
+               loglikes->NumCols() == gconsts_.Dim() &&
+               data_sq.NumRows() == data.NumRows() &&
+               data_sq.NumCols() == data.NumCols());
+  if (data.NumCols() != Dim()) {
+    KALDI_ERR << "DiagGmm::ComponentLogLikelihood, dimension "
+              << "mismatch " << data.NumCols() << " vs. "<< Dim();
+  }
+  loglikes->CopyRowsFromVec(gconsts_);
+  // loglikes +=  means * inv(vars) * data.
+  loglikes->AddMatMat(1.0, data, kNoTrans, means_invvars_, kTrans, 1.0);
+  // loglikes += -0.5 * inv(vars) * data_sq.
+  loglikes->AddMatMat(-0.5, data_sq, kNoTrans, inv_vars_, kTrans, 1.0);
+}
+
 
 
 void DiagGmm::LogLikelihoodsPreselect(const VectorBase<BaseFloat> &data,
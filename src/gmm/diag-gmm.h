@@ -92,6 +92,16 @@ class DiagGmm {
   void LogLikelihoods(const MatrixBase<BaseFloat> &data,
                       Matrix<BaseFloat> *loglikes) const;
 
+  /// This version of the LogLikelihoods function is for callers that evaluate
+  /// many GMMs on the same block of frames (e.g. DecodableAmDiagGmmUnmapped
+  /// with a frame block size > 1): it takes the elementwise square of "data"
+  /// precomputed, and writes to "loglikes", which must already have size
+  /// data.NumRows() by NumGauss() (so it can be a SubMatrix of a larger
+  /// buffer).  It does the whole computation with two matrix-matrix products.
+  void LogLikelihoods(const MatrixBase<BaseFloat> &data,
+                      const MatrixBase<BaseFloat> &data_sq,
+                      MatrixBase<BaseFloat> *loglikes) const;
+
   
   /// Outputs the per-component log-likelihoods of a subset of mixture
   /// components.  Note: at output, loglikes->Dim() will equal indices.size().
@@ -47,6 +47,7 @@ int main(int argc, char *argv[]) {
     Timer timer;
     bool allow_partial = false;
     BaseFloat acoustic_scale = 0.1;
+    int32 frame_block_size = 1;
     LatticeFasterDecoderConfig config;
     
     std::string word_syms_filename;
@@ -57,6 +58,9 @@ int main(int argc, char *argv[]) {
                 "Symbol table for words [for debug output]");
     po.Register("allow-partial", &allow_partial,
                 "If true, produce output even if end state was not reached.");
+    po.Register("frame-block-size", &frame_block_size,
+                "If >1, compute each pdf's likelihoods for this many frames "
+                "at a time (faster, using matrix-matrix products).");
     
     po.Read(argc, argv);
 
@@ -106,7 +110,7 @@ int main(int argc, char *argv[]) {
     if (ClassifyRspecifier(fst_in_str, NULL, NULL) == kNoRspecifier) {
       SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
       // Input FST is just one FST, not a table of FSTs.
-      VectorFst<StdArc> *decode_fst = fst::ReadFstKaldi(fst_in_str);
+      fst::Fst<StdArc> *decode_fst = fst::ReadFstKaldiGeneric(fst_in_str);
       
       {
         LatticeFasterDecoder decoder(*decode_fst, config);
@@ -123,6 +127,7 @@ int main(int argc, char *argv[]) {
           
           DecodableAmDiagGmmScaled gmm_decodable(am_gmm, trans_model, features,
                                                  acoustic_scale);
+          gmm_decodable.SetFrameBlockSize(frame_block_size);
 
           double like;
           if (DecodeUtteranceLatticeFaster(
@@ -158,6 +163,7 @@ int main(int argc, char *argv[]) {
         LatticeFasterDecoder decoder(fst_reader.Value(), config);
         DecodableAmDiagGmmScaled gmm_decodable(am_gmm, trans_model, features,
                                                acoustic_scale);
+        gmm_decodable.SetFrameBlockSize(frame_block_size);
         double like;
         if (DecodeUtteranceLatticeFaster(
                 decoder, gmm_decodable, trans_model, word_syms, utt,
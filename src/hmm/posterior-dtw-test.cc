@@ -0,0 +1,126 @@
+// hmm/posterior-dtw-test.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "hmm/posterior-dtw.h"
+
+namespace kaldi {
+
+// Returns random posteriors with "num_frames" frames, with up to
+// "max_per_frame" entries per frame whose indexes are less than "num_indexes".
+void RandomPosterior(int32 num_frames, int32 num_indexes, int32 max_per_frame,
+                     Posterior *post) {
+  post->resize(num_frames);
+  for (int32 i = 0; i < num_frames; i++) {
+    (*post)[i].clear();
+    int32 n = 1 + Rand() % max_per_frame;
+    for (int32 j = 0; j < n; j++)
+      (*post)[i].push_back(std::make_pair(Rand() % num_indexes,
+                                          RandUniform()));
+  }
+}
+
+// Returns log of the frame similarity, the dot product of the posteriors (a
+// zero similarity counts as exp(kMinLogDiffDouble), as in
+// PosteriorDtwDistance()).
+double LogSimilarity(const std::vector<std::pair<int32, BaseFloat> > &a,
+                     const std::vector<std::pair<int32, BaseFloat> > &b) {
+  double sim = 0.0;
+  for (size_t i = 0; i < a.size(); i++)
+    for (size_t j = 0; j < b.size(); j++)
+      if (a[i].first == b[j].first)
+        sim += static_cast<double>(a[i].second) * b[j].second;
+  return (sim == 0.0 ? kMinLogDiffDouble : Log(sim));
+}
+
+// Enumerates every alignment path through the rest of the similarity matrix
+// from (i, j), whose score so far (excluding (i, j)) is "score", and adds the
+// scores of the paths that end at each frame j of the last row to
+// (*end_scores)[j].  "horizontal_in_first_row" says whether the path may move
+// along the first row.
+void EnumeratePaths(const Matrix<double> &log_sim, int32 i, int32 j,
+                    double score, bool horizontal_in_first_row,
+                    std::vector<double> *end_scores) {
+  int32 num_rows = log_sim.NumRows(), num_cols = log_sim.NumCols();
+  score += log_sim(i, j);
+  if (i + 1 == num_rows)
+    (*end_scores)[j] = LogAdd((*end_scores)[j], score);
+  if (j + 1 < num_cols && (i > 0 || horizontal_in_first_row))
+    EnumeratePaths(log_sim, i, j + 1, score, horizontal_in_first_row,
+                   end_scores);
+  if (i + 1 < num_rows)
+    EnumeratePaths(log_sim, i + 1, j, score, horizontal_in_first_row,
+                   end_scores);
+  if (i + 1 < num_rows && j + 1 < num_cols)
+    EnumeratePaths(log_sim, i + 1, j + 1, score, horizontal_in_first_row,
+                   end_scores);
+}
+
+// Computes what PosteriorDtwDistance() should return, by brute force.
+double BruteForceDistance(const Posterior &post1, const Posterior &post2,
+                          bool subsequence) {
+  int32 num_frames1 = post1.size(), num_frames2 = post2.size();
+  Matrix<double> log_sim(num_frames1, num_frames2);
+  for (int32 i = 0; i < num_frames1; i++)
+    for (int32 j = 0; j < num_frames2; j++)
+      log_sim(i, j) = LogSimilarity(post1[i], post2[j]);
+  std::vector<double> end_scores(num_frames2, kLogZeroDouble);
+  if (!subsequence) {
+    EnumeratePaths(log_sim, 0, 0, 0.0, true, &end_scores);
+    return end_scores[num_frames2 - 1];
+  }
+  // The query may start at any frame of the second utterance, but once
+  // started it has to move on to its next frame.
+  for (int32 j = 0; j < num_frames2; j++)
+    EnumeratePaths(log_sim, 0, j, 0.0, false, &end_scores);
+  return *std::max_element(end_scores.begin(), end_scores.end());
+}
+
+void UnitTestPosteriorDtw() {
+  for (int32 i = 0; i < 200; i++) {
+    // Small numbers of indexes make the posteriors dense, so that the matrix
+    // product gets used; large numbers make them sparse.  The utterances are
+    // short so that we can enumerate all of the paths.
+    int32 num_indexes = (i % 2 == 0 ? 1 + Rand() % 5 : 50 + Rand() % 500),
+        max_per_frame = 1 + Rand() % 4,
+        num_frames1 = 1 + Rand() % 6, num_frames2 = 1 + Rand() % 7;
+    Posterior post1, post2;
+    RandomPosterior(num_frames1, num_indexes, max_per_frame, &post1);
+    RandomPosterior(num_frames2, num_indexes, max_per_frame, &post2);
+    PosteriorDtwUtterance utt1(post1), utt2(post2);
+    PosteriorDtwOptions opts;
+    opts.block_rows = 1 + Rand() % 4;
+    opts.block_cols = 1 + Rand() % 4;
+    for (int32 subsequence = 0; subsequence < 2; subsequence++) {
+      opts.subsequence = (subsequence != 0);
+      double distance = PosteriorDtwDistance(utt1, utt2, opts),
+          brute_force = BruteForceDistance(post1, post2, opts.subsequence);
+      KALDI_ASSERT(fabs(distance - brute_force) <
+                   1.0e-05 * std::max(1.0, fabs(brute_force)));
+    }
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  kaldi::UnitTestPosteriorDtw();
+  std::cout << "Test OK.\n";
+}
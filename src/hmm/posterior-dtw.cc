@@ -0,0 +1,222 @@
+// hmm/posterior-dtw.cc
+
+// Copyright 2013  Daniel Povey
+//           2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "hmm/posterior-dtw.h"
+#include "util/stl-utils.h"
+
+namespace kaldi {
+
+PosteriorDtwUtterance::PosteriorDtwUtterance(const Posterior &post) {
+  for (size_t i = 0; i < post.size(); i++)
+    for (size_t j = 0; j < post[i].size(); j++)
+      indexes_.push_back(post[i][j].first);
+  SortAndUniq(&indexes_);
+
+  int32 num_frames = post.size(), num_indexes = indexes_.size();
+  post_.resize(num_frames);
+  inverted_.resize(num_indexes);
+  for (int32 i = 0; i < num_frames; i++) {
+    post_[i].reserve(post[i].size());
+    for (size_t j = 0; j < post[i].size(); j++) {
+      int32 k = std::lower_bound(indexes_.begin(), indexes_.end(),
+                                 post[i][j].first) - indexes_.begin();
+      BaseFloat p = post[i][j].second;
+      post_[i].push_back(std::make_pair(k, p));
+      inverted_[k].push_back(std::make_pair(i, p));
+    }
+  }
+}
+
+
+// Returns log(exp(a) + exp(b) + exp(c)), ignoring terms that are too small
+// to make a difference, as LogAdd() does.
+static inline double LogAdd3(double a, double b, double c) {
+  double max = std::max(a, std::max(b, c)), sum = 0.0;
+  if (a - max >= kMinLogDiffDouble) sum += Exp(a - max);
+  if (b - max >= kMinLogDiffDouble) sum += Exp(b - max);
+  if (c - max >= kMinLogDiffDouble) sum += Exp(c - max);
+  // sum >= 1.0 as it includes the term of the max.
+  return max + Log1p(sum - 1.0);
+}
+
+
+// The frame similarities of one utterance against another, computed a block of
+// rows at a time.  Only the indexes present in both utterances matter.  The
+// similarities are done as a matrix product over those indexes if the
+// posteriors are dense enough for that to be faster, and otherwise with the
+// inverted index of the second utterance, whose cost is the number of pairs of
+// nonzero elements that actually meet.  For the matrix product, the
+// posteriors are put into dense matrices only a block of frames at a time, so
+// the memory used does not grow with the length of the utterances.
+class FrameSimilarityComputer {
+ public:
+  FrameSimilarityComputer(const PosteriorDtwUtterance &utt1,
+                          const PosteriorDtwUtterance &utt2, int32 block_cols):
+      utt1_(utt1), utt2_(utt2), block_cols_(block_cols), num_shared_(0) {
+    // Work out the shared indexes, as positions in the Indexes() of each
+    // utterance.
+    const std::vector<int32> &indexes1 = utt1.Indexes(),
+        &indexes2 = utt2.Indexes();
+    map1to2_.resize(indexes1.size(), -1);
+    shared1_.resize(indexes1.size(), -1);
+    shared2_.resize(indexes2.size(), -1);
+    double sparse_cost = 0.0;
+    for (size_t k1 = 0, k2 = 0; k1 < indexes1.size() && k2 < indexes2.size();) {
+      if (indexes1[k1] < indexes2[k2]) {
+        k1++;
+      } else if (indexes1[k1] > indexes2[k2]) {
+        k2++;
+      } else {
+        map1to2_[k1] = k2;
+        shared1_[k1] = num_shared_;
+        shared2_[k2] = num_shared_;
+        num_shared_++;
+        sparse_cost += static_cast<double>(utt1.Inverted()[k1].size()) *
+            utt2.Inverted()[k2].size();
+        k1++;
+        k2++;
+      }
+    }
+    double dense_cost = static_cast<double>(utt1.NumFrames()) *
+        utt2.NumFrames() * num_shared_;
+    // The matrix product does many more operations but is much faster per
+    // operation.
+    const double kGemmSpeedup = 50.0;
+    use_gemm_ = (num_shared_ > 0 && dense_cost < kGemmSpeedup * sparse_cost);
+  }
+
+  // Outputs the similarities of frames "begin" to begin + sim->NumRows() - 1
+  // of the first utterance (rows) with all the frames of the second (columns).
+  void Compute(int32 begin, Matrix<double> *sim) {
+    int32 num_rows = sim->NumRows(), num_frames2 = utt2_.NumFrames();
+    KALDI_ASSERT(sim->NumCols() == num_frames2);
+    if (use_gemm_) {
+      GetDense(utt1_.Post(), shared1_, begin, num_rows, &dense1_);
+      for (int32 c = 0; c < num_frames2; c += block_cols_) {
+        int32 num_cols = std::min(block_cols_, num_frames2 - c);
+        GetDense(utt2_.Post(), shared2_, c, num_cols, &dense2_);
+        sim->ColRange(c, num_cols).AddMatMat(1.0, dense1_, kNoTrans,
+                                             dense2_, kTrans, 0.0);
+      }
+      return;
+    }
+    sim->SetZero();
+    const std::vector<std::vector<std::pair<int32, BaseFloat> > > &inverted =
+        utt2_.Inverted();
+    for (int32 r = 0; r < num_rows; r++) {
+      double *sim_row = sim->RowData(r);
+      const std::vector<std::pair<int32, BaseFloat> > &this_post =
+          utt1_.Post()[begin + r];
+      for (size_t k = 0; k < this_post.size(); k++) {
+        int32 k2 = map1to2_[this_post[k].first];
+        if (k2 == -1) continue;
+        const std::vector<std::pair<int32, BaseFloat> > &frames = inverted[k2];
+        double weight = this_post[k].second;
+        for (size_t f = 0; f < frames.size(); f++)
+          sim_row[frames[f].first] += weight * frames[f].second;
+      }
+    }
+  }
+
+ private:
+  // Outputs frames "begin" to begin + num_frames - 1 of "post" as a dense
+  // matrix over the shared indexes; "shared" maps the positions in the
+  // utterance's Indexes() to positions among the shared indexes, or -1.
+  void GetDense(const Posterior &post, const std::vector<int32> &shared,
+                int32 begin, int32 num_frames, Matrix<double> *dense) const {
+    dense->Resize(num_frames, num_shared_);
+    for (int32 i = 0; i < num_frames; i++) {
+      const std::vector<std::pair<int32, BaseFloat> > &this_post =
+          post[begin + i];
+      double *dense_row = dense->RowData(i);
+      for (size_t k = 0; k < this_post.size(); k++) {
+        int32 s = shared[this_post[k].first];
+        if (s != -1) dense_row[s] += this_post[k].second;
+      }
+    }
+  }
+
+  const PosteriorDtwUtterance &utt1_;
+  const PosteriorDtwUtterance &utt2_;
+  // The number of frames of utt2_ put in dense form at a time.
+  int32 block_cols_;
+  // For each position in utt1_.Indexes(), the position of the same index in
+  // utt2_.Indexes(), or -1.
+  std::vector<int32> map1to2_;
+  // For each position in the Indexes() of utt1_ (resp. utt2_), its position
+  // among the shared indexes, or -1.
+  std::vector<int32> shared1_;
+  std::vector<int32> shared2_;
+  int32 num_shared_;
+  // True if we use the matrix product.
+  bool use_gemm_;
+  // Blocks of frames of each utterance, for the matrix product.
+  Matrix<double> dense1_;
+  Matrix<double> dense2_;
+};
+
+
+double PosteriorDtwDistance(const PosteriorDtwUtterance &utt1,
+                            const PosteriorDtwUtterance &utt2,
+                            const PosteriorDtwOptions &opts) {
+  int32 num_frames1 = utt1.NumFrames(), num_frames2 = utt2.NumFrames();
+  KALDI_ASSERT(num_frames1 > 0 && num_frames2 > 0 && opts.block_rows > 0 &&
+               opts.block_cols > 0);
+  FrameSimilarityComputer sim_computer(utt1, utt2, opts.block_cols);
+
+  Vector<double> prev(num_frames2, kUndefined), cur(num_frames2, kUndefined);
+  Matrix<double> sim;
+  for (int32 b = 0; b < num_frames1; b += opts.block_rows) {
+    int32 this_num_rows = std::min(opts.block_rows, num_frames1 - b);
+    sim.Resize(this_num_rows, num_frames2, kUndefined);
+    sim_computer.Compute(b, &sim);
+    for (int32 r = 0; r < this_num_rows; r++) {
+      int32 i = b + r;
+      const double *sim_row = sim.RowData(r);
+      double *cur_data = cur.Data();
+      const double *prev_data = prev.Data();
+      for (int32 j = 0; j < num_frames2; j++) {
+        double d = (sim_row[j] == 0.0 ? kMinLogDiffDouble : Log(sim_row[j]));
+        if (i == 0) {
+          if (j == 0 || opts.subsequence)
+            cur_data[j] = d;
+          else
+            cur_data[j] = cur_data[j - 1] + d;
+        } else if (j == 0) {
+          cur_data[j] = prev_data[j] + d;
+        } else {
+          cur_data[j] = LogAdd3(cur_data[j - 1], prev_data[j],
+                                prev_data[j - 1]) + d;
+        }
+      }
+      prev.Swap(&cur);
+    }
+  }
+  // "prev" now holds the last row.
+  if (opts.subsequence)
+    return prev.Max();
+  else
+    return prev(num_frames2 - 1);
+}
+
+
+}  // namespace kaldi
@@ -0,0 +1,104 @@
+// hmm/posterior-dtw.h
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_HMM_POSTERIOR_DTW_H_
+#define KALDI_HMM_POSTERIOR_DTW_H_
+
+#include <utility>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "matrix/kaldi-matrix.h"
+#include "hmm/posterior.h"
+#include "itf/options-itf.h"
+
+namespace kaldi {
+
+/// This file contains the dynamic time warping used by fgmm-global-dtw to
+/// compare utterances represented as posteriors (e.g. over the Gaussians of a
+/// UBM).  The similarity of two frames is the dot product of their posteriors.
+
+struct PosteriorDtwOptions {
+  bool subsequence;
+  int32 block_rows;
+  int32 block_cols;
+  PosteriorDtwOptions(): subsequence(false), block_rows(64),
+                         block_cols(1024) { }
+  void Register(OptionsItf *po) {
+    po->Register("subsequence", &subsequence, "If true, the first utterance "
+                 "of each trial (the query) may match any part of the second "
+                 "one instead of the whole of it; the score is then normalized "
+                 "by the length of the query.");
+    po->Register("block-rows", &block_rows, "Number of frames of the first "
+                 "utterance whose frame similarities are computed at a time "
+                 "(controls memory use)");
+    po->Register("block-cols", &block_cols, "Number of frames of the second "
+                 "utterance that are put in dense form at a time, when the "
+                 "frame similarities are computed as a matrix product "
+                 "(controls memory use)");
+  }
+};
+
+
+/// The posteriors of one utterance, in the forms that PosteriorDtwDistance()
+/// needs.  This is set up once for each utterance, which may then appear in
+/// any number of trials, on either side.
+class PosteriorDtwUtterance {
+ public:
+  explicit PosteriorDtwUtterance(const Posterior &post);
+
+  int32 NumFrames() const { return post_.size(); }
+
+  /// The sorted list of the indexes (e.g. Gaussians) that occur in the
+  /// posteriors.
+  const std::vector<int32> &Indexes() const { return indexes_; }
+
+  /// The posteriors, with each index replaced by its position in Indexes().
+  const Posterior &Post() const { return post_; }
+
+  /// For each position in Indexes(), the list of (frame, posterior) in which
+  /// it occurs.
+  const std::vector<std::vector<std::pair<int32, BaseFloat> > > &
+  Inverted() const { return inverted_; }
+
+ private:
+  std::vector<int32> indexes_;
+  Posterior post_;
+  std::vector<std::vector<std::pair<int32, BaseFloat> > > inverted_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(PosteriorDtwUtterance);
+};
+
+
+/// Computes the log of the sum, over all monotonic alignments of the frames of
+/// "utt1" and "utt2", of the product of the frame similarities (a zero
+/// similarity counts as exp(kMinLogDiffDouble)).  With opts.subsequence, the
+/// alignment of "utt1" may start and end at any frame of "utt2"; the sum is
+/// over the start frames, and the best end frame is taken.  Only one row of
+/// the recurrence is kept, and opts.block_rows rows of similarities, so the
+/// memory used is O(utt2.NumFrames()), plus, if the similarities are done as
+/// a matrix product, opts.block_rows + opts.block_cols frames in dense form.
+/// The similarities and the recurrence are computed in double precision.
+double PosteriorDtwDistance(const PosteriorDtwUtterance &utt1,
+                            const PosteriorDtwUtterance &utt2,
+                            const PosteriorDtwOptions &opts);
+
+
+}  // namespace kaldi
+
+#endif  // KALDI_HMM_POSTERIOR_DTW_H_
@@ -65,6 +65,8 @@ class PosteriorHolder {
   
   void Clear() { Posterior tmp; std::swap(tmp, t_); }
 
+  void Swap(PosteriorHolder *other) { t_.swap(other->t_); }
+
   // Reads into the holder.
   bool Read(std::istream &is);
   
@@ -94,6 +96,8 @@ class GaussPostHolder {
 
   void Clear() {  GaussPost tmp;  std::swap(tmp, t_); }
 
+  void Swap(GaussPostHolder *other) { t_.swap(other->t_); }
+
   // Reads into the holder.
   bool Read(std::istream &is);
   
@@ -87,6 +87,63 @@ void UnitTestPldaEstimation(int32 dim) {
   
 }
 
+void UnitTestPldaBatchScorer(int32 dim) {
+  // Make up a PLDA model by reading it from text.
+  Vector<double> mean(dim), psi(dim);
+  mean.SetRandn();
+  psi.SetRandn();
+  psi.ApplyPow(2.0);
+  std::sort(psi.Data(), psi.Data() + dim, std::greater<double>());
+  Matrix<double> transform(dim, dim);
+  transform.SetRandn();
+  std::ostringstream os;
+  WriteToken(os, false, "<Plda>");
+  mean.Write(os, false);
+  transform.Write(os, false);
+  psi.Write(os, false);
+  WriteToken(os, false, "</Plda>");
+  Plda plda;
+  std::istringstream is(os.str());
+  plda.Read(is, false);
+
+  PldaConfig config;
+  int32 num_enroll = 1 + Rand() % 20, num_test = 1 + Rand() % 20;
+  Matrix<BaseFloat> enroll_ivectors(num_enroll, dim),
+      test_ivectors(num_test, dim);
+  std::vector<int32> num_utts(num_enroll);
+  for (int32 e = 0; e < num_enroll; e++) {
+    num_utts[e] = 1 + Rand() % 4;
+    Vector<BaseFloat> ivector(dim);
+    ivector.SetRandn();
+    SubVector<BaseFloat> transformed(enroll_ivectors, e);
+    plda.TransformIvector(config, ivector, num_utts[e], &transformed);
+  }
+  for (int32 t = 0; t < num_test; t++) {
+    Vector<BaseFloat> ivector(dim);
+    ivector.SetRandn();
+    SubVector<BaseFloat> transformed(test_ivectors, t);
+    plda.TransformIvector(config, ivector, 1, &transformed);
+  }
+
+  PldaBatchScorer scorer(plda, enroll_ivectors, num_utts);
+  Matrix<BaseFloat> scores(num_enroll, num_test);
+  scorer.Score(test_ivectors, &scores);
+  int32 offset = Rand() % num_enroll;
+  Matrix<BaseFloat> block_scores(num_enroll - offset, num_test);
+  scorer.ScoreBlock(offset, test_ivectors, &block_scores);
+  for (int32 e = 0; e < num_enroll; e++) {
+    for (int32 t = 0; t < num_test; t++) {
+      Vector<double> enroll_ivector(enroll_ivectors.Row(e)),
+          test_ivector(test_ivectors.Row(t));
+      double llr = plda.LogLikelihoodRatio(enroll_ivector, num_utts[e],
+                                           test_ivector);
+      KALDI_ASSERT(fabs(llr - scores(e, t)) < 1.0e-03 * (1.0 + fabs(llr)));
+      if (e >= offset)
+        KALDI_ASSERT(ApproxEqual(block_scores(e - offset, t), scores(e, t)));
+    }
+  }
+}
+
 }
 
 
@@ -108,6 +165,8 @@ int main() {
 
   // UnitTestPldaEstimation(400);
   UnitTestPldaEstimation(80);
+  for (int i = 0; i < 10; i++)
+    UnitTestPldaBatchScorer(1 + Rand() % 50);
   std::cout << "Test OK.\n";
   return 0;
 }
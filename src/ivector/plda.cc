@@ -15,6 +15,7 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <map>
 #include <vector>
 #include "ivector/plda.h"
 
@@ -170,6 +171,88 @@ double Plda::LogLikelihoodRatio(
 }
 
 
+PldaBatchScorer::PldaBatchScorer(const Plda &plda,
+                                 const MatrixBase<BaseFloat> &enroll_ivectors,
+                                 const std::vector<int32> &num_utts) {
+  int32 dim = plda.Dim(), num_enroll = enroll_ivectors.NumRows();
+  KALDI_ASSERT(enroll_ivectors.NumCols() == dim &&
+               num_utts.size() == static_cast<size_t>(num_enroll));
+  const Vector<double> &psi = plda.psi_;
+  scaled_enroll_.Resize(num_enroll, dim, kUndefined);
+  enroll_offsets_.Resize(num_enroll, kUndefined);
+  quadratic_index_.resize(num_enroll);
+
+  // The quantities that only depend on n, for each distinct n.
+  std::map<int32, int32> n_to_index;
+  std::vector<Vector<double> > cross_scales, enroll_quadratics,
+      test_quadratics;
+  std::vector<double> constants;
+  double logdet_without_class = 0.0;  // logdet(I + \Psi).
+  for (int32 i = 0; i < dim; i++)
+    logdet_without_class += log(1.0 + psi(i));
+
+  Vector<double> ivector(dim), ivector_sq(dim);
+  for (int32 e = 0; e < num_enroll; e++) {
+    int32 n = num_utts[e];
+    KALDI_ASSERT(n > 0);
+    std::map<int32, int32>::iterator iter = n_to_index.find(n);
+    if (iter == n_to_index.end()) {
+      Vector<double> cross_scale(dim), enroll_quadratic(dim),
+          test_quadratic(dim);
+      double logdet_given_class = 0.0;
+      for (int32 i = 0; i < dim; i++) {
+        double a = n * psi(i) / (n * psi(i) + 1.0),
+            v = 1.0 + psi(i) / (n * psi(i) + 1.0);
+        cross_scale(i) = a / v;
+        enroll_quadratic(i) = -0.5 * a * a / v;
+        test_quadratic(i) = 0.5 * (1.0 / (1.0 + psi(i)) - 1.0 / v);
+        logdet_given_class += log(v);
+      }
+      iter = n_to_index.insert(std::make_pair(n, static_cast<int32>(
+          constants.size()))).first;
+      cross_scales.push_back(cross_scale);
+      enroll_quadratics.push_back(enroll_quadratic);
+      test_quadratics.push_back(test_quadratic);
+      constants.push_back(0.5 * (logdet_without_class - logdet_given_class));
+    }
+    int32 index = iter->second;
+    ivector.CopyFromVec(enroll_ivectors.Row(e));
+    ivector_sq.CopyFromVec(ivector);
+    ivector_sq.ApplyPow(2.0);
+    enroll_offsets_(e) = constants[index] +
+        VecVec(ivector_sq, enroll_quadratics[index]);
+    ivector.MulElements(cross_scales[index]);
+    scaled_enroll_.Row(e).CopyFromVec(ivector);
+    quadratic_index_[e] = index;
+  }
+  test_quadratic_.Resize(test_quadratics.size(), dim, kUndefined);
+  for (size_t i = 0; i < test_quadratics.size(); i++)
+    test_quadratic_.Row(i).CopyFromVec(test_quadratics[i]);
+}
+
+void PldaBatchScorer::ScoreBlock(int32 enroll_offset,
+                                 const MatrixBase<BaseFloat> &test_ivectors,
+                                 MatrixBase<BaseFloat> *scores) const {
+  int32 num_enroll = scores->NumRows(), num_test = test_ivectors.NumRows();
+  KALDI_ASSERT(enroll_offset >= 0 && enroll_offset + num_enroll <= NumEnroll()
+               && scores->NumCols() == num_test &&
+               test_ivectors.NumCols() == scaled_enroll_.NumCols());
+  scores->AddMatMat(1.0, scaled_enroll_.RowRange(enroll_offset, num_enroll),
+                    kNoTrans, test_ivectors, kTrans, 0.0);
+  // The terms in x_i^2, for each distinct n.
+  Matrix<BaseFloat> test_sq(test_ivectors);
+  test_sq.ApplyPow(2.0);
+  Matrix<BaseFloat> test_terms(test_quadratic_.NumRows(), num_test,
+                               kUndefined);
+  test_terms.AddMatMat(1.0, test_quadratic_, kNoTrans, test_sq, kTrans, 0.0);
+  for (int32 e = 0; e < num_enroll; e++) {
+    SubVector<BaseFloat> row(*scores, e);
+    row.Add(enroll_offsets_(enroll_offset + e));
+    row.AddVec(1.0, test_terms.Row(quadratic_index_[enroll_offset + e]));
+  }
+}
+
+
 void Plda::SmoothWithinClassCovariance(double smoothing_factor) {
   KALDI_ASSERT(smoothing_factor >= 0.0 && smoothing_factor <= 1.0);
   // smoothing_factor > 1.0 is possible but wouldn't really make sense.
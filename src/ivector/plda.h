@@ -120,6 +120,7 @@ class Plda {
   void ComputeDerivedVars(); // computes offset_.
   friend class PldaEstimator;
   friend class PldaUnsupervisedAdaptor;
+  friend class PldaBatchScorer;
   
   Vector<double> mean_;  // mean of samples in original space.
   Matrix<double> transform_; // of dimension Dim() by Dim();
@@ -145,6 +146,59 @@ class Plda {
 };
 
 
+/**
+   PldaBatchScorer computes the same log-likelihood ratios as
+   Plda::LogLikelihoodRatio(), for all pairs of a fixed set of "enrollment"
+   iVectors and any number of test iVectors, mostly as one matrix product.
+   Writing u for an enrollment iVector averaged over n utterances and x for a
+   test iVector (both transformed by Plda::TransformIvector()), and
+     a_i = n \psi_i / (n \psi_i + 1),  v_i = 1 + \psi_i / (n \psi_i + 1),
+   the log-likelihood ratio expands to
+     c(u, n)  +  \sum_i 0.5 (1 / (1 + \psi_i) - 1 / v_i) x_i^2
+              +  \sum_i (a_i / v_i) u_i x_i,
+   where c(u, n) does not depend on x.  The last term, for all pairs, is the
+   product of the matrix of enrollment iVectors, scaled by a / v, with the
+   matrix of test iVectors; the second one only depends on n, of which there
+   are normally only a few different values.
+ */
+class PldaBatchScorer {
+ public:
+  /// The rows of "enroll_ivectors" are the transformed enrollment iVectors,
+  /// and "num_utts" says how many utterances each was averaged over (as the
+  /// argument "num_train_utts" of Plda::LogLikelihoodRatio()).
+  PldaBatchScorer(const Plda &plda,
+                  const MatrixBase<BaseFloat> &enroll_ivectors,
+                  const std::vector<int32> &num_utts);
+
+  int32 NumEnroll() const { return scaled_enroll_.NumRows(); }
+
+  /// Outputs the log-likelihood ratios of all the enrollment iVectors
+  /// (rows of "scores") against the transformed test iVectors in the rows of
+  /// "test_ivectors" (columns of "scores").
+  void Score(const MatrixBase<BaseFloat> &test_ivectors,
+             MatrixBase<BaseFloat> *scores) const {
+    ScoreBlock(0, test_ivectors, scores);
+  }
+
+  /// As Score(), but only for enrollment iVectors "enroll_offset" through
+  /// enroll_offset + scores->NumRows() - 1, so that large sets can be scored
+  /// a block at a time.
+  void ScoreBlock(int32 enroll_offset,
+                  const MatrixBase<BaseFloat> &test_ivectors,
+                  MatrixBase<BaseFloat> *scores) const;
+
+ private:
+  // The enrollment iVectors times a / v.
+  Matrix<BaseFloat> scaled_enroll_;
+  // c(u, n) for each enrollment iVector.
+  Vector<BaseFloat> enroll_offsets_;
+  // One row for each distinct n: the coefficients of x_i^2.
+  Matrix<BaseFloat> test_quadratic_;
+  // For each enrollment iVector, its row of test_quadratic_.
+  std::vector<int32> quadratic_index_;
+};
+
+
 class PldaStats {
  public:
   PldaStats(): dim_(0) { } /// The dimension is set up the first time you add samples.
@@ -0,0 +1,111 @@
+// ivector/verification-metrics-test.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "ivector/verification-metrics.h"
+
+namespace kaldi {
+
+void UnitTestSortScores() {
+  int32 size = rand() % 100000, num_threads = 1 + rand() % 8;
+  std::vector<BaseFloat> scores(size);
+  for (int32 i = 0; i < size; i++)
+    scores[i] = (rand() % 10 == 0 ? rand() % 5 : RandGauss());
+  std::vector<BaseFloat> sorted(scores);
+  std::sort(sorted.begin(), sorted.end());
+  SortScores(num_threads, &scores);
+  KALDI_ASSERT(scores == sorted);
+}
+
+void UnitTestScoreHistogramBins() {
+  ScoreHistogram histogram(8 + rand() % 17);
+  for (int32 i = 0; i < 1000; i++) {
+    BaseFloat x = RandGauss() * Exp(5.0 * RandGauss()),
+        y = x + std::abs(RandGauss());
+    BaseFloat x_start = histogram.BinStart(x), y_start = histogram.BinStart(y);
+    KALDI_ASSERT(x_start <= x && x_start <= y_start);
+    KALDI_ASSERT(histogram.BinStart(x_start) == x_start);
+  }
+}
+
+// Checks the error rates from the histogram against those from the sorted
+// scores, and the latter against ComputeEer().
+void UnitTestErrorRates() {
+  VerificationMetricsOptions opts;
+  opts.p_target = 0.001 + 0.5 * RandUniform();
+  int32 num_target = 1000 + rand() % 10000,
+      num_nontarget = 1000 + rand() % 100000;
+  BaseFloat separation = 1.0 + 3.0 * RandUniform(),
+      offset = 10.0 * RandGauss();
+  // With some probability the scores are rounded, so that there are ties.
+  bool round = (rand() % 2 == 0);
+  ScoreHistogram histogram;
+  std::vector<BaseFloat> target_scores, nontarget_scores;
+  for (int32 i = 0; i < num_target + num_nontarget; i++) {
+    bool is_target = (i < num_target);
+    BaseFloat score = offset + RandGauss() + (is_target ? separation : 0.0);
+    if (round)
+      score = static_cast<int32>(score * 100.0) / 100.0;
+    (is_target ? target_scores : nontarget_scores).push_back(score);
+    histogram.Add(score, is_target);
+  }
+  SortScores(1 + rand() % 4, &target_scores);
+  SortScores(1 + rand() % 4, &nontarget_scores);
+
+  BaseFloat threshold;
+  BaseFloat eer = ComputeEer(target_scores, nontarget_scores, &threshold);
+
+  ErrorRateSweeper exact(opts, num_target, num_nontarget),
+      approx(opts, num_target, num_nontarget);
+  SweepSortedScores(target_scores, nontarget_scores, &exact);
+  histogram.Sweep(&approx);
+
+  BaseFloat exact_eer = exact.Eer(NULL), approx_eer = approx.Eer(NULL),
+      exact_dcf = exact.MinDcf(NULL), approx_dcf = approx.MinDcf(NULL);
+  KALDI_LOG << "EER is " << eer << ", " << exact_eer << " (exact sweep), "
+            << approx_eer << " (histogram); minDCF is " << exact_dcf
+            << " (exact), " << approx_dcf << " (histogram)";
+  // ComputeEer() is only accurate to about one score.
+  KALDI_ASSERT(std::abs(eer - exact_eer) < 2.0 / num_target +
+               2.0 / num_nontarget + (round ? 0.01 : 0.0));
+  KALDI_ASSERT(std::abs(exact_eer - approx_eer) < 0.002);
+  KALDI_ASSERT(std::abs(exact_dcf - approx_dcf) < 0.01);
+
+  const std::vector<DetPoint> &det = approx.DetCurve();
+  KALDI_ASSERT(det.front().p_miss == 0.0 && det.front().p_fa == 1.0 &&
+               det.back().p_miss == 1.0 && det.back().p_fa == 0.0);
+  for (size_t i = 1; i < det.size(); i++)
+    KALDI_ASSERT(det[i].threshold > det[i-1].threshold &&
+                 det[i].p_miss >= det[i-1].p_miss &&
+                 det[i].p_fa <= det[i-1].p_fa);
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 10; i++) {
+    UnitTestSortScores();
+    UnitTestScoreHistogramBins();
+    UnitTestErrorRates();
+  }
+  std::cout << "Test OK.\n";
+  return 0;
+}
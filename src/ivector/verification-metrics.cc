@@ -0,0 +1,294 @@
+// ivector/verification-metrics.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "ivector/verification-metrics.h"
+#include "thread/kaldi-thread.h"
+
+namespace kaldi {
+
+BaseFloat ComputeEer(const std::vector<BaseFloat> &target_scores,
+                     const std::vector<BaseFloat> &nontarget_scores,
+                     BaseFloat *threshold) {
+  KALDI_ASSERT(!target_scores.empty() && !nontarget_scores.empty());
+
+  size_t target_position = 0,
+      target_size = target_scores.size();
+  for (; target_position + 1 < target_size; target_position++) {
+    ssize_t nontarget_size = nontarget_scores.size(),
+        nontarget_n = nontarget_size * target_position * 1.0 / target_size,
+        nontarget_position = nontarget_size - 1 - nontarget_n;
+    if (nontarget_position  < 0)
+      nontarget_position = 0;
+    if (nontarget_scores[nontarget_position] <
+        target_scores[target_position])
+      break;
+  }
+  *threshold = target_scores[target_position];
+  BaseFloat eer = target_position * 1.0 / target_size;
+  return eer;
+}
+
+
+// Sorts one block of the vector per thread.
+class SortScoresClass: public MultiThreadable {
+ public:
+  SortScoresClass(const std::vector<size_t> &bounds,
+                  std::vector<BaseFloat> *scores):
+      bounds_(bounds), scores_(scores) { }
+  void operator () () {
+    std::sort(scores_->begin() + bounds_[thread_id_],
+              scores_->begin() + bounds_[thread_id_ + 1]);
+  }
+ private:
+  const std::vector<size_t> &bounds_;
+  std::vector<BaseFloat> *scores_;
+};
+
+// Merges blocks 2n and 2n + 1 of "src" into "dest" in thread n (or just
+// copies the last block, if there is an odd number of them).
+class MergeScoresClass: public MultiThreadable {
+ public:
+  MergeScoresClass(const std::vector<size_t> &bounds,
+                   const std::vector<BaseFloat> &src,
+                   std::vector<BaseFloat> *dest):
+      bounds_(bounds), src_(src), dest_(dest) { }
+  void operator () () {
+    size_t num_blocks = bounds_.size() - 1, b = 2 * thread_id_;
+    std::vector<BaseFloat>::const_iterator begin = src_.begin() + bounds_[b];
+    if (b + 1 == num_blocks) {
+      std::copy(begin, src_.begin() + bounds_[b + 1],
+                dest_->begin() + bounds_[b]);
+    } else {
+      std::merge(begin, src_.begin() + bounds_[b + 1],
+                 src_.begin() + bounds_[b + 1], src_.begin() + bounds_[b + 2],
+                 dest_->begin() + bounds_[b]);
+    }
+  }
+ private:
+  const std::vector<size_t> &bounds_;
+  const std::vector<BaseFloat> &src_;
+  std::vector<BaseFloat> *dest_;
+};
+
+void SortScores(int32 num_threads, std::vector<BaseFloat> *scores) {
+  size_t size = scores->size();
+  // Below this size it's not worth starting threads.
+  const size_t kMinBlockSize = 10000;
+  int32 num_blocks = std::min<size_t>(std::max(num_threads, 1),
+                                      size / kMinBlockSize);
+  if (num_blocks <= 1) {
+    std::sort(scores->begin(), scores->end());
+    return;
+  }
+  std::vector<size_t> bounds(num_blocks + 1);
+  for (int32 b = 0; b <= num_blocks; b++)
+    bounds[b] = size * b / num_blocks;
+  {
+    SortScoresClass c(bounds, scores);
+    MultiThreader<SortScoresClass> m(num_blocks, c);
+  }
+  std::vector<BaseFloat> temp(size);
+  while (bounds.size() > 2) {
+    int32 num_merges = bounds.size() / 2;  // (num_blocks + 1) / 2.
+    {
+      MergeScoresClass c(bounds, *scores, &temp);
+      MultiThreader<MergeScoresClass> m(num_merges, c);
+    }
+    scores->swap(temp);
+    std::vector<size_t> new_bounds;
+    for (size_t b = 0; b < bounds.size(); b += 2)
+      new_bounds.push_back(bounds[b]);
+    if (new_bounds.back() != size)
+      new_bounds.push_back(size);
+    bounds.swap(new_bounds);
+  }
+}
+
+
+ErrorRateSweeper::ErrorRateSweeper(const VerificationMetricsOptions &opts,
+                                   int64 tot_target, int64 tot_nontarget):
+    opts_(opts), tot_target_(tot_target), tot_nontarget_(tot_nontarget),
+    num_target_below_(0), num_nontarget_below_(0), last_score_(0.0),
+    started_(false), finished_(false), prev_p_miss_(0.0), prev_p_fa_(1.0),
+    eer_found_(false), eer_(0.0), eer_threshold_(0.0), min_dcf_(0.0),
+    min_dcf_threshold_(0.0) {
+  KALDI_ASSERT(tot_target > 0 && tot_nontarget > 0);
+  KALDI_ASSERT(opts.p_target > 0.0 && opts.p_target < 1.0 &&
+               opts.c_miss > 0.0 && opts.c_fa > 0.0 &&
+               opts.det_resolution >= 0.0);
+}
+
+void ErrorRateSweeper::Add(BaseFloat score, int64 num_target,
+                           int64 num_nontarget) {
+  KALDI_ASSERT(!finished_ && (!started_ || score > last_score_));
+  AddPoint(score, num_target_below_ * 1.0 / tot_target_,
+           (tot_nontarget_ - num_nontarget_below_) * 1.0 / tot_nontarget_);
+  num_target_below_ += num_target;
+  num_nontarget_below_ += num_nontarget;
+  last_score_ = score;
+}
+
+void ErrorRateSweeper::Finish() {
+  KALDI_ASSERT(!finished_);
+  if (num_target_below_ != tot_target_ ||
+      num_nontarget_below_ != tot_nontarget_)
+    KALDI_ERR << "Number of scores does not match the totals given: "
+              << num_target_below_ << " vs. " << tot_target_ << " targets, "
+              << num_nontarget_below_ << " vs. " << tot_nontarget_
+              << " non-targets.";
+  // Past the highest score everything is rejected.
+  AddPoint(std::numeric_limits<BaseFloat>::infinity(), 1.0, 0.0);
+  finished_ = true;
+}
+
+// Returns true if error rates a and b are far enough apart to need separate
+// points on the DET curve.
+static bool DetPointsDiffer(double a, double b, double resolution) {
+  double scale = std::max(std::min(a, 1.0 - a), std::min(b, 1.0 - b));
+  return std::abs(a - b) > resolution * scale;
+}
+
+void ErrorRateSweeper::AddPoint(BaseFloat threshold, double p_miss,
+                                double p_fa) {
+  if (!eer_found_ && p_miss >= p_fa) {
+    // The miss rate has caught up with the false alarm rate between the
+    // previous threshold and this one.
+    if (started_) {
+      double before = prev_p_fa_ - prev_p_miss_, after = p_miss - p_fa;
+      eer_ = prev_p_miss_ + (p_miss - prev_p_miss_) * before / (before + after);
+    } else {
+      eer_ = p_miss;
+    }
+    eer_threshold_ = threshold;
+    eer_found_ = true;
+  }
+
+  double miss_weight = opts_.c_miss * opts_.p_target,
+      fa_weight = opts_.c_fa * (1.0 - opts_.p_target),
+      dcf = (miss_weight * p_miss + fa_weight * p_fa) /
+      std::min(miss_weight, fa_weight);
+  if (!started_ || dcf < min_dcf_) {
+    min_dcf_ = dcf;
+    min_dcf_threshold_ = threshold;
+  }
+
+  bool is_last = (p_miss == 1.0 && p_fa == 0.0);
+  if (det_curve_.empty() || is_last ||
+      DetPointsDiffer(p_miss, det_curve_.back().p_miss, opts_.det_resolution) ||
+      DetPointsDiffer(p_fa, det_curve_.back().p_fa, opts_.det_resolution))
+    det_curve_.push_back(DetPoint(threshold, p_miss, p_fa));
+
+  prev_p_miss_ = p_miss;
+  prev_p_fa_ = p_fa;
+  started_ = true;
+}
+
+BaseFloat ErrorRateSweeper::Eer(BaseFloat *threshold) const {
+  KALDI_ASSERT(finished_ && eer_found_);
+  if (threshold != NULL)
+    *threshold = eer_threshold_;
+  return eer_;
+}
+
+BaseFloat ErrorRateSweeper::MinDcf(BaseFloat *threshold) const {
+  KALDI_ASSERT(finished_);
+  if (threshold != NULL)
+    *threshold = min_dcf_threshold_;
+  return min_dcf_;
+}
+
+
+void SweepSortedScores(const std::vector<BaseFloat> &target_scores,
+                       const std::vector<BaseFloat> &nontarget_scores,
+                       ErrorRateSweeper *sweeper) {
+  size_t t = 0, n = 0, num_target = target_scores.size(),
+      num_nontarget = nontarget_scores.size();
+  while (t < num_target || n < num_nontarget) {
+    BaseFloat score;
+    if (n == num_nontarget ||
+        (t < num_target && target_scores[t] < nontarget_scores[n]))
+      score = target_scores[t];
+    else
+      score = nontarget_scores[n];
+    size_t t_begin = t, n_begin = n;
+    while (t < num_target && target_scores[t] == score)
+      t++;
+    while (n < num_nontarget && nontarget_scores[n] == score)
+      n++;
+    sweeper->Add(score, t - t_begin, n - n_begin);
+  }
+  sweeper->Finish();
+}
+
+
+ScoreHistogram::ScoreHistogram(int32 num_bits):
+    shift_(32 - num_bits), num_target_(0), num_nontarget_(0) {
+  if (num_bits < 8 || num_bits > 24)
+    KALDI_ERR << "Number of bits for the score histogram must be from 8 to 24, "
+              << "got " << num_bits;
+  target_counts_.resize(static_cast<size_t>(1) << num_bits, 0);
+  nontarget_counts_.resize(static_cast<size_t>(1) << num_bits, 0);
+}
+
+uint32 ScoreHistogram::ScoreToKey(BaseFloat score) {
+  // For positive numbers the IEEE bit pattern, as an unsigned integer,
+  // increases with the value; for negative numbers it decreases.  We flip
+  // the sign bit of positive numbers and all the bits of negative ones.
+  float f = score;
+  uint32 u;
+  std::memcpy(&u, &f, sizeof(u));
+  return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+}
+
+BaseFloat ScoreHistogram::KeyToScore(uint32 key) {
+  uint32 u = (key & 0x80000000u) ? (key & 0x7fffffffu) : ~key;
+  float f;
+  std::memcpy(&f, &u, sizeof(f));
+  if (KALDI_ISNAN(f))  // the start of the lowest bin.
+    return -std::numeric_limits<BaseFloat>::infinity();
+  return f;
+}
+
+void ScoreHistogram::Add(BaseFloat score, bool is_target) {
+  if (KALDI_ISNAN(score))
+    KALDI_ERR << "Score is NaN.";
+  uint32 bin = ScoreToKey(score) >> shift_;
+  if (is_target) {
+    target_counts_[bin]++;
+    num_target_++;
+  } else {
+    nontarget_counts_[bin]++;
+    num_nontarget_++;
+  }
+}
+
+void ScoreHistogram::Sweep(ErrorRateSweeper *sweeper) const {
+  for (size_t bin = 0; bin < target_counts_.size(); bin++) {
+    if (target_counts_[bin] != 0 || nontarget_counts_[bin] != 0)
+      sweeper->Add(KeyToScore(static_cast<uint32>(bin) << shift_),
+                   target_counts_[bin], nontarget_counts_[bin]);
+  }
+  sweeper->Finish();
+}
+
+}  // namespace kaldi
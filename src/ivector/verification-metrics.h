@@ -0,0 +1,193 @@
+// ivector/verification-metrics.h
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_IVECTOR_VERIFICATION_METRICS_H_
+#define KALDI_IVECTOR_VERIFICATION_METRICS_H_
+
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "itf/options-itf.h"
+
+namespace kaldi {
+
+/**
+   ComputeEer computes the Equal Error Rate (EER) for the given scores
+   and returns it as a proportion beween 0 and 1.
+   If we set the threshold at x, then the target error-rate is the
+   proportion of target_scores below x; and the non-target error-rate
+   is the proportion of non-target scores above x.  We seek a
+   threshold x for which these error rates are the same; this
+   error rate is the EER.
+
+   We compute this by iterating over the positions in target_scores: 0, 1, 2,
+   and so on, and for each position consider whether the cutoff could be here.
+   For each of these position we compute the corresponding position in
+   nontarget_scores where the cutoff would be if the EER were the same.
+   For instance, if the vectors had the same length, this would be position
+   length() - 1, length() - 2, and so on.  As soon as the value at that
+   position in nontarget_scores at that position is less than the value from
+   target_scores, we have our EER.
+
+   In coding this we weren't particularly careful about edge cases or
+   making sure whether it's actually n + 1 instead of n.
+
+   The scores must already be sorted (see SortScores()).
+*/
+BaseFloat ComputeEer(const std::vector<BaseFloat> &target_scores,
+                     const std::vector<BaseFloat> &nontarget_scores,
+                     BaseFloat *threshold);
+
+/// Sorts "scores" in increasing order, using up to "num_threads" threads:
+/// blocks of the vector are sorted in parallel and then merged pairwise.
+/// This needs a temporary copy of the vector.
+void SortScores(int32 num_threads, std::vector<BaseFloat> *scores);
+
+
+struct VerificationMetricsOptions {
+  BaseFloat p_target;
+  BaseFloat c_miss;
+  BaseFloat c_fa;
+  BaseFloat det_resolution;
+  VerificationMetricsOptions(): p_target(0.01), c_miss(1.0), c_fa(1.0),
+                                det_resolution(0.01) { }
+  void Register(OptionsItf *po) {
+    po->Register("p-target", &p_target, "Prior probability of a target trial, "
+                 "for the detection cost function (DCF)");
+    po->Register("c-miss", &c_miss, "Cost of a missed target, for the DCF");
+    po->Register("c-fa", &c_fa, "Cost of a false alarm, for the DCF");
+    po->Register("det-resolution", &det_resolution, "A new point of the DET "
+                 "curve is output when either error rate (or one minus it, "
+                 "whichever is smaller) has changed by this proportion.");
+  }
+};
+
+/// A point of the detection error tradeoff (DET) curve: the miss and false
+/// alarm rates if the trials with scores >= threshold are accepted.
+struct DetPoint {
+  BaseFloat threshold;
+  double p_miss;
+  double p_fa;
+  DetPoint(BaseFloat threshold, double p_miss, double p_fa):
+      threshold(threshold), p_miss(p_miss), p_fa(p_fa) { }
+};
+
+
+/**
+   ErrorRateSweeper computes the EER, the minimum of the (normalized)
+   detection cost function and the DET curve, by moving the threshold up over
+   the scores.  It is given the number of target and non-target scores at each
+   distinct score (or histogram bin), in increasing order of score, so it
+   does not need to store the scores.  The EER is interpolated linearly
+   between the two thresholds where the miss rate overtakes the false alarm
+   rate.
+*/
+class ErrorRateSweeper {
+ public:
+  ErrorRateSweeper(const VerificationMetricsOptions &opts,
+                   int64 tot_target, int64 tot_nontarget);
+
+  /// Adds "num_target" target and "num_nontarget" non-target scores with
+  /// value "score" (or, for a histogram bin, with the lowest value in the
+  /// bin).  Must be called in increasing order of "score".
+  void Add(BaseFloat score, int64 num_target, int64 num_nontarget);
+
+  /// Call this after the last Add().
+  void Finish();
+
+  BaseFloat Eer(BaseFloat *threshold) const;
+
+  /// Returns the minimum over thresholds of the DCF, normalized by the DCF of
+  /// the best decision that ignores the scores.
+  BaseFloat MinDcf(BaseFloat *threshold) const;
+
+  const std::vector<DetPoint> &DetCurve() const { return det_curve_; }
+
+ private:
+  // Called with the error rates at each threshold.
+  void AddPoint(BaseFloat threshold, double p_miss, double p_fa);
+
+  VerificationMetricsOptions opts_;
+  int64 tot_target_;
+  int64 tot_nontarget_;
+  int64 num_target_below_;
+  int64 num_nontarget_below_;
+  BaseFloat last_score_;
+  bool started_;
+  bool finished_;
+  // The error rates at the previous threshold.
+  double prev_p_miss_;
+  double prev_p_fa_;
+  bool eer_found_;
+  BaseFloat eer_;
+  BaseFloat eer_threshold_;
+  BaseFloat min_dcf_;
+  BaseFloat min_dcf_threshold_;
+  std::vector<DetPoint> det_curve_;
+};
+
+/// Adds the sorted scores to "sweeper", one distinct value at a time (and
+/// calls its Finish()).
+void SweepSortedScores(const std::vector<BaseFloat> &target_scores,
+                       const std::vector<BaseFloat> &nontarget_scores,
+                       ErrorRateSweeper *sweeper);
+
+
+/**
+   ScoreHistogram counts target and non-target scores in a fixed amount of
+   memory, for score lists that are too large to keep.  The bin of a score is
+   given by the top "num_bits" bits of its single-precision floating point
+   representation (after reordering them so that the bins are in increasing
+   order of score), so the relative resolution is the same over the whole
+   range of scores and no range has to be known in advance: with the default
+   of 20 bits there are 11 bits of mantissa, i.e. the width of a bin is about
+   0.05% of its scores.
+*/
+class ScoreHistogram {
+ public:
+  explicit ScoreHistogram(int32 num_bits = 20);
+
+  void Add(BaseFloat score, bool is_target);
+
+  int64 NumTarget() const { return num_target_; }
+  int64 NumNontarget() const { return num_nontarget_; }
+
+  /// Adds the nonempty bins to "sweeper" in order (and calls its Finish()).
+  void Sweep(ErrorRateSweeper *sweeper) const;
+
+  /// Returns the lowest score that goes into the same bin as "score".
+  BaseFloat BinStart(BaseFloat score) const {
+    return KeyToScore(ScoreToKey(score) & ~((1u << shift_) - 1));
+  }
+
+ private:
+  static uint32 ScoreToKey(BaseFloat score);
+  static BaseFloat KeyToScore(uint32 key);
+
+  int32 shift_;
+  std::vector<int64> target_counts_;
+  std::vector<int64> nontarget_counts_;
+  int64 num_target_;
+  int64 num_nontarget_;
+};
+
+
+}  // namespace kaldi
+
+#endif  // KALDI_IVECTOR_VERIFICATION_METRICS_H_
@@ -311,10 +311,13 @@ IvectorExtractor::IvectorExtractor(const IvectorExtractorOptions &opts, const Iv
 
 void IvectorExtractor::GetIvectorDistribution(const VectorBase<double> &supervector, VectorBase<double> *mean,
                                               VectorBase<double> *normalized_supervector, double *auxf) const {
-  if (normalized_supervector == NULL)
-    normalized_supervector = new Vector<double> (supervector);
-  else
+  Vector<double> temp;  // used if normalized_supervector == NULL.
+  if (normalized_supervector == NULL) {
+    temp = supervector;
+    normalized_supervector = &temp;
+  } else {
     normalized_supervector->CopyFromVec(supervector);
+  }
   normalized_supervector->AddVec(-1.0, mu_);
   Vector<double> linear(IvectorDim());
   int32 feat_dim = FeatDim();
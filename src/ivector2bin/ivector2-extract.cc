@@ -23,8 +23,50 @@
 #include "util/common-utils.h"
 #include "gmm/am-diag-gmm.h"
 #include "ivector2/ivector-extractor.h"
+#include "thread/kaldi-task-sequence.h"
 #include <algorithm>
 
+namespace kaldi {
+namespace ivector2 {
+
+// This class is used to extract the iVectors of several utterances in
+// parallel: the work happens in operator (), and the output, in the original
+// order, in the destructor.
+class IvectorExtractTask {
+ public:
+  IvectorExtractTask(const IvectorExtractor &extractor,
+                     const std::string &key,
+                     const Vector<double> &supervector,
+                     DoubleVectorWriter *writer,
+                     double *tot_auxf):
+      extractor_(extractor), key_(key), supervector_(supervector),
+      writer_(writer), tot_auxf_(tot_auxf), auxf_(0.0) { }
+
+  void operator () () {
+    ivector_.Resize(extractor_.IvectorDim());
+    extractor_.GetIvectorDistribution(supervector_, &ivector_, NULL,
+                                      (tot_auxf_ != NULL ? &auxf_ : NULL));
+  }
+
+  ~IvectorExtractTask() {
+    if (tot_auxf_ != NULL)
+      *tot_auxf_ += auxf_;
+    writer_->Write(key_, ivector_);
+  }
+
+ private:
+  const IvectorExtractor &extractor_;
+  std::string key_;
+  Vector<double> supervector_;
+  DoubleVectorWriter *writer_;
+  double *tot_auxf_;  // if non-NULL we need the objective function.
+  double auxf_;
+  Vector<double> ivector_;
+};
+
+}  // namespace ivector2
+}  // namespace kaldi
+
 int main(int argc, char *argv[]) {
   using namespace kaldi;
   using namespace kaldi::ivector2;
@@ -42,6 +84,8 @@ int main(int argc, char *argv[]) {
     ParseOptions po(usage);
     bool compute_objf = false;
     po.Register("compute-objf", &compute_objf, "If true, compute the objective function");
+    TaskSequencerConfig sequencer_config;
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
     
@@ -67,16 +111,16 @@ int main(int argc, char *argv[]) {
     SequentialDoubleVectorReader supvector_reader(supvector_rspecifier);
     DoubleVectorWriter ivector_writer(ivectors_wspecifier);
 
-    Vector<double> ivector;
-    for (; !supvector_reader.Done(); supvector_reader.Next()) {
-      std::string key = supvector_reader.Key();
-      const Vector<double> &supervector = supvector_reader.Value();
-
-      ivector.Resize(extractor.IvectorDim());
-      extractor.GetIvectorDistribution(supervector, &ivector);
-      ivector_writer.Write(key, ivector);
-
-      num_done++;
+    {
+      TaskSequencer<IvectorExtractTask> sequencer(sequencer_config);
+      for (; !supvector_reader.Done(); supvector_reader.Next()) {
+        sequencer.Run(new IvectorExtractTask(extractor, supvector_reader.Key(),
+                                             supvector_reader.Value(),
+                                             &ivector_writer,
+                                             (compute_objf ? &tot_auxf : NULL)));
+        num_done++;
+      }
+      // Destructor of "sequencer" will wait for any remaining tasks.
     }
 
     KALDI_LOG << "Done " << num_done << " files.";
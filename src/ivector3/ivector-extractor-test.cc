@@ -0,0 +1,267 @@
+// ivector3/ivector-extractor-test.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gmm/model-test-common.h"
+#include "gmm/full-gmm-normal.h"
+#include "ivector3/ivector-extractor.h"
+#include "thread/kaldi-thread.h"
+
+
+namespace kaldi {
+
+namespace ivector3 {
+
+// Checks that two objects written in text mode have the same tokens and
+// approximately the same numbers.
+void AssertTextApproxEqual(const std::string &text1, const std::string &text2,
+                           double tol) {
+  std::istringstream is1(text1), is2(text2);
+  std::string token1, token2;
+  while (is1 >> token1) {
+    is2 >> token2;
+    KALDI_ASSERT(!is2.fail());
+    double value1, value2;
+    if (ConvertStringToReal(token1, &value1)) {
+      bool is_real = ConvertStringToReal(token2, &value2);
+      KALDI_ASSERT(is_real &&
+                   fabs(value1 - value2) <= tol * (1.0 + fabs(value1)));
+    } else {
+      KALDI_ASSERT(token1 == token2);
+    }
+  }
+  is2 >> token2;
+  KALDI_ASSERT(is2.fail());
+}
+
+// Gives the test access to the per-utterance stats.
+class TestUtteranceStats: public IvectorExtractorUtteranceStats {
+ public:
+  TestUtteranceStats(int32 num_gauss, int32 feat_dim):
+      IvectorExtractorUtteranceStats(num_gauss, feat_dim, true) { }
+  const Vector<double> &Gamma() const { return gamma_; }
+  const Matrix<double> &X() const { return X_; }
+  const SpMatrix<double> &S(int32 i) const { return S_[i]; }
+};
+
+// Returns the extractor's means, which are not otherwise accessible.
+void GetExtractorMeans(const IvectorExtractor &extractor,
+                       Matrix<double> *mu) {
+  std::ostringstream os;
+  extractor.Write(os, false);
+  std::istringstream is(os.str());
+  std::string token;
+  while (is >> token && token != "<mu>") { }
+  mu->Read(is, false);
+}
+
+// Accumulates the stats of utterances [begin, end) the way
+// IvectorExtractorStats::AccStatsForUtterance() did before it cached them,
+// with a rank-1 update of gamma_iV_iV_ and gamma_supV_iV_ per utterance, and
+// writes them in the format of IvectorExtractorStats::Write().
+void WriteReferenceStats(const IvectorExtractor &extractor,
+                         const std::vector<Matrix<BaseFloat> > &feats,
+                         const std::vector<Posterior> &post,
+                         int32 begin, int32 end, std::ostream &os,
+                         bool binary) {
+  int32 num_gauss = extractor.NumGauss(), feat_dim = extractor.FeatDim(),
+      ivector_dim = extractor.IvectorDim();
+  Matrix<double> mu;
+  GetExtractorMeans(extractor, &mu);
+  std::vector<Matrix<double> > gamma_supV_iV(
+      num_gauss, Matrix<double>(feat_dim, ivector_dim));
+  Matrix<double> gamma_iV_iV(num_gauss, ivector_dim * (ivector_dim + 1) / 2);
+  std::vector<SpMatrix<double> > gamma_supV_supV(num_gauss,
+                                                 SpMatrix<double>(feat_dim));
+  Vector<double> sum_iV(ivector_dim), gamma(num_gauss);
+  SpMatrix<double> iV_iV(ivector_dim);
+  double num_ivectors = 0.0;
+
+  for (int32 utt = begin; utt < end; utt++) {
+    TestUtteranceStats utt_stats(num_gauss, feat_dim);
+    utt_stats.AccStats(feats[utt], post[utt]);
+    Vector<double> ivector(ivector_dim);
+    Matrix<double> normalized_gammasup(num_gauss, feat_dim);
+    SpMatrix<double> ivector_var(ivector_dim);
+    extractor.GetIvectorDistribution(utt_stats, &ivector, &ivector_var,
+                                     &normalized_gammasup);
+
+    gamma.AddVec(1.0, utt_stats.Gamma());
+    SpMatrix<double> ivec_scatter(ivector_var);
+    ivec_scatter.AddVec2(1.0, ivector);
+    SubVector<double> ivec_scatter_vec(ivec_scatter.Data(),
+                                       ivector_dim * (ivector_dim + 1) / 2);
+    gamma_iV_iV.AddVecVec(1.0, utt_stats.Gamma(), ivec_scatter_vec);
+    sum_iV.AddVec(1.0, ivector);
+    iV_iV.AddSp(1.0, ivec_scatter);
+    num_ivectors++;
+    for (int32 i = 0; i < num_gauss; i++) {
+      gamma_supV_iV[i].AddVecVec(1.0, normalized_gammasup.Row(i), ivector);
+      gamma_supV_supV[i].AddSp(1.0, utt_stats.S(i));
+      if (!extractor.PriorMode()) {
+        Matrix<double> XsupsupX(feat_dim, feat_dim);
+        XsupsupX.AddVecVec(1.0, mu.Row(i), utt_stats.X().Row(i));
+        XsupsupX.AddVecVec(1.0, normalized_gammasup.Row(i), mu.Row(i));
+        SpMatrix<double> XsupsupX_sp(feat_dim);
+        XsupsupX_sp.CopyFromMat(XsupsupX);
+        gamma_supV_supV[i].AddSp(-1.0, XsupsupX_sp);
+      }
+    }
+  }
+
+  WriteToken(os, binary, "<IvectorExtractorStats3>");
+  WriteToken(os, binary, "<gammaSupViV>");
+  WriteBasicType(os, binary, num_gauss);
+  for (int32 i = 0; i < num_gauss; i++)
+    gamma_supV_iV[i].Write(os, binary);
+  WriteToken(os, binary, "<gammaiViV>");
+  gamma_iV_iV.Write(os, binary);
+  WriteToken(os, binary, "<gammaSupVsupV>");
+  WriteBasicType(os, binary, num_gauss);
+  for (int32 i = 0; i < num_gauss; i++)
+    gamma_supV_supV[i].Write(os, binary);
+  WriteToken(os, binary, "<sumiV>");
+  sum_iV.Write(os, binary);
+  WriteToken(os, binary, "<iViV>");
+  iV_iV.Write(os, binary);
+  WriteToken(os, binary, "<Gamma>");
+  gamma.Write(os, binary);
+  WriteToken(os, binary, "<NumIvectors>");
+  WriteBasicType(os, binary, num_ivectors);
+  WriteToken(os, binary, "</IvectorExtractorStats3>");
+}
+
+// Accumulates the stats of every num_threads_'th utterance.
+class IvectorExtractorTestAccStatsClass: public MultiThreadable {
+ public:
+  IvectorExtractorTestAccStatsClass(
+      const IvectorExtractor &extractor,
+      const std::vector<Matrix<BaseFloat> > &feats,
+      const std::vector<Posterior> &post, IvectorExtractorStats *stats):
+      extractor_(extractor), feats_(feats), post_(post), stats_(stats) { }
+  void operator () () {
+    for (size_t utt = thread_id_; utt < feats_.size(); utt += num_threads_)
+      stats_->AccStatsForUtterance(extractor_, feats_[utt], post_[utt]);
+  }
+ private:
+  const IvectorExtractor &extractor_;
+  const std::vector<Matrix<BaseFloat> > &feats_;
+  const std::vector<Posterior> &post_;
+  IvectorExtractorStats *stats_;
+};
+
+// Checks that the stats accumulated through a cache from several threads
+// match the per-utterance accumulation done before the cache existed, also
+// when accumulating into stats that were Read(), and that the update of the
+// extractor done with several threads matches the one done with one thread.
+void UnitTestIvectorExtractorStats() {
+  FullGmm fgmm;
+  int32 dim = 2 + Rand() % 5, num_comp = 1 + Rand() % 5;
+  unittest::InitRandFullGmm(dim, num_comp, &fgmm);
+  FullGmmNormal fgmm_normal(fgmm);
+
+  IvectorExtractorOptions ivector_opts;
+  ivector_opts.ivector_dim = 2 + Rand() % 5;
+  ivector_opts.prior_mode = (Rand() % 2 == 0);
+  IvectorExtractor extractor(ivector_opts, fgmm);
+
+  int32 num_utts = 1 + Rand() % 20;
+  std::vector<Matrix<BaseFloat> > all_feats(num_utts);
+  std::vector<Posterior> all_post(num_utts);
+  for (int32 utt = 0; utt < num_utts; utt++) {
+    int32 num_frames = 50 + Rand() % 100;
+    all_feats[utt].Resize(num_frames, dim);
+    fgmm_normal.Rand(&all_feats[utt]);
+    all_post[utt].resize(num_frames);
+    for (int32 t = 0; t < num_frames; t++) {
+      Vector<BaseFloat> posterior(num_comp, kUndefined);
+      fgmm.ComponentPosteriors(all_feats[utt].Row(t), &posterior);
+      for (int32 i = 0; i < num_comp; i++)
+        all_post[utt][t].push_back(std::make_pair(i, posterior(i)));
+    }
+  }
+
+  // The stats are compared as text; they are read back from the binary form,
+  // which keeps the full precision.
+  std::ostringstream ref_stats_os, ref_stats_binary_os;
+  WriteReferenceStats(extractor, all_feats, all_post, 0, num_utts,
+                      ref_stats_os, false);
+  WriteReferenceStats(extractor, all_feats, all_post, 0, num_utts,
+                      ref_stats_binary_os, true);
+
+  IvectorExtractorStatsOptions cached_opts;
+  cached_opts.cache_size = 1 + Rand() % 10;
+  IvectorExtractorStats cached_stats(extractor, cached_opts);
+  g_num_threads = 2 + Rand() % 4;
+  RunMultiThreaded(IvectorExtractorTestAccStatsClass(
+      extractor, all_feats, all_post, &cached_stats));
+  // Write() flushes the cache.
+  std::ostringstream cached_stats_os;
+  cached_stats.Write(cached_stats_os, false);
+  AssertTextApproxEqual(ref_stats_os.str(), cached_stats_os.str(), 1.0e-04);
+
+  // Stats that were default-constructed and Read() size their caches when
+  // they are first used.
+  int32 num_read = Rand() % (num_utts + 1);
+  std::ostringstream part_stats_os;
+  WriteReferenceStats(extractor, all_feats, all_post, 0, num_read,
+                      part_stats_os, true);
+  IvectorExtractorStats read_stats;
+  {
+    std::istringstream is(part_stats_os.str());
+    read_stats.Read(is, true);
+  }
+  for (int32 utt = num_read; utt < num_utts; utt++)
+    read_stats.AccStatsForUtterance(extractor, all_feats[utt], all_post[utt]);
+  std::ostringstream read_stats_os;
+  read_stats.Write(read_stats_os, false);
+  AssertTextApproxEqual(ref_stats_os.str(), read_stats_os.str(), 1.0e-04);
+
+  IvectorExtractorEstimationOptions update_opts;
+  // Sometimes some Gaussians are not updated.
+  update_opts.gaussian_min_count = (Rand() % 2 == 0 ? 0.0 : 100.0);
+  if (Rand() % 2 == 0) update_opts.variance_floor_factor = 0.0;
+  IvectorExtractorStats ref_stats;
+  {
+    std::istringstream is(ref_stats_binary_os.str());
+    ref_stats.Read(is, true);
+  }
+  IvectorExtractor serial_extractor(extractor), parallel_extractor(extractor);
+  g_num_threads = 1;
+  ref_stats.Update(serial_extractor, update_opts);
+  g_num_threads = 2 + Rand() % 4;
+  cached_stats.Update(parallel_extractor, update_opts);
+  g_num_threads = 1;
+
+  std::ostringstream serial_os, parallel_os;
+  serial_extractor.Write(serial_os, false);
+  parallel_extractor.Write(parallel_os, false);
+  AssertTextApproxEqual(serial_os.str(), parallel_os.str(), 1.0e-03);
+}
+
+}  // namespace ivector3
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  using namespace kaldi::ivector3;
+  for (int i = 0; i < 20; i++)
+    UnitTestIvectorExtractorStats();
+  std::cout << "Test OK.\n";
+  return 0;
+}
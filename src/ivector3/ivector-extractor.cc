@@ -51,32 +51,62 @@ void IvectorExtractorUtteranceStats::AccStats(
         feat_dim = feats.NumCols();
   KALDI_ASSERT(X_.NumCols() == feat_dim);
   KALDI_ASSERT(feats.NumRows() == static_cast<int32>(post.size()));
-  SpMatrix<double> outer_prod(feat_dim);
 
+  // We first transpose the posteriors, so that all the frames of a Gaussian
+  // can be done together: its first-order stats as one matrix-vector product
+  // and its second-order stats as one symmetric rank-k update, instead of
+  // one vector addition and one rank-one update per (frame, Gaussian) pair.
+  std::vector<VecType> gauss_frames(num_gauss);
   for (int32 t = 0; t < num_frames; t++) {
-    SubVector<BaseFloat> frame(feats, t);
     const VecType &this_post(post[t]);
-    if (S_.size() != 0) {
-      outer_prod.SetZero();
-      outer_prod.AddVec2(1.0, frame);
-    }
     for (VecType::const_iterator iter = this_post.begin();
         iter != this_post.end(); ++iter) {
       int32 i = iter->first; // Gaussian index.
       KALDI_ASSERT(i >= 0 && i < num_gauss &&
                    "Out-of-range Gaussian (mismatched posteriors?)");
-      double weight = iter->second;
+      gauss_frames[i].push_back(std::make_pair(t, iter->second));
+    }
+  }
+
+  // The rows of "frames" are the frames times the square root of their
+  // posterior, which is in "sqrt_weights".
+  Matrix<double> frames;
+  Vector<double> sqrt_weights;
+  for (int32 i = 0; i < num_gauss; i++) {
+    const VecType &this_frames(gauss_frames[i]);
+    int32 n = this_frames.size();
+    if (n == 0) continue;
+    frames.Resize(n, feat_dim, kUndefined);
+    sqrt_weights.Resize(n, kUndefined);
+    for (int32 k = 0; k < n; k++) {
+      SubVector<BaseFloat> frame(feats, this_frames[k].first);
+      double weight = this_frames[k].second;
       gamma_(i) += weight;
-      X_.Row(i).AddVec(weight, frame);
-      if (S_.size() != 0) {
-        S_[i].AddSp(weight, outer_prod);
+      frames.Row(k).CopyFromVec(frame);
+      if (weight >= 0.0) {
+        sqrt_weights(k) = std::sqrt(weight);
+        frames.Row(k).Scale(sqrt_weights(k));
+      } else {
+        // Negative posteriors are very unusual; we do these frames
+        // one at a time.
+        X_.Row(i).AddVec(weight, frame);
+        if (S_.size() != 0)
+          S_[i].AddVec2(weight, frames.Row(k));
+        sqrt_weights(k) = 0.0;
+        frames.Row(k).SetZero();
       }
     }
-  } 
+    X_.Row(i).AddMatVec(1.0, frames, kTrans, sqrt_weights, 1.0);
+    if (S_.size() != 0)
+      S_[i].AddMat2(1.0, frames, kTrans, 1.0);
+  }
 }
 
 
-IvectorExtractorStats::IvectorExtractorStats(const IvectorExtractor& extractor) {
+IvectorExtractorStats::IvectorExtractorStats(
+    const IvectorExtractor& extractor,
+    const IvectorExtractorStatsOptions &stats_opts):
+    cache_size_(stats_opts.cache_size), num_cached_(0) {
   const int32 num_gauss = extractor.NumGauss();
   const int32 ivector_dim = extractor.IvectorDim();
   const int32 feat_dim = extractor.FeatDim();
@@ -92,6 +122,8 @@ IvectorExtractorStats::IvectorExtractorStats(const IvectorExtractor& extractor)
   iV_iV_.Resize(ivector_dim);
   gamma_.Resize(num_gauss);
   num_ivectors_ = 0.0;
+
+  KALDI_ASSERT(cache_size_ > 0);
 }
 
 
@@ -112,25 +144,39 @@ void IvectorExtractorStats::AccStatsForUtterance(const IvectorExtractor &extract
 
   extractor.GetIvectorDistribution(utt_stats, &ivector, &ivector_var, &normalized_gammasup);
   
-  gamma_iV_lock_.Lock();
-  gamma_.AddVec(1.0, utt_stats.gamma_);
-
   SpMatrix<double> ivec_scatter(ivector_var);
   ivec_scatter.AddVec2(1.0, ivector);       // ivector^2 + ivec_var
-  SubVector<double> ivec_scatter_vec(ivec_scatter.Data(),
-                                     ivector_dim * (ivector_dim + 1) / 2);
-  gamma_iV_iV_.AddVecVec(1.0, utt_stats.gamma_, ivec_scatter_vec);
+
+  gamma_iV_lock_.Lock();
+  gamma_.AddVec(1.0, utt_stats.gamma_);
   sum_iV_.AddVec(1.0, ivector);
   iV_iV_.AddSp(1.0, ivec_scatter);
   num_ivectors_++;
   gamma_iV_lock_.Unlock();
 
-  gamm_supV_iV_lock_.Lock();
-  for (int32 i = 0; i < extractor.NumGauss(); i++) {
-    gamma_supV_iV_[i].AddVecVec(1.0, normalized_gammasup.Row(i), ivector);
+  // The stats for gamma_iV_iV_ and gamma_supV_iV_ go through the cache.
+  cache_lock_.Lock();
+  if (gamma_cache_.NumRows() == 0) {
+    gamma_cache_.Resize(cache_size_, num_gauss);
+    ivec_scatter_cache_.Resize(cache_size_,
+                               ivector_dim * (ivector_dim + 1) / 2);
+    ivector_cache_.Resize(cache_size_, ivector_dim);
+    gammasup_cache_.Resize(cache_size_, num_gauss * feat_dim);
   }
-  gamm_supV_iV_lock_.Unlock();
-  
+  while (num_cached_ == gamma_cache_.NumRows()) {
+    // Cache full.  The "while" statement is in case of certain race conditions.
+    cache_lock_.Unlock();
+    FlushCache();
+    cache_lock_.Lock();
+  }
+  gamma_cache_.Row(num_cached_).CopyFromVec(utt_stats.gamma_);
+  SubVector<double> ivec_scatter_vec(ivec_scatter.Data(),
+                                     ivector_dim * (ivector_dim + 1) / 2);
+  ivec_scatter_cache_.Row(num_cached_).CopyFromVec(ivec_scatter_vec);
+  ivector_cache_.Row(num_cached_).CopyFromVec(ivector);
+  gammasup_cache_.Row(num_cached_).CopyRowsFromMat(normalized_gammasup);
+  num_cached_++;
+  cache_lock_.Unlock();
 
   Matrix<double> XsupsupX (feat_dim, feat_dim);
   SpMatrix<double> XsupsupX_sp (feat_dim);
@@ -149,7 +195,47 @@ void IvectorExtractorStats::AccStatsForUtterance(const IvectorExtractor &extract
   gamma_supV_supV_lock_.Unlock();
 }
 
+void IvectorExtractorStats::FlushCache() {
+  cache_lock_.Lock();
+  if (num_cached_ > 0) {
+    KALDI_VLOG(1) << "Flushing cache for IvectorExtractorStats";
+    // Store these quantities as copies in memory so other threads can use the
+    // cache while we update the stats from it.
+    Matrix<double> gamma_cache(gamma_cache_.RowRange(0, num_cached_)),
+        ivec_scatter_cache(ivec_scatter_cache_.RowRange(0, num_cached_)),
+        ivector_cache(ivector_cache_.RowRange(0, num_cached_)),
+        gammasup_cache(gammasup_cache_.RowRange(0, num_cached_));
+    num_cached_ = 0; // As far as other threads are concerned, the cache is
+                     // cleared and they may write to it.
+    cache_lock_.Unlock();
+
+    gamma_iV_lock_.Lock();
+    gamma_iV_iV_.AddMatMat(1.0, gamma_cache, kTrans,
+                           ivec_scatter_cache, kNoTrans, 1.0);
+    gamma_iV_lock_.Unlock();
+
+    int32 num_gauss = gamma_supV_iV_.size(),
+        feat_dim = gammasup_cache.NumCols() / num_gauss;
+    gamm_supV_iV_lock_.Lock();
+    for (int32 i = 0; i < num_gauss; i++) {
+      SubMatrix<double> gammasup_i(gammasup_cache, 0, gammasup_cache.NumRows(),
+                                   i * feat_dim, feat_dim);
+      gamma_supV_iV_[i].AddMatMat(1.0, gammasup_i, kTrans,
+                                  ivector_cache, kNoTrans, 1.0);
+    }
+    gamm_supV_iV_lock_.Unlock();
+  } else {
+    cache_lock_.Unlock();
+  }
+}
+
+void IvectorExtractorStats::Write(std::ostream &os, bool binary) {
+  FlushCache();
+  ((const IvectorExtractorStats&)(*this)).Write(os, binary); // call const version.
+}
+
 void IvectorExtractorStats::Write(std::ostream &os, bool binary) const {
+  KALDI_ASSERT(num_cached_ == 0 && "Please use the non-const Write().");
   WriteToken(os, binary, "<IvectorExtractorStats3>");
   WriteToken(os, binary, "<gammaSupViV>");
   int32 size = gamma_supV_iV_.size();
@@ -175,6 +261,7 @@ void IvectorExtractorStats::Write(std::ostream &os, bool binary) const {
 }
 
 void IvectorExtractorStats::Read(std::istream &is, bool binary, bool add) {
+  FlushCache();  // So that the cached stats are added (or replaced) too.
   ExpectToken(is, binary, "<IvectorExtractorStats3>");
   ExpectToken(is, binary, "<gammaSupViV>");
   int32 size;
@@ -302,57 +389,134 @@ void IvectorExtractorStats::UpdateProjections(
 }
 
 
+void IvectorExtractorStats::UpdateVariance(
+    const IvectorExtractorEstimationOptions &update_opts,
+    int32 i,
+    IvectorExtractor *extractor) const {
+  if (gamma_(i) < update_opts.gaussian_min_count)
+    return; // warned in UpdateProjections
+
+  int32 feat_dim = extractor->FeatDim(),
+      ivector_dim = extractor->IvectorDim();
+  Matrix<double> AY(feat_dim, feat_dim);
+  Matrix<double> AYYA(feat_dim, feat_dim);
+  SpMatrix<double> gamma_iV_iV_sp(ivector_dim, kUndefined);
+  SubVector<double> gamma_iV_iV_sub(gamma_iV_iV_sp.Data(), ivector_dim * (ivector_dim+1) / 2);
+
+  AY.AddMatMat(-1.0, extractor->A_[i], kNoTrans, gamma_supV_iV_[i], kTrans, 0.0);   // = - A*Y^T
+  AYYA.CopyFromMat(AY, kTrans);   // = - Y^T*A
+  AYYA.AddMat(1.0, AY);           // = - (A*Y^T + Y^T*A)
+
+  extractor->Psi_inv_[i].CopyFromMat(AYYA);
+  extractor->Psi_inv_[i].AddSp(1.0, gamma_supV_supV_[i]);
+
+  SubVector<double> gamma_iV_iV_vec(gamma_iV_iV_, i); // i'th row of R; vectorized form of SpMatrix.
+  gamma_iV_iV_sub.CopyFromVec(gamma_iV_iV_vec);       // copy to SpMatrix's memory.
+
+  extractor->Psi_inv_[i].AddMat2Sp(1.0, extractor->A_[i], kNoTrans, gamma_iV_iV_sp, 1.0);
+  extractor->Psi_inv_[i].Scale(1.0 / gamma_(i));
+}
+
+int32 IvectorExtractorStats::FloorVariance(
+    const IvectorExtractorEstimationOptions &update_opts,
+    const SpMatrix<double> &floor,
+    int32 i,
+    IvectorExtractor *extractor) const {
+  // If the Gaussian was skipped, Psi_inv_[i] still has the old inverse
+  // variance.
+  if (gamma_(i) < update_opts.gaussian_min_count)
+    return 0;
+  int32 num_floored = 0;
+  if (update_opts.variance_floor_factor != 0)
+    num_floored = extractor->Psi_inv_[i].ApplyFloor(floor);
+  extractor->Psi_inv_[i].Invert();
+  return num_floored;
+}
+
+class IvectorExtractorUpdateVarianceClass {
+ public:
+  IvectorExtractorUpdateVarianceClass(const IvectorExtractorStats &stats,
+                        const IvectorExtractorEstimationOptions &opts,
+                        int32 i,
+                        IvectorExtractor *extractor):
+      stats_(stats), opts_(opts), i_(i), extractor_(extractor) { }
+  void operator () () {
+    stats_.UpdateVariance(opts_, i_, extractor_);
+  }
+ private:
+  const IvectorExtractorStats &stats_;
+  const IvectorExtractorEstimationOptions &opts_;
+  int32 i_;
+  IvectorExtractor *extractor_;
+};
+
+class IvectorExtractorFloorVarianceClass {
+ public:
+  IvectorExtractorFloorVarianceClass(const IvectorExtractorStats &stats,
+                        const IvectorExtractorEstimationOptions &opts,
+                        const SpMatrix<double> &floor,
+                        int32 i,
+                        IvectorExtractor *extractor,
+                        int32 *tot_num_floored):
+      stats_(stats), opts_(opts), floor_(floor), i_(i), extractor_(extractor),
+      tot_num_floored_(tot_num_floored), num_floored_(0) { }
+  void operator () () {
+    num_floored_ = stats_.FloorVariance(opts_, floor_, i_, extractor_);
+  }
+  ~IvectorExtractorFloorVarianceClass() {
+    *tot_num_floored_ += num_floored_;
+    if (num_floored_ > 0)
+      KALDI_LOG << "For Gaussian index " << i_ << ", floored "
+                << num_floored_ << " eigenvalues of variance.";
+  }
+ private:
+  const IvectorExtractorStats &stats_;
+  const IvectorExtractorEstimationOptions &opts_;
+  const SpMatrix<double> &floor_;
+  int32 i_;
+  IvectorExtractor *extractor_;
+  int32 *tot_num_floored_;
+  int32 num_floored_;
+};
+
 void IvectorExtractorStats::Update(IvectorExtractor &extractor, const IvectorExtractorEstimationOptions &update_opts) {
   
+  FlushCache();
+
   UpdateProjections(update_opts, extractor);
 
   // Update variance
   if (update_opts.update_variance) {
-    int32 feat_dim = extractor.FeatDim();
-    Matrix<double> AY(feat_dim, feat_dim);
-    Matrix<double> AYYA(feat_dim, feat_dim);
-
-    SpMatrix<double> tot_Psi(feat_dim);
+    int32 feat_dim = extractor.FeatDim(),
+        num_gauss = extractor.NumGauss();
+    TaskSequencerConfig sequencer_opts;
+    sequencer_opts.num_threads = g_num_threads;
+    {
+      TaskSequencer<IvectorExtractorUpdateVarianceClass> sequencer(
+          sequencer_opts);
+      for (int32 i = 0; i < num_gauss; i++)
+        sequencer.Run(new IvectorExtractorUpdateVarianceClass(
+            *this, update_opts, i, &extractor));
+    }
 
     bool floor_psi = (update_opts.variance_floor_factor != 0) ;
 
-    int32 ivector_dim = extractor.IvectorDim();
-    SpMatrix<double> gamma_iV_iV_sp(ivector_dim, kUndefined);
-    SubVector<double> gamma_iV_iV_sub(gamma_iV_iV_sp.Data(), ivector_dim * (ivector_dim+1) / 2);
-
-    for (int32 i = 0; i < extractor.NumGauss(); i++) {
-      if (gamma_(i) < update_opts.gaussian_min_count) continue; // warned in UpdateProjections
-
-      AY.AddMatMat(-1.0, extractor.A_[i], kNoTrans, gamma_supV_iV_[i], kTrans, 0.0);   // = - A*Y^T
-      AYYA.CopyFromMat(AY, kTrans);   // = - Y^T*A
-      AYYA.AddMat(1.0, AY);           // = - (A*Y^T + Y^T*A)
-
-      extractor.Psi_inv_[i].CopyFromMat(AYYA);
-      extractor.Psi_inv_[i].AddSp(1.0, gamma_supV_supV_[i]);
-     
-      SubVector<double> gamma_iV_iV_vec(gamma_iV_iV_, i); // i'th row of R; vectorized form of SpMatrix.
-      gamma_iV_iV_sub.CopyFromVec(gamma_iV_iV_vec);       // copy to SpMatrix's memory.
-     
-      extractor.Psi_inv_[i].AddMat2Sp(1.0, extractor.A_[i], kNoTrans, gamma_iV_iV_sp, 1.0);
-      extractor.Psi_inv_[i].Scale(1.0 / gamma_(i));
-      if (floor_psi) {
-        tot_Psi.AddSp(1.0, extractor.Psi_inv_[i]);
-      }
+    SpMatrix<double> tot_Psi(feat_dim);
+    if (floor_psi) {
+      for (int32 i = 0; i < num_gauss; i++)
+        if (gamma_(i) >= update_opts.gaussian_min_count)
+          tot_Psi.AddSp(1.0, extractor.Psi_inv_[i]);
     }
-    tot_Psi.Scale(update_opts.variance_floor_factor / extractor.NumGauss());
+    tot_Psi.Scale(update_opts.variance_floor_factor / num_gauss);
     int32 tot_num_floored = 0;
-
-    for (int32 i = 0; i < extractor.NumGauss(); i++) {
-      if (floor_psi) {
-        int32 num_floored = extractor.Psi_inv_[i].ApplyFloor(tot_Psi);
-        tot_num_floored += num_floored;
-        if (num_floored > 0)
-          KALDI_LOG << "For Gaussian index " << i << ", floored "
-                    << num_floored << " eigenvalues of variance.";
-      }
-      extractor.Psi_inv_[i].Invert();
+    {
+      TaskSequencer<IvectorExtractorFloorVarianceClass> sequencer(
+          sequencer_opts);
+      for (int32 i = 0; i < num_gauss; i++)
+        sequencer.Run(new IvectorExtractorFloorVarianceClass(
+            *this, update_opts, tot_Psi, i, &extractor, &tot_num_floored));
     }
-    double floored_percent = tot_num_floored * 100.0 / (extractor.NumGauss() * extractor.FeatDim());
+    double floored_percent = tot_num_floored * 100.0 / (num_gauss * feat_dim);
     KALDI_LOG << "Floored " << floored_percent << "% of all Gaussian eigenvalues";
   }
 
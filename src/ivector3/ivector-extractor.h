@@ -100,18 +100,41 @@ struct IvectorExtractorEstimationOptions {
   }
 };
 
+struct IvectorExtractorStatsOptions {
+  int32 cache_size;
+  IvectorExtractorStatsOptions(): cache_size(100) { }
+  void Register(OptionsItf *po) {
+    po->Register("cache-size", &cache_size, "Size of cache for the stats that "
+                 "are products of the iVector with other quantities (the "
+                 "number of utterances whose stats are added as one matrix "
+                 "multiplication)");
+  }
+};
+
 class IvectorExtractor;
 
 class IvectorExtractorStats {
  public:
   friend class IvectorExtractor;
 
-  IvectorExtractorStats() {};
+  IvectorExtractorStats():
+      cache_size_(IvectorExtractorStatsOptions().cache_size), num_cached_(0) {};
 
-  IvectorExtractorStats(const IvectorExtractor& extractor);
+  IvectorExtractorStats(const IvectorExtractor& extractor,
+                        const IvectorExtractorStatsOptions &stats_opts =
+                        IvectorExtractorStatsOptions());
   
+  /// This may be called from several threads at once.  The stats that are
+  /// products with the iVector (most of the work) are cached, and added a
+  /// few utterances at a time by FlushCache().
   void AccStatsForUtterance(const IvectorExtractor &extractor, const MatrixBase<BaseFloat> &feats, 
                             const Posterior &post);
+
+  /// Adds the cached stats to the totals.  Write() and Update() call this.
+  void FlushCache();
+
+  /// Calls FlushCache() before writing.
+  void Write(std::ostream &os, bool binary);
   
   void Write(std::ostream &os, bool binary) const;
 
@@ -132,6 +155,18 @@ class IvectorExtractorStats {
 
   void UpdateProjections(const IvectorExtractorEstimationOptions &opts, IvectorExtractor &extractor) const;
 
+  /// Sets extractor->Psi_inv_[i] to the new variance (not yet inverted) of
+  /// Gaussian i; this needs the projection already updated.
+  void UpdateVariance(const IvectorExtractorEstimationOptions &update_opts,
+                      int32 i, IvectorExtractor *extractor) const;
+
+  /// Floors the variance from UpdateVariance() to "floor" (unless the
+  /// variance floor factor is zero) and inverts it.  Returns the number of
+  /// eigenvalues floored.
+  int32 FloorVariance(const IvectorExtractorEstimationOptions &update_opts,
+                      const SpMatrix<double> &floor, int32 i,
+                      IvectorExtractor *extractor) const;
+
  private:
   std::vector<Matrix<double> > gamma_supV_iV_;
   Matrix<double> gamma_iV_iV_;
@@ -144,6 +179,24 @@ class IvectorExtractorStats {
   Mutex gamma_iV_lock_;
   Mutex gamm_supV_iV_lock_;
   Mutex gamma_supV_supV_lock_;
+
+  /// This mutex guards num_cached_ and the caches below.
+  Mutex cache_lock_;
+  /// The number of utterances the caches hold; they are sized on first use,
+  /// as the dimensions are not known if the stats were default-constructed
+  /// and then Read().
+  int32 cache_size_;
+  /// To avoid too-frequent rank-1 updates of gamma_iV_iV_ and gamma_supV_iV_,
+  /// which are slow, we cache the per-utterance quantities here.
+  int32 num_cached_;
+  /// dimension: [num-to-cache][I]
+  Matrix<double> gamma_cache_;
+  /// dimension: [num-to-cache][S*(S+1)/2]
+  Matrix<double> ivec_scatter_cache_;
+  /// dimension: [num-to-cache][S]
+  Matrix<double> ivector_cache_;
+  /// The normalized first-order stats; dimension: [num-to-cache][I*D]
+  Matrix<double> gammasup_cache_;
 };
 
 class IvectorExtractor {
@@ -23,8 +23,63 @@
 #include "util/common-utils.h"
 #include "gmm/am-diag-gmm.h"
 #include "ivector3/ivector-extractor.h"
+#include "thread/kaldi-task-sequence.h"
 #include <algorithm>
 
+namespace kaldi {
+namespace ivector3 {
+
+// This class is used to extract the iVectors of several utterances in
+// parallel: the stats accumulation and the solve happen in operator (), and
+// the output, in the original order, in the destructor.
+class IvectorExtractTask {
+ public:
+  IvectorExtractTask(const IvectorExtractor &extractor,
+                     const std::string &key,
+                     const Matrix<BaseFloat> &feats,
+                     const Posterior &posterior,
+                     DoubleVectorWriter *writer,
+                     double *tot_auxf):
+      extractor_(extractor), key_(key), feats_(feats), posterior_(posterior),
+      writer_(writer), tot_auxf_(tot_auxf), auxf_(0.0) { }
+
+  void operator () () {
+    bool need_2nd_order_stats = (tot_auxf_ != NULL);
+    IvectorExtractorUtteranceStats stats(extractor_.NumGauss(),
+                                         extractor_.FeatDim(),
+                                         need_2nd_order_stats);
+    stats.AccStats(feats_, posterior_);
+    // We don't need these any more.
+    feats_.Resize(0, 0);
+    Posterior().swap(posterior_);
+
+    ivector_.Resize(extractor_.IvectorDim());
+    bool for_scoring = true;
+    extractor_.GetIvectorDistribution(stats, &ivector_, NULL, NULL,
+                                      (tot_auxf_ != NULL ? &auxf_ : NULL),
+                                      for_scoring);
+  }
+
+  ~IvectorExtractTask() {
+    if (tot_auxf_ != NULL)
+      *tot_auxf_ += auxf_;
+    writer_->Write(key_, ivector_);
+  }
+
+ private:
+  const IvectorExtractor &extractor_;
+  std::string key_;
+  Matrix<BaseFloat> feats_;
+  Posterior posterior_;
+  DoubleVectorWriter *writer_;
+  double *tot_auxf_;  // if non-NULL we need the objective function.
+  double auxf_;
+  Vector<double> ivector_;
+};
+
+}  // namespace ivector3
+}  // namespace kaldi
+
 int main(int argc, char *argv[]) {
   using namespace kaldi;
   using namespace kaldi::ivector3;
@@ -42,6 +97,8 @@ int main(int argc, char *argv[]) {
     ParseOptions po(usage);
     bool compute_objf = false;
     po.Register("compute-objf", &compute_objf, "If true, compute the objective function");
+    TaskSequencerConfig sequencer_config;
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
     
@@ -68,54 +125,38 @@ int main(int argc, char *argv[]) {
     RandomAccessPosteriorReader posteriors_reader(posterior_rspecifier);
     DoubleVectorWriter ivector_writer(ivectors_wspecifier);
 
-    Vector<double> ivector(extractor.IvectorDim());
-
-    IvectorExtractorUtteranceStats stats;
-
     int32 num_done = 0, num_err = 0;
-    double this_auxf = 0;
-    int32 feat_dim = extractor.FeatDim();
-    int32 num_gauss = extractor.NumGauss();
-    bool need_2nd_order_stats = false;
-    if (compute_objf) 
-      need_2nd_order_stats = true;
-
-    for (; !feature_reader.Done(); feature_reader.Next()) {
-      std::string key = feature_reader.Key();
-      if (!posteriors_reader.HasKey(key)) {
-        KALDI_WARN << "No posteriors for utterance " << key;
-        num_err++;
-        continue;
-      }
-      const Matrix<BaseFloat> &mat = feature_reader.Value();
-      const Posterior &posterior = posteriors_reader.Value(key);
-
-      stats.Reset(num_gauss, feat_dim, need_2nd_order_stats);
-      stats.AccStats(mat, posterior);
-     
-      if (static_cast<int32>(posterior.size()) != mat.NumRows()) {
-        KALDI_WARN << "Size mismatch between posterior " << (posterior.size())
-                   << " and features " << (mat.NumRows()) << " for utterance "
-                   << key;
-        num_err++;
-        continue;
-      }
-
-      double *auxf_ptr = NULL;
-      if (compute_objf)
-        auxf_ptr = &this_auxf;
-
-      bool for_scoring = true;
-      extractor.GetIvectorDistribution(stats, &ivector, NULL, NULL, auxf_ptr, for_scoring);
-      
-      tot_auxf += this_auxf;
 
-      ivector_writer.Write(key, ivector);
-
-      num_done++;
+    {
+      TaskSequencer<IvectorExtractTask> sequencer(sequencer_config);
+      for (; !feature_reader.Done(); feature_reader.Next()) {
+        std::string key = feature_reader.Key();
+        if (!posteriors_reader.HasKey(key)) {
+          KALDI_WARN << "No posteriors for utterance " << key;
+          num_err++;
+          continue;
+        }
+        const Matrix<BaseFloat> &mat = feature_reader.Value();
+        const Posterior &posterior = posteriors_reader.Value(key);
+
+        if (static_cast<int32>(posterior.size()) != mat.NumRows()) {
+          KALDI_WARN << "Size mismatch between posterior " << (posterior.size())
+                     << " and features " << (mat.NumRows()) << " for utterance "
+                     << key;
+          num_err++;
+          continue;
+        }
+
+        sequencer.Run(new IvectorExtractTask(extractor, key, mat, posterior,
+                                             &ivector_writer,
+                                             (compute_objf ? &tot_auxf : NULL)));
+        num_done++;
+      }
+      // Destructor of "sequencer" will wait for any remaining tasks.
     }
 
-    KALDI_LOG << "Done " << num_done << " files.";
+    KALDI_LOG << "Done " << num_done << " files, " << num_err
+              << " with errors.";
 
     if (compute_objf)
       KALDI_LOG << "Overall average objective-function estimating "
@@ -65,8 +65,8 @@ int main(int argc, char *argv[]) {
     const char *usage =
         "Accumulate stats for iVector extractor training\n"
         "Reads in feature and Gaussian-level posteriors (typically from a full GMM)\n"
-        "Supports multiple threads, but won't be able to make use of too many at a time\n"
-        "(e.g. more than about 4)\n"
+        "Supports multiple threads (--num-threads); the stats of the utterances\n"
+        "are summed --cache-size utterances at a time.\n"
         "Usage:  ivector-model-acc-stats [options] <model-in> <posteriors-rspecifier>"
         "<feature-rspecifier> <stats-out>\n"
         "e.g.: \n"
@@ -77,6 +77,8 @@ int main(int argc, char *argv[]) {
     po.Register("binary", &binary, "Write output in binary mode");
     TaskSequencerConfig sequencer_opts;
     sequencer_opts.Register(&po);
+    IvectorExtractorStatsOptions stats_opts;
+    stats_opts.Register(&po);
 
     po.Read(argc, argv);
     
@@ -104,7 +106,7 @@ int main(int argc, char *argv[]) {
     g_num_threads = sequencer_opts.num_threads;
     
     
-    IvectorExtractorStats stats(extractor);
+    IvectorExtractorStats stats(extractor, stats_opts);
 
     int64 tot_t = 0;
     int32 num_done = 0, num_err = 0;
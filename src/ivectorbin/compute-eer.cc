@@ -20,58 +20,7 @@
 
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
-
-namespace kaldi {
-
-/**
-   ComputeEer computes the Equal Error Rate (EER) for the given scores
-   and returns it as a proportion beween 0 and 1.
-   If we set the threshold at x, then the target error-rate is the
-   proportion of target_scores below x; and the non-target error-rate
-   is the proportion of non-target scores above x.  We seek a
-   threshold x for which these error rates are the same; this
-   error rate is the EER.
-
-   We compute this by iterating over the positions in target_scores: 0, 1, 2,
-   and so on, and for each position consider whether the cutoff could be here.
-   For each of these position we compute the corresponding position in
-   nontarget_scores where the cutoff would be if the EER were the same.
-   For instance, if the vectors had the same length, this would be position
-   length() - 1, length() - 2, and so on.  As soon as the value at that
-   position in nontarget_scores at that position is less than the value from
-   target_scores, we have our EER.
-
-   In coding this we weren't particularly careful about edge cases or
-   making sure whether it's actually n + 1 instead of n.
-*/
-
-BaseFloat ComputeEer(std::vector<BaseFloat> *target_scores,
-                     std::vector<BaseFloat> *nontarget_scores,
-                     BaseFloat *threshold) {
-  KALDI_ASSERT(!target_scores->empty() && !nontarget_scores->empty());
-  std::sort(target_scores->begin(), target_scores->end());
-  std::sort(nontarget_scores->begin(), nontarget_scores->end());
-  
-  size_t target_position = 0,
-      target_size = target_scores->size();
-  for (; target_position + 1 < target_size; target_position++) {
-    ssize_t nontarget_size = nontarget_scores->size(),
-        nontarget_n = nontarget_size * target_position * 1.0 / target_size,
-        nontarget_position = nontarget_size - 1 - nontarget_n;
-    if (nontarget_position  < 0)
-      nontarget_position = 0;
-    if ((*nontarget_scores)[nontarget_position] <
-        (*target_scores)[target_position])
-      break;
-  }
-  *threshold = (*target_scores)[target_position];
-  BaseFloat eer = target_position * 1.0 / target_size;
-  return eer;
-}
-
-
-}
-
+#include "ivector/verification-metrics.h"
 
 
 int main(int argc, char *argv[]) {
@@ -84,11 +33,32 @@ int main(int argc, char *argv[]) {
         "The first field must be a numeric score, and the second\n"
         "either the string 'target' or 'nontarget'. \n"
         "The EER will be printed to the standard output.\n"
+        "The minimum detection cost (minDCF) is also computed, and the DET\n"
+        "curve may be written with --det-curve.  By default all the scores are\n"
+        "kept and sorted (see --num-threads); with --streaming=true they are\n"
+        "counted in a histogram of fixed size instead, for very large score\n"
+        "files (see --histogram-bits).\n"
         "\n"
         "Usage: compute-eer <scores-in>\n"
         "e.g.: compute-eer -\n";
     
     ParseOptions po(usage);
+    bool streaming = false;
+    int32 histogram_bits = 20, num_threads = 1;
+    std::string det_wxfilename;
+    VerificationMetricsOptions metrics_opts;
+    metrics_opts.Register(&po);
+    po.Register("streaming", &streaming, "If true, count the scores in a "
+                "histogram rather than storing them; the results are then "
+                "approximate (see --histogram-bits).");
+    po.Register("histogram-bits", &histogram_bits, "With --streaming=true, "
+                "the number of bits of the floating point scores that "
+                "determine their histogram bin (8 to 24); the memory used is "
+                "16 bytes times 2 to this power.");
+    po.Register("num-threads", &num_threads, "Number of threads used to sort "
+                "the scores, if --streaming=false.");
+    po.Register("det-curve", &det_wxfilename, "If supplied, write the DET curve "
+                "here, as lines \"<threshold> <p-miss> <p-false-alarm>\".");
     po.Read(argc, argv);
     
     if (po.NumArgs() != 1) {
@@ -99,6 +69,9 @@ int main(int argc, char *argv[]) {
     std::string scores_rxfilename = po.GetArg(1);
 
     std::vector<BaseFloat> target_scores, nontarget_scores;
+    ScoreHistogram *histogram = NULL;
+    if (streaming)
+      histogram = new ScoreHistogram(histogram_bits);
     Input ki(scores_rxfilename);
     
     std::string line;
@@ -114,27 +87,61 @@ int main(int argc, char *argv[]) {
         KALDI_ERR << "Invalid input line (first field must be float): "
                   << line;
       }
+      bool is_target = false;
       if (split_line[1] == "target")
-        target_scores.push_back(score);
+        is_target = true;
       else if (split_line[1] == "nontarget")
-        nontarget_scores.push_back(score);
+        is_target = false;
       else {
         KALDI_ERR << "Invalid input line (second field must be "
                   << "'target' or 'nontarget')";
       }
+      if (histogram != NULL)
+        histogram->Add(score, is_target);
+      else if (is_target)
+        target_scores.push_back(score);
+      else
+        nontarget_scores.push_back(score);
     }
-    if (target_scores.empty() && nontarget_scores.empty())
+    int64 num_target = (streaming ? histogram->NumTarget() :
+                        target_scores.size()),
+        num_nontarget = (streaming ? histogram->NumNontarget() :
+                         nontarget_scores.size());
+    if (num_target == 0 && num_nontarget == 0)
       KALDI_ERR << "Empty input.";
-    if (target_scores.empty())
+    if (num_target == 0)
       KALDI_ERR << "No target scores seen.";
-    if (nontarget_scores.empty())
+    if (num_nontarget == 0)
       KALDI_ERR << "No non-target scores seen.";
 
-    BaseFloat threshold;
-    BaseFloat eer = ComputeEer(&target_scores, &nontarget_scores, &threshold);
+    BaseFloat eer, threshold;
+    ErrorRateSweeper sweeper(metrics_opts, num_target, num_nontarget);
+    if (streaming) {
+      histogram->Sweep(&sweeper);
+      delete histogram;
+      eer = sweeper.Eer(&threshold);
+    } else {
+      SortScores(num_threads, &target_scores);
+      SortScores(num_threads, &nontarget_scores);
+      SweepSortedScores(target_scores, nontarget_scores, &sweeper);
+      eer = ComputeEer(target_scores, nontarget_scores, &threshold);
+    }
 
     KALDI_LOG << "Equal error rate is " << (100.0 * eer)
               << "%, at threshold " << threshold;
+    BaseFloat dcf_threshold, min_dcf = sweeper.MinDcf(&dcf_threshold);
+    KALDI_LOG << "Minimum DCF (p-target = " << metrics_opts.p_target
+              << ", c-miss = " << metrics_opts.c_miss << ", c-fa = "
+              << metrics_opts.c_fa << ") is " << min_dcf << ", at threshold "
+              << dcf_threshold;
+
+    if (!det_wxfilename.empty()) {
+      Output ko(det_wxfilename, false);
+      const std::vector<DetPoint> &det_curve = sweeper.DetCurve();
+      for (size_t i = 0; i < det_curve.size(); i++)
+        ko.Stream() << det_curve[i].threshold << ' ' << det_curve[i].p_miss
+                    << ' ' << det_curve[i].p_fa << '\n';
+    }
 
     std::cout.precision(4);
     std::cout << (100.0 * eer);
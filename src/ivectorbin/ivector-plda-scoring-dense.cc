@@ -0,0 +1,316 @@
+// ivectorbin/ivector-plda-scoring-dense.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <functional>
+#include <queue>
+#include <sstream>
+
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+#include "util/common-utils.h"
+#include "ivector/plda.h"
+#include "thread/kaldi-task-sequence.h"
+
+namespace kaldi {
+
+// Scores one block of test iVectors against the enrollment iVectors
+// [enroll_begin, enroll_end), which are all of them if top_k > 0.  The work
+// happens in operator (), and the output (in the order of the test iVectors)
+// in the destructor.
+class PldaDenseScoreTask {
+ public:
+  PldaDenseScoreTask(const PldaBatchScorer &scorer,
+                     const std::vector<std::string> &enroll_keys,
+                     const std::vector<std::string> &test_keys,
+                     const Matrix<BaseFloat> &test_ivectors,
+                     int32 test_offset, int32 num_test,
+                     int32 enroll_begin, int32 enroll_end,
+                     int32 block_size, int32 top_k,
+                     std::ostream *os, double *tot_sum, double *tot_sumsq):
+      scorer_(scorer), enroll_keys_(enroll_keys), test_keys_(test_keys),
+      test_ivectors_(test_ivectors, test_offset, num_test, 0,
+                     test_ivectors.NumCols()),
+      test_offset_(test_offset), enroll_begin_(enroll_begin),
+      enroll_end_(enroll_end), block_size_(block_size), top_k_(top_k),
+      os_(os), tot_sum_(tot_sum), tot_sumsq_(tot_sumsq),
+      sum_(0.0), sumsq_(0.0) {
+    KALDI_ASSERT(top_k == 0 || (enroll_begin == 0 &&
+                                enroll_end == scorer.NumEnroll()));
+  }
+
+  void operator () () {
+    typedef std::pair<BaseFloat, int32> ScorePair;
+    typedef std::priority_queue<ScorePair, std::vector<ScorePair>,
+                                std::greater<ScorePair> > MinHeap;
+    int32 num_test = test_ivectors_.NumRows();
+    std::vector<MinHeap> best(top_k_ > 0 ? num_test : 0);
+    std::ostringstream text;
+    Matrix<BaseFloat> scores;
+    for (int32 e = enroll_begin_; e < enroll_end_; e += block_size_) {
+      int32 this_num_enroll = std::min(block_size_, enroll_end_ - e);
+      scores.Resize(this_num_enroll, num_test, kUndefined);
+      scorer_.ScoreBlock(e, test_ivectors_, &scores);
+      for (int32 i = 0; i < this_num_enroll; i++) {
+        const BaseFloat *row = scores.RowData(i);
+        for (int32 t = 0; t < num_test; t++) {
+          BaseFloat score = row[t];
+          sum_ += score;
+          sumsq_ += score * score;
+          if (top_k_ > 0) {
+            MinHeap &heap = best[t];
+            if (static_cast<int32>(heap.size()) < top_k_) {
+              heap.push(ScorePair(score, e + i));
+            } else if (score > heap.top().first) {
+              heap.pop();
+              heap.push(ScorePair(score, e + i));
+            }
+          }
+        }
+      }
+      if (top_k_ == 0) {
+        // Output the whole block, grouped by test iVector.
+        for (int32 t = 0; t < num_test; t++) {
+          const std::string &test_key = test_keys_[test_offset_ + t];
+          for (int32 i = 0; i < this_num_enroll; i++)
+            text << enroll_keys_[e + i] << ' ' << test_key << ' '
+                 << scores(i, t) << '\n';
+        }
+      }
+    }
+    for (size_t t = 0; t < best.size(); t++) {
+      // The heap gives the scores in increasing order; we output the best first.
+      std::vector<ScorePair> sorted;
+      for (; !best[t].empty(); best[t].pop())
+        sorted.push_back(best[t].top());
+      const std::string &test_key = test_keys_[test_offset_ + t];
+      for (size_t j = sorted.size(); j > 0; j--)
+        text << enroll_keys_[sorted[j - 1].second] << ' ' << test_key << ' '
+             << sorted[j - 1].first << '\n';
+    }
+    output_ = text.str();
+  }
+
+  ~PldaDenseScoreTask() {
+    *os_ << output_;
+    *tot_sum_ += sum_;
+    *tot_sumsq_ += sumsq_;
+  }
+
+ private:
+  const PldaBatchScorer &scorer_;
+  const std::vector<std::string> &enroll_keys_;
+  const std::vector<std::string> &test_keys_;
+  SubMatrix<BaseFloat> test_ivectors_;
+  int32 test_offset_;
+  int32 enroll_begin_;
+  int32 enroll_end_;
+  int32 block_size_;
+  int32 top_k_;
+  std::ostream *os_;
+  double *tot_sum_;
+  double *tot_sumsq_;
+  double sum_;
+  double sumsq_;
+  std::string output_;
+};
+
+// Reads the iVectors in "rspecifier", transforms them with the PLDA model and
+// stacks them into "ivectors".  If "num_utts_reader" is non-NULL the number of
+// utterances of each is read from it (iVectors without one are skipped);
+// otherwise it is 1.  Returns the total renormalization scale.
+double ReadTransformedIvectors(const Plda &plda, const PldaConfig &plda_config,
+                               const std::string &rspecifier,
+                               RandomAccessInt32Reader *num_utts_reader,
+                               std::vector<std::string> *keys,
+                               std::vector<int32> *num_utts,
+                               Matrix<BaseFloat> *ivectors,
+                               int64 *num_err) {
+  std::vector<Vector<BaseFloat>*> transformed;
+  double tot_renorm_scale = 0.0;
+  SequentialBaseFloatVectorReader reader(rspecifier);
+  for (; !reader.Done(); reader.Next()) {
+    std::string key = reader.Key();
+    int32 num_examples = 1;
+    if (num_utts_reader != NULL) {
+      if (!num_utts_reader->HasKey(key)) {
+        KALDI_WARN << "Number of utterances not given for speaker " << key;
+        (*num_err)++;
+        continue;
+      }
+      num_examples = num_utts_reader->Value(key);
+    }
+    Vector<BaseFloat> *transformed_ivector = new Vector<BaseFloat>(plda.Dim());
+    tot_renorm_scale += plda.TransformIvector(plda_config, reader.Value(),
+                                              num_examples,
+                                              transformed_ivector);
+    transformed.push_back(transformed_ivector);
+    keys->push_back(key);
+    num_utts->push_back(num_examples);
+  }
+  ivectors->Resize(transformed.size(), plda.Dim());
+  for (size_t i = 0; i < transformed.size(); i++) {
+    ivectors->Row(i).CopyFromVec(*(transformed[i]));
+    delete transformed[i];
+  }
+  return tot_renorm_scale;
+}
+
+}  // namespace kaldi
+
+
+int main(int argc, char *argv[]) {
+  using namespace kaldi;
+  typedef kaldi::int32 int32;
+  typedef kaldi::int64 int64;
+  try {
+    const char *usage =
+        "Computes PLDA log-likelihood ratios of all the pairs of train\n"
+        "(enrollment) and test iVectors, without a trials file.  This gives the\n"
+        "same scores as ivector-plda-scoring, but computes them a block of\n"
+        "iVectors at a time as matrix products, so it is much faster for large\n"
+        "numbers of trials.  The output has lines of the form\n"
+        "<train-key> <test-key> <score>\n"
+        "grouped by test iVector.  With --top-k=K, only the K best-scoring\n"
+        "train iVectors are output for each test iVector, best first.\n"
+        "\n"
+        "Usage: ivector-plda-scoring-dense [options] <plda> "
+        "<train-ivector-rspecifier>\n"
+        "  <test-ivector-rspecifier> <scores-wxfilename>\n"
+        "\n"
+        "e.g.: ivector-plda-scoring-dense --num-threads=8 --top-k=10 "
+        "--num-utts=ark:exp/train/num_utts.ark plda "
+        "ark:exp/train/spk_ivectors.ark ark:exp/test/ivectors.ark scores\n"
+        "See also: ivector-plda-scoring, ivector-compute-plda\n";
+
+    ParseOptions po(usage);
+
+    std::string num_utts_rspecifier;
+    int32 block_size = 256, top_k = 0, max_task_lines = 100000;
+
+    PldaConfig plda_config;
+    plda_config.Register(&po);
+    TaskSequencerConfig sequencer_config;
+    sequencer_config.Register(&po);
+    po.Register("num-utts", &num_utts_rspecifier, "Table to read the number of "
+                "utterances per speaker, e.g. ark:num_utts.ark\n");
+    po.Register("block-size", &block_size, "Number of test iVectors per task, "
+                "and number of train iVectors scored against them at a time");
+    po.Register("top-k", &top_k, "If > 0, output only this many of the best "
+                "scores for each test iVector");
+    po.Register("max-task-lines", &max_task_lines, "With --top-k=0, the "
+                "maximum number of output lines each task keeps in memory "
+                "until its turn to write them (the train iVectors are split "
+                "between several tasks to stay under it, but each task scores "
+                "at least one block of them)");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 4) {
+      po.PrintUsage();
+      exit(1);
+    }
+    if (block_size <= 0 || top_k < 0 || max_task_lines <= 0)
+      KALDI_ERR << "Invalid options --block-size=" << block_size
+                << " --top-k=" << top_k << " --max-task-lines="
+                << max_task_lines;
+
+    std::string plda_rxfilename = po.GetArg(1),
+        train_ivector_rspecifier = po.GetArg(2),
+        test_ivector_rspecifier = po.GetArg(3),
+        scores_wxfilename = po.GetArg(4);
+
+    Plda plda;
+    ReadKaldiObject(plda_rxfilename, &plda);
+
+    RandomAccessInt32Reader num_utts_reader(num_utts_rspecifier);
+
+    std::vector<std::string> train_keys, test_keys;
+    std::vector<int32> train_num_utts, test_num_utts;
+    Matrix<BaseFloat> train_ivectors, test_ivectors;
+    int64 num_train_errs = 0, num_test_errs = 0;
+
+    KALDI_LOG << "Reading train iVectors";
+    double tot_train_renorm_scale = ReadTransformedIvectors(
+        plda, plda_config, train_ivector_rspecifier,
+        (num_utts_rspecifier.empty() ? NULL : &num_utts_reader),
+        &train_keys, &train_num_utts, &train_ivectors, &num_train_errs);
+    int32 num_train_ivectors = train_keys.size();
+    KALDI_LOG << "Read " << num_train_ivectors << " training iVectors, "
+              << "errors on " << num_train_errs;
+    if (num_train_ivectors == 0)
+      KALDI_ERR << "No training iVectors present.";
+    KALDI_LOG << "Average renormalization scale on training iVectors was "
+              << (tot_train_renorm_scale / num_train_ivectors);
+
+    KALDI_LOG << "Reading test iVectors";
+    double tot_test_renorm_scale = ReadTransformedIvectors(
+        plda, plda_config, test_ivector_rspecifier, NULL,
+        &test_keys, &test_num_utts, &test_ivectors, &num_test_errs);
+    int32 num_test_ivectors = test_keys.size();
+    KALDI_LOG << "Read " << num_test_ivectors << " test iVectors.";
+    if (num_test_ivectors == 0)
+      KALDI_ERR << "No test iVectors present.";
+    KALDI_LOG << "Average renormalization scale on test iVectors was "
+              << (tot_test_renorm_scale / num_test_ivectors);
+
+    PldaBatchScorer scorer(plda, train_ivectors, train_num_utts);
+
+    bool binary = false;
+    Output ko(scores_wxfilename, binary);
+    double sum = 0.0, sumsq = 0.0;
+    Timer timer;
+    {
+      TaskSequencer<PldaDenseScoreTask> sequencer(sequencer_config);
+      for (int32 t = 0; t < num_test_ivectors; t += block_size) {
+        int32 this_num_test = std::min(block_size, num_test_ivectors - t);
+        // The number of train iVectors per task: all of them for --top-k,
+        // otherwise a whole number of blocks giving at most max_task_lines
+        // lines (or one block), so that the output is the same.
+        int32 train_per_task = num_train_ivectors;
+        if (top_k == 0) {
+          int64 block_lines = static_cast<int64>(block_size) * this_num_test,
+              num_blocks = std::max<int64>(1, max_task_lines / block_lines);
+          train_per_task = std::min<int64>(num_train_ivectors,
+                                           num_blocks * block_size);
+        }
+        for (int32 e = 0; e < num_train_ivectors; e += train_per_task) {
+          int32 e_end = std::min(num_train_ivectors, e + train_per_task);
+          sequencer.Run(new PldaDenseScoreTask(
+              scorer, train_keys, test_keys, test_ivectors, t, this_num_test,
+              e, e_end, block_size, top_k, &(ko.Stream()), &sum, &sumsq));
+        }
+      }
+    }
+    double elapsed = timer.Elapsed();
+    int64 num_trials = static_cast<int64>(num_train_ivectors) *
+        num_test_ivectors;
+
+    BaseFloat mean = sum / num_trials, scatter = sumsq / num_trials,
+        variance = scatter - mean * mean, stddev = sqrt(variance);
+    KALDI_LOG << "Mean score was " << mean << ", standard deviation was "
+              << stddev;
+    KALDI_LOG << "Scored " << num_trials << " trials in " << elapsed
+              << " seconds, " << (num_trials / std::max(elapsed, 1.0e-06))
+              << " trials per second.";
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
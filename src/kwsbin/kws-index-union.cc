@@ -18,11 +18,112 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+
 #include "base/kaldi-common.h"
+#include "base/timer.h"
 #include "util/common-utils.h"
 #include "fstext/fstext-utils.h"
 #include "lat/kaldi-kws.h"
 #include "lat/kws-functions.h"
+#include "thread/kaldi-task-sequence.h"
+#include "thread/kaldi-thread.h"
+
+namespace kaldi {
+
+// Does the encoded epsilon removal, determinization and minimization of an
+// index.
+void OptimizeIndex(int32 max_states, KwsLexicographicFst *index) {
+  using namespace fst;
+  KwsLexicographicFst ifst = *index;
+  EncodeMapper<KwsLexicographicArc> encoder(kEncodeLabels, ENCODE);
+  Encode(&ifst, &encoder);
+  try {
+    DeterminizeStar(ifst, index, kDelta, NULL, max_states);
+  } catch(const std::exception &e) {
+    KALDI_WARN << e.what()
+               << " (should affect speed of search but not results)";
+    *index = ifst;
+  }
+  Minimize(index);
+  Decode(index, encoder);
+}
+
+// Takes the union of a shard of the input indices and optimizes it.  The
+// optimized shards are output in order into "shards".
+class IndexShardUnionTask {
+ public:
+  // Takes ownership of the pointers in "indices".
+  IndexShardUnionTask(const std::vector<KwsLexicographicFst*> &indices,
+                      bool skip_opt, int32 max_states,
+                      std::vector<KwsLexicographicFst*> *shards):
+      indices_(indices), skip_opt_(skip_opt), max_states_(max_states),
+      shards_(shards), union_(new KwsLexicographicFst) { }
+
+  void operator () () {
+    for (size_t i = 0; i < indices_.size(); i++) {
+      fst::Union(union_, *(indices_[i]));
+      delete indices_[i];
+    }
+    indices_.clear();
+    if (!skip_opt_)
+      OptimizeIndex(max_states_, union_);
+  }
+
+  ~IndexShardUnionTask() {
+    DeletePointers(&indices_);  // empty unless operator () was not called.
+    shards_->push_back(union_);
+  }
+
+ private:
+  std::vector<KwsLexicographicFst*> indices_;
+  bool skip_opt_;
+  int32 max_states_;
+  std::vector<KwsLexicographicFst*> *shards_;
+  KwsLexicographicFst *union_;
+};
+
+// One level of the reduction of the shards: the index 2*i+1 is merged into the
+// index 2*i, which is then optimized, and the index 2*i+1 is deleted and set to
+// NULL.  The pairs are divided among the threads.
+class IndexMergeClass: public MultiThreadable {
+ public:
+  IndexMergeClass(bool skip_opt, int32 max_states,
+                  std::vector<KwsLexicographicFst*> *indices):
+      skip_opt_(skip_opt), max_states_(max_states), indices_(indices) { }
+
+  void operator () () {
+    int32 num_pairs = indices_->size() / 2;
+    for (int32 i = thread_id_; i < num_pairs; i += num_threads_) {
+      KwsLexicographicFst *&first = (*indices_)[2 * i],
+          *&second = (*indices_)[2 * i + 1];
+      fst::Union(first, *second);
+      delete second;
+      second = NULL;
+      if (!skip_opt_)
+        OptimizeIndex(max_states_, first);
+    }
+  }
+
+ private:
+  bool skip_opt_;
+  int32 max_states_;
+  std::vector<KwsLexicographicFst*> *indices_;
+};
+
+void LogIndexStats(const std::string &stage, double elapsed,
+                   const std::vector<KwsLexicographicFst*> &indices) {
+  int64 num_states = 0, num_arcs = 0;
+  for (size_t i = 0; i < indices.size(); i++) {
+    num_states += indices[i]->NumStates();
+    num_arcs += fst::NumArcs(*(indices[i]));
+  }
+  KALDI_LOG << stage << " took " << elapsed << " seconds; "
+            << indices.size() << " indices with " << num_states
+            << " states and " << num_arcs << " arcs in total.";
+}
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -35,6 +136,10 @@ int main(int argc, char *argv[]) {
         "Take a union of the indexed lattices. The input index is in the T*T*T semiring and\n"
         "the output index is also in the T*T*T semiring. At the end of this program, encoded\n"
         "epsilon removal, determinization and minimization will be applied.\n"
+        "The input indices are unioned and optimized in shards of --shard-size\n"
+        "indices, and the shards are then merged pairwise, optimizing after each\n"
+        "merge; with --num-threads > 1 the shards and the merges at each level\n"
+        "are processed in parallel.\n"
         "\n"
         "Usage: kws-index-union [options]  index-rspecifier index-wspecifier\n"
         " e.g.: kws-index-union ark:input.idx ark:global.idx\n";
@@ -44,9 +149,14 @@ int main(int argc, char *argv[]) {
     bool strict = true;
     bool skip_opt = false;
     int32 max_states = -1;
+    int32 shard_size = 100;
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
     po.Register("strict", &strict, "Will allow 0 lattice if it is set to false.");
     po.Register("skip-optimization", &skip_opt, "Skip optimization if it's set to true.");
     po.Register("max-states", &max_states, "Maximum states for DeterminizeStar.");
+    po.Register("shard-size", &shard_size, "Number of input indices that are "
+                "unioned and optimized together before the pairwise merging.");
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
@@ -54,6 +164,9 @@ int main(int argc, char *argv[]) {
       po.PrintUsage();
       exit(1);
     }
+    if (shard_size <= 0)
+      KALDI_ERR << "--shard-size must be positive.";
+    g_num_threads = sequencer_config.num_threads;
 
     std::string index_rspecifier = po.GetArg(1),
         index_wspecifier = po.GetOptArg(2);
@@ -61,38 +174,52 @@ int main(int argc, char *argv[]) {
     SequentialTableReader< VectorFstTplHolder<KwsLexicographicArc> > index_reader(index_rspecifier);
     TableWriter< VectorFstTplHolder<KwsLexicographicArc> > index_writer(index_wspecifier);
 
-    int32 n_done = 0;
-    KwsLexicographicFst global_index;
-    for (; !index_reader.Done(); index_reader.Next()) {
-      std::string key = index_reader.Key();
-      KwsLexicographicFst index = index_reader.Value();
-      index_reader.FreeCurrent();
-
-      Union(&global_index, index);
-
-      n_done++;
-    }
+    if (skip_opt)
+      KALDI_LOG << "Skipping index optimization...";
 
-    if (skip_opt == false) {
-      // Do the encoded epsilon removal, determinization and minimization
-      KwsLexicographicFst ifst = global_index;
-      EncodeMapper<KwsLexicographicArc> encoder(kEncodeLabels, ENCODE);
-      Encode(&ifst, &encoder);
-      try {
-        DeterminizeStar(ifst, &global_index, kDelta, NULL, max_states);
-      } catch(const std::exception &e) {
-        KALDI_WARN << e.what()
-                   << " (should affect speed of search but not results)";
-        global_index = ifst;
+    int32 n_done = 0, num_shards = 0;
+    std::vector<KwsLexicographicFst*> shards;
+    Timer timer;
+    {
+      TaskSequencer<IndexShardUnionTask> sequencer(sequencer_config);
+      std::vector<KwsLexicographicFst*> indices;
+      for (; !index_reader.Done(); index_reader.Next()) {
+        indices.push_back(new KwsLexicographicFst(index_reader.Value()));
+        index_reader.FreeCurrent();
+        n_done++;
+        if (indices.size() == static_cast<size_t>(shard_size)) {
+          num_shards++;
+          sequencer.Run(new IndexShardUnionTask(indices, skip_opt, max_states,
+                                                &shards));
+          indices.clear();
+        }
       }
-      Minimize(&global_index);
-      Decode(&global_index, encoder);
-    } else {
-      KALDI_LOG << "Skipping index optimization...";
+      if (!indices.empty() || num_shards == 0)
+        sequencer.Run(new IndexShardUnionTask(indices, skip_opt, max_states,
+                                              &shards));
+      sequencer.Wait();
+    }
+    LogIndexStats("Reading and optimizing shards of the input", timer.Elapsed(),
+                  shards);
+
+    for (int32 level = 1; shards.size() > 1; level++) {
+      timer.Reset();
+      IndexMergeClass c(skip_opt, max_states, &shards);
+      RunMultiThreaded(c);
+      // Remove the indices that were merged into their neighbours.
+      std::vector<KwsLexicographicFst*>::iterator new_end =
+          std::remove(shards.begin(), shards.end(),
+                      static_cast<KwsLexicographicFst*>(NULL));
+      shards.erase(new_end, shards.end());
+      std::ostringstream stage;
+      stage << "Merging level " << level;
+      LogIndexStats(stage.str(), timer.Elapsed(), shards);
     }
+    KALDI_ASSERT(shards.size() == 1);
 
     // Write the result
-    index_writer.Write("global", global_index);
+    index_writer.Write("global", *(shards[0]));
+    DeletePointers(&shards);
 
     KALDI_LOG << "Done " << n_done << " indices";
     if (strict == true)
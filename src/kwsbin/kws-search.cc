@@ -18,58 +18,105 @@
 // limitations under the License.
 
 
+#include <algorithm>
+
 #include "base/kaldi-common.h"
+#include "base/timer.h"
 #include "util/common-utils.h"
 #include "fstext/fstext-utils.h"
 #include "lat/kaldi-kws.h"
+#include "lat/kws-search.h"
+#include "thread/kaldi-thread.h"
 
 namespace kaldi {
 
-typedef KwsLexicographicArc Arc;
-typedef Arc::Weight Weight;
-typedef Arc::StateId StateId;
-
-uint64 EncodeLabel(StateId ilabel,
-                   StateId olabel) {
-  return (((int64)olabel)<<32)+((int64)ilabel);
-
-}
-
-StateId DecodeLabelUid(uint64 osymbol) {
-  // We only need the utterance id
-  return ((StateId)(osymbol>>32));
-}
-
-class VectorFstToKwsLexicographicFstMapper {
+// Runs SearchKwsKeywordTrie() in several threads; the keywords are divided
+// among the threads by their first word.
+class KeywordTrieSearchClass: public MultiThreadable {
  public:
-  typedef fst::StdArc FromArc;
-  typedef FromArc::Weight FromWeight;
-  typedef KwsLexicographicArc ToArc;
-  typedef KwsLexicographicWeight ToWeight;
-
-  VectorFstToKwsLexicographicFstMapper() {}
+  KeywordTrieSearchClass(const KwsLexicographicFst &index,
+                         const KwsKeywordTrie &trie,
+                         std::vector<KwsKeywordHits> *hits):
+      index_(index), trie_(trie), hits_(hits) { }
 
-  ToArc operator()(const FromArc &arc) const {
-    return ToArc(arc.ilabel, 
-                 arc.olabel,
-                 (arc.weight == FromWeight::Zero() ?
-                  ToWeight::Zero() :
-                  ToWeight(arc.weight.Value(),
-                           StdLStdWeight::One())),
-                 arc.nextstate);
+  void operator () () {
+    SearchKwsKeywordTrie(index_, trie_, thread_id_, num_threads_, hits_);
   }
 
-  fst::MapFinalAction FinalAction() const { return fst::MAP_NO_SUPERFINAL; }
-
-  fst::MapSymbolsAction InputSymbolsAction() const { return fst::MAP_COPY_SYMBOLS; }
+ private:
+  const KwsLexicographicFst &index_;
+  const KwsKeywordTrie &trie_;
+  std::vector<KwsKeywordHits> *hits_;
+};
 
-  fst::MapSymbolsAction OutputSymbolsAction() const { return fst::MAP_COPY_SYMBOLS;}
+// Writes the results of keyword "key": for each, the utterance of the
+// (relabeled) label, the times and the score.
+void WriteKeywordResults(const std::string &key,
+                         const KwsSearchResults &results,
+                         double negative_tolerance,
+                         const unordered_map<uint32, uint64> &label_decoder,
+                         TableWriter< BasicVectorHolder<double> > *result_writer) {
+  for (size_t i = 0; i < results.size(); i++) {
+    unordered_map<uint32, uint64>::const_iterator iter =
+        label_decoder.find(results[i].first);
+    KALDI_ASSERT(iter != label_decoder.end());
+    const KwsLexicographicWeight &weight = results[i].second;
+    int32 uid = DecodeKwsLabelUid(iter->second);
+    int32 tbeg = weight.Value2().Value1().Value();
+    int32 tend = weight.Value2().Value2().Value();
+    double score = weight.Value1().Value();
+
+    if (score < 0) {
+      if (score < negative_tolerance) {
+        KALDI_WARN << "Score out of expected range: " << score;
+      }
+      score = 0.0;
+    }
+    vector<double> result;
+    result.push_back(uid);
+    result.push_back(tbeg);
+    result.push_back(tend);
+    result.push_back(score);
+    result_writer->Write(key, result);
+  }
+}
 
-  uint64 Properties(uint64 props) const { return props; }
-};
+// Searches keyword "key" by composition and writes the results; returns false
+// if nothing was found.
+bool SearchKeywordByComposition(
+    const std::string &key, const fst::VectorFst<fst::StdArc> &keyword,
+    const KwsLexicographicFst &index, int32 n_best, double negative_tolerance,
+    const unordered_map<uint32, uint64> &label_decoder,
+    TableWriter< BasicVectorHolder<double> > *result_writer, int32 *n_fail) {
+  KwsSearchResults results;
+  int32 this_n_fail = 0;
+  bool ans = SearchKwsKeywordByComposition(keyword, index, n_best, &results,
+                                           &this_n_fail);
+  if (this_n_fail != 0)
+    KALDI_WARN << "The resulting FST does not have the expected structure "
+               << "for key " << key;
+  *n_fail += this_n_fail;
+  WriteKeywordResults(key, results, negative_tolerance, label_decoder,
+                      result_writer);
+  return ans;
+}
 
+// Applies --keyword-beam and --keyword-nbest to a keyword FST.
+void PrepareKeyword(double keyword_beam, int32 keyword_nbest,
+                    fst::VectorFst<fst::StdArc> *keyword) {
+  // Process the case where we have confusion for keywords
+  if (keyword_beam != -1) {
+    fst::Prune(keyword, keyword_beam);
+  }
+  if (keyword_nbest != -1) {
+    fst::VectorFst<fst::StdArc> tmp;
+    fst::ShortestPath(*keyword, &tmp, keyword_nbest, true, true);
+    *keyword = tmp;
+  }
 }
 
+}  // namespace kaldi
+
 int main(int argc, char *argv[]) {
   try {
     using namespace kaldi;
@@ -79,12 +126,14 @@ int main(int argc, char *argv[]) {
     typedef kaldi::uint64 uint64;
     typedef KwsLexicographicArc Arc;
     typedef Arc::Weight Weight;
-    typedef Arc::StateId StateId;
 
     const char *usage =
         "Search the keywords over the index. This program can be executed parallely, either\n"
         "on the index side or the keywords side; we use a script to combine the final search\n"
         "results. Note that the index archive has a only key \"global\".\n"
+        "With --batch=true the keywords are read first and the linear ones are\n"
+        "searched together (in parallel with --num-threads > 1); they get at\n"
+        "most --nbest hits each, best first.\n"
         "The output file is in the format:\n"
         "kw utterance_id beg_frame end_frame negated_log_probs\n"
         " e.g.: KW1 1 23 67 0.6074219\n"
@@ -99,7 +148,9 @@ int main(int argc, char *argv[]) {
     bool strict = true;
     double negative_tolerance = -0.1;
     double keyword_beam = -1;
-    
+    bool batch = false;
+    int32 num_threads = 1;
+
     po.Register("nbest", &n_best, "Return the best n hypotheses.");
     po.Register("keyword-nbest", &keyword_nbest,
                 "Pick the best n keywords if the FST contains multiple keywords.");
@@ -109,6 +160,11 @@ int main(int argc, char *argv[]) {
                 "than this tolerance.");
     po.Register("keyword-beam", &keyword_beam,
                 "Prune the FST with the given beam if the FST contains multiple keywords.");
+    po.Register("batch", &batch, "If true, search all the linear keywords in a "
+                "single traversal of the index, sharing their common prefixes, "
+                "instead of composing each keyword with the index.");
+    po.Register("num-threads", &num_threads, "Number of threads for the "
+                "search with --batch=true.");
 
     if (n_best < 0 && n_best != -1) {
       KALDI_ERR << "Bad number for nbest";
@@ -129,6 +185,7 @@ int main(int argc, char *argv[]) {
       po.PrintUsage();
       exit(1);
     }
+    g_num_threads = num_threads;
 
     std::string index_rspecifier = po.GetArg(1),
         keyword_rspecifier = po.GetOptArg(2),
@@ -141,108 +198,90 @@ int main(int argc, char *argv[]) {
     // Index has key "global"
     KwsLexicographicFst index = index_reader.Value("global");
     
-    // First we have to remove the disambiguation symbols. But rather than
-    // removing them totally, we actually move them from input side to output
-    // side, making the output symbol a "combined" symbol of the disambiguation
-    // symbols and the utterance id's.
-    // Note that in Dogan and Murat's original paper, they simply remove the
-    // disambiguation symbol on the input symbol side, which will not allow us
-    // to do epsilon removal after composition with the keyword FST. They have
-    // to traverse the resulting FST.
-    int32 label_count = 1;
-    unordered_map<uint64, uint32> label_encoder;
+    // Move the disambiguation symbols to the output side of the final arcs
+    // (see RelabelKwsIndexForSearch()).
     unordered_map<uint32, uint64> label_decoder;
-    for (StateIterator<KwsLexicographicFst> siter(index); !siter.Done(); siter.Next()) {
-      StateId state_id = siter.Value();
-      for (MutableArcIterator<KwsLexicographicFst> 
-           aiter(&index, state_id); !aiter.Done(); aiter.Next()) {
-        Arc arc = aiter.Value();
-        // Skip the non-final arcs
-        if (index.Final(arc.nextstate) == Weight::Zero())
-          continue;
-        // Encode the input and output label of the final arc, and this is the
-        // new output label for this arc; set the input label to <epsilon>
-        uint64 osymbol = EncodeLabel(arc.ilabel, arc.olabel);
-        arc.ilabel = 0;
-        if (label_encoder.find(osymbol) == label_encoder.end()) {
-          arc.olabel = label_count;
-          label_encoder[osymbol] = label_count;
-          label_decoder[label_count] = osymbol;
-          label_count++;
-        } else { 
-          arc.olabel = label_encoder[osymbol];
-        }
-        aiter.SetValue(arc);
-      }
-    }
-    ArcSort(&index, fst::ILabelCompare<KwsLexicographicArc>());
-    
+    RelabelKwsIndexForSearch(&index, &label_decoder);
+
     int32 n_done = 0;
     int32 n_fail = 0;
-    for (; !keyword_reader.Done(); keyword_reader.Next()) {
-      std::string key = keyword_reader.Key();
-      VectorFst<StdArc> keyword = keyword_reader.Value();
-      keyword_reader.FreeCurrent();
-
-      // Process the case where we have confusion for keywords
-      if (keyword_beam != -1) {
-        Prune(&keyword, keyword_beam);
+    int32 n_keywords = 0;  // including those with no results
+    Timer timer;
+    if (!batch) {
+      for (; !keyword_reader.Done(); keyword_reader.Next()) {
+        std::string key = keyword_reader.Key();
+        VectorFst<StdArc> keyword = keyword_reader.Value();
+        keyword_reader.FreeCurrent();
+        PrepareKeyword(keyword_beam, keyword_nbest, &keyword);
+        n_keywords++;
+        if (SearchKeywordByComposition(key, keyword, index, n_best,
+                                       negative_tolerance, label_decoder,
+                                       &result_writer, &n_fail))
+          n_done++;
       }
-      if (keyword_nbest != -1) {
-        VectorFst<StdArc> tmp;
-        ShortestPath(keyword, &tmp, keyword_nbest, true, true);
-        keyword = tmp;
+    } else {
+      // The linear keywords go into the trie; the others are searched by
+      // composition, as above.  The results are written in the order of the
+      // input.
+      std::vector<std::string> keys;
+      std::vector<VectorFst<StdArc>*> nonlinear_keywords;  // NULL if linear.
+      std::vector<Weight> keyword_weights;
+      KwsKeywordTrie trie;
+      for (; !keyword_reader.Done(); keyword_reader.Next()) {
+        keys.push_back(keyword_reader.Key());
+        VectorFst<StdArc> *keyword =
+            new VectorFst<StdArc>(keyword_reader.Value());
+        keyword_reader.FreeCurrent();
+        PrepareKeyword(keyword_beam, keyword_nbest, keyword);
+        std::vector<int32> words;
+        Weight weight;
+        if (GetLinearKwsKeyword(*keyword, &words, &weight)) {
+          trie.AddKeyword(words, keys.size() - 1);
+          delete keyword;
+          keyword = NULL;
+        } else {
+          weight = Weight::Zero();
+        }
+        nonlinear_keywords.push_back(keyword);
+        keyword_weights.push_back(weight);
       }
-
-      KwsLexicographicFst keyword_fst;
-      KwsLexicographicFst result_fst;
-      Map(keyword, &keyword_fst, VectorFstToKwsLexicographicFstMapper());
-      Compose(keyword_fst, index, &result_fst);
-      Project(&result_fst, PROJECT_OUTPUT);
-      Minimize(&result_fst);
-      ShortestPath(result_fst, &result_fst, n_best);
-      RmEpsilon(&result_fst);
-
-      // No result found
-      if (result_fst.Start() == kNoStateId)
-        continue;
-
-      // Got something here
-      double score;
-      int32 tbeg, tend, uid;
-      for (ArcIterator<KwsLexicographicFst> 
-           aiter(result_fst, result_fst.Start()); !aiter.Done(); aiter.Next()) {
-        const Arc &arc = aiter.Value();
-
-        // We're expecting a two-state FST
-        if (result_fst.Final(arc.nextstate) != Weight::One()) {
-          KALDI_WARN << "The resulting FST does not have the expected structure for key " << key;
-          n_fail++;
+      n_keywords = keys.size();
+      std::vector<KwsKeywordHits> hits(keys.size());
+      {
+        KeywordTrieSearchClass c(index, trie, &hits);
+        RunMultiThreaded(c);
+      }
+      KALDI_LOG << "Searched the keyword trie with " << trie.NumNodes()
+                << " nodes in " << timer.Elapsed() << " seconds.";
+      for (size_t i = 0; i < keys.size(); i++) {
+        if (nonlinear_keywords[i] == NULL) {
+          if (hits[i].empty())  // No result found
+            continue;
+          KwsSearchResults results;
+          GetKwsKeywordHits(hits[i], keyword_weights[i], n_best, &results);
+          WriteKeywordResults(keys[i], results, negative_tolerance,
+                              label_decoder, &result_writer);
+        } else if (!SearchKeywordByComposition(keys[i],
+                                               *(nonlinear_keywords[i]),
+                                               index, n_best,
+                                               negative_tolerance,
+                                               label_decoder, &result_writer,
+                                               &n_fail)) {
           continue;
         }
-
-        uint64 osymbol = label_decoder[arc.olabel];
-        uid = (int32)DecodeLabelUid(osymbol);
-        tbeg = arc.weight.Value2().Value1().Value();
-        tend = arc.weight.Value2().Value2().Value();
-        score = arc.weight.Value1().Value();
-
-        if (score < 0) {
-          if (score < negative_tolerance) {
-            KALDI_WARN << "Score out of expected range: " << score;
-          }
-          score = 0.0;
-        }
-        vector<double> result;
-        result.push_back(uid);
-        result.push_back(tbeg);
-        result.push_back(tend);
-        result.push_back(score);
-        result_writer.Write(key, result);
+        n_done++;
       }
-
-      n_done++;
+      int32 num_nonlinear = keys.size() - std::count(
+          nonlinear_keywords.begin(), nonlinear_keywords.end(),
+          static_cast<VectorFst<StdArc>*>(NULL));
+      KALDI_LOG << num_nonlinear << " of the keywords were not linear and "
+                << "were searched by composition.";
+      DeletePointers(&nonlinear_keywords);
     }
+    double elapsed = timer.Elapsed();
+    KALDI_LOG << "Searched the keywords in " << elapsed
+              << " seconds, " << (n_keywords / std::max(elapsed, 1.0e-06))
+              << " keywords per second.";
 
     KALDI_LOG << "Done " << n_done << " keywords";
     if (strict == true)
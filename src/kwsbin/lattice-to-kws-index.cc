@@ -18,8 +18,8 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
-
 #include "base/kaldi-common.h"
+#include "base/timer.h"
 #include "util/common-utils.h"
 #include "fstext/fstext-utils.h"
 #include "lat/kaldi-lattice.h"
@@ -27,6 +27,203 @@
 #include "lat/kaldi-kws.h"
 #include "lat/kws-functions.h"
 #include "fstext/epsilon-property.h"
+#include "thread/kaldi-task-sequence.h"
+
+namespace kaldi {
+
+// Times of the stages of index building, summed over lattices (and so over
+// threads), and the total size of the indices.
+struct KwsIndexStats {
+  enum Stage { kClustering = 0, kFactorGeneration, kFactorMerging,
+               kDisambiguation, kOptimization, kNumStages };
+  double time[kNumStages];
+  int64 num_states;
+  int64 num_arcs;
+  KwsIndexStats(): num_states(0), num_arcs(0) {
+    for (int32 i = 0; i < kNumStages; i++) time[i] = 0.0;
+  }
+  void Add(const KwsIndexStats &other) {
+    for (int32 i = 0; i < kNumStages; i++) time[i] += other.time[i];
+    num_states += other.num_states;
+    num_arcs += other.num_arcs;
+  }
+  void Print() const {
+    const char *names[] = { "arc clustering", "factor generation",
+                            "factor merging", "factor disambiguation",
+                            "optimization" };
+    for (int32 i = 0; i < kNumStages; i++)
+      KALDI_LOG << "Time in " << names[i] << " was " << time[i]
+                << " seconds (summed over threads).";
+    KALDI_LOG << "The indices have " << num_states << " states and "
+              << num_arcs << " arcs in total.";
+  }
+};
+
+class LatticeToKwsIndexTask {
+ public:
+  // Initializer takes ownership of "clat".
+  LatticeToKwsIndexTask(const std::string &key,
+                        int32 utterance_id,
+                        CompactLattice *clat,
+                        int32 max_silence_frames,
+                        int32 max_states,
+                        bool allow_partial,
+                        TableWriter< fst::VectorFstTplHolder<KwsLexicographicArc> > *index_writer,
+                        int32 *num_done,
+                        int32 *num_fail,
+                        KwsIndexStats *tot_stats):
+      key_(key), utterance_id_(utterance_id), clat_(clat),
+      max_silence_frames_(max_silence_frames), max_states_(max_states),
+      allow_partial_(allow_partial), index_writer_(index_writer),
+      num_done_(num_done), num_fail_(num_fail), tot_stats_(tot_stats),
+      ok_(false), factor_failed_(false) { }
+
+  void operator () () {
+    ok_ = Process();
+    delete clat_;  // This is no longer needed so we can delete it now.
+    clat_ = NULL;
+  }
+
+  ~LatticeToKwsIndexTask() {  // Produces output.  Run sequentially.
+    if (factor_failed_)
+      (*num_fail_)++;
+    if (ok_) {
+      // Write result
+      index_writer_->Write(key_, index_transducer_);
+      stats_.num_states += index_transducer_.NumStates();
+      stats_.num_arcs += fst::NumArcs(index_transducer_);
+      (*num_done_)++;
+    } else {
+      (*num_fail_)++;
+    }
+    tot_stats_->Add(stats_);
+    delete clat_;  // NULL unless operator () was not called.
+  }
+
+ private:
+  bool Process() {
+    CompactLattice &clat = *clat_;
+    Timer timer;
+
+    // Topologically sort the lattice, if not already sorted.
+    uint64 props = clat.Properties(fst::kFstProperties, false);
+    if (!(props & fst::kTopSorted)) {
+      if (fst::TopSort(&clat) == false) {
+        KALDI_WARN << "Cycles detected in lattice " << key_;
+        return false;
+      }
+    }
+
+    // Get the alignments
+    vector<int32> state_times;
+    CompactLatticeStateTimes(clat, &state_times);
+
+    // Cluster the arcs in the CompactLattice, write the cluster_id on the
+    // output label side.
+    // ClusterLattice() corresponds to the second part of the preprocessing in
+    // Dogan and Murat's paper -- clustering. Note that we do the first part
+    // of preprocessing (the weight pushing step) later when generating the
+    // factor transducer.
+    KALDI_VLOG(1) << "Arc clustering...";
+    bool success = false;
+    success = ClusterLattice(&clat, state_times);
+    if (!success) {
+      KALDI_WARN << "State id's and alignments do not match for lattice "
+                 << key_;
+      return false;
+    }
+    stats_.time[KwsIndexStats::kClustering] += timer.Elapsed();
+    timer.Reset();
+
+    // The next part is something new, not in the Dogan and Can paper.  It is
+    // necessary because we have epsilon arcs, due to silences, in our
+    // lattices.  We modify the factor transducer, while maintaining
+    // equivalence, to ensure that states don't have both epsilon *and*
+    // non-epsilon arcs entering them.  (and the same, with "entering"
+    // replaced with "leaving").  Later we will find out which states have
+    // non-epsilon arcs leaving/entering them and use it to be more selective
+    // in adding arcs to connect them with the initial/final states.  The goal
+    // here is to disallow silences at the beginning or ending of a keyword
+    // occurrence.
+    if (true) {
+      EnsureEpsilonProperty(&clat);
+      fst::TopSort(&clat);
+      // We have to recompute the state times because they will have changed.
+      CompactLatticeStateTimes(clat, &state_times);
+    }
+
+    // Generate factor transducer
+    // CreateFactorTransducer() corresponds to the "Factor Generation" part of
+    // Dogan and Murat's paper. But we also move the weight pushing step to
+    // this function as we have to compute the alphas and betas anyway.
+    KALDI_VLOG(1) << "Generating factor transducer...";
+    KwsProductFst factor_transducer;
+    success = CreateFactorTransducer(clat, state_times, utterance_id_,
+                                     &factor_transducer);
+    if (!success) {
+      // We go on and write whatever we got, but also count it as a failure.
+      KALDI_WARN << "Cannot generate factor transducer for lattice " << key_;
+      factor_failed_ = true;
+    }
+
+    MaybeDoSanityCheck(factor_transducer);
+
+    // Remove long silence arc
+    // We add the filtering step in our implementation. This is because gap
+    // between two successive words in a query term should be less than 0.5s
+    KALDI_VLOG(1) << "Removing long silence...";
+    RemoveLongSilences(max_silence_frames_, state_times, &factor_transducer);
+
+    MaybeDoSanityCheck(factor_transducer);
+    stats_.time[KwsIndexStats::kFactorGeneration] += timer.Elapsed();
+    timer.Reset();
+
+    // Do factor merging, and return a transducer in T*T*T semiring. This step
+    // corresponds to the "Factor Merging" part in Dogan and Murat's paper.
+    KALDI_VLOG(1) << "Merging factors...";
+    DoFactorMerging(&factor_transducer, &index_transducer_);
+
+    MaybeDoSanityCheck(index_transducer_);
+    stats_.time[KwsIndexStats::kFactorMerging] += timer.Elapsed();
+    timer.Reset();
+
+    // Do factor disambiguation. It corresponds to the "Factor Disambiguation"
+    // step in Dogan and Murat's paper.
+    KALDI_VLOG(1) << "Doing factor disambiguation...";
+    DoFactorDisambiguation(&index_transducer_);
+
+    MaybeDoSanityCheck(index_transducer_);
+    stats_.time[KwsIndexStats::kDisambiguation] += timer.Elapsed();
+    timer.Reset();
+
+    // Optimize the above factor transducer. It corresponds to the
+    // "Optimization" step in the paper.
+    KALDI_VLOG(1) << "Optimizing factor transducer...";
+    OptimizeFactorTransducer(&index_transducer_, max_states_, allow_partial_);
+
+    MaybeDoSanityCheck(index_transducer_);
+    stats_.time[KwsIndexStats::kOptimization] += timer.Elapsed();
+    return true;
+  }
+
+  std::string key_;
+  int32 utterance_id_;
+  CompactLattice *clat_;  // The lattice we're working on.  Owned locally.
+  int32 max_silence_frames_;
+  int32 max_states_;
+  bool allow_partial_;
+  TableWriter< fst::VectorFstTplHolder<KwsLexicographicArc> > *index_writer_;
+  int32 *num_done_;
+  int32 *num_fail_;
+  KwsIndexStats *tot_stats_;
+  // The output of our process, written in the destructor.
+  bool ok_;
+  bool factor_failed_;
+  KwsLexicographicFst index_transducer_;
+  KwsIndexStats stats_;
+};
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -38,7 +235,8 @@ int main(int argc, char *argv[]) {
     const char *usage =
         "Create an inverted index of the given lattices. The output index is in the T*T*T\n"
         "semiring. For details for the semiring, please refer to Dogan Can and Muran Saraclar's"
-        "lattice indexing paper."
+        "lattice indexing paper.  With --num-threads > 1, several lattices are\n"
+        "indexed at once; the output is in the same order as the input.\n"
         "\n"
         "Usage: lattice-to-kws-index [options]  utter-symtab-rspecifier lattice-rspecifier index-wspecifier\n"
         " e.g.: lattice-to-kws-index ark:utter.symtab ark:1.lats ark:global.idx\n";
@@ -49,6 +247,7 @@ int main(int argc, char *argv[]) {
     bool strict = true;
     bool allow_partial = true;
     BaseFloat max_states_scale = 4;
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
     po.Register("max-silence-frames", &max_silence_frames, "Maximum #frames for"
                 " silence arc.");
     po.Register("strict", &strict, "Setting --strict=false will cause successful "
@@ -59,6 +258,7 @@ int main(int argc, char *argv[]) {
                 "limit on the number of states.");
     po.Register("allow-partial", &allow_partial, "Allow partial output if fails"
                 " to determinize, otherwise skip determinization if it fails.");
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
@@ -83,123 +283,41 @@ int main(int argc, char *argv[]) {
     int32 n_fail = 0;
 
     int32 max_states = -1;
-
-    for (; !clat_reader.Done(); clat_reader.Next()) {
-      std::string key = clat_reader.Key();
-      CompactLattice clat = clat_reader.Value();
-      clat_reader.FreeCurrent();
-      KALDI_LOG << "Processing lattice " << key;
-
-      if (max_states_scale > 0) {
-        max_states = static_cast<int32>(
-            max_states_scale * static_cast<BaseFloat>(clat.NumStates()));
-      }
-
-      // Check if we have the corresponding utterance id.
-      if (!usymtab_reader.HasKey(key)) {
-        KALDI_WARN << "Cannot find utterance id for " << key;
-        n_fail++;
-        continue;
-      }
-
-      // Topologically sort the lattice, if not already sorted.
-      uint64 props = clat.Properties(fst::kFstProperties, false);
-      if (!(props & fst::kTopSorted)) {
-        if (fst::TopSort(&clat) == false) {
-          KALDI_WARN << "Cycles detected in lattice " << key;
+    KwsIndexStats stats;
+    Timer timer;
+
+    {
+      TaskSequencer<LatticeToKwsIndexTask> sequencer(sequencer_config);
+      for (; !clat_reader.Done(); clat_reader.Next()) {
+        std::string key = clat_reader.Key();
+        KALDI_LOG << "Processing lattice " << key;
+
+        // Check if we have the corresponding utterance id.
+        if (!usymtab_reader.HasKey(key)) {
+          KALDI_WARN << "Cannot find utterance id for " << key;
           n_fail++;
           continue;
         }
-      } 
+        // will give ownership to "task" below.
+        CompactLattice *clat = new CompactLattice(clat_reader.Value());
+        clat_reader.FreeCurrent();
 
-      // Get the alignments
-      vector<int32> state_times;
-      CompactLatticeStateTimes(clat, &state_times);
-
-      // Cluster the arcs in the CompactLattice, write the cluster_id on the
-      // output label side.
-      // ClusterLattice() corresponds to the second part of the preprocessing in
-      // Dogan and Murat's paper -- clustering. Note that we do the first part
-      // of preprocessing (the weight pushing step) later when generating the
-      // factor transducer.
-      KALDI_VLOG(1) << "Arc clustering...";
-      bool success = false;
-      success = ClusterLattice(&clat, state_times);
-      if (!success) {
-        KALDI_WARN << "State id's and alignments do not match for lattice " << key;
-        n_fail++;
-        continue;
-      }
+        if (max_states_scale > 0) {
+          max_states = static_cast<int32>(
+              max_states_scale * static_cast<BaseFloat>(clat->NumStates()));
+        }
 
-      // The next part is something new, not in the Dogan and Can paper.  It is
-      // necessary because we have epsilon arcs, due to silences, in our
-      // lattices.  We modify the factor transducer, while maintaining
-      // equivalence, to ensure that states don't have both epsilon *and*
-      // non-epsilon arcs entering them.  (and the same, with "entering"
-      // replaced with "leaving").  Later we will find out which states have
-      // non-epsilon arcs leaving/entering them and use it to be more selective
-      // in adding arcs to connect them with the initial/final states.  The goal
-      // here is to disallow silences at the beginning or ending of a keyword
-      // occurrence.
-      if (true) {
-        EnsureEpsilonProperty(&clat);
-        fst::TopSort(&clat);
-        // We have to recompute the state times because they will have changed.
-        CompactLatticeStateTimes(clat, &state_times);        
-      }
-      
-      // Generate factor transducer
-      // CreateFactorTransducer() corresponds to the "Factor Generation" part of
-      // Dogan and Murat's paper. But we also move the weight pushing step to
-      // this function as we have to compute the alphas and betas anyway.
-      KALDI_VLOG(1) << "Generating factor transducer...";
-      KwsProductFst factor_transducer;
-      int32 utterance_id = usymtab_reader.Value(key);
-      success = CreateFactorTransducer(clat, state_times, utterance_id, &factor_transducer);
-      if (!success) {
-        KALDI_WARN << "Cannot generate factor transducer for lattice " << key;
-        n_fail++; 
+        sequencer.Run(new LatticeToKwsIndexTask(
+            key, usymtab_reader.Value(key), clat, max_silence_frames,
+            max_states, allow_partial, &index_writer, &n_done, &n_fail,
+            &stats));
       }
-
-      MaybeDoSanityCheck(factor_transducer);
-
-      // Remove long silence arc
-      // We add the filtering step in our implementation. This is because gap
-      // between two successive words in a query term should be less than 0.5s
-      KALDI_VLOG(1) << "Removing long silence...";
-      RemoveLongSilences(max_silence_frames, state_times, &factor_transducer);
-
-      MaybeDoSanityCheck(factor_transducer);
-
-      // Do factor merging, and return a transducer in T*T*T semiring. This step
-      // corresponds to the "Factor Merging" part in Dogan and Murat's paper.
-      KALDI_VLOG(1) << "Merging factors...";
-      KwsLexicographicFst index_transducer;
-      DoFactorMerging(&factor_transducer, &index_transducer);
-
-      MaybeDoSanityCheck(index_transducer);
-      
-      // Do factor disambiguation. It corresponds to the "Factor Disambiguation"
-      // step in Dogan and Murat's paper.
-      KALDI_VLOG(1) << "Doing factor disambiguation...";
-      DoFactorDisambiguation(&index_transducer);
-
-      MaybeDoSanityCheck(index_transducer);
-
-      // Optimize the above factor transducer. It corresponds to the
-      // "Optimization" step in the paper.
-      KALDI_VLOG(1) << "Optimizing factor transducer...";
-      OptimizeFactorTransducer(&index_transducer, max_states, allow_partial);
-
-      MaybeDoSanityCheck(index_transducer);      
-      
-      // Write result
-      index_writer.Write(key, index_transducer);  
-
-      n_done++;
+      sequencer.Wait();
     }
 
-    KALDI_LOG << "Done " << n_done << " lattices, failed for " << n_fail;
+    stats.Print();
+    KALDI_LOG << "Done " << n_done << " lattices, failed for " << n_fail
+              << "; took " << timer.Elapsed() << " seconds.";
     if (strict == true)
       return (n_done != 0 ? 0 : 1);
     else
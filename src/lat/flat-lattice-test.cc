@@ -0,0 +1,247 @@
+// lat/flat-lattice-test.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <algorithm>
+
+#include "lat/kaldi-lattice.h"
+#include "lat/flat-lattice.h"
+#include "lat/lattice-functions.h"
+#include "lat/kws-functions.h"
+
+
+namespace kaldi {
+using namespace fst;
+
+// Creates a random lattice whose states are at consistent times, as a
+// lattice from the decoder would be: the states are created frame by frame,
+// so the lattice is topologically sorted, every state after the start state
+// has an arc coming in, and the final-probs are at the last frame (possibly
+// with a one-frame string on the final-prob).
+CompactLattice *RandTimedCompactLattice() {
+  int32 num_frames = 3 + Rand() % 10, num_words = 5, num_tids = 20;
+  std::vector<std::vector<int32> > states_at(num_frames + 1);
+  CompactLattice *clat = new CompactLattice;
+  clat->SetStart(clat->AddState());
+  states_at[0].push_back(0);
+  for (int32 t = 1; t <= num_frames; t++) {
+    int32 n = 1 + Rand() % 3;
+    for (int32 i = 0; i < n; i++)
+      states_at[t].push_back(clat->AddState());
+  }
+  for (int32 t = 0; t <= num_frames; t++) {
+    for (size_t i = 0; i < states_at[t].size(); i++) {
+      int32 s = states_at[t][i];
+      int32 num_arcs = (t == num_frames ? 0 : 1 + Rand() % 3);
+      for (int32 j = 0; j < num_arcs; j++) {
+        int32 len = 1 + Rand() % 2;
+        if (t + len > num_frames) len = num_frames - t;
+        const std::vector<int32> &next = states_at[t + len];
+        std::vector<int32> str(len);
+        for (int32 k = 0; k < len; k++) str[k] = 1 + Rand() % num_tids;
+        int32 word = Rand() % (num_words + 1);
+        LatticeWeight w(RandUniform() * 2.0, RandUniform() * 2.0);
+        clat->AddArc(s, CompactLatticeArc(word, word,
+                                          CompactLatticeWeight(w, str),
+                                          next[Rand() % next.size()]));
+      }
+      if (t > 0) {  // Make sure every state is reachable.
+        const std::vector<int32> &prev = states_at[t - 1];
+        std::vector<int32> str(1, 1 + Rand() % num_tids);
+        LatticeWeight w(RandUniform() * 2.0, RandUniform() * 2.0);
+        clat->AddArc(prev[Rand() % prev.size()],
+                     CompactLatticeArc(0, 0, CompactLatticeWeight(w, str), s));
+      }
+      LatticeWeight w(RandUniform(), RandUniform());
+      if (t == num_frames) {
+        clat->SetFinal(s, CompactLatticeWeight(w, std::vector<int32>()));
+      } else if (t == num_frames - 1 && Rand() % 2 == 0) {
+        std::vector<int32> str(1, 1 + Rand() % num_tids);
+        clat->SetFinal(s, CompactLatticeWeight(w, str));
+      }
+    }
+  }
+  return clat;
+}
+
+// Returns a copy of "clat" with the states in a random order, not topologically
+// sorted, and with an extra unreachable state.
+CompactLattice *ShuffledCopy(const CompactLattice &clat) {
+  int32 num_states = clat.NumStates();
+  std::vector<int32> perm(num_states);
+  for (int32 s = 0; s < num_states; s++) perm[s] = s;
+  std::random_shuffle(perm.begin(), perm.end());
+  CompactLattice *ans = new CompactLattice;
+  for (int32 s = 0; s <= num_states; s++) ans->AddState();
+  ans->SetStart(perm[clat.Start()]);
+  for (int32 s = 0; s < num_states; s++) {
+    for (ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done();
+         aiter.Next()) {
+      CompactLatticeArc arc = aiter.Value();
+      arc.nextstate = perm[arc.nextstate];
+      ans->AddArc(perm[s], arc);
+    }
+    ans->SetFinal(perm[s], clat.Final(s));
+  }
+  ans->AddArc(num_states, CompactLatticeArc(1, 1, CompactLatticeWeight::One(),
+                                            perm[clat.Start()]));
+  return ans;
+}
+
+void AssertPosteriorsEqual(const Posterior &post1, const Posterior &post2) {
+  KALDI_ASSERT(post1.size() == post2.size());
+  for (size_t t = 0; t < post1.size(); t++) {
+    KALDI_ASSERT(post1[t].size() == post2[t].size());
+    for (size_t i = 0; i < post1[t].size(); i++) {
+      KALDI_ASSERT(post1[t][i].first == post2[t][i].first);
+      KALDI_ASSERT(ApproxEqual(post1[t][i].second, post2[t][i].second, 1e-4));
+    }
+  }
+}
+
+void TestFlatLatticeCopy() {
+  CompactLattice *clat = RandTimedCompactLattice();
+  FlatLattice flat;
+  KALDI_ASSERT(flat.CopyFrom(*clat));
+  KALDI_ASSERT(flat.NumStates() == clat->NumStates() &&
+               flat.NumArcs() == NumArcs(*clat));
+  CompactLattice clat2;
+  flat.CopyTo(&clat2);
+  KALDI_ASSERT(Equal(*clat, clat2));
+
+  // A lattice with states out of order should be renumbered, and the
+  // unreachable state dropped.
+  CompactLattice *shuffled = ShuffledCopy(*clat);
+  FlatLattice flat2;
+  KALDI_ASSERT(flat2.CopyFrom(*shuffled));
+  KALDI_ASSERT(flat2.NumStates() == clat->NumStates());
+  flat2.CopyTo(&clat2);
+  KALDI_ASSERT(clat2.Properties(kTopSorted, true));
+  KALDI_ASSERT(RandEquivalent(*clat, clat2, 5, 0.001, Rand(), 10));
+
+  // A cycle should be detected.
+  shuffled->AddArc(shuffled->Start(),
+                   CompactLatticeArc(1, 1, CompactLatticeWeight::One(),
+                                     shuffled->Start()));
+  KALDI_ASSERT(!flat2.CopyFrom(*shuffled) && flat2.NumStates() == 0);
+  delete shuffled;
+  delete clat;
+}
+
+void TestFlatLatticeForwardBackward() {
+  CompactLattice *clat = RandTimedCompactLattice();
+  BaseFloat acoustic_scale = 0.1 + RandUniform(), lm_scale = 0.5 + RandUniform();
+  FlatLattice flat;
+  flat.CopyFrom(*clat);
+  flat.Scale(lm_scale, acoustic_scale);
+
+  ScaleLattice(LatticeScale(lm_scale, acoustic_scale), clat);
+  Lattice lat;
+  ConvertLattice(*clat, &lat);
+  TopSort(&lat);
+  Posterior post1, post2;
+  double ac_like1, ac_like2;
+  BaseFloat like1 = LatticeForwardBackward(lat, &post1, &ac_like1);
+  BaseFloat like2 = FlatLatticeForwardBackward(flat, &post2, &ac_like2);
+  KALDI_ASSERT(ApproxEqual(like1, like2, 1e-4));
+  KALDI_ASSERT(ApproxEqual(ac_like1, ac_like2, 1e-4));
+  AssertPosteriorsEqual(post1, post2);
+  delete clat;
+}
+
+void TestFlatLatticeAlphasBetas() {
+  CompactLattice *clat = RandTimedCompactLattice();
+  FlatLattice flat;
+  flat.CopyFrom(*clat);
+  std::vector<double> alpha1, beta1, alpha2, beta2;
+  KALDI_ASSERT(ComputeCompactLatticeAlphas(*clat, &alpha1));
+  KALDI_ASSERT(ComputeCompactLatticeBetas(*clat, &beta1));
+  ComputeFlatLatticeAlphas(flat, &alpha2);
+  ComputeFlatLatticeBetas(flat, &beta2);
+  KALDI_ASSERT(alpha1.size() == alpha2.size() && beta1.size() == beta2.size());
+  for (size_t s = 0; s < alpha1.size(); s++) {
+    KALDI_ASSERT(ApproxEqual(alpha1[s], alpha2[s]) &&
+                 ApproxEqual(beta1[s], beta2[s]));
+  }
+  delete clat;
+}
+
+void TestPruneFlatLattice() {
+  CompactLattice *clat = RandTimedCompactLattice();
+  BaseFloat beam = 0.5 + 3.0 * RandUniform();
+  FlatLattice flat;
+  flat.CopyFrom(*clat);
+  bool ans1 = PruneLattice(beam, clat),
+      ans2 = PruneFlatLattice(beam, &flat);
+  KALDI_ASSERT(ans1 == ans2);
+  KALDI_ASSERT(flat.NumStates() == clat->NumStates() &&
+               flat.NumArcs() == NumArcs(*clat));
+  if (ans1) {
+    TopSort(clat);
+    CompactLattice clat2;
+    flat.CopyTo(&clat2);
+    KALDI_ASSERT(RandEquivalent(*clat, clat2, 5, 0.001, Rand(), 10));
+  }
+  delete clat;
+}
+
+void TestComposeFlatLatticeDeterministic() {
+  CompactLattice *clat = RandTimedCompactLattice();
+  // A unigram "LM" with one state.
+  StdVectorFst lm;
+  lm.SetStart(lm.AddState());
+  lm.SetFinal(0, TropicalWeight(RandUniform()));
+  for (int32 word = 1; word <= 5; word++)
+    lm.AddArc(0, StdArc(word, word, TropicalWeight(2.0 * RandUniform()), 0));
+  ArcSort(&lm, ILabelCompare<StdArc>());
+  BackoffDeterministicOnDemandFst<StdArc> det_fst(lm);
+
+  CompactLattice composed1, composed2;
+  ComposeCompactLatticeDeterministic(*clat, &det_fst, &composed1);
+  FlatLattice flat;
+  flat.CopyFrom(*clat);
+  ComposeFlatLatticeDeterministic(flat, &det_fst, &composed2);
+  KALDI_ASSERT(Equal(composed1, composed2));
+
+  // A lattice with a cycle cannot be copied into a FlatLattice, so
+  // lattice-lmrescore-const-arpa composes it with
+  // ComposeCompactLatticeDeterministic(), which must keep the cycle.
+  int32 s = Rand() % clat->NumStates();
+  clat->AddArc(s, CompactLatticeArc(1, 1, CompactLatticeWeight::One(), s));
+  KALDI_ASSERT(!flat.CopyFrom(*clat));
+  ComposeCompactLatticeDeterministic(*clat, &det_fst, &composed1);
+  KALDI_ASSERT(composed1.Start() != kNoStateId &&
+               composed1.Properties(kCyclic, true));
+  delete clat;
+}
+
+}  // end namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  using kaldi::int32;
+  for (int32 i = 0; i < 20; i++) {
+    TestFlatLatticeCopy();
+    TestFlatLatticeForwardBackward();
+    TestFlatLatticeAlphasBetas();
+    TestPruneFlatLattice();
+    TestComposeFlatLatticeDeterministic();
+  }
+  KALDI_LOG << "Success.";
+}
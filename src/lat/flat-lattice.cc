@@ -0,0 +1,528 @@
+// lat/flat-lattice.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <algorithm>
+#include <limits>
+#include <queue>
+
+#include "lat/flat-lattice.h"
+#include "util/stl-utils.h"
+
+namespace kaldi {
+
+void FlatLattice::Clear() {
+  state_offsets_.clear();
+  state_offsets_.push_back(0);
+  arcs_.clear();
+  finals_.clear();
+  strings_.clear();
+}
+
+bool FlatLattice::CopyFrom(const CompactLattice &clat) {
+  typedef CompactLattice::StateId StateId;
+  Clear();
+  StateId start = clat.Start();
+  if (start == fst::kNoStateId) return true;
+  int32 num_states_in = clat.NumStates();
+
+  // "order" is the list of input states in the order we will number them.
+  std::vector<StateId> order;
+  if (start == 0 && clat.Properties(fst::kTopSorted, true)) {
+    order.resize(num_states_in);
+    for (StateId s = 0; s < num_states_in; s++) order[s] = s;
+  } else {
+    // Reverse post-order of a depth-first search from the start state, which
+    // is a topological order of the reachable states if there are no cycles.
+    // 0 = not visited, 1 = on the stack, 2 = finished.
+    std::vector<char> color(num_states_in, 0);
+    std::vector<std::pair<StateId, size_t> > stack;
+    stack.push_back(std::make_pair(start, 0));
+    color[start] = 1;
+    while (!stack.empty()) {
+      StateId s = stack.back().first;
+      size_t pos = stack.back().second;
+      fst::ArcIterator<CompactLattice> aiter(clat, s);
+      aiter.Seek(pos);
+      if (aiter.Done()) {
+        color[s] = 2;
+        order.push_back(s);
+        stack.pop_back();
+        continue;
+      }
+      stack.back().second++;
+      StateId next = aiter.Value().nextstate;
+      if (color[next] == 1) {
+        KALDI_WARN << "Cycles detected in lattice.";
+        Clear();
+        return false;
+      } else if (color[next] == 0) {
+        color[next] = 1;
+        stack.push_back(std::make_pair(next, 0));
+      }
+    }
+    std::reverse(order.begin(), order.end());
+  }
+
+  int32 num_states = order.size();
+  std::vector<int32> new_id(num_states_in, -1);
+  for (int32 i = 0; i < num_states; i++) new_id[order[i]] = i;
+
+  size_t num_arcs = 0, string_size = 0;
+  for (int32 i = 0; i < num_states; i++) {
+    StateId s = order[i];
+    num_arcs += clat.NumArcs(s);
+    for (fst::ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done();
+         aiter.Next())
+      string_size += aiter.Value().weight.String().size();
+    string_size += clat.Final(s).String().size();
+  }
+  state_offsets_.resize(num_states + 1);
+  arcs_.resize(num_arcs);
+  finals_.resize(num_states);
+  strings_.reserve(string_size);
+
+  size_t a = 0;
+  for (int32 i = 0; i < num_states; i++) {
+    StateId s = order[i];
+    state_offsets_[i] = a;
+    for (fst::ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done();
+         aiter.Next(), a++) {
+      const CompactLatticeArc &carc = aiter.Value();
+      const std::vector<int32> &str = carc.weight.String();
+      Arc &arc = arcs_[a];
+      arc.ilabel = carc.ilabel;
+      arc.olabel = carc.olabel;
+      arc.weight = carc.weight.Weight();
+      arc.nextstate = new_id[carc.nextstate];
+      KALDI_ASSERT(arc.nextstate > i);
+      arc.string_offset = strings_.size();
+      arc.string_length = str.size();
+      strings_.insert(strings_.end(), str.begin(), str.end());
+    }
+    CompactLatticeWeight cfinal = clat.Final(s);
+    const std::vector<int32> &str = cfinal.String();
+    Final &final = finals_[i];
+    final.weight = cfinal.Weight();
+    final.string_offset = strings_.size();
+    final.string_length = str.size();
+    strings_.insert(strings_.end(), str.begin(), str.end());
+  }
+  state_offsets_[num_states] = a;
+  return true;
+}
+
+void FlatLattice::CopyTo(CompactLattice *clat) const {
+  clat->DeleteStates();
+  int32 num_states = NumStates();
+  if (num_states == 0) return;
+  for (int32 s = 0; s < num_states; s++)
+    clat->AddState();
+  clat->SetStart(0);
+  const int32 *strings = StringData();
+  for (int32 s = 0; s < num_states; s++) {
+    clat->ReserveArcs(s, NumArcs(s));
+    for (const Arc *arc = ArcsBegin(s); arc != ArcsEnd(s); ++arc) {
+      std::vector<int32> str(strings + arc->string_offset,
+                             strings + arc->string_offset + arc->string_length);
+      clat->AddArc(s, CompactLatticeArc(arc->ilabel, arc->olabel,
+                                        CompactLatticeWeight(arc->weight, str),
+                                        arc->nextstate));
+    }
+    const Final &final = finals_[s];
+    if (final.weight != LatticeWeight::Zero()) {
+      std::vector<int32> str(strings + final.string_offset,
+                             strings + final.string_offset +
+                             final.string_length);
+      clat->SetFinal(s, CompactLatticeWeight(final.weight, str));
+    }
+  }
+}
+
+// Scales a LatticeWeight; Zero() stays Zero() so that a negative scale does
+// not turn it into -infinity.
+static inline void ScaleLatticeWeight(BaseFloat graph_scale,
+                                      BaseFloat acoustic_scale,
+                                      LatticeWeight *w) {
+  if (*w != LatticeWeight::Zero())
+    *w = LatticeWeight(graph_scale * w->Value1(),
+                       acoustic_scale * w->Value2());
+}
+
+void FlatLattice::Scale(BaseFloat graph_scale, BaseFloat acoustic_scale) {
+  for (size_t a = 0; a < arcs_.size(); a++)
+    ScaleLatticeWeight(graph_scale, acoustic_scale, &(arcs_[a].weight));
+  for (size_t s = 0; s < finals_.size(); s++)
+    ScaleLatticeWeight(graph_scale, acoustic_scale, &(finals_[s].weight));
+}
+
+void FlatLattice::Filter(const std::vector<bool> &keep_state,
+                         const std::vector<bool> &keep_arc,
+                         const std::vector<bool> &keep_final) {
+  int32 num_states = NumStates();
+  KALDI_ASSERT(keep_state.size() == static_cast<size_t>(num_states) &&
+               keep_final.size() == static_cast<size_t>(num_states) &&
+               keep_arc.size() == arcs_.size());
+  std::vector<int32> new_id(num_states, -1);
+  int32 new_num_states = 0;
+  for (int32 s = 0; s < num_states; s++)
+    if (keep_state[s]) new_id[s] = new_num_states++;
+
+  // Everything is compacted in place: the new positions are never after the
+  // old ones, so we never overwrite data we still need.  The strings are
+  // copied into a new pool as they are not necessarily in order.
+  std::vector<int32> new_strings;
+  new_strings.reserve(strings_.size());
+  int32 a_out = 0;
+  for (int32 s = 0; s < num_states; s++) {
+    if (!keep_state[s]) continue;
+    int32 s_out = new_id[s], arcs_begin = state_offsets_[s],
+        arcs_end = state_offsets_[s + 1];
+    state_offsets_[s_out] = a_out;
+    for (int32 a = arcs_begin; a < arcs_end; a++) {
+      Arc arc = arcs_[a];
+      if (!keep_arc[a] || !keep_state[arc.nextstate]) continue;
+      arc.nextstate = new_id[arc.nextstate];
+      int32 offset = new_strings.size();
+      new_strings.insert(new_strings.end(),
+                         strings_.begin() + arc.string_offset,
+                         strings_.begin() + arc.string_offset +
+                         arc.string_length);
+      arc.string_offset = offset;
+      arcs_[a_out++] = arc;
+    }
+    Final final = finals_[s];
+    if (!keep_final[s]) {
+      final.weight = LatticeWeight::Zero();
+      final.string_length = 0;
+    }
+    int32 offset = new_strings.size();
+    new_strings.insert(new_strings.end(),
+                       strings_.begin() + final.string_offset,
+                       strings_.begin() + final.string_offset +
+                       final.string_length);
+    final.string_offset = offset;
+    finals_[s_out] = final;
+  }
+  state_offsets_[new_num_states] = a_out;
+  state_offsets_.resize(new_num_states + 1);
+  arcs_.resize(a_out);
+  finals_.resize(new_num_states);
+  strings_.swap(new_strings);
+}
+
+
+int32 FlatLatticeStateTimes(const FlatLattice &lat,
+                            std::vector<int32> *times) {
+  int32 num_states = lat.NumStates();
+  times->clear();
+  times->resize(num_states, -1);
+  if (num_states == 0) {
+    KALDI_WARN << "Utterance does not have a final-state.";
+    return 0;
+  }
+  (*times)[0] = 0;
+  int32 utt_len = -1;
+  for (int32 s = 0; s < num_states; s++) {
+    int32 cur_time = (*times)[s];
+    for (const FlatLattice::Arc *arc = lat.ArcsBegin(s);
+         arc != lat.ArcsEnd(s); ++arc) {
+      int32 &next_time = (*times)[arc->nextstate];
+      if (next_time == -1)
+        next_time = cur_time + arc->string_length;
+      else
+        KALDI_ASSERT(next_time == cur_time + arc->string_length);
+    }
+    if (lat.IsFinal(s)) {
+      int32 this_utt_len = cur_time + lat.GetFinal(s).string_length;
+      if (utt_len == -1) utt_len = this_utt_len;
+      else if (this_utt_len != utt_len) {
+        KALDI_WARN << "Utterance does not "
+            "seem to have a consistent length.";
+        utt_len = std::max(utt_len, this_utt_len);
+      }
+    }
+  }
+  if (utt_len == -1) {
+    KALDI_WARN << "Utterance does not have a final-state.";
+    return 0;
+  }
+  return utt_len;
+}
+
+BaseFloat FlatLatticeForwardBackward(const FlatLattice &lat, Posterior *post,
+                                     double *acoustic_like_sum) {
+  typedef FlatLattice::Arc Arc;
+  if (acoustic_like_sum) *acoustic_like_sum = 0.0;
+
+  int32 num_states = lat.NumStates();
+  std::vector<int32> state_times;
+  int32 max_time = FlatLatticeStateTimes(lat, &state_times);
+  std::vector<double> alpha(num_states, kLogZeroDouble), beta(num_states);
+  double tot_forward_prob = kLogZeroDouble;
+
+  post->clear();
+  post->resize(max_time);
+  if (num_states == 0) return kLogZeroDouble;
+
+  const int32 *strings = lat.StringData();
+  alpha[0] = 0.0;
+  for (int32 s = 0; s < num_states; s++) {
+    double this_alpha = alpha[s];
+    for (const Arc *arc = lat.ArcsBegin(s); arc != lat.ArcsEnd(s); ++arc) {
+      double arc_like = -ConvertToCost(arc->weight);
+      alpha[arc->nextstate] = LogAdd(alpha[arc->nextstate],
+                                     this_alpha + arc_like);
+    }
+    if (lat.IsFinal(s)) {
+      const FlatLattice::Final &f = lat.GetFinal(s);
+      tot_forward_prob = LogAdd(tot_forward_prob,
+                                this_alpha - ConvertToCost(f.weight));
+      KALDI_ASSERT(state_times[s] + f.string_length == max_time &&
+                   "Lattice is inconsistent (final-prob not at max_time)");
+    }
+  }
+  for (int32 s = num_states - 1; s >= 0; s--) {
+    const FlatLattice::Final &f = lat.GetFinal(s);
+    int32 t = state_times[s];
+    double this_beta = -ConvertToCost(f.weight);
+    for (const Arc *arc = lat.ArcsBegin(s); arc != lat.ArcsEnd(s); ++arc) {
+      double arc_like = -ConvertToCost(arc->weight),
+          arc_beta = beta[arc->nextstate] + arc_like;
+      this_beta = LogAdd(this_beta, arc_beta);
+      // The following "if" is an optimization to avoid un-needed exp().
+      if (arc->string_length != 0 || acoustic_like_sum != NULL) {
+        double posterior = exp(alpha[s] + arc_beta - tot_forward_prob);
+        const int32 *str = strings + arc->string_offset;
+        for (int32 i = 0; i < arc->string_length; i++)
+          (*post)[t + i].push_back(std::make_pair(str[i], posterior));
+        if (acoustic_like_sum != NULL)
+          *acoustic_like_sum -= posterior * arc->weight.Value2();
+      }
+    }
+    if (f.weight != LatticeWeight::Zero()) {
+      double posterior = exp(alpha[s] - ConvertToCost(f.weight) -
+                             tot_forward_prob);
+      const int32 *str = strings + f.string_offset;
+      for (int32 i = 0; i < f.string_length; i++)
+        (*post)[t + i].push_back(std::make_pair(str[i], posterior));
+      if (acoustic_like_sum != NULL)
+        *acoustic_like_sum -= posterior * f.weight.Value2();
+    }
+    beta[s] = this_beta;
+  }
+  double tot_backward_prob = beta[0];
+  if (!ApproxEqual(tot_forward_prob, tot_backward_prob, 1e-8)) {
+    KALDI_WARN << "Total forward probability over lattice = " << tot_forward_prob
+               << ", while total backward probability = " << tot_backward_prob;
+  }
+  // Now combine any posteriors with the same transition-id.
+  for (int32 t = 0; t < max_time; t++)
+    MergePairVectorSumming(&((*post)[t]));
+  return tot_backward_prob;
+}
+
+bool PruneFlatLattice(BaseFloat beam, FlatLattice *lat) {
+  typedef FlatLattice::Arc Arc;
+  KALDI_ASSERT(beam > 0.0);
+  int32 num_states = lat->NumStates(), num_arcs = lat->NumArcs();
+  if (num_states == 0) return false;
+  const double inf = std::numeric_limits<double>::infinity();
+  std::vector<double> forward_cost(num_states, inf),
+      backward_cost(num_states, inf);  // Viterbi costs.
+  forward_cost[0] = 0.0;
+  double best_final_cost = inf;
+  for (int32 s = 0; s < num_states; s++) {
+    double this_forward_cost = forward_cost[s];
+    for (const Arc *arc = lat->ArcsBegin(s); arc != lat->ArcsEnd(s); ++arc) {
+      double next_forward_cost = this_forward_cost +
+          ConvertToCost(arc->weight);
+      if (forward_cost[arc->nextstate] > next_forward_cost)
+        forward_cost[arc->nextstate] = next_forward_cost;
+    }
+    double this_final_cost = this_forward_cost +
+        ConvertToCost(lat->GetFinal(s).weight);
+    if (this_final_cost < best_final_cost)
+      best_final_cost = this_final_cost;
+  }
+  double cutoff = best_final_cost + beam;
+
+  // Go backwards computing the backward costs and deciding which arcs and
+  // final-probs survive, with the same criteria as PruneLattice().
+  std::vector<bool> keep_arc(num_arcs, false), keep_final(num_states, false),
+      coaccessible(num_states, false);
+  for (int32 s = num_states - 1; s >= 0; s--) {
+    double this_forward_cost = forward_cost[s],
+        this_backward_cost = ConvertToCost(lat->GetFinal(s).weight);
+    if (this_backward_cost != inf &&
+        this_backward_cost + this_forward_cost <= cutoff) {
+      keep_final[s] = true;
+      coaccessible[s] = true;
+    }
+    const Arc *begin = lat->ArcsBegin(s), *end = lat->ArcsEnd(s);
+    for (const Arc *arc = begin; arc != end; ++arc) {
+      double arc_cost = ConvertToCost(arc->weight),
+          arc_backward_cost = arc_cost + backward_cost[arc->nextstate],
+          this_fb_cost = this_forward_cost + arc_backward_cost;
+      if (arc_backward_cost < this_backward_cost)
+        this_backward_cost = arc_backward_cost;
+      if (this_fb_cost <= cutoff && coaccessible[arc->nextstate]) {
+        keep_arc[arc - lat->ArcsBegin(0)] = true;
+        coaccessible[s] = true;
+      }
+    }
+    backward_cost[s] = this_backward_cost;
+  }
+  // Now remove what is not accessible from the start state via kept arcs
+  // (the equivalent of fst::Connect()).
+  std::vector<bool> keep_state(num_states, false);
+  keep_state[0] = coaccessible[0];
+  for (int32 s = 0; s < num_states; s++) {
+    if (!keep_state[s]) {
+      keep_final[s] = false;
+      continue;
+    }
+    const Arc *begin = lat->ArcsBegin(s), *end = lat->ArcsEnd(s);
+    for (const Arc *arc = begin; arc != end; ++arc)
+      if (keep_arc[arc - lat->ArcsBegin(0)])
+        keep_state[arc->nextstate] = true;
+  }
+  lat->Filter(keep_state, keep_arc, keep_final);
+  return (lat->NumStates() > 0);
+}
+
+void ComputeFlatLatticeAlphas(const FlatLattice &lat,
+                              std::vector<double> *alpha) {
+  typedef FlatLattice::Arc Arc;
+  int32 num_states = lat.NumStates();
+  alpha->resize(0);
+  alpha->resize(num_states, kLogZeroDouble);
+  if (num_states == 0) return;
+  // As in ComputeCompactLatticeAlphas(), alpha[s] does not include the
+  // final-prob of s.
+  (*alpha)[0] = 0.0;
+  for (int32 s = 0; s < num_states; s++) {
+    double this_alpha = (*alpha)[s];
+    for (const Arc *arc = lat.ArcsBegin(s); arc != lat.ArcsEnd(s); ++arc) {
+      double arc_like = -(arc->weight.Value1() + arc->weight.Value2());
+      (*alpha)[arc->nextstate] = LogAdd((*alpha)[arc->nextstate],
+                                        this_alpha + arc_like);
+    }
+  }
+}
+
+void ComputeFlatLatticeBetas(const FlatLattice &lat,
+                             std::vector<double> *beta) {
+  typedef FlatLattice::Arc Arc;
+  int32 num_states = lat.NumStates();
+  beta->resize(0);
+  beta->resize(num_states, kLogZeroDouble);
+  for (int32 s = num_states - 1; s >= 0; s--) {
+    const LatticeWeight &f = lat.GetFinal(s).weight;
+    double this_beta = -(f.Value1() + f.Value2());
+    for (const Arc *arc = lat.ArcsBegin(s); arc != lat.ArcsEnd(s); ++arc) {
+      double arc_like = -(arc->weight.Value1() + arc->weight.Value2()),
+          arc_beta = (*beta)[arc->nextstate] + arc_like;
+      this_beta = LogAdd(this_beta, arc_beta);
+    }
+    (*beta)[s] = this_beta;
+  }
+}
+
+void ComposeFlatLatticeDeterministic(
+    const FlatLattice &lat,
+    fst::DeterministicOnDemandFst<fst::StdArc> *det_fst,
+    CompactLattice *composed_clat) {
+  typedef FlatLattice::Arc Arc;
+  typedef fst::StdArc::StateId StateId;
+  typedef std::pair<StateId, StateId> StatePair;
+  typedef unordered_map<StatePair, StateId, PairHasher<StateId> > MapType;
+  typedef MapType::iterator IterType;
+
+  KALDI_ASSERT(composed_clat != NULL);
+  composed_clat->DeleteStates();
+  if (lat.NumStates() == 0) return;
+
+  const int32 *strings = lat.StringData();
+  MapType state_map;
+  std::queue<StatePair> state_queue;
+
+  StateId start_state = composed_clat->AddState();
+  StatePair start_pair(0, det_fst->Start());
+  composed_clat->SetStart(start_state);
+  state_queue.push(start_pair);
+  state_map[start_pair] = start_state;
+
+  while (!state_queue.empty()) {
+    StatePair s = state_queue.front();
+    StateId s1 = s.first, s2 = s.second;
+    state_queue.pop();
+    StateId this_state = state_map[s];
+
+    const FlatLattice::Final &f = lat.GetFinal(s1);
+    if (f.weight != LatticeWeight::Zero()) {
+      CompactLatticeWeight final_weight(
+          LatticeWeight(f.weight.Value1() + det_fst->Final(s2).Value(),
+                        f.weight.Value2()),
+          std::vector<int32>(strings + f.string_offset,
+                             strings + f.string_offset + f.string_length));
+      if (final_weight != CompactLatticeWeight::Zero())
+        composed_clat->SetFinal(this_state, final_weight);
+    }
+
+    for (const Arc *arc1 = lat.ArcsBegin(s1); arc1 != lat.ArcsEnd(s1);
+         ++arc1) {
+      fst::StdArc arc2;
+      StateId next_state2;
+      BaseFloat lm_cost = 0.0;
+      if (arc1->olabel == 0) {
+        // Epsilon: <det_fst> stays at the current state.
+        next_state2 = s2;
+      } else if (det_fst->GetArc(s2, arc1->olabel, &arc2)) {
+        next_state2 = arc2.nextstate;
+        lm_cost = arc2.weight.Value();
+      } else {
+        continue;
+      }
+
+      StatePair next_state_pair(arc1->nextstate, next_state2);
+      IterType siter = state_map.find(next_state_pair);
+      StateId next_state;
+      if (siter == state_map.end()) {
+        next_state = composed_clat->AddState();
+        state_map[next_state_pair] = next_state;
+        state_queue.push(next_state_pair);
+      } else {
+        next_state = siter->second;
+      }
+      CompactLatticeWeight composed_weight(
+          LatticeWeight(arc1->weight.Value1() + lm_cost,
+                        arc1->weight.Value2()),
+          std::vector<int32>(strings + arc1->string_offset,
+                             strings + arc1->string_offset +
+                             arc1->string_length));
+      composed_clat->AddArc(this_state,
+                            CompactLatticeArc(arc1->ilabel, arc1->olabel,
+                                              composed_weight, next_state));
+    }
+  }
+  fst::Connect(composed_clat);
+}
+
+}  // namespace kaldi
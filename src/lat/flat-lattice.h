@@ -0,0 +1,155 @@
+// lat/flat-lattice.h
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_LAT_FLAT_LATTICE_H_
+#define KALDI_LAT_FLAT_LATTICE_H_
+
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "hmm/posterior.h"
+#include "fstext/fstext-lib.h"
+#include "lat/kaldi-lattice.h"
+
+namespace kaldi {
+
+/// FlatLattice is a read-only, topologically sorted copy of a CompactLattice
+/// laid out like a CSR matrix: the arcs of all states are in one contiguous
+/// array, with state s owning arcs [state_offsets_[s], state_offsets_[s+1]),
+/// and the transition-id strings of all arcs and final-probs are stored in one
+/// shared pool that the arcs index into.  The start state is always zero and
+/// every arc goes to a higher-numbered state, so algorithms that visit the
+/// states in order (forward-backward, pruning, alpha/beta computation) touch
+/// memory sequentially and need no per-state allocations.  It is intended for
+/// the lattice-processing inner loops; for anything that modifies the lattice
+/// structure, convert back to CompactLattice with CopyTo().
+class FlatLattice {
+ public:
+  struct Arc {
+    int32 ilabel;
+    int32 olabel;
+    LatticeWeight weight;
+    int32 nextstate;
+    int32 string_offset;  // offset of the transition-ids in StringData().
+    int32 string_length;  // number of transition-ids on the arc.
+  };
+  struct Final {
+    LatticeWeight weight;  // LatticeWeight::Zero() if the state is not final.
+    int32 string_offset;
+    int32 string_length;
+  };
+
+  FlatLattice() { Clear(); }
+
+  /// Copies "clat" into this object.  If "clat" is already topologically
+  /// sorted with start state zero, the state numbering is kept; otherwise the
+  /// states are renumbered in topological order and states not reachable from
+  /// the start state are dropped.  Returns false (and leaves this object
+  /// empty) if the lattice has cycles.  A lattice with no start state gives an
+  /// empty FlatLattice.
+  bool CopyFrom(const CompactLattice &clat);
+
+  /// Converts back to CompactLattice format.
+  void CopyTo(CompactLattice *clat) const;
+
+  void Clear();
+
+  int32 NumStates() const { return static_cast<int32>(finals_.size()); }
+  int32 NumArcs() const { return static_cast<int32>(arcs_.size()); }
+  int32 NumArcs(int32 s) const {
+    return state_offsets_[s + 1] - state_offsets_[s];
+  }
+
+  /// The arcs leaving state s are [ArcsBegin(s), ArcsEnd(s)).
+  const Arc *ArcsBegin(int32 s) const {
+    return arcs_.empty() ? NULL : &(arcs_[0]) + state_offsets_[s];
+  }
+  const Arc *ArcsEnd(int32 s) const {
+    return arcs_.empty() ? NULL : &(arcs_[0]) + state_offsets_[s + 1];
+  }
+  const Final &GetFinal(int32 s) const { return finals_[s]; }
+  bool IsFinal(int32 s) const {
+    return finals_[s].weight != LatticeWeight::Zero();
+  }
+
+  /// The pool of transition-ids; arc.string_offset indexes into this.
+  const int32 *StringData() const {
+    return strings_.empty() ? NULL : &(strings_[0]);
+  }
+
+  /// Scales the graph and acoustic parts of all weights, like
+  /// fst::ScaleLattice(fst::LatticeScale(graph_scale, acoustic_scale), ...).
+  void Scale(BaseFloat graph_scale, BaseFloat acoustic_scale);
+
+  /// Keeps only the states with keep_state[s] true and, of the arcs between
+  /// them, those with keep_arc[a] true (a indexes the arcs in order); final
+  /// weights of states with keep_final[s] false are removed.  States are
+  /// renumbered in order, so the result is still topologically sorted.  This
+  /// does not remove states that become unreachable, so the caller must
+  /// ensure the kept set is connected.
+  void Filter(const std::vector<bool> &keep_state,
+              const std::vector<bool> &keep_arc,
+              const std::vector<bool> &keep_final);
+
+ private:
+  std::vector<int32> state_offsets_;  // dimension NumStates() + 1.
+  std::vector<Arc> arcs_;
+  std::vector<Final> finals_;  // dimension NumStates().
+  std::vector<int32> strings_;
+};
+
+
+/// Like CompactLatticeStateTimes(): works out the frame index at which each
+/// state is, and returns the length of the utterance.
+int32 FlatLatticeStateTimes(const FlatLattice &lat,
+                            std::vector<int32> *times);
+
+/// Equivalent to LatticeForwardBackward() on the lattice obtained by converting
+/// "lat" to Lattice format, but works directly on the flat lattice.  Returns
+/// the total log-likelihood and outputs the posteriors of the transition-ids;
+/// if acoustic_like_sum != NULL, outputs the expected acoustic log-likelihood
+/// (the sum over arcs of posterior times acoustic likelihood).
+BaseFloat FlatLatticeForwardBackward(const FlatLattice &lat, Posterior *post,
+                                     double *acoustic_like_sum = NULL);
+
+/// Equivalent to PruneLattice() on the CompactLattice form: removes arcs and
+/// states whose best path is more than "beam" worse than the best path in the
+/// lattice.  Returns false if the result is empty.
+bool PruneFlatLattice(BaseFloat beam, FlatLattice *lat);
+
+/// Like ComputeCompactLatticeAlphas(); alpha does not include the final-prob.
+void ComputeFlatLatticeAlphas(const FlatLattice &lat,
+                              std::vector<double> *alpha);
+
+/// Like ComputeCompactLatticeBetas(); beta includes the final-prob.
+void ComputeFlatLatticeBetas(const FlatLattice &lat,
+                             std::vector<double> *beta);
+
+/// Like ComposeCompactLatticeDeterministic(), but the input is a FlatLattice:
+/// composes with <det_fst> on the output labels, adding the LM cost to the
+/// graph part of the weights, and outputs a connected CompactLattice.
+void ComposeFlatLatticeDeterministic(
+    const FlatLattice &lat,
+    fst::DeterministicOnDemandFst<fst::StdArc> *det_fst,
+    CompactLattice *composed_clat);
+
+}  // namespace kaldi
+
+#endif  // KALDI_LAT_FLAT_LATTICE_H_
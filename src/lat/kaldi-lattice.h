@@ -90,6 +90,8 @@ class CompactLatticeHolder {
 
   void Clear() { if (t_) { delete t_; t_ = NULL; } }
 
+  void Swap(CompactLatticeHolder *other) { std::swap(t_, other->t_); }
+
   ~CompactLatticeHolder() { Clear(); }
 
  private:
@@ -120,6 +122,8 @@ class LatticeHolder {
 
   void Clear() { if (t_) { delete t_; t_ = NULL; } }
 
+  void Swap(LatticeHolder *other) { std::swap(t_, other->t_); }
+
   ~LatticeHolder() { Clear(); }
 
  private:
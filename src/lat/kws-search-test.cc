@@ -0,0 +1,168 @@
+// lat/kws-search-test.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <map>
+
+#include "lat/kaldi-lattice.h"
+#include "lat/lattice-functions.h"
+#include "lat/kws-functions.h"
+#include "lat/kws-search.h"
+#include "fstext/epsilon-property.h"
+
+namespace kaldi {
+
+// Returns a random lattice over words 1 .. num_words (and silence, 0), whose
+// arcs go from each state to the next one or the one after, with consistent
+// times so that it can be indexed.
+void RandKwsLattice(int32 num_words, CompactLattice *clat) {
+  int32 num_states = 2 + Rand() % 10;
+  std::vector<int32> times(num_states, 0);
+  for (int32 s = 1; s < num_states; s++)
+    times[s] = times[s - 1] + 1 + Rand() % 3;
+  clat->DeleteStates();
+  for (int32 s = 0; s < num_states; s++)
+    clat->AddState();
+  clat->SetStart(0);
+  clat->SetFinal(num_states - 1, CompactLatticeWeight::One());
+  for (int32 s = 0; s + 1 < num_states; s++) {
+    int32 num_arcs = 1 + Rand() % 3;
+    for (int32 a = 0; a < num_arcs; a++) {
+      int32 next = (s + 2 < num_states && Rand() % 4 == 0 ? s + 2 : s + 1),
+          word = (Rand() % 5 == 0 ? 0 : 1 + Rand() % num_words);
+      std::vector<int32> tids(times[next] - times[s], 1);
+      CompactLatticeWeight weight(
+          LatticeWeight(RandUniform(), 5.0 * RandUniform()), tids);
+      clat->AddArc(s, CompactLatticeArc(word, word, weight, next));
+    }
+  }
+}
+
+// Creates the index of a lattice the way lattice-to-kws-index does.
+void CreateKwsIndex(CompactLattice *clat, int32 utterance_id,
+                    KwsLexicographicFst *index) {
+  std::vector<int32> state_times;
+  CompactLatticeStateTimes(*clat, &state_times);
+  bool ans = ClusterLattice(clat, state_times);
+  KALDI_ASSERT(ans);
+  EnsureEpsilonProperty(clat);
+  fst::TopSort(clat);
+  CompactLatticeStateTimes(*clat, &state_times);
+  KwsProductFst factor_transducer;
+  ans = CreateFactorTransducer(*clat, state_times, utterance_id,
+                               &factor_transducer);
+  KALDI_ASSERT(ans);
+  RemoveLongSilences(50, state_times, &factor_transducer);
+  DoFactorMerging(&factor_transducer, index);
+  DoFactorDisambiguation(index);
+  OptimizeFactorTransducer(index, -1, true);
+}
+
+// Returns a linear keyword acceptor for "words".
+void MakeKeyword(const std::vector<int32> &words,
+                 fst::VectorFst<fst::StdArc> *keyword) {
+  keyword->DeleteStates();
+  keyword->AddState();
+  keyword->SetStart(0);
+  for (size_t i = 0; i < words.size(); i++) {
+    keyword->AddState();
+    keyword->AddArc(i, fst::StdArc(words[i], words[i],
+                                   fst::TropicalWeight::One(), i + 1));
+  }
+  keyword->SetFinal(words.size(), fst::TropicalWeight::One());
+}
+
+// Returns the best weight for each label in "results".  (The composition may
+// give an occurrence more than once, if it is reached by several paths.)
+void BestWeights(const KwsSearchResults &results,
+                 std::map<uint32, KwsLexicographicWeight> *best) {
+  best->clear();
+  for (size_t i = 0; i < results.size(); i++) {
+    std::map<uint32, KwsLexicographicWeight>::iterator iter =
+        best->find(results[i].first);
+    if (iter == best->end())
+      (*best)[results[i].first] = results[i].second;
+    else
+      iter->second = Plus(iter->second, results[i].second);
+  }
+}
+
+// Checks that searching keywords with the trie, as kws-search --batch=true
+// does, gives the same hits as composing each keyword with the index.
+void UnitTestKwsKeywordTrieSearch() {
+  int32 num_words = 1 + Rand() % 5;
+  CompactLattice clat;
+  RandKwsLattice(num_words, &clat);
+  KwsLexicographicFst index;
+  CreateKwsIndex(&clat, 1 + Rand() % 10, &index);
+  unordered_map<uint32, uint64> label_decoder;
+  RelabelKwsIndexForSearch(&index, &label_decoder);
+
+  // Random keywords, which will often share prefixes.
+  int32 num_keywords = 1 + Rand() % 20;
+  std::vector<fst::VectorFst<fst::StdArc> > keywords(num_keywords);
+  KwsKeywordTrie trie;
+  for (int32 k = 0; k < num_keywords; k++) {
+    std::vector<int32> words(1 + Rand() % 3);
+    for (size_t i = 0; i < words.size(); i++)
+      words[i] = 1 + Rand() % num_words;
+    MakeKeyword(words, &(keywords[k]));
+    std::vector<int32> linear_words;
+    KwsLexicographicWeight weight;
+    bool linear = GetLinearKwsKeyword(keywords[k], &linear_words, &weight);
+    KALDI_ASSERT(linear && linear_words == words &&
+                 weight == KwsLexicographicWeight::One());
+    trie.AddKeyword(words, k);
+  }
+  // As with --num-threads, the search is split up by the first word.
+  int32 num_threads = 1 + Rand() % 3;
+  std::vector<KwsKeywordHits> hits(num_keywords);
+  for (int32 t = 0; t < num_threads; t++)
+    SearchKwsKeywordTrie(index, trie, t, num_threads, &hits);
+
+  // n_best is more than the number of possible hits.
+  int32 n_best = 1000, n_fail = 0;
+  for (int32 k = 0; k < num_keywords; k++) {
+    KwsSearchResults composition_results, trie_results;
+    SearchKwsKeywordByComposition(keywords[k], index, n_best,
+                                  &composition_results, &n_fail);
+    GetKwsKeywordHits(hits[k], KwsLexicographicWeight::One(), n_best,
+                      &trie_results);
+    std::map<uint32, KwsLexicographicWeight> composition_best, trie_best;
+    BestWeights(composition_results, &composition_best);
+    BestWeights(trie_results, &trie_best);
+    KALDI_ASSERT(trie_best.size() == trie_results.size());
+    KALDI_ASSERT(composition_best.size() == trie_best.size());
+    std::map<uint32, KwsLexicographicWeight>::const_iterator
+        iter1 = composition_best.begin(), iter2 = trie_best.begin();
+    for (; iter1 != composition_best.end(); ++iter1, ++iter2) {
+      KALDI_ASSERT(iter1->first == iter2->first);
+      KALDI_ASSERT(label_decoder.count(iter1->first) == 1);
+      KALDI_ASSERT(fst::ApproxEqual(iter1->second, iter2->second, 1.0e-04));
+    }
+  }
+  KALDI_ASSERT(n_fail == 0);
+}
+
+}  // namespace kaldi
+
+int main() {
+  for (kaldi::int32 i = 0; i < 50; i++)
+    kaldi::UnitTestKwsKeywordTrieSearch();
+  std::cout << "Test OK.\n";
+}
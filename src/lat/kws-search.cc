@@ -0,0 +1,322 @@
+// lat/kws-search.cc
+
+// Copyright 2012-2013  Johns Hopkins University (Authors: Guoguo Chen, Daniel Povey)
+//                2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <deque>
+
+#include "lat/kws-search.h"
+
+namespace kaldi {
+
+typedef KwsLexicographicArc Arc;
+typedef Arc::Weight Weight;
+typedef Arc::StateId StateId;
+
+static uint64 EncodeLabel(StateId ilabel, StateId olabel) {
+  return (((int64)olabel)<<32)+((int64)ilabel);
+}
+
+int32 DecodeKwsLabelUid(uint64 osymbol) {
+  // We only need the utterance id
+  return ((StateId)(osymbol>>32));
+}
+
+void RelabelKwsIndexForSearch(KwsLexicographicFst *index,
+                              unordered_map<uint32, uint64> *label_decoder) {
+  using namespace fst;
+  int32 label_count = 1;
+  unordered_map<uint64, uint32> label_encoder;
+  label_decoder->clear();
+  for (StateIterator<KwsLexicographicFst> siter(*index); !siter.Done();
+       siter.Next()) {
+    StateId state_id = siter.Value();
+    for (MutableArcIterator<KwsLexicographicFst>
+         aiter(index, state_id); !aiter.Done(); aiter.Next()) {
+      Arc arc = aiter.Value();
+      // Skip the non-final arcs
+      if (index->Final(arc.nextstate) == Weight::Zero())
+        continue;
+      // Encode the input and output label of the final arc, and this is the
+      // new output label for this arc; set the input label to <epsilon>
+      uint64 osymbol = EncodeLabel(arc.ilabel, arc.olabel);
+      arc.ilabel = 0;
+      if (label_encoder.find(osymbol) == label_encoder.end()) {
+        arc.olabel = label_count;
+        label_encoder[osymbol] = label_count;
+        (*label_decoder)[label_count] = osymbol;
+        label_count++;
+      } else {
+        arc.olabel = label_encoder[osymbol];
+      }
+      aiter.SetValue(arc);
+    }
+  }
+  ArcSort(index, fst::ILabelCompare<KwsLexicographicArc>());
+}
+
+
+class VectorFstToKwsLexicographicFstMapper {
+ public:
+  typedef fst::StdArc FromArc;
+  typedef FromArc::Weight FromWeight;
+  typedef KwsLexicographicArc ToArc;
+  typedef KwsLexicographicWeight ToWeight;
+
+  VectorFstToKwsLexicographicFstMapper() {}
+
+  ToArc operator()(const FromArc &arc) const {
+    return ToArc(arc.ilabel,
+                 arc.olabel,
+                 (arc.weight == FromWeight::Zero() ?
+                  ToWeight::Zero() :
+                  ToWeight(arc.weight.Value(),
+                           StdLStdWeight::One())),
+                 arc.nextstate);
+  }
+
+  fst::MapFinalAction FinalAction() const { return fst::MAP_NO_SUPERFINAL; }
+
+  fst::MapSymbolsAction InputSymbolsAction() const { return fst::MAP_COPY_SYMBOLS; }
+
+  fst::MapSymbolsAction OutputSymbolsAction() const { return fst::MAP_COPY_SYMBOLS;}
+
+  uint64 Properties(uint64 props) const { return props; }
+};
+
+bool SearchKwsKeywordByComposition(const fst::VectorFst<fst::StdArc> &keyword,
+                                   const KwsLexicographicFst &index,
+                                   int32 n_best, KwsSearchResults *results,
+                                   int32 *n_fail) {
+  using namespace fst;
+  results->clear();
+  KwsLexicographicFst keyword_fst;
+  KwsLexicographicFst result_fst;
+  Map(keyword, &keyword_fst, VectorFstToKwsLexicographicFstMapper());
+  Compose(keyword_fst, index, &result_fst);
+  Project(&result_fst, PROJECT_OUTPUT);
+  Minimize(&result_fst);
+  ShortestPath(result_fst, &result_fst, n_best);
+  RmEpsilon(&result_fst);
+
+  // No result found
+  if (result_fst.Start() == kNoStateId)
+    return false;
+
+  // Got something here
+  for (ArcIterator<KwsLexicographicFst>
+       aiter(result_fst, result_fst.Start()); !aiter.Done(); aiter.Next()) {
+    const Arc &arc = aiter.Value();
+
+    // We're expecting a two-state FST
+    if (result_fst.Final(arc.nextstate) != Weight::One()) {
+      (*n_fail)++;
+      continue;
+    }
+    results->push_back(std::make_pair(static_cast<uint32>(arc.olabel),
+                                      arc.weight));
+  }
+  return true;
+}
+
+bool GetLinearKwsKeyword(const fst::VectorFst<fst::StdArc> &keyword,
+                         std::vector<int32> *words, Weight *weight) {
+  using namespace fst;
+  words->clear();
+  TropicalWeight w = TropicalWeight::One();
+  StdArc::StateId s = keyword.Start();
+  if (s == kNoStateId) return false;
+  for (StdArc::StateId i = 0; i <= keyword.NumStates(); i++) {
+    if (keyword.NumArcs(s) == 0) {
+      if (keyword.Final(s) == TropicalWeight::Zero()) return false;
+      w = Times(w, keyword.Final(s));
+      if (words->empty()) return false;  // Leave this odd case to Compose().
+      *weight = Weight(w, StdLStdWeight::One());
+      return true;
+    }
+    if (keyword.NumArcs(s) != 1 || keyword.Final(s) != TropicalWeight::Zero())
+      return false;
+    ArcIterator<VectorFst<StdArc> > aiter(keyword, s);
+    const StdArc &arc = aiter.Value();
+    if (arc.ilabel != arc.olabel) return false;
+    if (arc.ilabel != 0) words->push_back(arc.ilabel);
+    w = Times(w, arc.weight);
+    s = arc.nextstate;
+  }
+  return false;  // There is a cycle.
+}
+
+
+void KwsKeywordTrie::AddKeyword(const std::vector<int32> &words,
+                                int32 keyword_index) {
+  int32 node = 0;
+  for (size_t i = 0; i < words.size(); i++) {
+    std::vector<std::pair<int32, int32> > &children = nodes_[node].children;
+    std::vector<std::pair<int32, int32> >::iterator iter =
+        std::lower_bound(children.begin(), children.end(),
+                         std::make_pair(words[i], static_cast<int32>(-1)));
+    if (iter != children.end() && iter->first == words[i]) {
+      node = iter->second;
+    } else {
+      int32 child = nodes_.size();
+      children.insert(iter, std::make_pair(words[i], child));
+      nodes_.push_back(Node());
+      node = child;
+    }
+  }
+  nodes_[node].keywords.push_back(keyword_index);
+}
+
+int32 KwsKeywordTrie::Child(int32 node, int32 word) const {
+  const std::vector<std::pair<int32, int32> > &children =
+      nodes_[node].children;
+  std::vector<std::pair<int32, int32> >::const_iterator iter =
+      std::lower_bound(children.begin(), children.end(),
+                       std::make_pair(word, static_cast<int32>(-1)));
+  if (iter != children.end() && iter->first == word) return iter->second;
+  return -1;
+}
+
+
+// The search of SearchKwsKeywordTrie().  It relies on the structure of the
+// index after RelabelKwsIndexForSearch(): word arcs have the word as ilabel,
+// the arcs into final states have ilabel 0 and the new label as olabel, and the
+// remaining (silence) arcs have both labels 0.
+class KwsKeywordTrieSearcher {
+ public:
+  KwsKeywordTrieSearcher(const KwsLexicographicFst &index,
+                         const KwsKeywordTrie &trie,
+                         int32 thread_id, int32 num_threads,
+                         std::vector<KwsKeywordHits> *hits):
+      index_(index), trie_(trie), thread_id_(thread_id),
+      num_threads_(num_threads), hits_(hits) { }
+
+  void Search() {
+    if (index_.Start() == fst::kNoStateId)
+      return;
+    Relax(index_.Start(), 0, Weight::One());
+    while (!queue_.empty()) {
+      uint64 pair = queue_.front();
+      queue_.pop_front();
+      PairInfo &info = pairs_[pair];
+      info.queued = false;
+      Expand(static_cast<StateId>(pair >> 32),
+             static_cast<int32>(pair & 0xFFFFFFFF), info.weight);
+    }
+  }
+
+ private:
+  struct PairInfo {
+    Weight weight;  // The best weight found so far to reach the pair.
+    bool queued;    // True if the pair is in queue_.
+  };
+
+  // Records that (state, node) can be reached with weight "weight", and queues
+  // it if that is better than what we had.
+  void Relax(StateId state, int32 node, const Weight &weight) {
+    uint64 pair = (static_cast<uint64>(state) << 32) |
+        static_cast<uint32>(node);
+    unordered_map<uint64, PairInfo>::iterator iter = pairs_.find(pair);
+    if (iter == pairs_.end()) {
+      PairInfo &info = pairs_[pair];
+      info.weight = weight;
+      info.queued = true;
+      queue_.push_back(pair);
+    } else if (less_(weight, iter->second.weight)) {
+      iter->second.weight = weight;
+      if (!iter->second.queued) {
+        iter->second.queued = true;
+        queue_.push_back(pair);
+      }
+    }
+  }
+
+  void Expand(StateId state, int32 node, Weight weight) {
+    const KwsKeywordTrie::Node &trie_node = trie_.GetNode(node);
+    for (fst::ArcIterator<KwsLexicographicFst> aiter(index_, state);
+         !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      if (arc.ilabel == 0) {
+        if (arc.olabel == 0) {  // Silence; the keyword does not advance.
+          Relax(arc.nextstate, node, Times(weight, arc.weight));
+        } else if (!trie_node.keywords.empty()) {  // A hit.
+          Weight w = Times(Times(weight, arc.weight),
+                           index_.Final(arc.nextstate));
+          for (size_t i = 0; i < trie_node.keywords.size(); i++) {
+            KwsKeywordHits &hits = (*hits_)[trie_node.keywords[i]];
+            KwsKeywordHits::iterator iter = hits.find(arc.olabel);
+            if (iter == hits.end())
+              hits[arc.olabel] = w;
+            else
+              iter->second = Plus(iter->second, w);
+          }
+        }
+      } else {
+        int32 child = trie_.Child(node, arc.ilabel);
+        if (child == -1) continue;
+        if (node == 0 && child % num_threads_ != thread_id_) continue;
+        Relax(arc.nextstate, child, Times(weight, arc.weight));
+      }
+    }
+  }
+
+  const KwsLexicographicFst &index_;
+  const KwsKeywordTrie &trie_;
+  int32 thread_id_;
+  int32 num_threads_;
+  std::vector<KwsKeywordHits> *hits_;
+  unordered_map<uint64, PairInfo> pairs_;
+  std::deque<uint64> queue_;
+  fst::NaturalLess<Weight> less_;
+};
+
+void SearchKwsKeywordTrie(const KwsLexicographicFst &index,
+                          const KwsKeywordTrie &trie,
+                          int32 thread_id, int32 num_threads,
+                          std::vector<KwsKeywordHits> *hits) {
+  KALDI_ASSERT(thread_id >= 0 && thread_id < num_threads);
+  KwsKeywordTrieSearcher searcher(index, trie, thread_id, num_threads, hits);
+  searcher.Search();
+}
+
+
+// Compares hits on their weights, best first.
+struct HitWeightLess {
+  bool operator () (const std::pair<uint32, Weight> &a,
+                    const std::pair<uint32, Weight> &b) const {
+    return less_(a.second, b.second) ||
+        (a.second == b.second && a.first < b.first);
+  }
+  fst::NaturalLess<Weight> less_;
+};
+
+void GetKwsKeywordHits(const KwsKeywordHits &hits,
+                       const KwsLexicographicWeight &keyword_weight,
+                       int32 n_best, KwsSearchResults *results) {
+  results->clear();
+  for (KwsKeywordHits::const_iterator iter = hits.begin(); iter != hits.end();
+       ++iter)
+    results->push_back(std::make_pair(iter->first,
+                                      Times(keyword_weight, iter->second)));
+  std::sort(results->begin(), results->end(), HitWeightLess());
+  if (n_best != -1 && results->size() > static_cast<size_t>(n_best))
+    results->resize(n_best);
+}
+
+}  // namespace kaldi
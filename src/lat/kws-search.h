@@ -0,0 +1,130 @@
+// lat/kws-search.h
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_LAT_KWS_SEARCH_H_
+#define KALDI_LAT_KWS_SEARCH_H_
+
+#include <utility>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "util/stl-utils.h"
+#include "lat/kaldi-kws.h"
+
+namespace kaldi {
+
+/// This file contains the searching of keywords in a KWS index, as done by
+/// kws-search: either one keyword at a time by composition, or, for the
+/// keywords that are a single sequence of words, all of them together in one
+/// traversal of the index.
+
+/// Prepares an index (as written by lattice-to-kws-index or kws-index-union)
+/// for searching.  The disambiguation symbols are moved from the input side to
+/// the output side of the arcs into final states, where they are combined with
+/// the utterance ids into new output labels; "label_decoder" maps these labels
+/// back to the combined symbols (see DecodeKwsLabelUid()).  The arcs are then
+/// sorted on input label.  Note that in Dogan and Murat's original paper they
+/// simply remove the disambiguation symbols on the input side, which would not
+/// allow us to do epsilon removal after composition with the keyword FST.
+void RelabelKwsIndexForSearch(KwsLexicographicFst *index,
+                              unordered_map<uint32, uint64> *label_decoder);
+
+/// Returns the utterance id from one of the combined symbols of
+/// RelabelKwsIndexForSearch().
+int32 DecodeKwsLabelUid(uint64 osymbol);
+
+/// The results of searching for a keyword: (output label of the index after
+/// RelabelKwsIndexForSearch(), weight), best first.
+typedef std::vector<std::pair<uint32, KwsLexicographicWeight> >
+    KwsSearchResults;
+
+/// Searches one keyword by composing it with the index (which must have been
+/// prepared with RelabelKwsIndexForSearch()), keeping the "n_best" best paths.
+/// Returns false if nothing was found.  Increments "n_fail" for each path of
+/// the result that does not have the expected structure.  Note: an
+/// occurrence may be output more than once if several paths of the index lead
+/// to it (e.g. with silences in different places).
+bool SearchKwsKeywordByComposition(const fst::VectorFst<fst::StdArc> &keyword,
+                                   const KwsLexicographicFst &index,
+                                   int32 n_best, KwsSearchResults *results,
+                                   int32 *n_fail);
+
+/// If the keyword FST is a single path (a linear acceptor, as produced by
+/// transcripts-to-fsts), outputs its non-epsilon words and the product of its
+/// weights and returns true.  Otherwise returns false.
+bool GetLinearKwsKeyword(const fst::VectorFst<fst::StdArc> &keyword,
+                         std::vector<int32> *words,
+                         KwsLexicographicWeight *weight);
+
+/// A trie of linear keywords, for searching them together with
+/// SearchKwsKeywordTrie().  Node 0 is the root.
+class KwsKeywordTrie {
+ public:
+  struct Node {
+    // (word, child-node), sorted on word.
+    std::vector<std::pair<int32, int32> > children;
+    // The keywords (indexes given to AddKeyword()) that end here.
+    std::vector<int32> keywords;
+  };
+
+  KwsKeywordTrie(): nodes_(1) { }
+
+  void AddKeyword(const std::vector<int32> &words, int32 keyword_index);
+
+  const Node &GetNode(int32 node) const { return nodes_[node]; }
+
+  /// Returns the child of "node" for word "word", or -1.
+  int32 Child(int32 node, int32 word) const;
+
+  int32 NumNodes() const { return nodes_.size(); }
+
+ private:
+  std::vector<Node> nodes_;
+};
+
+/// The hits of a keyword: for each output label of the index, the best weight
+/// of a path through the index for the keyword.
+typedef unordered_map<uint32, KwsLexicographicWeight> KwsKeywordHits;
+
+/// Searches the keywords of "trie" in the index (which must have been prepared
+/// with RelabelKwsIndexForSearch()) in one traversal, adding their hits to
+/// "hits", which is indexed by the keyword indexes given to
+/// KwsKeywordTrie::AddKeyword().  The traversal is over (index-state,
+/// trie-node) pairs, keeping the best weight of each; a pair is only expanded
+/// again if a better weight is found for it, so the work does not grow with
+/// the number of paths through the index.  For use from several threads, only
+/// the keywords whose first word's trie node is "thread_id" modulo
+/// "num_threads" are searched; each keyword is searched by just one thread, so
+/// the threads write to different elements of "hits".
+void SearchKwsKeywordTrie(const KwsLexicographicFst &index,
+                          const KwsKeywordTrie &trie,
+                          int32 thread_id, int32 num_threads,
+                          std::vector<KwsKeywordHits> *hits);
+
+/// Outputs the hits of a keyword searched with SearchKwsKeywordTrie(), best
+/// first, times the weight of the keyword itself, keeping the "n_best" best
+/// if n_best != -1.
+void GetKwsKeywordHits(const KwsKeywordHits &hits,
+                       const KwsLexicographicWeight &keyword_weight,
+                       int32 n_best, KwsSearchResults *results);
+
+}  // namespace kaldi
+
+#endif  // KALDI_LAT_KWS_SEARCH_H_
@@ -818,6 +818,35 @@ BaseFloat LatticeForwardBackwardMpeVariants(
   return tot_forward_score;
 }
 
+void LatticeToMpePostTask::operator () () {
+  if (acoustic_scale_ != 1.0 || lm_scale_ != 1.0)
+    fst::ScaleLattice(fst::LatticeScale(lm_scale_, acoustic_scale_), lat_);
+
+  uint64 props = lat_->Properties(fst::kFstProperties, false);
+  if (!(props & fst::kTopSorted)) {
+    if (fst::TopSort(lat_) == false)
+      KALDI_ERR << "Cycles detected in lattice.";
+  }
+  lat_frame_acc_ = LatticeForwardBackwardMpeVariants(
+      trans_model_, silence_phones_, *lat_, alignment_, criterion_, &post_);
+  KALDI_VLOG(2) << "Processed lattice for utterance: " << key_ << "; found "
+                << lat_->NumStates() << " states and " << fst::NumArcs(*lat_)
+                << " arcs.";
+  delete lat_;  // This is no longer needed so we can delete it now.
+  lat_ = NULL;
+}
+
+LatticeToMpePostTask::~LatticeToMpePostTask() {
+  double lat_time = post_.size();
+  *total_lat_frame_acc_ += lat_frame_acc_;
+  *total_time_ += lat_time;
+  KALDI_VLOG(2) << "Average frame accuracy for utterance " << key_ << " is "
+                << (lat_frame_acc_ / lat_time) << " over " << lat_time
+                << " frames.";
+  posterior_writer_->Write(key_, post_);
+  delete lat_;  // NULL unless operator () was not called.
+}
+
 bool CompactLatticeToWordAlignment(const CompactLattice &clat,
                                    std::vector<int32> *words,
                                    std::vector<int32> *begin_times,
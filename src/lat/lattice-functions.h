@@ -161,6 +161,58 @@ BaseFloat LatticeForwardBackwardMpeVariants(
     std::string criterion,
     Posterior *post);
 
+/**
+   This class is a task for TaskSequencer (see thread/kaldi-task-sequence.h)
+   that scales and topologically sorts one lattice and does the MPFE or SMBR
+   forward-backward on it with LatticeForwardBackwardMpeVariants(); "criterion"
+   is "mpfe" or "smbr".  The destructor, which the sequencer calls in the order
+   the tasks were given, writes the posteriors and adds the frame accuracy and
+   the number of frames to the totals.  It is used by
+   lattice-to-mpe-post-parallel and lattice-to-smbr-post-parallel.
+*/
+class LatticeToMpePostTask {
+ public:
+  // Initializer takes ownership of "lat".
+  LatticeToMpePostTask(const TransitionModel &trans_model,
+                       const std::vector<int32> &silence_phones,
+                       const std::string &criterion,
+                       const std::string &key,
+                       BaseFloat acoustic_scale,
+                       BaseFloat lm_scale,
+                       Lattice *lat,
+                       const std::vector<int32> &alignment,
+                       PosteriorWriter *posterior_writer,
+                       double *total_lat_frame_acc,
+                       double *total_time):
+      trans_model_(trans_model), silence_phones_(silence_phones),
+      criterion_(criterion), key_(key), acoustic_scale_(acoustic_scale),
+      lm_scale_(lm_scale), lat_(lat), alignment_(alignment),
+      posterior_writer_(posterior_writer),
+      total_lat_frame_acc_(total_lat_frame_acc), total_time_(total_time),
+      lat_frame_acc_(0.0) { }
+
+  void operator () ();
+
+  ~LatticeToMpePostTask();  // Produces output.  Run sequentially.
+
+ private:
+  const TransitionModel &trans_model_;
+  const std::vector<int32> &silence_phones_;
+  std::string criterion_;
+  std::string key_;
+  BaseFloat acoustic_scale_;
+  BaseFloat lm_scale_;
+  Lattice *lat_;  // The lattice we're working on.  Owned locally.
+  std::vector<int32> alignment_;
+  PosteriorWriter *posterior_writer_;
+  double *total_lat_frame_acc_;
+  double *total_time_;
+  // The output of our process, written in the destructor.
+  Posterior post_;
+  double lat_frame_acc_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(LatticeToMpePostTask);
+};
+
 /**
    This function can be used to compute posteriors for MMI, with a positive contribution
    for the numerator and a negative one for the denominator.  This function is not actually
@@ -22,9 +22,101 @@
 #include "fstext/fstext-lib.h"
 #include "lat/kaldi-lattice.h"
 #include "lat/lattice-functions.h"
+#include "lat/flat-lattice.h"
 #include "lm/const-arpa-lm.h"
+#include "lm/const-arpa-lm-cache.h"
+#include "thread/kaldi-task-sequence.h"
 #include "util/common-utils.h"
 
+namespace kaldi {
+
+class LmRescoreConstArpaTask {
+ public:
+  // Initializer takes ownership of "clat".  If "cache" is NULL, the LM is
+  // wrapped in a ConstArpaLmDeterministicFst for this lattice only.
+  LmRescoreConstArpaTask(const ConstArpaLm &const_arpa,
+                         ConstArpaLmCache *cache,
+                         BaseFloat lm_scale,
+                         const std::string &key,
+                         CompactLattice *clat,
+                         CompactLatticeWriter *clat_writer,
+                         int32 *num_done,
+                         int32 *num_fail):
+      const_arpa_(const_arpa), cache_(cache), lm_scale_(lm_scale), key_(key),
+      clat_(clat), clat_writer_(clat_writer), num_done_(num_done),
+      num_fail_(num_fail) { }
+
+  void operator () () {
+    // Before composing with the LM FST, we scale the lattice weights
+    // by the inverse of "lm_scale".  We'll later scale by "lm_scale".
+    // We do it this way so we can determinize and it will give the
+    // right effect (taking the "best path" through the LM) regardless
+    // of the sign of lm_scale.
+    // The composition works on a FlatLattice copy, whose arcs are
+    // stored contiguously.
+    FlatLattice flat_lat;
+    CompactLattice composed_clat;
+    if (flat_lat.CopyFrom(*clat_)) {
+      clat_->DeleteStates();
+      flat_lat.Scale(1.0 / lm_scale_, 1.0);
+
+      // Composes lattice with language model.
+      if (cache_ != NULL) {
+        ConstArpaLmCachedDeterministicFst const_arpa_fst(cache_);
+        ComposeFlatLatticeDeterministic(flat_lat,
+                                        &const_arpa_fst, &composed_clat);
+      } else {
+        // Wraps the ConstArpaLm format language model into FST. We re-create
+        // it for each lattice to prevent memory usage increasing with time.
+        ConstArpaLmDeterministicFst const_arpa_fst(const_arpa_);
+        ComposeFlatLatticeDeterministic(flat_lat,
+                                        &const_arpa_fst, &composed_clat);
+      }
+    } else {
+      // A FlatLattice cannot hold a lattice with cycles, so we compose this
+      // one in CompactLattice format, without the cache.
+      KALDI_VLOG(1) << "Lattice for utterance " << key_ << " has cycles; "
+                    << "composing it without the flat copy or the cache.";
+      fst::ScaleLattice(fst::GraphLatticeScale(1.0 / lm_scale_), clat_);
+      ArcSort(clat_, fst::OLabelCompare<CompactLatticeArc>());
+      ConstArpaLmDeterministicFst const_arpa_fst(const_arpa_);
+      ComposeCompactLatticeDeterministic(*clat_,
+                                         &const_arpa_fst, &composed_clat);
+    }
+
+    // Determinizes the composed lattice.
+    Lattice composed_lat;
+    ConvertLattice(composed_clat, &composed_lat);
+    Invert(&composed_lat);
+    DeterminizeLattice(composed_lat, clat_);
+    fst::ScaleLattice(fst::GraphLatticeScale(lm_scale_), clat_);
+  }
+
+  ~LmRescoreConstArpaTask() {  // Produces output.  Run sequentially.
+    if (clat_->Start() == fst::kNoStateId) {
+      KALDI_WARN << "Empty lattice for utterance " << key_
+                 << " (incompatible LM?)";
+      (*num_fail_)++;
+    } else {
+      clat_writer_->Write(key_, *clat_);
+      (*num_done_)++;
+    }
+    delete clat_;
+  }
+
+ private:
+  const ConstArpaLm &const_arpa_;
+  ConstArpaLmCache *cache_;
+  BaseFloat lm_scale_;
+  std::string key_;
+  CompactLattice *clat_;  // The input, and then the output.  Owned locally.
+  CompactLatticeWriter *clat_writer_;
+  int32 *num_done_;
+  int32 *num_fail_;
+};
+
+}  // namespace kaldi
+
 int main(int argc, char *argv[]) {
   try {
     using namespace kaldi;
@@ -36,7 +128,11 @@ int main(int argc, char *argv[]) {
         "will be wrapped into the DeterministicOnDemandFst interface and the\n"
         "rescoring is done by composing with the wrapped LM using a special\n"
         "type of composition algorithm. Determinization will be applied on\n"
-        "the composed lattice.\n"
+        "the composed lattice.  With --num-threads > 1 several lattices are\n"
+        "rescored at once; the output is in the same order as the input.\n"
+        "Unless --cache-size=0, n-gram lookups are cached across lattices in a\n"
+        "cache shared by all threads.  Lattices with cycles are rescored too,\n"
+        "but without the cache.\n"
         "\n"
         "Usage: lattice-lmrescore-const-arpa [options] lattice-rspecifier \\\n"
         "                                   const-arpa-in lattice-wspecifier\n"
@@ -45,9 +141,24 @@ int main(int argc, char *argv[]) {
       
     ParseOptions po(usage);
     BaseFloat lm_scale = 1.0;
+    int32 cache_size = 1000000;
+    bool use_mmap = true, huge_pages = false;
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
     
     po.Register("lm-scale", &lm_scale, "Scaling factor for language model "
                 "costs; frequently 1.0 or -1.0");
+    po.Register("cache-size", &cache_size, "Maximum number of n-gram lookups "
+                "kept in the cache shared across lattices and threads; 0 "
+                "disables the cache.");
+    po.Register("mmap", &use_mmap, "If true and the LM is a file in the "
+                "mappable layout (see arpa-to-const-arpa --mappable), "
+                "memory-map it instead of reading it, so that processes on "
+                "the same machine share one copy.");
+    po.Register("huge-pages", &huge_pages, "If true, ask for the memory-mapped "
+                "LM to be backed by huge pages (only effective on file "
+                "systems that support it, e.g. hugetlbfs or tmpfs mounted "
+                "with huge=advise).");
+    sequencer_config.Register(&po);
     
     po.Read(argc, argv);
 
@@ -62,58 +173,48 @@ int main(int argc, char *argv[]) {
 
     // Reads the language model in ConstArpaLm format.
     ConstArpaLm const_arpa;
-    ReadKaldiObject(lm_rxfilename, &const_arpa);
+    ReadConstArpaLm(lm_rxfilename, use_mmap, huge_pages, &const_arpa);
+
+    ConstArpaLmCache *cache = NULL;
+    if (cache_size > 0)
+      cache = new ConstArpaLmCache(const_arpa, cache_size);
 
     // Reads and writes as compact lattice.
     SequentialCompactLatticeReader compact_lattice_reader(lats_rspecifier);
     CompactLatticeWriter compact_lattice_writer(lats_wspecifier); 
 
     int32 n_done = 0, n_fail = 0;
-    for (; !compact_lattice_reader.Done(); compact_lattice_reader.Next()) {
-      std::string key = compact_lattice_reader.Key();
-      CompactLattice clat = compact_lattice_reader.Value();
-      compact_lattice_reader.FreeCurrent();
-
-      if (lm_scale != 0.0) {
-        // Before composing with the LM FST, we scale the lattice weights
-        // by the inverse of "lm_scale".  We'll later scale by "lm_scale".
-        // We do it this way so we can determinize and it will give the
-        // right effect (taking the "best path" through the LM) regardless
-        // of the sign of lm_scale.
-        fst::ScaleLattice(fst::GraphLatticeScale(1.0/lm_scale), &clat);
-        ArcSort(&clat, fst::OLabelCompare<CompactLatticeArc>());
-
-        // Wraps the ConstArpaLm format language model into FST. We re-create it
-        // for each lattice to prevent memory usage increasing with time.
-        ConstArpaLmDeterministicFst const_arpa_fst(const_arpa);
-
-        // Composes lattice with language model.        
-        CompactLattice composed_clat;
-        ComposeCompactLatticeDeterministic(clat,
-                                           &const_arpa_fst, &composed_clat);
-
-        // Determinizes the composed lattice.
-        Lattice composed_lat;
-        ConvertLattice(composed_clat, &composed_lat);
-        Invert(&composed_lat);
-        CompactLattice determinized_clat;
-        DeterminizeLattice(composed_lat, &determinized_clat);
-        fst::ScaleLattice(fst::GraphLatticeScale(lm_scale), &determinized_clat);
-        if (determinized_clat.Start() == fst::kNoStateId) {
-          KALDI_WARN << "Empty lattice for utterance " << key
-              << " (incompatible LM?)";
-          n_fail++;
+    {
+      TaskSequencer<LmRescoreConstArpaTask> sequencer(sequencer_config);
+      for (; !compact_lattice_reader.Done(); compact_lattice_reader.Next()) {
+        std::string key = compact_lattice_reader.Key();
+        if (lm_scale != 0.0) {
+          // will give ownership to "task" below.
+          CompactLattice *clat =
+              new CompactLattice(compact_lattice_reader.Value());
+          compact_lattice_reader.FreeCurrent();
+          sequencer.Run(new LmRescoreConstArpaTask(
+              const_arpa, cache, lm_scale, key, clat, &compact_lattice_writer,
+              &n_done, &n_fail));
         } else {
-          compact_lattice_writer.Write(key, determinized_clat);
+          // Zero scale so nothing to do.  We have to wait for the lattices
+          // in progress so that the output stays in order.
+          sequencer.Wait();
           n_done++;
+          compact_lattice_writer.Write(key, compact_lattice_reader.Value());
         }
-      } else {
-        // Zero scale so nothing to do.
-        n_done++;
-        compact_lattice_writer.Write(key, clat);
       }
+      sequencer.Wait();
     }
 
+    if (cache != NULL) {
+      int64 num_lookups, num_hits;
+      cache->GetStats(&num_lookups, &num_hits);
+      KALDI_LOG << "LM cache: " << num_lookups << " lookups, hit rate "
+                << (num_hits / std::max<double>(1.0, num_lookups))
+                << ", " << cache->NumStates() << " history states.";
+      delete cache;
+    }
     KALDI_LOG << "Done " << n_done << " lattices, failed for " << n_fail;
     return (n_done != 0 ? 0 : 1);
   } catch(const std::exception &e) {
@@ -0,0 +1,125 @@
+// latbin/lattice-to-mpe-post-parallel.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "fstext/fstext-lib.h"
+#include "lat/kaldi-lattice.h"
+#include "lat/lattice-functions.h"
+#include "hmm/transition-model.h"
+#include "thread/kaldi-task-sequence.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+
+    const char *usage =
+        "Do forward-backward and collect frame level MPE posteriors over\n"
+        "lattices, which can be fed into gmm-acc-stats2 to do MPE traning.\n"
+        "Caution: this is not really MPE, this is MPFE (minimum phone frame\n"
+        "error).  The posteriors may be positive or negative.  This is a\n"
+        "version of lattice-to-mpe-post that accepts the --num-threads option;\n"
+        "the output is written in the same order as the input.\n"
+        "Usage: lattice-to-mpe-post-parallel [options] <model> "
+        "<num-posteriors-rspecifier>\n"
+        " <lats-rspecifier> <posteriors-wspecifier> \n"
+        "e.g.: lattice-to-mpe-post-parallel --num-threads=8 "
+        "--acoustic-scale=0.1 1.mdl ark:num.post\n"
+        " ark:1.lats ark:1.post\n";
+
+    BaseFloat acoustic_scale = 1.0, lm_scale = 1.0;
+    std::string silence_phones_str;
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
+    ParseOptions po(usage);
+    po.Register("acoustic-scale", &acoustic_scale,
+                "Scaling factor for acoustic likelihoods");
+    po.Register("lm-scale", &lm_scale,
+                "Scaling factor for \"graph costs\" (including LM costs)");
+    po.Register("silence-phones", &silence_phones_str,
+                "Colon-separated list of integer id's of silence phones, e.g. 46:47");
+    sequencer_config.Register(&po);
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 4) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::vector<int32> silence_phones;
+    if (!SplitStringToIntegers(silence_phones_str, ":", false, &silence_phones))
+      KALDI_ERR << "Invalid silence-phones string " << silence_phones_str;
+    SortAndUniq(&silence_phones);
+    if (silence_phones.empty())
+      KALDI_WARN << "No silence phones specified, make sure this is what you intended.";
+
+    if (acoustic_scale == 0.0)
+      KALDI_ERR << "Do not use a zero acoustic scale (cannot be inverted)";
+
+    std::string model_filename = po.GetArg(1),
+        alignments_rspecifier = po.GetArg(2),
+        lats_rspecifier = po.GetArg(3),
+        posteriors_wspecifier = po.GetArg(4);
+
+    SequentialLatticeReader lattice_reader(lats_rspecifier);
+    PosteriorWriter posterior_writer(posteriors_wspecifier);
+    RandomAccessInt32VectorReader alignments_reader(alignments_rspecifier);
+
+    TransitionModel trans_model;
+    {
+      bool binary;
+      Input ki(model_filename, &binary);
+      trans_model.Read(ki.Stream(), binary);
+    }
+
+    int32 num_done = 0, num_err = 0;
+    double total_lat_frame_acc = 0.0, total_time = 0.0;
+
+    {
+      TaskSequencer<LatticeToMpePostTask> sequencer(sequencer_config);
+      for (; !lattice_reader.Done(); lattice_reader.Next()) {
+        std::string key = lattice_reader.Key();
+        if (!alignments_reader.HasKey(key)) {
+          KALDI_WARN << "No alignment for utterance " << key;
+          num_err++;
+          continue;
+        }
+        // will give ownership to "task" below.
+        Lattice *lat = lattice_reader.Value().Copy();
+        lattice_reader.FreeCurrent();
+        sequencer.Run(new LatticeToMpePostTask(
+            trans_model, silence_phones, "mpfe", key, acoustic_scale, lm_scale,
+            lat, alignments_reader.Value(key), &posterior_writer,
+            &total_lat_frame_acc, &total_time));
+        num_done++;
+      }
+      sequencer.Wait();
+    }
+
+    KALDI_LOG << "Overall average frame-accuracy is "
+              << (total_lat_frame_acc/total_time) << " over " << total_time
+              << " frames.";
+    KALDI_LOG << "Done " << num_done << " lattices, " << num_err
+              << " with no alignment.";
+    return (num_done != 0 ? 0 : 1);
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
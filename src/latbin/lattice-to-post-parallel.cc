@@ -0,0 +1,170 @@
+// latbin/lattice-to-post-parallel.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "fstext/fstext-lib.h"
+#include "lat/kaldi-lattice.h"
+#include "lat/lattice-functions.h"
+#include "thread/kaldi-task-sequence.h"
+
+namespace kaldi {
+
+class LatticeToPostTask {
+ public:
+  // Initializer takes ownership of "lat".
+  LatticeToPostTask(const std::string &key,
+                    BaseFloat acoustic_scale,
+                    BaseFloat lm_scale,
+                    Lattice *lat,
+                    PosteriorWriter *posterior_writer,
+                    BaseFloatWriter *loglikes_writer,
+                    double *total_like,
+                    double *total_ac_like,
+                    double *total_time):
+      key_(key), acoustic_scale_(acoustic_scale), lm_scale_(lm_scale),
+      lat_(lat), posterior_writer_(posterior_writer),
+      loglikes_writer_(loglikes_writer), total_like_(total_like),
+      total_ac_like_(total_ac_like), total_time_(total_time),
+      lat_like_(0.0), lat_ac_like_(0.0) { }
+
+  void operator () () {
+    if (acoustic_scale_ != 1.0 || lm_scale_ != 1.0)
+      fst::ScaleLattice(fst::LatticeScale(lm_scale_, acoustic_scale_), lat_);
+
+    uint64 props = lat_->Properties(fst::kFstProperties, false);
+    if (!(props & fst::kTopSorted)) {
+      if (fst::TopSort(lat_) == false)
+        KALDI_ERR << "Cycles detected in lattice.";
+    }
+    lat_like_ = LatticeForwardBackward(*lat_, &post_, &lat_ac_like_);
+    KALDI_VLOG(2) << "Processed lattice for utterance: " << key_ << "; found "
+                  << lat_->NumStates() << " states and " << fst::NumArcs(*lat_)
+                  << " arcs.";
+    delete lat_;  // This is no longer needed so we can delete it now.
+    lat_ = NULL;
+  }
+
+  ~LatticeToPostTask() {  // Produces output.  Run sequentially.
+    double lat_time = post_.size();
+    *total_like_ += lat_like_;
+    *total_ac_like_ += lat_ac_like_;
+    *total_time_ += lat_time;
+    KALDI_VLOG(2) << "Average log-likelihood for utterance " << key_ << " is "
+                  << (lat_like_ / lat_time) << " over " << lat_time
+                  << " frames.  Average acoustic log-like per frame is "
+                  << (lat_ac_like_ / lat_time);
+    if (loglikes_writer_->IsOpen())
+      loglikes_writer_->Write(key_, lat_like_);
+    posterior_writer_->Write(key_, post_);
+    delete lat_;  // NULL unless operator () was not called.
+  }
+
+ private:
+  std::string key_;
+  BaseFloat acoustic_scale_;
+  BaseFloat lm_scale_;
+  Lattice *lat_;  // The lattice we're working on.  Owned locally.
+  PosteriorWriter *posterior_writer_;
+  BaseFloatWriter *loglikes_writer_;
+  double *total_like_;
+  double *total_ac_like_;
+  double *total_time_;
+  // The output of our process, written in the destructor.
+  Posterior post_;
+  double lat_like_;
+  double lat_ac_like_;
+};
+
+}  // namespace kaldi
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+
+    const char *usage =
+        "Do forward-backward and collect posteriors over lattices.  This is a\n"
+        "version of lattice-to-post that accepts the --num-threads option: the\n"
+        "lattices are read in the main thread, and the topological sort and\n"
+        "forward-backward are done in parallel; the output is written in the\n"
+        "same order as the input.\n"
+        "Usage: lattice-to-post-parallel [options] lats-rspecifier "
+        "posts-wspecifier [loglikes-wspecifier]\n"
+        " e.g.: lattice-to-post-parallel --num-threads=8 --acoustic-scale=0.1 "
+        "ark:1.lats ark:1.post\n";
+
+    BaseFloat acoustic_scale = 1.0, lm_scale = 1.0;
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
+    ParseOptions po(usage);
+    po.Register("acoustic-scale", &acoustic_scale,
+                "Scaling factor for acoustic likelihoods");
+    po.Register("lm-scale", &lm_scale,
+                "Scaling factor for \"graph costs\" (including LM costs)");
+    sequencer_config.Register(&po);
+    po.Read(argc, argv);
+
+    if (po.NumArgs() < 2 || po.NumArgs() > 3) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    if (acoustic_scale == 0.0)
+      KALDI_ERR << "Do not use a zero acoustic scale (cannot be inverted)";
+
+    std::string lats_rspecifier = po.GetArg(1),
+        posteriors_wspecifier = po.GetArg(2),
+        loglikes_wspecifier = po.GetOptArg(3);
+
+    // Read as regular lattice
+    SequentialLatticeReader lattice_reader(lats_rspecifier);
+
+    PosteriorWriter posterior_writer(posteriors_wspecifier);
+    BaseFloatWriter loglikes_writer(loglikes_wspecifier);
+
+    int32 n_done = 0;
+    double total_like = 0.0, total_ac_like = 0.0, total_time = 0.0;
+
+    {
+      TaskSequencer<LatticeToPostTask> sequencer(sequencer_config);
+      for (; !lattice_reader.Done(); lattice_reader.Next()) {
+        std::string key = lattice_reader.Key();
+        // will give ownership to "task" below.
+        Lattice *lat = lattice_reader.Value().Copy();
+        lattice_reader.FreeCurrent();
+        sequencer.Run(new LatticeToPostTask(key, acoustic_scale, lm_scale, lat,
+                                            &posterior_writer,
+                                            &loglikes_writer, &total_like,
+                                            &total_ac_like, &total_time));
+        n_done++;
+      }
+      sequencer.Wait();
+    }
+
+    KALDI_LOG << "Overall average log-like/frame is "
+              << (total_like/total_time) << " over " << total_time
+              << " frames.  Average acoustic like/frame is "
+              << (total_ac_like/total_time);
+    KALDI_LOG << "Done " << n_done << " lattices.";
+    return (n_done != 0 ? 0 : 1);
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -0,0 +1,196 @@
+// lm/const-arpa-lm-cache-test.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fstream>
+#include <set>
+#include <unistd.h>
+
+#include "lm/const-arpa-lm.h"
+#include "lm/const-arpa-lm-cache.h"
+#include "thread/kaldi-thread.h"
+
+namespace kaldi {
+
+// Writes a random trigram LM in the integerized Arpa format that
+// BuildConstArpaLm() reads.  The words are 1 (<s>), 2 (</s>), "unk" if it is
+// not -1, and the others up to num_words - 1, except that one of them is left
+// out so that there is a word the LM does not know.
+void WriteRandomArpa(const std::string &filename, int32 num_words,
+                     int32 unk) {
+  int32 missing_word = 3 + Rand() % (num_words - 3);
+  if (missing_word == unk) missing_word++;
+  std::vector<int32> words;
+  for (int32 w = 1; w < num_words; w++)
+    if (w != missing_word) words.push_back(w);
+
+  std::vector<std::vector<std::vector<int32> > > ngrams(3);
+  for (size_t i = 0; i < words.size(); i++)
+    ngrams[0].push_back(std::vector<int32>(1, words[i]));
+  for (int32 order = 2; order <= 3; order++) {
+    const std::vector<std::vector<int32> > &hists = ngrams[order - 2];
+    for (size_t h = 0; h < hists.size(); h++) {
+      if (hists[h].back() == 2) continue;  // Nothing follows </s>.
+      for (size_t i = 0; i < words.size(); i++) {
+        if (words[i] == 1 || Rand() % 3 != 0) continue;
+        std::vector<int32> ngram(hists[h]);
+        ngram.push_back(words[i]);
+        ngrams[order - 1].push_back(ngram);
+      }
+    }
+  }
+
+  std::ofstream os(filename.c_str());
+  os << "\n\\data\\\n";
+  for (int32 order = 1; order <= 3; order++)
+    os << "ngram " << order << "=" << ngrams[order - 1].size() << "\n";
+  for (int32 order = 1; order <= 3; order++) {
+    os << "\n\\" << order << "-grams:\n";
+    for (size_t i = 0; i < ngrams[order - 1].size(); i++) {
+      os << -5.0 * RandUniform() << '\t';
+      for (int32 j = 0; j < order; j++)
+        os << (j > 0 ? " " : "") << ngrams[order - 1][i][j];
+      if (order < 3)
+        os << '\t' << -RandUniform();
+      os << '\n';
+    }
+  }
+  os << "\n\\end\\\n";
+}
+
+// Each thread walks random word sequences (including words that the LM does
+// not know) through the cached FST and, alongside, through its own uncached
+// ConstArpaLmDeterministicFst, and counts the differences between them: in
+// whether there is an arc, in its weight or in the final weights, and in which
+// states are the same.
+class ConstArpaLmCacheTestClass: public MultiThreadable {
+ public:
+  ConstArpaLmCacheTestClass(const ConstArpaLm &lm, ConstArpaLmCache *cache,
+                            int32 num_words, int32 num_sentences,
+                            int32 *num_errors,
+                            std::set<std::pair<int32, int32> > *keys):
+      lm_(lm), cache_(cache), num_words_(num_words),
+      num_sentences_(num_sentences), num_errors_ptr_(num_errors),
+      keys_ptr_(keys), num_errors_(0) { }
+
+  ~ConstArpaLmCacheTestClass() {
+    *num_errors_ptr_ += num_errors_;
+    keys_ptr_->insert(keys_.begin(), keys_.end());
+  }
+
+  void operator () () {
+    RandomState rand_state;
+    ConstArpaLmDeterministicFst lm_fst(lm_);
+    ConstArpaLmCachedDeterministicFst cached_fst(cache_);
+    for (int32 i = 0; i < num_sentences_; i++) {
+      fst::StdArc::StateId s = lm_fst.Start(), cached_s = cached_fst.Start();
+      CheckStates(s, cached_s);
+      int32 length = RandInt(0, 10, &rand_state);
+      for (int32 j = 0; j < length; j++) {
+        // num_words is not a word of the LM.
+        int32 word = RandInt(1, num_words_, &rand_state);
+        fst::StdArc arc, cached_arc;
+        bool ans = lm_fst.GetArc(s, word, &arc),
+            cached_ans = cached_fst.GetArc(cached_s, word, &cached_arc);
+        keys_.insert(std::make_pair(cached_s, word));
+        if (ans != cached_ans) {
+          num_errors_++;
+          break;
+        }
+        if (!ans) continue;
+        if (arc.weight != cached_arc.weight || cached_arc.ilabel != word ||
+            cached_arc.olabel != word)
+          num_errors_++;
+        s = arc.nextstate;
+        cached_s = cached_arc.nextstate;
+        CheckStates(s, cached_s);
+      }
+      keys_.insert(std::make_pair(cached_s, -1));
+      if (lm_fst.Final(s) != cached_fst.Final(cached_s))
+        num_errors_++;
+    }
+  }
+
+ private:
+  // The uncached and cached states must correspond one to one.
+  void CheckStates(int32 s, int32 cached_s) {
+    if (to_cached_.insert(std::make_pair(s, cached_s)).first->second !=
+        cached_s ||
+        from_cached_.insert(std::make_pair(cached_s, s)).first->second != s)
+      num_errors_++;
+  }
+
+  const ConstArpaLm &lm_;
+  ConstArpaLmCache *cache_;
+  int32 num_words_;
+  int32 num_sentences_;
+  int32 *num_errors_ptr_;
+  std::set<std::pair<int32, int32> > *keys_ptr_;
+  int32 num_errors_;
+  // The (state, word) lookups done in the cache; word is -1 for final-probs.
+  std::set<std::pair<int32, int32> > keys_;
+  unordered_map<int32, int32> to_cached_;
+  unordered_map<int32, int32> from_cached_;
+};
+
+// Returns true if some entries of the cache were evicted and looked up again.
+bool UnitTestConstArpaLmCache() {
+  int32 num_words = 5 + Rand() % 20, unk = (Rand() % 2 == 0 ? 3 : -1);
+  WriteRandomArpa("tmp.arpa", num_words, unk);
+  BuildConstArpaLm(false, 1, 2, unk, "tmp.arpa", "tmp.carpa");
+  ConstArpaLm lm;
+  ReadKaldiObject("tmp.carpa", &lm);
+
+  // The cache is small (as with a small --cache-size), so that entries get
+  // evicted.
+  ConstArpaLmCache cache(lm, 1 + Rand() % 20, 1 + Rand() % 4);
+  int32 num_errors = 0;
+  std::set<std::pair<int32, int32> > keys;
+  g_num_threads = 1;
+  RunMultiThreaded(ConstArpaLmCacheTestClass(lm, &cache, num_words, 20,
+                                             &num_errors, &keys));
+  KALDI_ASSERT(num_errors == 0);
+  int64 num_lookups, num_hits;
+  cache.GetStats(&num_lookups, &num_hits);
+  // Each distinct lookup misses at least once; more misses than that mean
+  // that entries were evicted.
+  int64 num_misses = num_lookups - num_hits;
+  KALDI_ASSERT(num_misses >= static_cast<int64>(keys.size()));
+  bool evicted = (num_misses > static_cast<int64>(keys.size()));
+
+  // Now several threads share the cache, which is already partly filled.
+  g_num_threads = 2 + Rand() % 6;
+  RunMultiThreaded(ConstArpaLmCacheTestClass(lm, &cache, num_words, 50,
+                                             &num_errors, &keys));
+  KALDI_ASSERT(num_errors == 0);
+  g_num_threads = 1;
+
+  unlink("tmp.arpa");
+  unlink("tmp.carpa");
+  return evicted;
+}
+
+}  // namespace kaldi
+
+int main() {
+  bool evicted = false;
+  for (kaldi::int32 i = 0; i < 20; i++)
+    evicted = kaldi::UnitTestConstArpaLmCache() || evicted;
+  KALDI_ASSERT(evicted);
+  std::cout << "Test OK.\n";
+}
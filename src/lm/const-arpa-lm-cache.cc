@@ -0,0 +1,177 @@
+// lm/const-arpa-lm-cache.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <algorithm>
+#include <limits>
+
+#include "lm/const-arpa-lm-cache.h"
+
+namespace kaldi {
+
+ConstArpaLmCache::ConstArpaLmCache(const ConstArpaLm &lm, size_t max_arcs,
+                                   int32 num_stripes):
+    lm_(lm), num_stripes_(num_stripes) {
+  KALDI_ASSERT(num_stripes > 0);
+  max_arcs_per_stripe_ = std::max<size_t>(1, max_arcs / num_stripes);
+  for (int32 i = 0; i < num_stripes; i++) {
+    arc_stripes_.push_back(new ArcStripe());
+    history_stripes_.push_back(new HistoryStripe());
+  }
+  std::vector<int32> bos_state(1, lm_.BosSymbol());
+  start_state_ = GetState(bos_state);
+}
+
+ConstArpaLmCache::~ConstArpaLmCache() {
+  DeletePointers(&arc_stripes_);
+  DeletePointers(&history_stripes_);
+}
+
+bool ConstArpaLmCache::LookupArc(int32 state, int32 word,
+                                 std::pair<int32, float> *value) {
+  ArcStripe *stripe = GetArcStripe(state, word);
+  stripe->mutex.Lock();
+  stripe->num_lookups++;
+  ArcMapType::const_iterator iter = stripe->arcs.find(ArcKey(state, word));
+  bool found = (iter != stripe->arcs.end());
+  if (found) {
+    stripe->num_hits++;
+    *value = iter->second;
+  }
+  stripe->mutex.Unlock();
+  return found;
+}
+
+void ConstArpaLmCache::InsertArc(int32 state, int32 word,
+                                 const std::pair<int32, float> &value) {
+  ArcStripe *stripe = GetArcStripe(state, word);
+  stripe->mutex.Lock();
+  if (stripe->arcs.size() >= max_arcs_per_stripe_)
+    stripe->arcs.clear();
+  stripe->arcs[ArcKey(state, word)] = value;
+  stripe->mutex.Unlock();
+}
+
+int32 ConstArpaLmCache::GetState(const std::vector<int32> &wseq) {
+  int32 s = static_cast<int32>(VectorHasher<int32>()(wseq) % num_stripes_);
+  HistoryStripe *stripe = history_stripes_[s];
+  stripe->mutex.Lock();
+  std::pair<HistoryMapType::iterator, bool> result =
+      stripe->wseq_to_index.insert(
+          std::make_pair(wseq, static_cast<int32>(
+              stripe->index_to_wseq.size())));
+  if (result.second)
+    stripe->index_to_wseq.push_back(wseq);
+  int32 index = result.first->second;
+  stripe->mutex.Unlock();
+  KALDI_ASSERT(index < (std::numeric_limits<int32>::max() - s) / num_stripes_);
+  return index * num_stripes_ + s;
+}
+
+void ConstArpaLmCache::GetHistory(int32 state,
+                                  std::vector<int32> *wseq) const {
+  KALDI_ASSERT(state >= 0);
+  const HistoryStripe *stripe = history_stripes_[state % num_stripes_];
+  size_t index = state / num_stripes_;
+  stripe->mutex.Lock();
+  KALDI_ASSERT(index < stripe->index_to_wseq.size());
+  *wseq = stripe->index_to_wseq[index];
+  stripe->mutex.Unlock();
+}
+
+bool ConstArpaLmCache::GetArc(int32 state, int32 word, float *logprob,
+                              int32 *next_state) {
+  std::pair<int32, float> value;
+  if (!LookupArc(state, word, &value)) {
+    // Not cached; this is the same computation as in
+    // ConstArpaLmDeterministicFst::GetArc().
+    std::vector<int32> wseq;
+    GetHistory(state, &wseq);
+    value.second = lm_.GetNgramLogprob(word, wseq);
+    if (value.second == std::numeric_limits<float>::min()) {
+      value.first = -1;
+    } else {
+      wseq.push_back(word);
+      while (wseq.size() >= lm_.NgramOrder())
+        wseq.erase(wseq.begin(), wseq.begin() + 1);
+      while (!lm_.HistoryStateExists(wseq)) {
+        KALDI_ASSERT(wseq.size() > 0);
+        wseq.erase(wseq.begin(), wseq.begin() + 1);
+      }
+      value.first = GetState(wseq);
+    }
+    InsertArc(state, word, value);
+  }
+  if (value.first == -1) return false;
+  *logprob = value.second;
+  *next_state = value.first;
+  return true;
+}
+
+float ConstArpaLmCache::FinalLogprob(int32 state) {
+  // Final-probs are stored in the arc table with word -1, which is not a
+  // valid word.
+  std::pair<int32, float> value;
+  if (!LookupArc(state, -1, &value)) {
+    std::vector<int32> wseq;
+    GetHistory(state, &wseq);
+    value.first = -1;
+    value.second = lm_.GetNgramLogprob(lm_.EosSymbol(), wseq);
+    InsertArc(state, -1, value);
+  }
+  return value.second;
+}
+
+void ConstArpaLmCache::GetStats(int64 *num_lookups, int64 *num_hits) const {
+  *num_lookups = 0;
+  *num_hits = 0;
+  for (int32 i = 0; i < num_stripes_; i++) {
+    const ArcStripe *stripe = arc_stripes_[i];
+    stripe->mutex.Lock();
+    *num_lookups += stripe->num_lookups;
+    *num_hits += stripe->num_hits;
+    stripe->mutex.Unlock();
+  }
+}
+
+int32 ConstArpaLmCache::NumStates() const {
+  int32 ans = 0;
+  for (int32 i = 0; i < num_stripes_; i++) {
+    const HistoryStripe *stripe = history_stripes_[i];
+    stripe->mutex.Lock();
+    ans += stripe->index_to_wseq.size();
+    stripe->mutex.Unlock();
+  }
+  return ans;
+}
+
+bool ConstArpaLmCachedDeterministicFst::GetArc(StateId s, Label ilabel,
+                                               fst::StdArc *oarc) {
+  float logprob;
+  int32 next_state;
+  if (!cache_->GetArc(s, ilabel, &logprob, &next_state))
+    return false;
+  oarc->ilabel = ilabel;
+  oarc->olabel = ilabel;
+  oarc->nextstate = next_state;
+  oarc->weight = Weight(-logprob);
+  return true;
+}
+
+}  // namespace kaldi
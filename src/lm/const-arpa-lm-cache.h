@@ -0,0 +1,160 @@
+// lm/const-arpa-lm-cache.h
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_LM_CONST_ARPA_LM_CACHE_H_
+#define KALDI_LM_CONST_ARPA_LM_CACHE_H_
+
+#include <utility>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "fstext/deterministic-fst.h"
+#include "lm/const-arpa-lm.h"
+#include "thread/kaldi-mutex.h"
+#include "util/stl-utils.h"
+
+namespace kaldi {
+
+/**
+   ConstArpaLmCache is a thread-safe cache of lookups in a ConstArpaLm, meant to
+   be shared by all the threads of a program and kept across lattices.  It
+   gives each history word-sequence (as in ConstArpaLmDeterministicFst) a state
+   number that is the same for all users of the cache, and remembers the result
+   of each (state, word) lookup: the n-gram log-probability and the successor
+   state.  So once the histories that occur in the data have been seen, an arc
+   lookup is one hash-table probe instead of a walk down the ConstArpaLm trie
+   with backoff.
+
+   Both tables are split into "stripes", each with its own lock, chosen by the
+   hash of the key, so that threads rarely wait for each other.  The history
+   table only grows (the states are referred to by lattices in flight, and
+   there are at most as many as there are history states in the LM); the arc
+   table is bounded by "max_arcs", and a stripe that gets full is simply
+   emptied.
+ */
+class ConstArpaLmCache {
+ public:
+  /// "max_arcs" is the approximate maximum number of cached (state, word)
+  /// lookups; "num_stripes" is the number of separately locked parts of each
+  /// table.
+  ConstArpaLmCache(const ConstArpaLm &lm, size_t max_arcs = 1000000,
+                   int32 num_stripes = 64);
+
+  ~ConstArpaLmCache();
+
+  /// The state for the history "<s>".
+  int32 Start() const { return start_state_; }
+
+  /// Looks up "word" after history-state "state".  Returns false if the word
+  /// has no probability in the LM (only possible if there is no <unk>);
+  /// otherwise outputs the log-probability and the successor state.
+  bool GetArc(int32 state, int32 word, float *logprob, int32 *next_state);
+
+  /// Returns the log-probability of </s> after history-state "state".
+  float FinalLogprob(int32 state);
+
+  /// Number of (state, word) lookups so far, including final-probs, and how
+  /// many of them were found in the cache.
+  void GetStats(int64 *num_lookups, int64 *num_hits) const;
+
+  /// Number of history states created so far.
+  int32 NumStates() const;
+
+  const ConstArpaLm &Lm() const { return lm_; }
+
+ private:
+  typedef std::pair<int32, int32> ArcKey;
+  // The value is (next-state, logprob); next-state is -1 for final-probs.
+  typedef unordered_map<ArcKey, std::pair<int32, float>,
+                        PairHasher<int32> > ArcMapType;
+  typedef unordered_map<std::vector<int32>, int32,
+                        VectorHasher<int32> > HistoryMapType;
+
+  struct ArcStripe {
+    mutable Mutex mutex;
+    ArcMapType arcs;
+    int64 num_lookups;
+    int64 num_hits;
+    ArcStripe(): num_lookups(0), num_hits(0) { }
+  };
+  struct HistoryStripe {
+    mutable Mutex mutex;
+    HistoryMapType wseq_to_index;
+    // The word-sequences of the states in this stripe, indexed by
+    // state / num_stripes_.
+    std::vector<std::vector<int32> > index_to_wseq;
+  };
+
+  ArcStripe *GetArcStripe(int32 state, int32 word) const {
+    size_t h = static_cast<size_t>(state) * 7853 + static_cast<size_t>(word);
+    return arc_stripes_[h % num_stripes_];
+  }
+
+  // Looks up (state, word) in the arc table; returns true if found.  Also
+  // updates the statistics.
+  bool LookupArc(int32 state, int32 word, std::pair<int32, float> *value);
+
+  void InsertArc(int32 state, int32 word, const std::pair<int32, float> &value);
+
+  // Returns the state for this history, creating it if necessary.
+  int32 GetState(const std::vector<int32> &wseq);
+
+  // Outputs the history of this state.
+  void GetHistory(int32 state, std::vector<int32> *wseq) const;
+
+  const ConstArpaLm &lm_;
+  int32 num_stripes_;
+  size_t max_arcs_per_stripe_;
+  int32 start_state_;
+  std::vector<ArcStripe*> arc_stripes_;
+  std::vector<HistoryStripe*> history_stripes_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ConstArpaLmCache);
+};
+
+
+/**
+ This class wraps a ConstArpaLmCache with the interface defined in
+ DeterministicOnDemandFst.  It has no state of its own, so it is cheap to create
+ one per lattice, and the state numbers are those of the cache.
+ */
+class ConstArpaLmCachedDeterministicFst :
+    public fst::DeterministicOnDemandFst<fst::StdArc> {
+ public:
+  typedef fst::StdArc::Weight Weight;
+  typedef fst::StdArc::StateId StateId;
+  typedef fst::StdArc::Label Label;
+
+  explicit ConstArpaLmCachedDeterministicFst(ConstArpaLmCache *cache):
+      cache_(cache) { }
+
+  virtual StateId Start() { return cache_->Start(); }
+
+  virtual Weight Final(StateId s) { return Weight(-cache_->FinalLogprob(s)); }
+
+  virtual bool GetArc(StateId s, Label ilabel, fst::StdArc* oarc);
+
+ private:
+  ConstArpaLmCache *cache_;
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_LM_CONST_ARPA_LM_CACHE_H_
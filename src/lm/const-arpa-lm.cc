@@ -17,6 +17,8 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <cstring>
+#include <fstream>
 #include <sstream>
 
 #include "lm/const-arpa-lm.h"
@@ -147,6 +149,7 @@ class ConstArpaLmBuilder {
     lm_states_size_ = 0;
     max_address_offset_ = pow(2, 30) - 1;
     is_built_ = false;
+    mappable_ = false;
     lm_states_ = NULL;
     unigram_states_ = NULL;
     overflow_buffer_ = NULL; 
@@ -180,6 +183,9 @@ class ConstArpaLmBuilder {
     max_address_offset_ = max_address_offset;
   }
 
+  // If true, Write() uses the layout that ConstArpaLm::Map() accepts.
+  void SetMappable(bool mappable) { mappable_ = mappable; }
+
  private:
   // If true, use natural base e for log-prob, otherwise use base 10. The
   // default base in Arpa format language model is base 10.
@@ -188,6 +194,9 @@ class ConstArpaLmBuilder {
   // Indicating if ConstArpaLm has been built or not.
   bool is_built_;
 
+  // If true, write ConstArpaLm in the mappable layout.
+  bool mappable_;
+
   // Maximum relative address for the child. We put it here just for testing.
   // The default value is 30-bits and should not be changed except for testing.
   int32 max_address_offset_;
@@ -544,7 +553,121 @@ void ConstArpaLmBuilder::Write(std::ostream &os, bool binary) const {
   ConstArpaLm const_arpa_lm(bos_symbol_, eos_symbol_, unk_symbol_, ngram_order_,
                             num_words_, overflow_buffer_size_, lm_states_size_,
                             unigram_states_, overflow_buffer_, lm_states_);
-  const_arpa_lm.Write(os, binary);
+  if (mappable_)
+    const_arpa_lm.WriteMappable(os);
+  else
+    const_arpa_lm.Write(os, binary);
+}
+
+// The header of the mappable layout of ConstArpaLm, which is written as raw
+// bytes.  The offsets are in bytes from the start of the header.
+struct ConstArpaLmMappedHeader {
+  char magic[24];  // "<ConstArpaLmMapped>", padded with zeros.
+  int32 byte_order;  // kConstArpaLmByteOrder, to detect a byte-order mismatch.
+  int32 bos_symbol;
+  int32 eos_symbol;
+  int32 unk_symbol;
+  int32 ngram_order;
+  int32 num_words;
+  int32 overflow_buffer_size;
+  int32 lm_states_size;
+  int64 lm_states_offset;  // int32 [lm_states_size]
+  int64 unigram_offset;  // int64 [num_words]; as in Write(), 0 for NULL and
+                         // otherwise the index into lm_states plus one.
+  int64 overflow_offset;  // int64 [overflow_buffer_size], like unigram_offset.
+  int64 total_size;
+};
+
+static const char *kConstArpaLmMagic = "<ConstArpaLmMapped>";
+static const int32 kConstArpaLmByteOrder = 0x01020304;
+
+// Kaldi's binary-mode header ("\0B") is written before the object by
+// WriteKaldiObject(); we place the LmStates at a page boundary of the file
+// (and the int64 arrays at 8-byte boundaries) on that assumption.
+static const int64 kKaldiBinaryHeaderSize = 2;
+
+static int64 AlignedOffset(int64 offset, int64 alignment) {
+  int64 file_offset = offset + kKaldiBinaryHeaderSize;
+  file_offset = (file_offset + alignment - 1) / alignment * alignment;
+  return file_offset - kKaldiBinaryHeaderSize;
+}
+
+static void WriteZeros(std::ostream &os, int64 num_bytes) {
+  KALDI_ASSERT(num_bytes >= 0);
+  std::vector<char> zeros(num_bytes, 0);
+  if (num_bytes > 0) os.write(&(zeros[0]), num_bytes);
+}
+
+static void SkipBytes(std::istream &is, int64 num_bytes) {
+  KALDI_ASSERT(num_bytes >= 0);
+  is.ignore(num_bytes);
+}
+
+void ConstArpaLm::WriteMappable(std::ostream &os) const {
+  KALDI_ASSERT(initialized_);
+  ConstArpaLmMappedHeader header;
+  memset(&header, 0, sizeof(header));
+  strncpy(header.magic, kConstArpaLmMagic, sizeof(header.magic));
+  header.byte_order = kConstArpaLmByteOrder;
+  header.bos_symbol = bos_symbol_;
+  header.eos_symbol = eos_symbol_;
+  header.unk_symbol = unk_symbol_;
+  header.ngram_order = ngram_order_;
+  header.num_words = num_words_;
+  header.overflow_buffer_size = overflow_buffer_size_;
+  header.lm_states_size = lm_states_size_;
+  header.lm_states_offset = AlignedOffset(sizeof(header), 4096);
+  header.unigram_offset = AlignedOffset(
+      header.lm_states_offset + sizeof(int32) * lm_states_size_, 8);
+  header.overflow_offset = AlignedOffset(
+      header.unigram_offset + sizeof(int64) * num_words_, 8);
+  header.total_size = header.overflow_offset +
+      sizeof(int64) * overflow_buffer_size_;
+
+  std::vector<int64> unigram_offsets(num_words_), overflow_offsets(
+      overflow_buffer_size_);
+  // See ConstArpaLm::Write() for the "relative address".
+  for (int32 i = 0; i < num_words_; ++i)
+    unigram_offsets[i] = (unigram_states_[i] == NULL) ? 0 :
+        unigram_states_[i] - lm_states_ + 1;
+  for (int32 i = 0; i < overflow_buffer_size_; ++i)
+    overflow_offsets[i] = (overflow_buffer_[i] == NULL) ? 0 :
+        overflow_buffer_[i] - lm_states_ + 1;
+
+  os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  WriteZeros(os, header.lm_states_offset - sizeof(header));
+  os.write(reinterpret_cast<const char*>(lm_states_),
+           sizeof(int32) * lm_states_size_);
+  WriteZeros(os, header.unigram_offset - header.lm_states_offset -
+             sizeof(int32) * lm_states_size_);
+  if (num_words_ > 0)
+    os.write(reinterpret_cast<const char*>(&(unigram_offsets[0])),
+             sizeof(int64) * num_words_);
+  WriteZeros(os, header.overflow_offset - header.unigram_offset -
+             sizeof(int64) * num_words_);
+  if (overflow_buffer_size_ > 0)
+    os.write(reinterpret_cast<const char*>(&(overflow_offsets[0])),
+             sizeof(int64) * overflow_buffer_size_);
+  if (os.fail())
+    KALDI_ERR << "Error writing ConstArpaLm.";
+}
+
+// Checks the header of the mappable layout, and dies if it is inconsistent.
+static void CheckMappedHeader(const ConstArpaLmMappedHeader &header) {
+  if (header.byte_order != kConstArpaLmByteOrder)
+    KALDI_ERR << "ConstArpaLm was written in the mappable layout on a machine "
+              << "with a different byte order; convert it with "
+              << "const-arpa-copy --mappable=false on that machine.";
+  if (header.lm_states_size < 0 || header.num_words < 0 ||
+      header.overflow_buffer_size < 0 ||
+      header.lm_states_offset < static_cast<int64>(sizeof(header)) ||
+      header.unigram_offset < header.lm_states_offset +
+      static_cast<int64>(sizeof(int32)) * header.lm_states_size ||
+      header.overflow_offset < header.unigram_offset +
+      static_cast<int64>(sizeof(int64)) * header.num_words ||
+      header.total_size < header.overflow_offset +
+      static_cast<int64>(sizeof(int64)) * header.overflow_buffer_size)
+    KALDI_ERR << "Corrupted header in mappable ConstArpaLm.";
 }
 
 void ConstArpaLm::Write(std::ostream &os, bool binary) const {
@@ -602,6 +725,11 @@ void ConstArpaLm::Read(std::istream &is, bool binary) {
     KALDI_ERR << "text-mode reading is not implemented for ConstArpaLm.";
   }
 
+  if (is.peek() == kConstArpaLmMagic[0]) {
+    ReadMappable(is);
+    return;
+  }
+
   // Misc info.
   ReadBasicType(is, binary, &bos_symbol_);
   ReadBasicType(is, binary, &eos_symbol_);
@@ -648,6 +776,117 @@ void ConstArpaLm::Read(std::istream &is, bool binary) {
   initialized_ = true;;
 }
 
+void ConstArpaLm::ReadMappable(std::istream &is) {
+  ConstArpaLmMappedHeader header;
+  is.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (is.fail() || strncmp(header.magic, kConstArpaLmMagic,
+                           sizeof(header.magic)) != 0)
+    KALDI_ERR << "Error reading header of mappable ConstArpaLm.";
+  CheckMappedHeader(header);
+  SetFromMappedHeader(header);
+
+  lm_states_ = new int32[lm_states_size_];
+  std::vector<int64> unigram_offsets(num_words_), overflow_offsets(
+      overflow_buffer_size_);
+  SkipBytes(is, header.lm_states_offset - sizeof(header));
+  is.read(reinterpret_cast<char*>(lm_states_),
+          sizeof(int32) * lm_states_size_);
+  SkipBytes(is, header.unigram_offset - header.lm_states_offset -
+            sizeof(int32) * lm_states_size_);
+  if (num_words_ > 0)
+    is.read(reinterpret_cast<char*>(&(unigram_offsets[0])),
+            sizeof(int64) * num_words_);
+  SkipBytes(is, header.overflow_offset - header.unigram_offset -
+            sizeof(int64) * num_words_);
+  if (overflow_buffer_size_ > 0)
+    is.read(reinterpret_cast<char*>(&(overflow_offsets[0])),
+            sizeof(int64) * overflow_buffer_size_);
+  if (is.fail()) {
+    delete[] lm_states_;
+    lm_states_ = NULL;
+    KALDI_ERR << "Error reading mappable ConstArpaLm.";
+  }
+  SetPointers(unigram_offsets.empty() ? NULL : &(unigram_offsets[0]),
+              overflow_offsets.empty() ? NULL : &(overflow_offsets[0]));
+}
+
+bool ConstArpaLm::Map(const std::string &filename, bool huge_pages) {
+  KALDI_ASSERT(!initialized_);
+  if (ClassifyRxfilename(filename) != kFileInput)
+    return false;
+  {  // Look at the start of the file before mapping it.
+    std::ifstream is(filename.c_str(), std::ios::binary);
+    char buf[kKaldiBinaryHeaderSize + sizeof(ConstArpaLmMappedHeader)];
+    if (!is.read(buf, sizeof(buf)) || buf[0] != '\0' || buf[1] != 'B' ||
+        strncmp(buf + kKaldiBinaryHeaderSize, kConstArpaLmMagic,
+                sizeof(ConstArpaLmMappedHeader().magic)) != 0)
+      return false;
+  }
+  if (!mapped_file_.Open(filename))
+    return false;
+  const char *base = mapped_file_.Data() + kKaldiBinaryHeaderSize;
+  ConstArpaLmMappedHeader header;
+  memcpy(&header, base, sizeof(header));
+  CheckMappedHeader(header);
+  if (header.total_size + kKaldiBinaryHeaderSize >
+      static_cast<int64>(mapped_file_.Size()))
+    KALDI_ERR << "Mappable ConstArpaLm in " << filename << " is truncated.";
+  if ((reinterpret_cast<size_t>(base + header.unigram_offset) % 8 != 0) ||
+      (reinterpret_cast<size_t>(base + header.overflow_offset) % 8 != 0)) {
+    // Only happens if the file was not written by WriteKaldiObject().
+    KALDI_WARN << "Mappable ConstArpaLm in " << filename << " is not aligned; "
+               << "reading it instead of mapping it.";
+    mapped_file_.Close();
+    return false;
+  }
+  mapped_file_.Advise(true, huge_pages);
+  SetFromMappedHeader(header);
+  // The mapping is read-only; nothing in this class writes to <lm_states_>
+  // once the model is initialized.
+  lm_states_ = reinterpret_cast<int32*>(
+      const_cast<char*>(base + header.lm_states_offset));
+  SetPointers(reinterpret_cast<const int64*>(base + header.unigram_offset),
+              reinterpret_cast<const int64*>(base + header.overflow_offset));
+  return true;
+}
+
+void ConstArpaLm::SetFromMappedHeader(const ConstArpaLmMappedHeader &header) {
+  bos_symbol_ = header.bos_symbol;
+  eos_symbol_ = header.eos_symbol;
+  unk_symbol_ = header.unk_symbol;
+  ngram_order_ = header.ngram_order;
+  num_words_ = header.num_words;
+  overflow_buffer_size_ = header.overflow_buffer_size;
+  lm_states_size_ = header.lm_states_size;
+}
+
+void ConstArpaLm::SetPointers(const int64 *unigram_offsets,
+                              const int64 *overflow_offsets) {
+  // Check out how we compute the relative address in ConstArpaLm::Write().
+  unigram_states_ = new int32*[num_words_];
+  for (int32 i = 0; i < num_words_; ++i) {
+    KALDI_ASSERT(unigram_offsets[i] >= 0 &&
+                 unigram_offsets[i] <= lm_states_size_);
+    unigram_states_[i] = (unigram_offsets[i] == 0) ? NULL :
+        lm_states_ + unigram_offsets[i] - 1;
+  }
+  overflow_buffer_ = new int32*[overflow_buffer_size_];
+  for (int32 i = 0; i < overflow_buffer_size_; ++i) {
+    KALDI_ASSERT(overflow_offsets[i] >= 0 &&
+                 overflow_offsets[i] <= lm_states_size_);
+    overflow_buffer_[i] = (overflow_offsets[i] == 0) ? NULL :
+        lm_states_ + overflow_offsets[i] - 1;
+  }
+  KALDI_ASSERT(ngram_order_ > 0);
+  KALDI_ASSERT(bos_symbol_ < num_words_ && bos_symbol_ > 0);
+  KALDI_ASSERT(eos_symbol_ < num_words_ && eos_symbol_ > 0);
+  KALDI_ASSERT(unk_symbol_ < num_words_ &&
+               (unk_symbol_ > 0 || unk_symbol_ == -1));
+  lm_states_end_ = lm_states_ + lm_states_size_ - 1;
+  memory_assigned_ = true;
+  initialized_ = true;
+}
+
 bool ConstArpaLm::HistoryStateExists(const std::vector<int32>& hist) const {
   // We do not create LmState for empty word sequence, but technically it is the
   // history state of all unigrams.
@@ -998,13 +1237,24 @@ bool ConstArpaLmDeterministicFst::GetArc(StateId s,
 bool BuildConstArpaLm(const bool natural_base, const int32 bos_symbol,
                       const int32 eos_symbol, const int32 unk_symbol,
                       const std::string& arpa_rxfilename,
-                      const std::string& const_arpa_wxfilename) {
+                      const std::string& const_arpa_wxfilename,
+                      const bool mappable) {
   ConstArpaLmBuilder lm_builder(natural_base, bos_symbol,
                                 eos_symbol, unk_symbol);
   ReadKaldiObject(arpa_rxfilename, &lm_builder);
   lm_builder.Build();
+  lm_builder.SetMappable(mappable);
   WriteKaldiObject(lm_builder, const_arpa_wxfilename, true);
   return true;
 }
 
+void ReadConstArpaLm(const std::string &lm_rxfilename, bool use_mmap,
+                     bool huge_pages, ConstArpaLm *lm) {
+  if (use_mmap && lm->Map(lm_rxfilename, huge_pages)) {
+    KALDI_VLOG(1) << "Memory-mapped ConstArpaLm from " << lm_rxfilename;
+    return;
+  }
+  ReadKaldiObject(lm_rxfilename, lm);
+}
+
 } // namespace kaldi
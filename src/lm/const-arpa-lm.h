@@ -23,12 +23,16 @@
 #include "base/kaldi-common.h"
 #include "fstext/deterministic-fst.h"
 #include "util/common-utils.h"
+#include "util/mapped-file.h"
 
 namespace kaldi {
 
 // Forward declaration of Auxiliary struct ArpaLine.
 struct ArpaLine;
 
+// Forward declaration of the header of the mappable layout.
+struct ConstArpaLmMappedHeader;
+
 class ConstArpaLm {
  public:
 
@@ -69,18 +73,38 @@ class ConstArpaLm {
 
   ~ConstArpaLm() {
     if (memory_assigned_) {
-      delete[] lm_states_;
+      if (!mapped_file_.IsOpen())
+        delete[] lm_states_;
       delete[] unigram_states_;
       delete[] overflow_buffer_;
     }
   }
 
-  // Reads the ConstArpaLm format language model.
+  // Reads the ConstArpaLm format language model, in either the normal or the
+  // mappable layout (see WriteMappable()).
   void Read(std::istream &is, bool binary);
 
   // Writes the language model in ConstArpaLm format.
   void Write(std::ostream &os, bool binary) const;
 
+  // Writes the language model in the "mappable" layout, in which the LmStates
+  // are stored as a plain array, so that Map() can use the file contents
+  // directly instead of reading them.  The layout is not portable between
+  // machines with different byte orders.  The data is aligned for the case
+  // where the model is written after Kaldi's binary-mode header, as by
+  // WriteKaldiObject(); Read() accepts it regardless.
+  void WriteMappable(std::ostream &os) const;
+
+  // Memory-maps a file written in the mappable layout (by WriteKaldiObject()
+  // with the ConstArpaLmBuilder or with const-arpa-copy), instead of reading
+  // it.  The LmStates stay in the file mapping, so loading is nearly instant
+  // and all processes on a machine that map the same file share one copy in
+  // the page cache.  If "huge_pages" is true, asks for the mapping to be
+  // backed by huge pages (see MappedFile::Advise()).  Returns false if
+  // "filename" is not an ordinary file in the mappable layout, in which case
+  // it should be read normally.
+  bool Map(const std::string &filename, bool huge_pages = false);
+
   // Creates Arpa format language model from ConstArpaLm format, and writes it
   // to output stream. This will be useful in testing.
   void WriteArpa(std::ostream &os) const;
@@ -128,14 +152,28 @@ class ConstArpaLm {
   void DecodeChildInfo(const int32 child_info, int32* parent,
                        int32** child_lm_state, float* logprob) const;
 
+  // Reads the mappable layout into memory; called from Read().
+  void ReadMappable(std::istream &is);
+
+  // Sets the sizes and symbols from the header of the mappable layout.
+  void SetFromMappedHeader(const ConstArpaLmMappedHeader &header);
+
+  // Given <lm_states_>, creates <unigram_states_> and <overflow_buffer_> from
+  // the relative addresses (as in Write()), and checks the model.
+  void SetPointers(const int64 *unigram_offsets,
+                   const int64 *overflow_offsets);
+
   void WriteArpaRecurse(int32* lm_state,
                         const std::vector<int32>& seq,
                         std::vector<ArpaLine> *output) const;
 
-  // We assign memory in Read(). If it is called, we have to release memory in
-  // the destructor.
+  // We assign memory in Read() and Map(). If it is called, we have to release
+  // memory in the destructor.
   bool memory_assigned_;
 
+  // The file that <lm_states_> points into, if we were loaded by Map().
+  MappedFile mapped_file_;
+
   // Makes sure that the language model has been loaded before using it.
   bool initialized_;
 
@@ -229,11 +267,19 @@ class ConstArpaLmDeterministicFst :
 
 // Reads in an Arpa format language model and converts it into ConstArpaLm
 // format. We assume that the words in the input Arpa format language model have
-// been converted into integers.
+// been converted into integers. If <mappable> is true, the output is written in
+// the layout that ConstArpaLm::Map() accepts.
 bool BuildConstArpaLm(const bool natural_base, const int32 bos_symbol,
                       const int32 eos_symbol, const int32 unk_symbol,
                       const std::string& arpa_rxfilename,
-                      const std::string& const_arpa_wxfilename);
+                      const std::string& const_arpa_wxfilename,
+                      const bool mappable = false);
+
+// Loads a ConstArpaLm format language model: if <use_mmap> is true and
+// <lm_rxfilename> is an ordinary file in the mappable layout, it is
+// memory-mapped (see ConstArpaLm::Map()), otherwise it is read as usual.
+void ReadConstArpaLm(const std::string &lm_rxfilename, bool use_mmap,
+                     bool huge_pages, ConstArpaLm *lm);
 
 } // namespace kaldi
 
@@ -29,6 +29,7 @@
 #include <string>
 #include <sstream>
 #include "lm/kaldi-lm.h"
+#include "lm/const-arpa-lm.h"
 
 namespace kaldi {
 
@@ -298,6 +299,79 @@ bool TestLmTableEvalScore(const string &inpfile,
   return success;
 }
 
+/// @brief Tests the mappable layout of ConstArpaLm: the model is built from a
+/// small integerized Arpa file in both layouts, and the mappable one is loaded
+/// with Map() and with Read() (which uses ReadMappable()).  All of them must
+/// give the n-gram scores of the Arpa file, and the same scores as each other
+/// for every n-gram up to the order of the model.
+bool TestConstArpaLmMappable(const string &arpa_file,
+                             const string &normal_file,
+                             const string &mappable_file) {
+  // This is input.arpa with the words as integers, <s> = 1, </s> = 2, a = 3,
+  // b = 4, plus <unk> = 5.
+  {
+    std::ofstream os(arpa_file.c_str());
+    os << "\n\\data\\\nngram 1=5\nngram 2=2\nngram 3=2\n\n"
+       << "\\1-grams:\n-5.234679\t3\t-3.3\n-3.456783\t4\n"
+       << "0.0000000\t1\t-2.5\n-4.333333\t2\n-6.000000\t5\n\n"
+       << "\\2-grams:\n-1.45678\t3 4\t-3.23\n-1.30490\t1 3\t-4.2\n\n"
+       << "\\3-grams:\n-0.34958\t1 3 4\n-0.23940\t3 4 2\n\n\\end\\\n";
+  }
+  int32 bos = 1, eos = 2, unk = 5, num_words = 6;
+  BuildConstArpaLm(false, bos, eos, unk, arpa_file, normal_file, false);
+  BuildConstArpaLm(false, bos, eos, unk, arpa_file, mappable_file, true);
+
+  ConstArpaLm normal_lm, mapped_lm, read_lm, unmapped_lm;
+  ReadKaldiObject(normal_file, &normal_lm);
+  ReadKaldiObject(mappable_file, &read_lm);
+  bool success = mapped_lm.Map(mappable_file);
+  // Map() refuses the normal layout, which then has to be read.
+  success = success && !unmapped_lm.Map(normal_file);
+
+  // The n-grams of the Arpa file (history words, 0 for none, then the word)
+  // and their log-probs.
+  int32 ngrams[][3] = { {0, 0, 3}, {0, 0, 4}, {0, 0, 2}, {0, 0, 5},
+                        {0, 3, 4}, {0, 1, 3}, {1, 3, 4}, {3, 4, 2} };
+  float logprobs[] = { -5.234679, -3.456783, -4.333333, -6.0,
+                       -1.45678, -1.30490, -0.34958, -0.23940 };
+  ConstArpaLm *lms[] = { &normal_lm, &mapped_lm, &read_lm };
+  for (size_t i = 0; i < sizeof(logprobs) / sizeof(logprobs[0]); i++) {
+    std::vector<int32> hist;
+    for (int32 j = 0; j < 2; j++)
+      if (ngrams[i][j] != 0) hist.push_back(ngrams[i][j]);
+    for (int32 j = 0; j < 3; j++)
+      if (!ApproxEqual(lms[j]->GetNgramLogprob(ngrams[i][2], hist),
+                       logprobs[i]))
+        success = false;
+  }
+
+  // Every n-gram, including ones that back off and out-of-vocabulary words,
+  // must score exactly the same in all of the models.
+  for (int32 h1 = -1; h1 <= num_words; h1++) {
+    for (int32 h2 = -1; h2 <= num_words; h2++) {
+      if (h1 != -1 && h2 == -1) continue;
+      std::vector<int32> hist;
+      if (h1 != -1) hist.push_back(h1);
+      if (h2 != -1) hist.push_back(h2);
+      for (int32 word = 1; word <= num_words; word++) {
+        float logprob = normal_lm.GetNgramLogprob(word, hist);
+        if (mapped_lm.GetNgramLogprob(word, hist) != logprob ||
+            read_lm.GetNgramLogprob(word, hist) != logprob ||
+            mapped_lm.HistoryStateExists(hist) !=
+            normal_lm.HistoryStateExists(hist))
+          success = false;
+      }
+    }
+  }
+  std::cout << "ConstArpaLm test: mappable layout "
+            << (success ? "PASSED" : "FAILED") << '\n';
+
+  unlink(arpa_file.c_str());
+  unlink(normal_file.c_str());
+  unlink(mappable_file.c_str());
+  return success;
+}
+
 }  // end namespace kaldi
 
 int main(int argc, char *argv[]) {
@@ -337,6 +411,10 @@ int main(int argc, char *argv[]) {
                                            refscore.str());
   }
 
+  success &= kaldi::TestConstArpaLmMappable("input.int.arpa",
+                                            "const_arpa.normal",
+                                            "const_arpa.mappable");
+
   unlink("output.fst");
 
   exit(success ? 0 : 1);
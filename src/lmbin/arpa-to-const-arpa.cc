@@ -37,6 +37,8 @@ int main(int argc, char *argv[]) {
         "ConstArpaLm format language model. We first map the words in an Arpa\n"
         "format language model to integers using utils/map_arpa_m.pl, and\n"
         "then use this program to build a ConstArpaLm format language model.\n"
+        "With --mappable=true the output can be memory-mapped by the programs\n"
+        "that read it, instead of being read into memory.\n"
         "\n"
         "Usage: arpa-to-const-arpa [opts] <input-arpa> <const-arpa>\n"
         " e.g.: arpa-to-const-arpa --bos-symbol=1 --eos-symbol=2 \\\n"
@@ -48,6 +50,7 @@ int main(int argc, char *argv[]) {
     int32 unk_symbol = -1;
     int32 bos_symbol = -1;
     int32 eos_symbol = -1;
+    bool mappable = false;
     po.Register("natural-base", &natural_base,
                 "If true, use log-base e instead of log-base 10.");
     po.Register("unk-symbol", &unk_symbol,
@@ -59,6 +62,10 @@ int main(int argc, char *argv[]) {
     po.Register("eos-symbol", &eos_symbol,
                 "Integer corresponds to </s>. You must set this to your actual "
                 "EOS integer.");
+    po.Register("mappable", &mappable,
+                "If true, write the language model in the layout that can be "
+                "memory-mapped (not portable between machines with different "
+                "byte orders).");
 
     po.Read(argc, argv);
 
@@ -77,7 +84,8 @@ int main(int argc, char *argv[]) {
 
     bool ans = BuildConstArpaLm(natural_base, bos_symbol,
                                 eos_symbol, unk_symbol,
-                                arpa_rxfilename, const_arpa_wxfilename);
+                                arpa_rxfilename, const_arpa_wxfilename,
+                                mappable);
 
     if (ans)
       return 0;
@@ -0,0 +1,69 @@
+// lmbin/const-arpa-copy.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+
+#include "lm/const-arpa-lm.h"
+#include "util/common-utils.h"
+
+int main(int argc, char *argv[]) {
+  using namespace kaldi;
+  try {
+    const char *usage  =
+        "Copies a ConstArpaLm format language model, converting it to or from\n"
+        "the layout that can be memory-mapped (by lattice-lmrescore-const-arpa\n"
+        "and other programs that read ConstArpaLm), so that existing models do\n"
+        "not have to be rebuilt from the Arpa file.\n"
+        "\n"
+        "Usage: const-arpa-copy [opts] <const-arpa-in> <const-arpa-out>\n"
+        " e.g.: const-arpa-copy --mappable=true G.carpa G.mapped.carpa\n";
+
+    ParseOptions po(usage);
+
+    bool mappable = true;
+    po.Register("mappable", &mappable,
+                "If true, write the mappable layout; otherwise the normal one.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string const_arpa_rxfilename = po.GetArg(1),
+        const_arpa_wxfilename = po.GetArg(2);
+
+    ConstArpaLm const_arpa;
+    ReadKaldiObject(const_arpa_rxfilename, &const_arpa);
+
+    Output ko(const_arpa_wxfilename, true);
+    if (mappable)
+      const_arpa.WriteMappable(ko.Stream());
+    else
+      const_arpa.Write(ko.Stream(), true);
+    KALDI_LOG << "Wrote ConstArpaLm in the " << (mappable ? "mappable" :
+                                                  "normal")
+              << " layout to " << const_arpa_wxfilename;
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return -1;
+  }
+}
@@ -0,0 +1,193 @@
+// lmbin/const-arpa-lm-cache-bench.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+#include "lm/const-arpa-lm.h"
+#include "lm/const-arpa-lm-cache.h"
+#include "thread/kaldi-thread.h"
+#include "util/common-utils.h"
+
+namespace kaldi {
+
+// Each thread takes every num_threads_'th sentence and walks through it in the
+// LM, as the composition in lattice-lmrescore-const-arpa would for a lattice
+// with that best path: at each word it also looks up "branching" other words
+// from the data, as for the alternative arcs of a lattice, and at the end it
+// looks up the final-prob.  If "cache" is NULL it uses a
+// ConstArpaLmDeterministicFst per sentence, as the rescoring does without the
+// cache.
+class ConstArpaLmBenchClass: public MultiThreadable {
+ public:
+  ConstArpaLmBenchClass(const ConstArpaLm &lm, ConstArpaLmCache *cache,
+                        const std::vector<std::vector<int32> > &sentences,
+                        const std::vector<int32> &vocab, int32 branching,
+                        int32 num_repeats, int64 *tot_lookups):
+      lm_(lm), cache_(cache), sentences_(sentences), vocab_(vocab),
+      branching_(branching), num_repeats_(num_repeats),
+      tot_lookups_ptr_(tot_lookups), tot_lookups_(0) { }
+
+  ~ConstArpaLmBenchClass() { *tot_lookups_ptr_ += tot_lookups_; }
+
+  void operator () () {
+    RandomState rand_state;
+    for (int32 r = 0; r < num_repeats_; r++) {
+      for (size_t i = thread_id_; i < sentences_.size(); i += num_threads_) {
+        if (cache_ != NULL) {
+          ConstArpaLmCachedDeterministicFst lm_fst(cache_);
+          ProcessSentence(sentences_[i], &lm_fst, &rand_state);
+        } else {
+          ConstArpaLmDeterministicFst lm_fst(lm_);
+          ProcessSentence(sentences_[i], &lm_fst, &rand_state);
+        }
+      }
+    }
+  }
+
+ private:
+  void ProcessSentence(const std::vector<int32> &sentence,
+                       fst::DeterministicOnDemandFst<fst::StdArc> *lm_fst,
+                       RandomState *rand_state) {
+    fst::StdArc::StateId s = lm_fst->Start();
+    fst::StdArc arc;
+    for (size_t j = 0; j < sentence.size(); j++) {
+      for (int32 b = 0; b < branching_; b++) {
+        int32 word = vocab_[RandInt(0, vocab_.size() - 1, rand_state)];
+        lm_fst->GetArc(s, word, &arc);
+        tot_lookups_++;
+      }
+      tot_lookups_++;
+      if (!lm_fst->GetArc(s, sentence[j], &arc))
+        return;  // No probability for this word (the LM has no <unk>).
+      s = arc.nextstate;
+    }
+    lm_fst->Final(s);
+    tot_lookups_++;
+  }
+
+  const ConstArpaLm &lm_;
+  ConstArpaLmCache *cache_;
+  const std::vector<std::vector<int32> > &sentences_;
+  const std::vector<int32> &vocab_;
+  int32 branching_;
+  int32 num_repeats_;
+  int64 *tot_lookups_ptr_;
+  int64 tot_lookups_;
+};
+
+}  // namespace kaldi
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+    typedef kaldi::int64 int64;
+
+    const char *usage =
+        "Measures the speed of n-gram lookups in a ConstArpaLm format language\n"
+        "model, with and without the ConstArpaLmCache that\n"
+        "lattice-lmrescore-const-arpa shares between lattices and threads.\n"
+        "Each sentence of the integer text is walked through in the LM, with\n"
+        "--branching extra lookups per word to imitate the alternative arcs\n"
+        "of a lattice.  Prints the lookups per second of both methods and\n"
+        "the hit rate of the cache.\n"
+        "\n"
+        "Usage: const-arpa-lm-cache-bench [options] <const-arpa-in> "
+        "<int-text-rspecifier>\n"
+        " e.g.: const-arpa-lm-cache-bench --num-threads=8 G.carpa \\\n"
+        "   'ark:utils/sym2int.pl -f 2- words.txt data/dev/text |'\n";
+
+    ParseOptions po(usage);
+    int32 branching = 4, num_repeats = 1, cache_size = 1000000;
+    po.Register("branching", &branching, "Number of extra lookups of random "
+                "words at each position of a sentence");
+    po.Register("num-repeats", &num_repeats, "Number of times each thread "
+                "goes through its sentences");
+    po.Register("cache-size", &cache_size, "Maximum number of n-gram lookups "
+                "in the cache");
+    po.Register("num-threads", &g_num_threads, "Number of threads to use.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string lm_rxfilename = po.GetArg(1),
+        text_rspecifier = po.GetArg(2);
+
+    ConstArpaLm const_arpa;
+    {
+      Timer timer;
+      ReadConstArpaLm(lm_rxfilename, true, false, &const_arpa);
+      KALDI_LOG << "Loaded the " << const_arpa.NgramOrder() << "-gram LM in "
+                << timer.Elapsed() << " seconds.";
+    }
+
+    std::vector<std::vector<int32> > sentences;
+    std::vector<int32> vocab;
+    SequentialInt32VectorReader text_reader(text_rspecifier);
+    for (; !text_reader.Done(); text_reader.Next()) {
+      const std::vector<int32> &sentence = text_reader.Value();
+      sentences.push_back(sentence);
+      vocab.insert(vocab.end(), sentence.begin(), sentence.end());
+    }
+    SortAndUniq(&vocab);
+    if (vocab.empty())
+      KALDI_ERR << "No words were read from " << text_rspecifier;
+
+    double uncached_speed, cached_speed;
+    {
+      int64 tot_lookups = 0;
+      Timer timer;
+      ConstArpaLmBenchClass c(const_arpa, NULL, sentences, vocab, branching,
+                              num_repeats, &tot_lookups);
+      RunMultiThreaded(c);
+      double elapsed = timer.Elapsed();
+      uncached_speed = tot_lookups / elapsed;
+      KALDI_LOG << "Without the cache: " << tot_lookups << " lookups in "
+                << elapsed << " seconds, " << uncached_speed
+                << " lookups/sec.";
+    }
+    {
+      int64 tot_lookups = 0, num_lookups, num_hits;
+      ConstArpaLmCache cache(const_arpa, cache_size);
+      Timer timer;
+      ConstArpaLmBenchClass c(const_arpa, &cache, sentences, vocab, branching,
+                              num_repeats, &tot_lookups);
+      RunMultiThreaded(c);
+      double elapsed = timer.Elapsed();
+      cached_speed = tot_lookups / elapsed;
+      cache.GetStats(&num_lookups, &num_hits);
+      KALDI_LOG << "With the cache: " << tot_lookups << " lookups in "
+                << elapsed << " seconds, " << cached_speed
+                << " lookups/sec; hit rate "
+                << (num_hits / std::max<double>(1.0, num_lookups)) << ", "
+                << cache.NumStates() << " history states.";
+    }
+    KALDI_LOG << "Speedup from the cache with " << g_num_threads
+              << " threads is " << (cached_speed / uncached_speed);
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
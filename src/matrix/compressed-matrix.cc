@@ -20,13 +20,16 @@
 
 #include "matrix/compressed-matrix.h"
 #include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace kaldi {
 
 //static 
 MatrixIndexT CompressedMatrix::DataSize(const GlobalHeader &header) {
   // Returns size in bytes of the data.
-  if (header.format == 1) {
+  if (header.format == 1 || header.format == 3) {
     return sizeof(GlobalHeader) +
         header.num_cols * (sizeof(PerColHeader) + header.num_rows);
   } else {
@@ -39,7 +42,7 @@ MatrixIndexT CompressedMatrix::DataSize(const GlobalHeader &header) {
 
 template<typename Real>
 void CompressedMatrix::CopyFromMat(
-    const MatrixBase<Real> &mat) {
+    const MatrixBase<Real> &mat, CompressionLayout layout) {
   if (data_ != NULL) {
     delete [] static_cast<float*>(data_);  // call delete [] because was allocated with new float[]
     data_ = NULL;
@@ -80,7 +83,8 @@ void CompressedMatrix::CopyFromMat(
   global_header.num_cols = mat.NumCols();
 
   if (mat.NumRows() > 8) {
-    global_header.format = 1;  // format where each row has a PerColHeader.
+    // formats where each column has a PerColHeader.
+    global_header.format = (layout == kCompressByRow ? 3 : 1);
   } else {
     global_header.format = 2;  // format where all data is uint16.
   }
@@ -91,7 +95,7 @@ void CompressedMatrix::CopyFromMat(
   
   *(reinterpret_cast<GlobalHeader*>(data_)) = global_header;
 
-  if (global_header.format == 1) {
+  if (global_header.format != 2) {
     PerColHeader *header_data =
         reinterpret_cast<PerColHeader*>(static_cast<char*>(data_) +
                                         sizeof(GlobalHeader));
@@ -99,14 +103,24 @@ void CompressedMatrix::CopyFromMat(
         reinterpret_cast<unsigned char*>(header_data + global_header.num_cols);
 
     const Real *matrix_data = mat.Data();
+    // In format 1 the bytes of each column are contiguous; in format 3, the
+    // bytes of each row.
+    int32 col_step, byte_stride;
+    if (global_header.format == 1) {
+      col_step = global_header.num_rows;
+      byte_stride = 1;
+    } else {
+      col_step = 1;
+      byte_stride = global_header.num_cols;
+    }
 
     for (int32 col = 0; col < global_header.num_cols; col++) {
       CompressColumn(global_header,
                      matrix_data + col, mat.Stride(),
                      global_header.num_rows,
-                     header_data, byte_data);
+                     header_data, byte_data, byte_stride);
       header_data++;
-      byte_data += global_header.num_rows;
+      byte_data += col_step;
     }
   } else {
     uint16 *data = reinterpret_cast<uint16*>(static_cast<char*>(data_) +
@@ -123,10 +137,12 @@ void CompressedMatrix::CopyFromMat(
 
 // Instantiate the template for float and double.
 template
-void CompressedMatrix::CopyFromMat(const MatrixBase<float> &mat);
+void CompressedMatrix::CopyFromMat(const MatrixBase<float> &mat,
+                                   CompressionLayout layout);
 
 template
-void CompressedMatrix::CopyFromMat(const MatrixBase<double> &mat);
+void CompressedMatrix::CopyFromMat(const MatrixBase<double> &mat,
+                                   CompressionLayout layout);
 
 
 CompressedMatrix::CompressedMatrix(
@@ -155,8 +171,8 @@ CompressedMatrix::CompressedMatrix(
   new_global_header.num_cols = num_cols;
   new_global_header.num_rows = num_rows;
 
-  // We don't switch format from 1 -> 2 (in case of size reduction) yet; if this
-  // is needed, we will do this below by creating a temporary Matrix.
+  // We don't switch format from 1 or 3 -> 2 (in case of size reduction) yet;
+  // if this is needed, we will do this below by creating a temporary Matrix.
   new_global_header.format = old_global_header->format;
   
   data_ = AllocateData(DataSize(new_global_header));  // allocate memory
@@ -187,6 +203,29 @@ CompressedMatrix::CompressedMatrix(
       new_start_of_col += num_rows;
       old_start_of_subcol += old_num_rows;
     }
+  } else if (old_global_header->format == 3) {
+    // As format 1, but the byte data is stored row by row.
+    PerColHeader *old_per_col_header =
+        reinterpret_cast<PerColHeader*>(old_global_header + 1);
+    unsigned char *old_byte_data =
+        reinterpret_cast<unsigned char*>(old_per_col_header +
+                                         old_global_header->num_cols);
+    PerColHeader *new_per_col_header =
+        reinterpret_cast<PerColHeader*>(
+            reinterpret_cast<GlobalHeader*>(data_) + 1);
+
+    memcpy(new_per_col_header, old_per_col_header + col_offset,
+           sizeof(PerColHeader) * num_cols);
+
+    unsigned char *new_byte_data =
+        reinterpret_cast<unsigned char*>(new_per_col_header + num_cols);
+    const unsigned char *old_start_of_subrow =
+        old_byte_data + col_offset + (row_offset * old_num_cols);
+    for (int32 i = 0; i < num_rows; i++) {
+      memcpy(new_byte_data, old_start_of_subrow, num_cols);
+      new_byte_data += num_cols;
+      old_start_of_subrow += old_num_cols;
+    }
   } else {
     // both have the new format (2).
     KALDI_ASSERT(old_global_header->format == 2);
@@ -205,8 +244,8 @@ CompressedMatrix::CompressedMatrix(
     }
   }
 
-  if (num_rows < 8 && new_global_header.format == 1) {
-    // format was 1 but we want it to be 2 -> create a temporary
+  if (num_rows < 8 && new_global_header.format != 2) {
+    // format was 1 or 3 but we want it to be 2 -> create a temporary
     // Matrix (uncompress), re-compress, and swap.
     Matrix<float> temp(this->NumRows(), this->NumCols(),
                        kUndefined);
@@ -359,10 +398,127 @@ inline unsigned char CompressedMatrix::FloatToChar(
 }
 
 
+// Uncompresses one byte, given the ranges of its column in the form computed
+// by CompressedMatrix::ComputeColRanges(): the three pieces of the piecewise
+// linear encoding start at p0, p25 and p75 and cover ranges of size d0, d1
+// and d2.  This is the same arithmetic as CompressedMatrix::CharToFloat()
+// (partly in double precision), so the results are identical.
+static inline float UncompressByte(float p0, float d0, float p25, float d1,
+                                   float p75, float d2, unsigned char value) {
+  if (value <= 64) {
+    return p0 + d0 * value * (1/64.0);
+  } else if (value <= 192) {
+    return p25 + d1 * (value - 64) * (1/128.0);
+  } else {
+    return p75 + d2 * (value - 192) * (1/63.0);
+  }
+}
+
+#ifdef __SSE2__
+// As UncompressByte(), for four values at once; "v" contains the byte values
+// converted to float.  It selects the piece for each value with masks rather
+// than branches.  Like UncompressByte(), it multiplies the range by the
+// offset within the piece in single precision and does the rest in double
+// precision, so the results are identical.
+static inline __m128 UncompressFour(__m128 v, __m128 p0, __m128 d0,
+                                    __m128 p25, __m128 d1,
+                                    __m128 p75, __m128 d2) {
+  const __m128 c64 = _mm_set1_ps(64.0f), c192 = _mm_set1_ps(192.0f);
+  const __m128d s0 = _mm_set1_pd(1/64.0), s1 = _mm_set1_pd(1/128.0),
+      s2 = _mm_set1_pd(1/63.0);
+  __m128 le64 = _mm_cmple_ps(v, c64), le192 = _mm_cmple_ps(v, c192),
+      start = _mm_or_ps(_mm_and_ps(le64, p0), _mm_andnot_ps(le64,
+          _mm_or_ps(_mm_and_ps(le192, p25), _mm_andnot_ps(le192, p75)))),
+      range = _mm_or_ps(_mm_and_ps(le64, d0), _mm_andnot_ps(le64,
+          _mm_or_ps(_mm_and_ps(le192, d1), _mm_andnot_ps(le192, d2)))),
+      offset = _mm_andnot_ps(le64, _mm_or_ps(_mm_and_ps(le192, c64),
+                                             _mm_andnot_ps(le192, c192))),
+      prod = _mm_mul_ps(range, _mm_sub_ps(v, offset));
+  // Widen the masks to 64 bits, for values 0 and 1 and then 2 and 3.
+  __m128i m64 = _mm_castps_si128(le64), m192 = _mm_castps_si128(le192);
+  __m128 ans[2];
+  for (int32 half = 0; half < 2; half++) {
+    __m128d mask64 = _mm_castsi128_pd(half == 0 ?
+                                      _mm_unpacklo_epi32(m64, m64) :
+                                      _mm_unpackhi_epi32(m64, m64)),
+        mask192 = _mm_castsi128_pd(half == 0 ?
+                                   _mm_unpacklo_epi32(m192, m192) :
+                                   _mm_unpackhi_epi32(m192, m192)),
+        scale = _mm_or_pd(_mm_and_pd(mask64, s0), _mm_andnot_pd(mask64,
+            _mm_or_pd(_mm_and_pd(mask192, s1), _mm_andnot_pd(mask192, s2)))),
+        start_d = _mm_cvtps_pd(half == 0 ? start : _mm_movehl_ps(start, start)),
+        prod_d = _mm_cvtps_pd(half == 0 ? prod : _mm_movehl_ps(prod, prod));
+    ans[half] = _mm_cvtpd_ps(_mm_add_pd(start_d, _mm_mul_pd(prod_d, scale)));
+  }
+  return _mm_movelh_ps(ans[0], ans[1]);
+}
+#endif
+
+// Uncompresses the bytes byte_data[0 .. n-1] to out[0 .. n-1].  "ranges" is
+// as computed by CompressedMatrix::ComputeColRanges().  If ranges_stride == 0,
+// all the bytes are from the same column, whose ranges are ranges[0 .. 5];
+// otherwise byte i is from column i, whose ranges are ranges[i],
+// ranges[i + ranges_stride], ..., ranges[i + 5 * ranges_stride].
+static void UncompressBytes(const float *ranges, int32 ranges_stride,
+                            const unsigned char *byte_data, int32 n,
+                            float *out) {
+  int32 i = 0;
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  if (ranges_stride == 0) {
+    __m128 p0 = _mm_set1_ps(ranges[0]), d0 = _mm_set1_ps(ranges[1]),
+        p25 = _mm_set1_ps(ranges[2]), d1 = _mm_set1_ps(ranges[3]),
+        p75 = _mm_set1_ps(ranges[4]), d2 = _mm_set1_ps(ranges[5]);
+    for (; i + 16 <= n; i += 16) {
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+          byte_data + i));
+      __m128i lo = _mm_unpacklo_epi8(b, zero), hi = _mm_unpackhi_epi8(b, zero);
+      __m128 v[4] = { _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)),
+                      _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)),
+                      _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)),
+                      _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)) };
+      for (int32 k = 0; k < 4; k++)
+        _mm_storeu_ps(out + i + 4 * k,
+                      UncompressFour(v[k], p0, d0, p25, d1, p75, d2));
+    }
+  } else {
+    const float *p0 = ranges, *d0 = ranges + ranges_stride,
+        *p25 = ranges + 2 * ranges_stride, *d1 = ranges + 3 * ranges_stride,
+        *p75 = ranges + 4 * ranges_stride, *d2 = ranges + 5 * ranges_stride;
+    for (; i + 16 <= n; i += 16) {
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+          byte_data + i));
+      __m128i lo = _mm_unpacklo_epi8(b, zero), hi = _mm_unpackhi_epi8(b, zero);
+      __m128 v[4] = { _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)),
+                      _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)),
+                      _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)),
+                      _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)) };
+      for (int32 k = 0; k < 4; k++) {
+        int32 j = i + 4 * k;
+        _mm_storeu_ps(out + j,
+                      UncompressFour(v[k], _mm_loadu_ps(p0 + j),
+                                     _mm_loadu_ps(d0 + j),
+                                     _mm_loadu_ps(p25 + j),
+                                     _mm_loadu_ps(d1 + j),
+                                     _mm_loadu_ps(p75 + j),
+                                     _mm_loadu_ps(d2 + j)));
+      }
+    }
+  }
+#endif
+  int32 step = (ranges_stride == 0 ? 1 : ranges_stride);
+  for (; i < n; i++) {
+    const float *r = ranges + (ranges_stride == 0 ? 0 : i);
+    out[i] = UncompressByte(r[0], r[step], r[2 * step], r[3 * step],
+                            r[4 * step], r[5 * step], byte_data[i]);
+  }
+}
+
 // static
 inline float CompressedMatrix::CharToFloat(
     float p0, float p25, float p75, float p100,
     unsigned char value) {
+  // UncompressByte() and UncompressFour() must give the same results as this.
   if (value <= 64) {
     return p0 + (p25 - p0) * value * (1/64.0);
   } else if (value <= 192) {
@@ -372,13 +528,31 @@ inline float CompressedMatrix::CharToFloat(
   }
 }
 
+// static
+void CompressedMatrix::ComputeColRanges(const GlobalHeader &global_header,
+                                        const PerColHeader *header,
+                                        int32 num_cols, float *ranges) {
+  for (int32 c = 0; c < num_cols; c++, header++) {
+    float p0 = Uint16ToFloat(global_header, header->percentile_0),
+        p25 = Uint16ToFloat(global_header, header->percentile_25),
+        p75 = Uint16ToFloat(global_header, header->percentile_75),
+        p100 = Uint16ToFloat(global_header, header->percentile_100);
+    ranges[c] = p0;
+    ranges[num_cols + c] = p25 - p0;
+    ranges[2 * num_cols + c] = p25;
+    ranges[3 * num_cols + c] = p75 - p25;
+    ranges[4 * num_cols + c] = p75;
+    ranges[5 * num_cols + c] = p100 - p75;
+  }
+}
+
 
 template<typename Real>  // static
 void CompressedMatrix::CompressColumn(
     const GlobalHeader &global_header,
     const Real *data, MatrixIndexT stride,
     int32 num_rows, CompressedMatrix::PerColHeader *header,
-    unsigned char *byte_data) {
+    unsigned char *byte_data, int32 byte_stride) {
   ComputeColHeader(global_header, data, stride,
                    num_rows, header);
   
@@ -389,7 +563,7 @@ void CompressedMatrix::CompressColumn(
 
   for (int32 i = 0; i < num_rows; i++) {
     Real this_data = data[i * stride];
-    byte_data[i] = FloatToChar(p0, p25, p75, p100, this_data);
+    byte_data[i * byte_stride] = FloatToChar(p0, p25, p75, p100, this_data);
   }
 }
 
@@ -407,6 +581,8 @@ void CompressedMatrix::Write(std::ostream &os, bool binary) const {
       GlobalHeader &h = *reinterpret_cast<GlobalHeader*>(data_);
       if (h.format == 1) {
         WriteToken(os, binary, "CM");
+      } else if (h.format == 3) {
+        WriteToken(os, binary, "CM3");
       } else {
         KALDI_ASSERT(h.format == 2);
         WriteToken(os, binary, "CM2");
@@ -442,13 +618,16 @@ void CompressedMatrix::Read(std::istream &is, bool binary) {
   if (binary) {
     int peekval = Peek(is, binary);
     if (peekval == 'C') {
-      std::string tok; // Should be CM (format 1) or CM2 (format 2)
+      std::string tok; // Should be CM (format 1), CM2 (format 2) or CM3
+                       // (format 3).
       ReadToken(is, binary, &tok);
       GlobalHeader h;
       if (tok == "CM") { h.format = 1; }
       else if (tok == "CM2") { h.format = 2; }
+      else if (tok == "CM3") { h.format = 3; }
       else {
-        KALDI_ERR << "Unexpected token " << tok << ", expecting CM or CM2.";
+        KALDI_ERR << "Unexpected token " << tok
+                  << ", expecting CM, CM2 or CM3.";
       }
       // don't read the "format" -> hence + 4, - 4.
       is.read(reinterpret_cast<char*>(&h) + 4, sizeof(h) - 4);
@@ -481,6 +660,77 @@ void CompressedMatrix::Read(std::istream &is, bool binary) {
     KALDI_ERR << "Failed to read data.";
 }
 
+template<typename Real>  // static
+void CompressedMatrix::ReadToMatrix(std::istream &is, Matrix<Real> *mat) {
+  std::string tok;
+  ReadToken(is, true, &tok);
+  GlobalHeader h;
+  if (tok == "CM") { h.format = 1; }
+  else if (tok == "CM2") { h.format = 2; }
+  else if (tok == "CM3") { h.format = 3; }
+  else {
+    KALDI_ERR << "Unexpected token " << tok << ", expecting CM, CM2 or CM3.";
+  }
+  // don't read the "format" -> hence + 4, - 4.
+  is.read(reinterpret_cast<char*>(&h) + 4, sizeof(h) - 4);
+  if (is.fail())
+    KALDI_ERR << "Failed to read header";
+  if (h.num_cols == 0) {  // empty matrix.
+    mat->Resize(0, 0);
+    return;
+  }
+  int32 num_rows = h.num_rows, num_cols = h.num_cols;
+  mat->Resize(num_rows, num_cols, kUndefined);
+  if (h.format == 1) {
+    std::vector<PerColHeader> per_col_header(num_cols);
+    is.read(reinterpret_cast<char*>(&(per_col_header[0])),
+            sizeof(PerColHeader) * num_cols);
+    std::vector<unsigned char> byte_data(num_rows);
+    std::vector<float> col_data(num_rows);
+    float ranges[6];
+    Real *data = mat->Data();
+    MatrixIndexT stride = mat->Stride();
+    for (int32 i = 0; i < num_cols; i++) {
+      is.read(reinterpret_cast<char*>(&(byte_data[0])), num_rows);
+      ComputeColRanges(h, &(per_col_header[i]), 1, ranges);
+      UncompressBytes(ranges, 0, &(byte_data[0]), num_rows, &(col_data[0]));
+      for (int32 j = 0; j < num_rows; j++)
+        data[j * stride + i] = col_data[j];
+    }
+  } else if (h.format == 3) {
+    std::vector<PerColHeader> per_col_header(num_cols);
+    is.read(reinterpret_cast<char*>(&(per_col_header[0])),
+            sizeof(PerColHeader) * num_cols);
+    std::vector<float> ranges(6 * num_cols), row_data(num_cols);
+    ComputeColRanges(h, &(per_col_header[0]), num_cols, &(ranges[0]));
+    std::vector<unsigned char> byte_data(num_cols);
+    for (int32 i = 0; i < num_rows; i++) {
+      is.read(reinterpret_cast<char*>(&(byte_data[0])), num_cols);
+      UncompressBytes(&(ranges[0]), num_cols, &(byte_data[0]), num_cols,
+                      &(row_data[0]));
+      Real *dest = mat->RowData(i);
+      for (int32 j = 0; j < num_cols; j++)
+        dest[j] = row_data[j];
+    }
+  } else {
+    std::vector<uint16> row_data(num_cols);
+    for (int32 i = 0; i < num_rows; i++) {
+      is.read(reinterpret_cast<char*>(&(row_data[0])),
+              sizeof(uint16) * num_cols);
+      Real *dest = mat->RowData(i);
+      for (int32 j = 0; j < num_cols; j++)
+        dest[j] = Uint16ToFloat(h, row_data[j]);
+    }
+  }
+  if (is.fail())
+    KALDI_ERR << "Failed to read data.";
+}
+
+template
+void CompressedMatrix::ReadToMatrix(std::istream &is, Matrix<float> *mat);
+template
+void CompressedMatrix::ReadToMatrix(std::istream &is, Matrix<double> *mat);
+
 template<typename Real>
 void CompressedMatrix::CopyToMat(MatrixBase<Real> *mat) const {
   if (data_ == NULL) {
@@ -492,31 +742,7 @@ void CompressedMatrix::CopyToMat(MatrixBase<Real> *mat) const {
   int32 num_cols = h->num_cols, num_rows = h->num_rows;
   KALDI_ASSERT(mat->NumRows() == num_rows);
   KALDI_ASSERT(mat->NumCols() == num_cols);
-  
-  if (h->format == 1) {
-    PerColHeader *per_col_header = reinterpret_cast<PerColHeader*>(h+1);
-    unsigned char *byte_data = reinterpret_cast<unsigned char*>(per_col_header +
-                                                                h->num_cols);
-    for (int32 i = 0; i < num_cols; i++, per_col_header++) {
-      float p0 = Uint16ToFloat(*h, per_col_header->percentile_0),
-          p25 = Uint16ToFloat(*h, per_col_header->percentile_25),
-          p75 = Uint16ToFloat(*h, per_col_header->percentile_75),
-          p100 = Uint16ToFloat(*h, per_col_header->percentile_100);
-      for (int32 j = 0; j < num_rows; j++, byte_data++) {
-        float f = CharToFloat(p0, p25, p75, p100, *byte_data);
-        (*mat)(j, i) = f;
-      }
-    }
-  } else {
-    KALDI_ASSERT(h->format == 2);
-    const uint16 *data = reinterpret_cast<const uint16*>(h + 1);
-    for (int32 i = 0; i < num_rows; i++) {
-      Real *row_data = mat->RowData(i);
-      for (int32 j = 0; j < num_cols; j++)
-        row_data[j] = Uint16ToFloat(*h, data[j]);
-      data += num_cols;
-    }
-  }
+  CopyToMat(0, 0, mat);
 }
 
 // Instantiate the template for float and double.
@@ -533,14 +759,24 @@ void CompressedMatrix::CopyRowToVec(MatrixIndexT row,
   KALDI_ASSERT(v->Dim() == this->NumCols());
 
   GlobalHeader *h = reinterpret_cast<GlobalHeader*>(data_);
+  int32 num_cols = h->num_cols;
 
-  if (h->format == 1) {  // format with per-col header.
+  if (h->format == 1 || h->format == 3) {  // formats with per-col header.
     PerColHeader *per_col_header = reinterpret_cast<PerColHeader*>(h+1);
     unsigned char *byte_data = reinterpret_cast<unsigned char*>(per_col_header +
-                                                                h->num_cols);
-    byte_data += row;  // point to first value we are interested in
-    for (int32 i = 0; i < h->num_cols;
-         i++, per_col_header++, byte_data+=h->num_rows) {
+                                                                num_cols);
+    // point to the first value in the row we want, and work out the
+    // distance between values in the row.
+    int32 byte_stride;
+    if (h->format == 1) {
+      byte_data += row;
+      byte_stride = h->num_rows;
+    } else {
+      byte_data += row * num_cols;
+      byte_stride = 1;
+    }
+    for (int32 i = 0; i < num_cols;
+         i++, per_col_header++, byte_data += byte_stride) {
       float p0 = Uint16ToFloat(*h, per_col_header->percentile_0),
           p25 = Uint16ToFloat(*h, per_col_header->percentile_25),
           p75 = Uint16ToFloat(*h, per_col_header->percentile_75),
@@ -550,13 +786,13 @@ void CompressedMatrix::CopyRowToVec(MatrixIndexT row,
     }
   } else {
     KALDI_ASSERT(h->format == 2);  // uint16 format
-    int32 num_cols = h->num_cols;
     const uint16 *row_data = reinterpret_cast<uint16*>(h + 1) + (num_cols * row);
     Real *v_data = v->Data();
     for (int32 c = 0; c < num_cols; c++)
       v_data[c] = Uint16ToFloat(*h, row_data[c]);
   }
 }
+
 template<typename Real>
 void CompressedMatrix::CopyColToVec(MatrixIndexT col,
                                     VectorBase<Real> *v) const {
@@ -566,17 +802,26 @@ void CompressedMatrix::CopyColToVec(MatrixIndexT col,
 
   GlobalHeader *h = reinterpret_cast<GlobalHeader*>(data_);
 
-  if (h->format == 1) {  // format with per-col header.
+  if (h->format == 1 || h->format == 3) {  // formats with per-col header.
     PerColHeader *per_col_header = reinterpret_cast<PerColHeader*>(h+1);
     unsigned char *byte_data = reinterpret_cast<unsigned char*>(per_col_header +
                                                                 h->num_cols);
-    byte_data += col*h->num_rows;  // point to first value in the column we want
+    // point to the first value in the column we want, and work out the
+    // distance between values in the column.
+    int32 byte_stride;
+    if (h->format == 1) {
+      byte_data += col * h->num_rows;
+      byte_stride = 1;
+    } else {
+      byte_data += col;
+      byte_stride = h->num_cols;
+    }
     per_col_header += col;
     float p0 = Uint16ToFloat(*h, per_col_header->percentile_0),
         p25 = Uint16ToFloat(*h, per_col_header->percentile_25),
         p75 = Uint16ToFloat(*h, per_col_header->percentile_75),
         p100 = Uint16ToFloat(*h, per_col_header->percentile_100);
-    for (int32 i = 0; i < h->num_rows; i++, byte_data++) {
+    for (int32 i = 0; i < h->num_rows; i++, byte_data += byte_stride) {
       float f = CharToFloat(p0, p25, p75, p100, *byte_data);
       (*v)(i) = f;
     }
@@ -608,16 +853,17 @@ void CompressedMatrix::CopyToMat(int32 row_offset,
   KALDI_PARANOID_ASSERT(col_offset < this->NumCols());
   KALDI_PARANOID_ASSERT(row_offset >= 0);
   KALDI_PARANOID_ASSERT(col_offset >= 0);
-  KALDI_ASSERT(row_offset+dest->NumRows() < this->NumRows());
-  KALDI_ASSERT(col_offset+dest->NumCols() < this->NumCols());
+  KALDI_ASSERT(row_offset+dest->NumRows() <= this->NumRows());
+  KALDI_ASSERT(col_offset+dest->NumCols() <= this->NumCols());
   // everything is OK
   GlobalHeader *h = reinterpret_cast<GlobalHeader*>(data_);
   int32 num_rows = h->num_rows, num_cols = h->num_cols,
       tgt_cols = dest->NumCols(), tgt_rows = dest->NumRows();
+  if (tgt_rows == 0 || tgt_cols == 0) return;
   
   if (h->format == 1) {
     // format where we have a per-column header and use one byte per
-    // element.
+    // element, stored column by column.
     PerColHeader *per_col_header = reinterpret_cast<PerColHeader*>(h+1);
     unsigned char *byte_data = reinterpret_cast<unsigned char*>(per_col_header +
                                                                 h->num_cols);
@@ -628,18 +874,34 @@ void CompressedMatrix::CopyToMat(int32 row_offset,
 
     per_col_header += col_offset;  // skip the appropriate number of headers
 
+    std::vector<float> col_data(tgt_rows);
+    float ranges[6];
+    Real *dest_data = dest->Data();
+    MatrixIndexT dest_stride = dest->Stride();
     for (int32 i = 0;
          i < tgt_cols;
          i++, per_col_header++, start_of_subcol+=num_rows) {
-      byte_data = start_of_subcol;
-      float p0 = Uint16ToFloat(*h, per_col_header->percentile_0),
-          p25 = Uint16ToFloat(*h, per_col_header->percentile_25),
-          p75 = Uint16ToFloat(*h, per_col_header->percentile_75),
-          p100 = Uint16ToFloat(*h, per_col_header->percentile_100);
-      for (int32 j = 0; j < tgt_rows; j++, byte_data++) {
-        float f = CharToFloat(p0, p25, p75, p100, *byte_data);
-        (*dest)(j, i) = f;
-      }
+      ComputeColRanges(*h, per_col_header, 1, ranges);
+      UncompressBytes(ranges, 0, start_of_subcol, tgt_rows, &(col_data[0]));
+      for (int32 j = 0; j < tgt_rows; j++)
+        dest_data[j * dest_stride + i] = col_data[j];
+    }
+  } else if (h->format == 3) {
+    // as format 1 but the bytes are stored row by row, so we can uncompress
+    // just the rows we want, and write the output sequentially.
+    PerColHeader *per_col_header = reinterpret_cast<PerColHeader*>(h+1);
+    const unsigned char *byte_data =
+        reinterpret_cast<unsigned char*>(per_col_header + num_cols) +
+        col_offset + (num_cols * row_offset);
+    std::vector<float> ranges(6 * tgt_cols), row_data(tgt_cols);
+    ComputeColRanges(*h, per_col_header + col_offset, tgt_cols,
+                     &(ranges[0]));
+    for (int32 row = 0; row < tgt_rows; row++, byte_data += num_cols) {
+      UncompressBytes(&(ranges[0]), tgt_cols, byte_data, tgt_cols,
+                      &(row_data[0]));
+      Real *dest_row = dest->RowData(row);
+      for (int32 col = 0; col < tgt_cols; col++)
+        dest_row[col] = row_data[col];
     }
   } else {
     KALDI_ASSERT(h->format == 2);
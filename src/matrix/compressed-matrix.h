@@ -42,6 +42,19 @@ namespace kaldi {
 /// If the matrix has 8 rows or fewer, we simply store all values as
 /// uint16.
 
+/// The layout of the byte data for matrices with more than 8 rows.  In both
+/// cases each column has its own percentile ranges, and the values are the
+/// same; only the order of the bytes differs.
+enum CompressionLayout {
+  kCompressByColumn,  // The original format: the bytes of each column are
+                      // stored together.
+  kCompressByRow      // The bytes of each row are stored together, so a range
+                      // of rows (e.g. a few frames of a feature matrix) can be
+                      // uncompressed without touching the rest of the data.
+                      // Files written in this layout can't be read by older
+                      // versions of the code.
+};
+
 class CompressedMatrix {
  public:
   CompressedMatrix(): data_(NULL) { }
@@ -49,7 +62,9 @@ class CompressedMatrix {
   ~CompressedMatrix() { Destroy(); }
   
   template<typename Real>
-  CompressedMatrix(const MatrixBase<Real> &mat): data_(NULL) { CopyFromMat(mat); }
+  CompressedMatrix(const MatrixBase<Real> &mat,
+                   CompressionLayout layout = kCompressByColumn):
+      data_(NULL) { CopyFromMat(mat, layout); }
 
   /// Initializer that can be used to select part of an existing
   /// CompressedMatrix without un-compressing and re-compressing (note: unlike
@@ -65,7 +80,8 @@ class CompressedMatrix {
 
   /// This will resize *this and copy the contents of mat to *this.
   template<typename Real>
-  void CopyFromMat(const MatrixBase<Real> &mat);
+  void CopyFromMat(const MatrixBase<Real> &mat,
+                   CompressionLayout layout = kCompressByColumn);
 
   CompressedMatrix(const CompressedMatrix &mat);
 
@@ -103,7 +119,8 @@ class CompressedMatrix {
 
   /// Copies submatrix of compressed matrix into matrix dest.
   /// Submatrix starts at row row_offset and column column_offset and its size
-  /// is defined by size of provided matrix dest
+  /// is defined by size of provided matrix dest.  If you often need ranges of
+  /// rows from large matrices, kCompressByRow makes this cheaper.
   template<typename Real>
   void CopyToMat(int32 row_offset,
                  int32 column_offset,
@@ -115,13 +132,25 @@ class CompressedMatrix {
   friend class Matrix<double>;
  private:
 
+  // Reads a compressed matrix in binary format (the "CM" or "CM2" token
+  // followed by the data, as written by Write(os, true)) and uncompresses it
+  // directly into "mat", which is resized.  The compressed data is read a
+  // column (or, for format 2, a row) at a time rather than all at once, so
+  // we never hold the whole compressed matrix in memory; with a
+  // memory-mapped input stream (see Input::OpenMapped() in util/kaldi-io.h)
+  // the data is copied only from the mapped pages to the destination.  This
+  // is called from Matrix<Real>::Read().
+  template<typename Real>
+  static void ReadToMatrix(std::istream &is, Matrix<Real> *mat);
+
   // allocates data using new [], ensures byte alignment
   // sufficient for float.
   static void *AllocateData(int32 num_bytes);
 
   // the "format" will be 1 for the original format where each column has a
   // PerColHeader, and 2 for the format now used for matrices with 8 or fewer
-  // rows, where everything is represented as 16-bit integers.
+  // rows, where everything is represented as 16-bit integers.  Format 3 is
+  // like format 1 but the byte data is stored row by row (kCompressByRow).
   struct GlobalHeader {
     int32 format;
     float min_value;
@@ -139,11 +168,13 @@ class CompressedMatrix {
     uint16 percentile_100;
   };
 
+  // Compresses one column; the byte for row i is written to
+  // byte_data[i * byte_stride].
   template<typename Real>
   static void CompressColumn(const GlobalHeader &global_header,
                              const Real *data, MatrixIndexT stride,
                              int32 num_rows, PerColHeader *header,
-                             unsigned char *byte_data);
+                             unsigned char *byte_data, int32 byte_stride);
   template<typename Real>
   static void ComputeColHeader(const GlobalHeader &global_header,
                                const Real *data, MatrixIndexT stride,
@@ -160,6 +191,14 @@ class CompressedMatrix {
   static inline float CharToFloat(float p0, float p25,
                                   float p75, float p100,
                                   unsigned char value);
+
+  // Converts the PerColHeaders of "num_cols" columns to the form used when
+  // uncompressing the byte data (see UncompressBytes() in the .cc file): the
+  // start and size of each piece of the encoding.  "ranges" must have space
+  // for 6 * num_cols floats.
+  static void ComputeColRanges(const GlobalHeader &global_header,
+                               const PerColHeader *header, int32 num_cols,
+                               float *ranges);
   
   void Destroy();
   
@@ -1210,11 +1210,9 @@ void Matrix<Real>::Read(std::istream & is, bool binary, bool add) {
   if (binary) {  // Read in binary mode.
     int peekval = Peek(is, binary);
     if (peekval == 'C') {
-      // This code enable us to read CompressedMatrix as a regular matrix.
-      CompressedMatrix compressed_mat;
-      compressed_mat.Read(is, binary); // at this point, add == false.
-      this->Resize(compressed_mat.NumRows(), compressed_mat.NumCols());
-      compressed_mat.CopyToMat(this);
+      // This code enable us to read CompressedMatrix as a regular matrix;
+      // it is uncompressed as it is read, without an intermediate copy.
+      CompressedMatrix::ReadToMatrix(is, this);  // at this point, add == false.
       return;
     }
     const char *my_token =  (sizeof(Real) == 4 ? "FM" : "DM");
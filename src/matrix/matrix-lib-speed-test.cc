@@ -268,6 +268,43 @@ static void UnitTestAddVecToColsSpeed() {
   KALDI_LOG << __func__ << " finished in " << t.Elapsed() << " seconds.";   
 }
 
+template<typename Real>
+static void UnitTestCompressedMatrixSpeed() {
+  Timer t;
+  // Something like a feature matrix: 1000 frames of 40-dimensional features.
+  MatrixIndexT num_rows = 1000, num_cols = 40, chunk_size = 8, iters = 100;
+  Matrix<Real> mat(num_rows, num_cols);
+  mat.SetRandn();
+  for (int32 i = 0; i < 2; i++) {
+    CompressionLayout layout = (i == 0 ? kCompressByColumn : kCompressByRow);
+    const char *name = (i == 0 ? "by column" : "by row");
+    CompressedMatrix cmat(mat, layout);
+    Matrix<Real> dest(num_rows, num_cols, kUndefined);
+    {
+      Timer t1;
+      for (int32 iter = 0; iter < iters; iter++)
+        cmat.CopyToMat(&dest);
+      KALDI_LOG << "For CompressedMatrix" << NameOf<Real>() << ", " << name
+                << ", uncompressing " << num_rows << " x " << num_cols
+                << " matrix took " << (t1.Elapsed() / iters) << " seconds.";
+    }
+    {
+      // Uncompress ranges of rows at random positions, as when selecting
+      // chunks of frames for training.
+      Matrix<Real> chunk(chunk_size, num_cols, kUndefined);
+      int32 num_chunks = iters * num_rows / chunk_size;
+      Timer t1;
+      for (int32 n = 0; n < num_chunks; n++)
+        cmat.CopyToMat(Rand() % (num_rows - chunk_size), 0, &chunk);
+      KALDI_LOG << "For CompressedMatrix" << NameOf<Real>() << ", " << name
+                << ", uncompressing " << num_chunks << " chunks of "
+                << chunk_size << " rows took " << t1.Elapsed() << " seconds.";
+    }
+  }
+  KALDI_LOG << __func__ << NameOf<Real>() << " finished in " << t.Elapsed()
+            << " seconds.";
+}
+
 template<typename Real> static void MatrixUnitSpeedTest() {
   UnitTestRealFftSpeed<Real>();
   UnitTestSplitRadixRealFftSpeed<Real>();
@@ -277,6 +314,7 @@ template<typename Real> static void MatrixUnitSpeedTest() {
   UnitTestAddColSumMatSpeed<Real>();
   UnitTestAddVecToRowsSpeed<Real>();
   UnitTestAddVecToColsSpeed<Real>();
+  UnitTestCompressedMatrixSpeed<Real>();
 }
 
 } // namespace kaldi
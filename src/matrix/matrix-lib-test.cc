@@ -3990,7 +3990,9 @@ template<typename Real> static void UnitTestCompressedMatrix() {
       for (MatrixIndexT c = 0; c < num_cols; c++)
         if (Rand() % modulus != 0) M(r, c) = rand_val;
 
-    CompressedMatrix cmat(M);
+    CompressionLayout layout = (Rand() % 2 == 0 ? kCompressByColumn :
+                                kCompressByRow);
+    CompressedMatrix cmat(M, layout);
     KALDI_ASSERT(cmat.NumRows() == num_rows);
     KALDI_ASSERT(cmat.NumCols() == num_cols);
 
@@ -4140,7 +4142,8 @@ static void UnitTestExtractCompressedMatrix() {
     }
     Matrix<Real> mat(num_rows, num_cols);
     mat.SetRandn();
-    CompressedMatrix cmat(mat);
+    CompressedMatrix cmat(mat, (Rand() % 2 == 0 ? kCompressByColumn :
+                                kCompressByRow));
 
     MatrixIndexT row_offset = Rand() % num_rows, col_offset = Rand() % num_cols;
     MatrixIndexT sub_num_rows = Rand() % (num_rows - row_offset) + 1,
@@ -4161,6 +4164,117 @@ static void UnitTestExtractCompressedMatrix() {
   }
 }
 
+// Checks that the two layouts give the same values, for matrices
+// large enough to use the SIMD code, and that ranges of rows are uncompressed
+// correctly.
+template<typename Real>
+static void UnitTestCompressedMatrixLayouts() {
+  for (int32 i = 0; i < 10; i++) {
+    MatrixIndexT num_rows = 9 + Rand() % 100, num_cols = 1 + Rand() % 50;
+    Matrix<Real> mat(num_rows, num_cols);
+    mat.SetRandn();
+    if (Rand() % 2 == 0)
+      mat.Row(Rand() % num_rows).Set(RandGauss() * 4.0);
+    CompressedMatrix cmat1(mat, kCompressByColumn),
+        cmat3(mat, kCompressByRow);
+    Matrix<Real> mat1(cmat1), mat3(cmat3);
+    // The layouts store the same bytes, so they uncompress identically.
+    KALDI_ASSERT(mat1.Equal(mat3));
+
+    MatrixIndexT row_offset = Rand() % num_rows,
+        sub_num_rows = 1 + Rand() % (num_rows - row_offset),
+        col_offset = Rand() % num_cols,
+        sub_num_cols = 1 + Rand() % (num_cols - col_offset);
+    Matrix<Real> sub1(sub_num_rows, sub_num_cols),
+        sub3(sub_num_rows, sub_num_cols);
+    cmat1.CopyToMat(row_offset, col_offset, &sub1);
+    cmat3.CopyToMat(row_offset, col_offset, &sub3);
+    SubMatrix<Real> sub(mat1, row_offset, sub_num_rows,
+                        col_offset, sub_num_cols);
+    KALDI_ASSERT(sub.Equal(sub1) && sub.Equal(sub3));
+    Vector<Real> row1(num_cols), row3(num_cols);
+    cmat1.CopyRowToVec(row_offset, &row1);
+    cmat3.CopyRowToVec(row_offset, &row3);
+    KALDI_ASSERT(row1.ApproxEqual(mat1.Row(row_offset), 0.0) &&
+                 row3.ApproxEqual(mat1.Row(row_offset), 0.0));
+
+    {  // Check I/O of the new format, read both ways.
+      std::ostringstream os;
+      cmat3.Write(os, true);
+      std::istringstream is1(os.str()), is2(os.str());
+      CompressedMatrix cmat4;
+      cmat4.Read(is1, true);
+      Matrix<Real> mat4(cmat4), mat5;
+      mat5.Read(is2, true);
+      KALDI_ASSERT(mat1.Equal(mat4) && mat1.Equal(mat5));
+    }
+  }
+}
+
+
+// Checks the values uncompressed from a fixed compressed matrix, in both byte
+// layouts and by all the access paths, against values computed with the
+// original code, so that existing archives keep uncompressing to exactly the
+// same values.
+template<typename Real>
+static void UnitTestCompressedMatrixPinnedValues() {
+  const int32 num_rows = 20, num_cols = 2;
+  const float min_value = -3.7, range = 11.3;
+  const uint16 percentiles[num_cols][4] = { { 0, 13107, 40000, 65535 },
+                                            { 100, 5000, 60001, 65000 } };
+  // These cover all three pieces of the encoding and their boundaries; the
+  // second column has them in reverse order.
+  const unsigned char bytes[num_rows] = { 0, 1, 32, 63, 64, 65, 100, 127, 128,
+                                          191, 192, 193, 200, 220, 240, 250,
+                                          253, 254, 255, 77 };
+  const float expected[num_cols][num_rows] = {
+    { -3.70000005, -3.66468763, -2.57000017, -1.47531247,
+      -1.44000006, -1.40377283, -0.135821819, 0.842311859,
+      0.878539085, 3.160851, 3.19707823, 3.26696563,
+      3.75617933, 5.15393257, 6.55168581, 7.25056219,
+      7.46022511, 7.53011274, 7.60000038, -0.969046831 },
+    { -1.87468147, 7.50775242, 7.49407053, 7.48038864,
+      7.4393425, 7.30252314, 7.02888441, 6.75524569,
+      6.65947199, 6.64579058, 6.57169962, 1.90396261,
+      1.82987165, -0.170587063, -2.76377439, -2.83786535,
+      -2.85106683, -3.26031137, -3.6695559, -3.68275738 } };
+
+  for (int32 by_row = 0; by_row < 2; by_row++) {
+    std::ostringstream os;
+    WriteToken(os, true, by_row ? "CM3" : "CM");
+    os.write(reinterpret_cast<const char*>(&min_value), sizeof(float));
+    os.write(reinterpret_cast<const char*>(&range), sizeof(float));
+    os.write(reinterpret_cast<const char*>(&num_rows), sizeof(int32));
+    os.write(reinterpret_cast<const char*>(&num_cols), sizeof(int32));
+    os.write(reinterpret_cast<const char*>(percentiles), sizeof(percentiles));
+    for (int32 i = 0; i < num_rows * num_cols; i++) {
+      int32 r = (by_row ? i / num_cols : i % num_rows),
+          c = (by_row ? i % num_cols : i / num_rows);
+      os.put(c == 0 ? bytes[r] : bytes[num_rows - 1 - r]);
+    }
+
+    std::istringstream is1(os.str()), is2(os.str());
+    CompressedMatrix cmat;
+    cmat.Read(is1, true);
+    Matrix<Real> mat1(cmat), mat2;
+    mat2.Read(is2, true);
+    Vector<Real> row(num_cols), col(num_rows);
+    for (int32 r = 0; r < num_rows; r++) {
+      cmat.CopyRowToVec(r, &row);
+      for (int32 c = 0; c < num_cols; c++) {
+        Real value = expected[c][r];
+        KALDI_ASSERT(mat1(r, c) == value && mat2(r, c) == value &&
+                     row(c) == value);
+      }
+    }
+    for (int32 c = 0; c < num_cols; c++) {
+      cmat.CopyColToVec(c, &col);
+      for (int32 r = 0; r < num_rows; r++)
+        KALDI_ASSERT(col(r) == static_cast<Real>(expected[c][r]));
+    }
+  }
+}
+
 
 template<typename Real>
 static void UnitTestTridiag() {
@@ -4282,6 +4396,8 @@ template<typename Real> static void MatrixUnitTest(bool full_test) {
   // UnitTestSvdBad<Real>(); // test bug in Jama SVD code.
   UnitTestCompressedMatrix<Real>();
   UnitTestExtractCompressedMatrix<Real>();
+  UnitTestCompressedMatrixLayouts<Real>();
+  UnitTestCompressedMatrixPinnedValues<Real>();
   UnitTestResize<Real>();
   UnitTestMatrixExponentialBackprop();
   UnitTestMatrixExponential<Real>();
@@ -1,5 +1,6 @@
 #include <mpi.h>
 #include "nnet/nnet-nnet.h"
+#include "nnet/nnet-reduce.h"
 
 using namespace kaldi;
 using namespace kaldi::nnet1;
@@ -37,3 +38,38 @@ void send_nnet_buffer(Nnet &nnet, const int src_rank_id) {
   MPI_Bcast(nnet.GetSendBuffer(), num_elements, MPI_FLOAT, src_rank_id, MPI_COMM_WORLD);
   nnet.SetAndScaleBuffer(1.0);
 }
+
+/// The NnetReduceTransport for MPI jobs (see nnet-reduce.h).  With MPI-3 the
+/// allreduce is non-blocking (MPI_Iallreduce), so it can overlap with the
+/// training of the next minibatch; with older MPI versions StartAllReduce()
+/// does the whole allreduce and Wait() does nothing.
+class MpiReduceTransport: public NnetReduceTransport {
+ public:
+  MpiReduceTransport() {
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank_);
+    MPI_Comm_size(MPI_COMM_WORLD, &num_jobs_);
+  }
+  virtual int32 Rank() const { return rank_; }
+  virtual int32 NumJobs() const { return num_jobs_; }
+  virtual void StartAllReduce(const BaseFloat *send, BaseFloat *recv,
+                              int32 dim) {
+#if MPI_VERSION >= 3
+    MPI_Iallreduce(const_cast<BaseFloat*>(send), recv, dim, MPI_FLOAT, MPI_SUM,
+                   MPI_COMM_WORLD, &request_);
+#else
+    MPI_Allreduce(const_cast<BaseFloat*>(send), recv, dim, MPI_FLOAT, MPI_SUM,
+                  MPI_COMM_WORLD);
+#endif
+  }
+  virtual void Wait() {
+#if MPI_VERSION >= 3
+    MPI_Wait(&request_, MPI_STATUS_IGNORE);
+#endif
+  }
+ private:
+  int rank_;
+  int num_jobs_;
+#if MPI_VERSION >= 3
+  MPI_Request request_;
+#endif
+};
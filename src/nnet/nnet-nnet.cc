@@ -500,6 +500,24 @@ void Nnet::SetAndScaleBuffer(const BaseFloat scale) {
 
 }
 
+void Nnet::AddBufferDelta(const BaseFloat scale) {
+  int32 num_elements = NumElements();
+  for (int32 i = 0; i < num_elements; i++)
+    receive_buffer_[i] = scale * receive_buffer_[i] - send_buffer_[i];
+  cuda_receive_buffer_.CopyFromArray(receive_buffer_);
+  BaseFloat *cuda_receive_buffer_ptr = cuda_receive_buffer_.Data();
+  int32 pos = 0;
+  // add the elements
+  for(int32 i=0; i<components_.size(); i++) {
+    if(components_[i]->IsUpdatable()) {
+      UpdatableComponent& c = dynamic_cast<UpdatableComponent&>(*components_[i]);
+      c.AverageElements(1.0, &cuda_receive_buffer_ptr[pos], 1.0, reduce_content_);
+      pos += c.NumElements(reduce_content_);
+    }
+  }
+  KALDI_ASSERT(pos == num_elements);
+}
+
 void Nnet::Init(const std::string &file) {
   Input in(file);
   std::istream &is = in.Stream();
@@ -132,6 +132,12 @@ class Nnet {
   /// Set the model with weights in the buffer and scale it
   void SetAndScaleBuffer(const BaseFloat scale);
 
+  /// Add scale times the receive buffer minus the send buffer to the model,
+  /// i.e. the change from the values in the send buffer (as prepared by
+  /// PrepSendBuffer()) to the scaled values received.  Overwrites the receive
+  /// buffer.
+  void AddBufferDelta(const BaseFloat scale);
+
   /// Initialize MLP from config
   void Init(const std::string &config_file);
   /// Read the MLP from file (can add layers to exisiting instance of Nnet)
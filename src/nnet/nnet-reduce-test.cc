@@ -0,0 +1,143 @@
+// nnet/nnet-reduce-test.cc
+
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet/nnet-reduce.h"
+#include "nnet/nnet-affine-transform.h"
+#include "thread/kaldi-thread.h"
+
+namespace kaldi {
+namespace nnet1 {
+
+// Each job does an allreduce of its own random vector, and does some
+// unrelated work while it is in progress.
+class AllReduceTestClass: public MultiThreadable {
+ public:
+  AllReduceTestClass(SharedMemoryReduceGroup *group,
+                     const std::vector<Vector<BaseFloat> > *inputs):
+      group_(group), inputs_(inputs) { }
+
+  void operator () () {
+    SharedMemoryReduceTransport transport(group_, thread_id_);
+    KALDI_ASSERT(transport.Rank() == thread_id_ &&
+                 transport.NumJobs() == num_threads_);
+    const Vector<BaseFloat> &input = (*inputs_)[thread_id_];
+    Vector<BaseFloat> sum(input.Dim());
+    for (int32 n = 0; n < 3; n++) {
+      transport.StartAllReduce(input.Data(), sum.Data(), input.Dim());
+      Matrix<BaseFloat> m(20, 20);
+      m.SetRandn();
+      m.Invert();  // Something to do meanwhile.
+      transport.Wait();
+
+      Vector<BaseFloat> ref_sum(input.Dim());
+      for (size_t j = 0; j < inputs_->size(); j++)
+        ref_sum.AddVec(1.0, (*inputs_)[j]);
+      AssertEqual(ref_sum, sum);
+    }
+  }
+
+ private:
+  SharedMemoryReduceGroup *group_;
+  const std::vector<Vector<BaseFloat> > *inputs_;
+};
+
+void TestSharedMemoryAllReduce() {
+  int32 num_jobs = 1 + Rand() % 5, dim = Rand() % 100;
+  std::vector<Vector<BaseFloat> > inputs(num_jobs);
+  for (int32 i = 0; i < num_jobs; i++) {
+    inputs[i].Resize(dim);
+    inputs[i].SetRandn();
+  }
+  SharedMemoryReduceGroup group(num_jobs);
+  AllReduceTestClass c(&group, &inputs);
+  MultiThreader<AllReduceTestClass> m(num_jobs, c);
+}
+
+// Each job starts the averaging of its own model, then changes its model by
+// "deltas", as training would, and then finishes the averaging.  The result
+// should be the average of the starting models, plus the job's own delta.
+class ModelAveragerTestClass: public MultiThreadable {
+ public:
+  ModelAveragerTestClass(SharedMemoryReduceGroup *group, const Nnet *nnet,
+                         const std::vector<Vector<BaseFloat> > *params,
+                         const std::vector<Vector<BaseFloat> > *deltas):
+      group_(group), nnet_(nnet), params_(params), deltas_(deltas) { }
+
+  void operator () () {
+    SharedMemoryReduceTransport transport(group_, thread_id_);
+    Nnet nnet(*nnet_);
+    nnet.AllocBuffer();
+    nnet.SetWeights((*params_)[thread_id_]);
+
+    NnetModelAverager averager(&transport, &nnet);
+    averager.Start();
+    KALDI_ASSERT(averager.InProgress());
+    Vector<BaseFloat> params((*params_)[thread_id_]);
+    params.AddVec(1.0, (*deltas_)[thread_id_]);
+    nnet.SetWeights(params);
+    averager.Finish();
+    KALDI_ASSERT(!averager.InProgress());
+
+    Vector<BaseFloat> ref_params(params.Dim());
+    for (int32 j = 0; j < num_threads_; j++)
+      ref_params.AddVec(1.0 / num_threads_, (*params_)[j]);
+    ref_params.AddVec(1.0, (*deltas_)[thread_id_]);
+    nnet.GetWeights(&params);
+    AssertEqual(ref_params, params);
+  }
+
+ private:
+  SharedMemoryReduceGroup *group_;
+  const Nnet *nnet_;
+  const std::vector<Vector<BaseFloat> > *params_;
+  const std::vector<Vector<BaseFloat> > *deltas_;
+};
+
+void TestNnetModelAverager() {
+  int32 num_jobs = 1 + Rand() % 5;
+  Nnet nnet;
+  nnet.AppendComponent(new AffineTransform(1 + Rand() % 10, 1 + Rand() % 10));
+  nnet.AppendComponent(new AffineTransform(nnet.OutputDim(), 1 + Rand() % 10));
+  std::vector<Vector<BaseFloat> > params(num_jobs), deltas(num_jobs);
+  for (int32 i = 0; i < num_jobs; i++) {
+    params[i].Resize(nnet.NumParams());
+    params[i].SetRandn();
+    deltas[i].Resize(nnet.NumParams());
+    deltas[i].SetRandn();
+    deltas[i].Scale(0.1);
+  }
+  SharedMemoryReduceGroup group(num_jobs);
+  ModelAveragerTestClass c(&group, &nnet, &params, &deltas);
+  MultiThreader<ModelAveragerTestClass> m(num_jobs, c);
+}
+
+}  // namespace nnet1
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  using namespace kaldi::nnet1;
+  for (int32 i = 0; i < 10; i++) {
+    TestSharedMemoryAllReduce();
+    TestNnetModelAverager();
+  }
+  KALDI_LOG << "Test OK.";
+  return 0;
+}
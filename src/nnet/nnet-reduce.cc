@@ -0,0 +1,112 @@
+// nnet/nnet-reduce.cc
+
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <cstring>
+
+#include "nnet/nnet-reduce.h"
+
+namespace kaldi {
+namespace nnet1 {
+
+SharedMemoryReduceGroup::SharedMemoryReduceGroup(int32 num_jobs):
+    num_jobs_(num_jobs), send_(num_jobs, NULL), recv_(num_jobs, NULL),
+    barrier_(num_jobs) {
+  KALDI_ASSERT(num_jobs > 0);
+}
+
+void SharedMemoryReduceGroup::AllReduce(int32 rank, const BaseFloat *send,
+                                        BaseFloat *recv, int32 dim) {
+  KALDI_ASSERT(rank >= 0 && rank < num_jobs_);
+  send_[rank] = send;
+  recv_[rank] = recv;
+  barrier_.Wait();  // Now all the buffers are known.
+  // This job sums the dimensions [begin, end) and writes them to every job.
+  int32 begin = (static_cast<int64>(dim) * rank) / num_jobs_,
+      end = (static_cast<int64>(dim) * (rank + 1)) / num_jobs_;
+  for (int32 i = begin; i < end; i++) {
+    BaseFloat sum = 0.0;
+    for (int32 j = 0; j < num_jobs_; j++)
+      sum += send_[j][i];
+    for (int32 j = 0; j < num_jobs_; j++)
+      recv_[j][i] = sum;
+  }
+  // Nobody may reuse their buffers until everybody has finished.
+  barrier_.Wait();
+}
+
+
+SharedMemoryReduceTransport::SharedMemoryReduceTransport(
+    SharedMemoryReduceGroup *group, int32 rank):
+    group_(group), rank_(rank), send_(NULL), recv_(NULL), dim_(0),
+    running_(false) {
+  KALDI_ASSERT(rank >= 0 && rank < group->NumJobs());
+}
+
+SharedMemoryReduceTransport::~SharedMemoryReduceTransport() {
+  if (running_) Wait();
+}
+
+void *SharedMemoryReduceTransport::Run(void *this_in) {
+  SharedMemoryReduceTransport *t =
+      static_cast<SharedMemoryReduceTransport*>(this_in);
+  t->group_->AllReduce(t->rank_, t->send_, t->recv_, t->dim_);
+  return NULL;
+}
+
+void SharedMemoryReduceTransport::StartAllReduce(const BaseFloat *send,
+                                                 BaseFloat *recv, int32 dim) {
+  KALDI_ASSERT(!running_);
+  send_ = send;
+  recv_ = recv;
+  dim_ = dim;
+  int32 ret;
+  if ((ret = pthread_create(&thread_, NULL, Run, this)) != 0)
+    KALDI_ERR << "Error creating thread, errno was: " << strerror(ret);
+  running_ = true;
+}
+
+void SharedMemoryReduceTransport::Wait() {
+  KALDI_ASSERT(running_);
+  int32 ret;
+  if ((ret = pthread_join(thread_, NULL)) != 0)
+    KALDI_ERR << "Error joining thread, errno was: " << strerror(ret);
+  running_ = false;
+}
+
+
+void NnetModelAverager::Start() {
+  KALDI_ASSERT(!in_progress_ && nnet_->GetReduceContent() != "gradient");
+  nnet_->PrepSendBuffer();
+  transport_->StartAllReduce(nnet_->GetSendBuffer(),
+                             nnet_->GetReceiveBuffer(),
+                             nnet_->NumElements());
+  in_progress_ = true;
+}
+
+void NnetModelAverager::Finish() {
+  KALDI_ASSERT(in_progress_);
+  transport_->Wait();
+  nnet_->AddBufferDelta(1.0 / transport_->NumJobs());
+  in_progress_ = false;
+}
+
+}  // namespace nnet1
+}  // namespace kaldi
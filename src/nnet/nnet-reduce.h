@@ -0,0 +1,151 @@
+// nnet/nnet-reduce.h
+
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_NNET_NNET_REDUCE_H_
+#define KALDI_NNET_NNET_REDUCE_H_
+
+#include <pthread.h>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "nnet/nnet-nnet.h"
+#include "thread/kaldi-barrier.h"
+
+namespace kaldi {
+namespace nnet1 {
+
+/**
+   NnetReduceTransport is the interface through which the parallel training
+   jobs sum their parameter buffers (an "allreduce").  The summing may happen
+   in the background: StartAllReduce() returns at once, and the buffers must
+   not be touched until Wait() has returned, which lets the caller go on
+   training while the parameters are being communicated.  The implementations
+   are MpiReduceTransport (nnet-mixing.h), for jobs on different machines, and
+   SharedMemoryReduceTransport below, for jobs that are threads of one process
+   (this is what the tests use).
+ */
+class NnetReduceTransport {
+ public:
+  /// This job's index, 0 <= Rank() < NumJobs().
+  virtual int32 Rank() const = 0;
+
+  virtual int32 NumJobs() const = 0;
+
+  /// Starts setting recv[i] to the sum over all jobs of their send[i], for
+  /// 0 <= i < dim.  Every job must call this, with the same "dim".
+  virtual void StartAllReduce(const BaseFloat *send, BaseFloat *recv,
+                              int32 dim) = 0;
+
+  /// Waits for the allreduce started by StartAllReduce() to finish.
+  virtual void Wait() = 0;
+
+  virtual ~NnetReduceTransport() { }
+};
+
+
+/// The state shared by the jobs of a SharedMemoryReduceTransport.
+class SharedMemoryReduceGroup {
+ public:
+  explicit SharedMemoryReduceGroup(int32 num_jobs);
+
+  int32 NumJobs() const { return num_jobs_; }
+
+  /// Called by each of the jobs, from its own thread; returns when the sum is
+  /// in all the jobs' "recv".  Each job sums its share of the dimensions.
+  void AllReduce(int32 rank, const BaseFloat *send, BaseFloat *recv,
+                 int32 dim);
+
+ private:
+  int32 num_jobs_;
+  std::vector<const BaseFloat*> send_;
+  std::vector<BaseFloat*> recv_;
+  Barrier barrier_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(SharedMemoryReduceGroup);
+};
+
+/// A transport for jobs that are threads of one process.  Each transport object
+/// does its allreduce in a thread of its own, so it is asynchronous like
+/// MPI_Iallreduce.
+class SharedMemoryReduceTransport: public NnetReduceTransport {
+ public:
+  SharedMemoryReduceTransport(SharedMemoryReduceGroup *group, int32 rank);
+
+  virtual ~SharedMemoryReduceTransport();
+
+  virtual int32 Rank() const { return rank_; }
+
+  virtual int32 NumJobs() const { return group_->NumJobs(); }
+
+  virtual void StartAllReduce(const BaseFloat *send, BaseFloat *recv,
+                              int32 dim);
+
+  virtual void Wait();
+
+ private:
+  static void *Run(void *this_in);
+
+  SharedMemoryReduceGroup *group_;
+  int32 rank_;
+  const BaseFloat *send_;
+  BaseFloat *recv_;
+  int32 dim_;
+  bool running_;
+  pthread_t thread_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(SharedMemoryReduceTransport);
+};
+
+
+/**
+   NnetModelAverager does synchronous model averaging among the training jobs,
+   overlapping the communication with training.  Start() copies the model (the
+   parameters selected by Nnet::SetReduceContent(), which must not be
+   "gradient") into the nnet's send buffer and starts the allreduce; the job
+   then goes on training.  Finish() waits for the allreduce, and sets the
+   model to the average of the models at Start(), plus whatever this job's
+   own updates changed since Start():
+
+     model := model + (sum / NumJobs() - model at Start()).
+
+   With no training in between, this is plain model averaging.  The nnet must
+   have had AllocBuffer() called.
+ */
+class NnetModelAverager {
+ public:
+  NnetModelAverager(NnetReduceTransport *transport, Nnet *nnet):
+      transport_(transport), nnet_(nnet), in_progress_(false) { }
+
+  void Start();
+
+  void Finish();
+
+  bool InProgress() const { return in_progress_; }
+
+ private:
+  NnetReduceTransport *transport_;
+  Nnet *nnet_;
+  bool in_progress_;
+};
+
+
+}  // namespace nnet1
+}  // namespace kaldi
+
+#endif  // KALDI_NNET_NNET_REDUCE_H_
@@ -27,6 +27,7 @@
 #include "itf/decodable-itf.h"
 #include "nnet2/am-nnet.h"
 #include "nnet2/nnet-compute.h"
+#include "nnet2/nnet-compute-cpu.h"
 
 namespace kaldi {
 namespace nnet2 {
@@ -43,6 +44,45 @@ class DecodableAmNnet: public DecodableInterface {
                                          // will be < feats.NumRows().
                   BaseFloat prob_scale = 1.0):
       trans_model_(trans_model) {
+    Init(am_nnet, feats, NULL, pad_input, prob_scale);
+  }
+
+  /// This version does the computation with "cpu_computer" (see
+  /// nnet-compute-cpu.h), which must have been set up with the network in
+  /// "am_nnet"; if it is NULL this is the same as the constructor above.
+  DecodableAmNnet(const TransitionModel &trans_model,
+                  const AmNnet &am_nnet,
+                  const CuMatrixBase<BaseFloat> &feats,
+                  NnetCpuComputer *cpu_computer,
+                  bool pad_input = true,
+                  BaseFloat prob_scale = 1.0):
+      trans_model_(trans_model) {
+    Init(am_nnet, feats, cpu_computer, pad_input, prob_scale);
+  }
+
+  // Note, frames are numbered from zero.  But state_index is numbered
+  // from one (this routine is called by FSTs).
+  virtual BaseFloat LogLikelihood(int32 frame, int32 transition_id) {
+    return log_probs_(frame,
+                      trans_model_.TransitionIdToPdf(transition_id));
+  }
+
+  virtual int32 NumFramesReady() const { return log_probs_.NumRows(); }
+  
+  // Indices are one-based!  This is for compatibility with OpenFst.
+  virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
+  
+  virtual bool IsLastFrame(int32 frame) const {
+    KALDI_ASSERT(frame < NumFramesReady());
+    return (frame == NumFramesReady() - 1);
+  }
+
+ protected:
+  void Init(const AmNnet &am_nnet,
+            const CuMatrixBase<BaseFloat> &feats,
+            NnetCpuComputer *cpu_computer,
+            bool pad_input,
+            BaseFloat prob_scale) {
     // Note: we could make this more memory-efficient by doing the
     // computation in smaller chunks than the whole utterance, and not
     // storing the whole thing.  We'll leave this for later.
@@ -54,13 +94,28 @@ class DecodableAmNnet: public DecodableInterface {
                  << "empty output.";
       return;
     }
-    CuMatrix<BaseFloat> log_probs(num_rows, trans_model.NumPdfs());
+    if (cpu_computer != NULL) {
+      // Everything stays in system memory.
+      Matrix<BaseFloat> cpu_feats(feats);
+      log_probs_.Resize(num_rows, trans_model_.NumPdfs(), kUndefined);
+      cpu_computer->Compute(cpu_feats, pad_input, &log_probs_);
+      log_probs_.ApplyFloor(1.0e-20); // Avoid log of zero which leads to NaN.
+      log_probs_.ApplyLog();
+      Vector<BaseFloat> priors(am_nnet.Priors());
+      KALDI_ASSERT(priors.Dim() == trans_model_.NumPdfs() &&
+                   "Priors in neural network not set up.");
+      priors.ApplyLog();
+      log_probs_.AddVecToRows(-1.0, priors);
+      log_probs_.Scale(prob_scale);
+      return;
+    }
+    CuMatrix<BaseFloat> log_probs(num_rows, trans_model_.NumPdfs());
     // the following function is declared in nnet-compute.h
     NnetComputation(am_nnet.GetNnet(), feats, pad_input, &log_probs);
     log_probs.ApplyFloor(1.0e-20); // Avoid log of zero which leads to NaN.
     log_probs.ApplyLog();
     CuVector<BaseFloat> priors(am_nnet.Priors());
-    KALDI_ASSERT(priors.Dim() == trans_model.NumPdfs() &&
+    KALDI_ASSERT(priors.Dim() == trans_model_.NumPdfs() &&
                  "Priors in neural network not set up.");
     priors.ApplyLog();
     // subtract log-prior (divide by prior)
@@ -72,24 +127,6 @@ class DecodableAmNnet: public DecodableInterface {
     log_probs_.Swap(&log_probs);
   }
 
-  // Note, frames are numbered from zero.  But state_index is numbered
-  // from one (this routine is called by FSTs).
-  virtual BaseFloat LogLikelihood(int32 frame, int32 transition_id) {
-    return log_probs_(frame,
-                      trans_model_.TransitionIdToPdf(transition_id));
-  }
-
-  virtual int32 NumFramesReady() const { return log_probs_.NumRows(); }
-  
-  // Indices are one-based!  This is for compatibility with OpenFst.
-  virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
-  
-  virtual bool IsLastFrame(int32 frame) const {
-    KALDI_ASSERT(frame < NumFramesReady());
-    return (frame == NumFramesReady() - 1);
-  }
-
- protected:
   const TransitionModel &trans_model_;
   Matrix<BaseFloat> log_probs_; // actually not really probabilities, since we divide
   // by the prior -> they won't sum to one.
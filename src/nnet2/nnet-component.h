@@ -350,6 +350,7 @@ class PnormComponent: public Component {
 
   virtual std::string Info() const;
  protected:
+  friend class NnetCpuPlan;
   int32 input_dim_;
   int32 output_dim_;
   BaseFloat p_;
@@ -374,6 +375,7 @@ class NormalizeComponent: public NonlinearComponent {
                         Component *to_update, // may be identical to "this".
                         CuMatrix<BaseFloat> *in_deriv) const;
  private:
+  friend class NnetCpuPlan;
   NormalizeComponent &operator = (const NormalizeComponent &other); // Disallow.
   static const BaseFloat kNormFloor;
   // about 0.7e-20.  We need a value that's exactly representable in
@@ -645,8 +647,8 @@ class AffineComponent: public UpdatableComponent {
   // This new function is used when mixing up:
   virtual void SetParams(const VectorBase<BaseFloat> &bias,
                          const MatrixBase<BaseFloat> &linear);
-  const CuVector<BaseFloat> &BiasParams() { return bias_params_; }
-  const CuMatrix<BaseFloat> &LinearParams() { return linear_params_; }
+  const CuVector<BaseFloat> &BiasParams() const { return bias_params_; }
+  const CuMatrix<BaseFloat> &LinearParams() const { return linear_params_; }
 
   virtual int32 GetParameterDim() const;
   virtual void Vectorize(VectorBase<BaseFloat> *params) const;
@@ -865,6 +867,7 @@ class SpliceComponent: public Component {
   virtual void Read(std::istream &is, bool binary);
   virtual void Write(std::ostream &os, bool binary) const;
  private:
+  friend class NnetCpuPlan;
   KALDI_DISALLOW_COPY_AND_ASSIGN(SpliceComponent);
   int32 input_dim_;
   int32 left_context_;
@@ -1218,6 +1221,7 @@ class FixedAffineComponent: public Component {
   const CuMatrix<BaseFloat> &LinearParams() const { return linear_params_; }
  protected:
   friend class AffineComponent;
+  friend class NnetCpuPlan;
   CuMatrix<BaseFloat> linear_params_;
   CuVector<BaseFloat> bias_params_;
   
@@ -1258,6 +1262,7 @@ class FixedScaleComponent: public Component {
   virtual void Write(std::ostream &os, bool binary) const;
 
  protected:
+  friend class NnetCpuPlan;
   CuVector<BaseFloat> scales_;  
   KALDI_DISALLOW_COPY_AND_ASSIGN(FixedScaleComponent);
 };
@@ -1295,6 +1300,7 @@ class FixedBiasComponent: public Component {
   virtual void Write(std::ostream &os, bool binary) const;
 
  protected:
+  friend class NnetCpuPlan;
   CuVector<BaseFloat> bias_;  
   KALDI_DISALLOW_COPY_AND_ASSIGN(FixedBiasComponent);
 };
@@ -0,0 +1,129 @@
+// nnet2/nnet-compute-cpu-test.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet2/nnet-compute.h"
+#include "nnet2/nnet-compute-cpu.h"
+
+namespace kaldi {
+namespace nnet2 {
+
+// A network like those of the p-norm recipes, with a few of the other
+// components thrown in, including one (PowerComponent) that the plan has to do
+// by calling Propagate().
+Nnet *GenPnormNnet(int32 input_dim, int32 output_dim) {
+  std::vector<Component*> components;
+  BaseFloat learning_rate = 0.0001, param_stddev = 0.1, bias_stddev = 0.1;
+  int32 const_dim = (rand() % 2 == 0 ? 0 : 5),
+      splice_dim = (input_dim - const_dim) * 5 + const_dim,
+      group = 2 + rand() % 3, pnorm_dim = 20 + rand() % 20,
+      hidden_dim = pnorm_dim * group;
+  {
+    SpliceComponent *splice = new SpliceComponent();
+    splice->Init(input_dim, 2, 2, const_dim);
+    components.push_back(splice);
+    CuMatrix<BaseFloat> lda(splice_dim, splice_dim + 1);
+    lda.SetRandn();
+    FixedAffineComponent *fixed = new FixedAffineComponent();
+    fixed->Init(lda);
+    components.push_back(fixed);
+  }
+  {
+    SpliceComponent *splice = new SpliceComponent();
+    splice->Init(splice_dim, 1, 1);
+    components.push_back(splice);
+    AffineComponent *affine = new AffineComponent();
+    affine->Init(learning_rate, splice_dim * 3, hidden_dim,
+                 param_stddev, bias_stddev);
+    components.push_back(affine);
+    components.push_back(new PnormComponent(hidden_dim, pnorm_dim, 2.0));
+    components.push_back(new NormalizeComponent(pnorm_dim));
+  }
+  {
+    AffineComponent *affine = new AffineComponent();
+    affine->Init(learning_rate, pnorm_dim, hidden_dim,
+                 param_stddev, bias_stddev);
+    components.push_back(affine);
+    components.push_back(new TanhComponent(hidden_dim));
+    components.push_back(new PowerComponent(hidden_dim, 2.0));
+    components.push_back(new RectifiedLinearComponent(hidden_dim));
+  }
+  {
+    AffineComponent *affine = new AffineComponent();
+    affine->Init(learning_rate, hidden_dim, output_dim,
+                 param_stddev, bias_stddev);
+    components.push_back(affine);
+    components.push_back(new SoftmaxComponent(output_dim));
+  }
+  Nnet *ans = new Nnet();
+  ans->Init(&components);
+  return ans;
+}
+
+void TestNnetCpuComputer(const Nnet &nnet) {
+  NnetCpuComputeOptions opts;
+  if (rand() % 2 == 0) {
+    // Make the blocks small so there are several of them.
+    opts.l2_cache_kb = 1;
+    opts.min_block_rows = 1 + rand() % 10;
+  }
+  NnetCpuPlan plan(nnet, opts);
+  KALDI_ASSERT(plan.LeftContext() == nnet.LeftContext() &&
+               plan.RightContext() == nnet.RightContext());
+  for (int32 i = 0; i < plan.NumSteps(); i++)
+    KALDI_LOG << "Step " << i << " is " << plan.StepName(i);
+
+  NnetCpuComputer computer(plan);
+  for (int32 n = 0; n < 4; n++) {
+    bool pad_input = (rand() % 2 == 0);
+    int32 context = nnet.LeftContext() + nnet.RightContext(),
+        num_rows = (pad_input ? 1 : context + 1) + rand() % 100,
+        num_output_rows = num_rows - (pad_input ? 0 : context);
+    Matrix<BaseFloat> input(num_rows, nnet.InputDim());
+    input.SetRandn();
+    CuMatrix<BaseFloat> cu_input(input),
+        cu_output(num_output_rows, nnet.OutputDim());
+    NnetComputation(nnet, cu_input, pad_input, &cu_output);
+    Matrix<BaseFloat> output1(cu_output),
+        output2(num_output_rows, nnet.OutputDim());
+    computer.Compute(input, pad_input, &output2);
+    AssertEqual(output1, output2, 1.0e-03);
+  }
+}
+
+void UnitTestNnetCpuComputer() {
+  int32 input_dim = 10 + rand() % 20, output_dim = 10 + rand() % 50;
+  Nnet *nnet = GenRandomNnet(input_dim, output_dim);
+  TestNnetCpuComputer(*nnet);
+  delete nnet;
+  nnet = GenPnormNnet(input_dim, output_dim);
+  TestNnetCpuComputer(*nnet);
+  delete nnet;
+}
+
+} // namespace nnet2
+} // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  using namespace kaldi::nnet2;
+  for (int32 i = 0; i < 10; i++)
+    UnitTestNnetCpuComputer();
+  KALDI_LOG << "Success.";
+  return 0;
+}
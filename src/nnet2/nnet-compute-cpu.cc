@@ -0,0 +1,402 @@
+// nnet2/nnet-compute-cpu.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "base/timer.h"
+#include "nnet2/nnet-compute-cpu.h"
+#include "util/stl-utils.h"
+
+namespace kaldi {
+namespace nnet2 {
+
+bool NnetCpuPlan::GetAffineParams(const Component &c,
+                                  Matrix<BaseFloat> *linear,
+                                  Vector<BaseFloat> *bias) {
+  // This covers AffineComponentPreconditioned and
+  // AffineComponentPreconditionedOnline too.
+  if (const AffineComponent *ac = dynamic_cast<const AffineComponent*>(&c)) {
+    linear->Resize(ac->LinearParams().NumRows(),
+                   ac->LinearParams().NumCols(), kUndefined);
+    ac->LinearParams().CopyToMat(linear);
+    bias->Resize(ac->BiasParams().Dim(), kUndefined);
+    ac->BiasParams().CopyToVec(bias);
+    return true;
+  }
+  if (const FixedAffineComponent *fc =
+      dynamic_cast<const FixedAffineComponent*>(&c)) {
+    linear->Resize(fc->linear_params_.NumRows(),
+                   fc->linear_params_.NumCols(), kUndefined);
+    fc->linear_params_.CopyToMat(linear);
+    bias->Resize(fc->bias_params_.Dim(), kUndefined);
+    fc->bias_params_.CopyToVec(bias);
+    return true;
+  }
+  return false;
+}
+
+bool NnetCpuPlan::GetOp(const Component &c, Op *op) {
+  op->output_dim = c.OutputDim();
+  op->param = 0.0;
+  op->vec.Resize(0);
+  if (dynamic_cast<const SigmoidComponent*>(&c) != NULL) {
+    op->type = kSigmoid;
+  } else if (dynamic_cast<const TanhComponent*>(&c) != NULL) {
+    op->type = kTanh;
+  } else if (dynamic_cast<const RectifiedLinearComponent*>(&c) != NULL) {
+    op->type = kRectifiedLinear;
+  } else if (dynamic_cast<const SoftHingeComponent*>(&c) != NULL) {
+    op->type = kSoftHinge;
+  } else if (const PnormComponent *pc =
+             dynamic_cast<const PnormComponent*>(&c)) {
+    op->type = kPnorm;
+    op->param = pc->p_;
+  } else if (dynamic_cast<const NormalizeComponent*>(&c) != NULL) {
+    op->type = kNormalize;
+    op->param = NormalizeComponent::kNormFloor;
+  } else if (dynamic_cast<const SoftmaxComponent*>(&c) != NULL) {
+    op->type = kSoftmax;
+  } else if (const FixedScaleComponent *sc =
+             dynamic_cast<const FixedScaleComponent*>(&c)) {
+    op->type = kFixedScale;
+    op->vec.Resize(sc->scales_.Dim(), kUndefined);
+    sc->scales_.CopyToVec(&(op->vec));
+  } else if (const FixedBiasComponent *bc =
+             dynamic_cast<const FixedBiasComponent*>(&c)) {
+    op->type = kFixedBias;
+    op->vec.Resize(bc->bias_.Dim(), kUndefined);
+    bc->bias_.CopyToVec(&(op->vec));
+  } else {
+    return false;
+  }
+  return true;
+}
+
+NnetCpuPlan::NnetCpuPlan(const Nnet &nnet,
+                         const NnetCpuComputeOptions &opts):
+    input_dim_(nnet.InputDim()), output_dim_(nnet.OutputDim()),
+    left_context_(nnet.LeftContext()), right_context_(nnet.RightContext()),
+    num_frames_(0) {
+  KALDI_ASSERT(opts.l2_cache_kb > 0 && opts.min_block_rows > 0);
+  int32 num_components = nnet.NumComponents();
+  KALDI_ASSERT(num_components > 0);
+  int32 c = 0;
+  while (c < num_components) {
+    const Component &component = nnet.GetComponent(c);
+    Step step;
+    step.name = component.Type();
+    step.input_dim = component.InputDim();
+    Matrix<BaseFloat> linear;
+    const SpliceComponent *splice =
+        dynamic_cast<const SpliceComponent*>(&component);
+    if (splice != NULL && c + 1 < num_components &&
+        GetAffineParams(nnet.GetComponent(c + 1), &linear, &step.bias)) {
+      // Splicing by offsets into the input: the columns of the affine
+      // component's weights that multiply the frame at offset "t" are applied
+      // directly to the input rows starting at "t".
+      int32 const_dim = splice->const_component_dim_,
+          splice_dim = splice->input_dim_ - const_dim,
+          num_splice = splice->left_context_ + splice->right_context_ + 1;
+      KALDI_ASSERT(linear.NumCols() == splice->OutputDim());
+      step.name += "+" + nnet.GetComponent(c + 1).Type();
+      step.context = num_splice - 1;
+      for (int32 t = 0; t < num_splice; t++) {
+        Term term;
+        term.row_offset = t;
+        term.col_offset = 0;
+        term.linear = linear.ColRange(t * splice_dim, splice_dim);
+        step.terms.push_back(term);
+      }
+      if (const_dim != 0) {
+        // SpliceComponent takes the constant part from the first frame.
+        Term term;
+        term.row_offset = 0;
+        term.col_offset = splice_dim;
+        term.linear = linear.ColRange(num_splice * splice_dim, const_dim);
+        step.terms.push_back(term);
+      }
+      step.affine_dim = linear.NumRows();
+      c += 2;
+    } else if (GetAffineParams(component, &linear, &step.bias)) {
+      Term term;
+      term.row_offset = 0;
+      term.col_offset = 0;
+      term.linear.Swap(&linear);
+      step.terms.push_back(term);
+      step.affine_dim = term.linear.NumRows();
+      c++;
+    } else {
+      Op op;
+      if (!GetOp(component, &op)) {
+        // Anything else is done by the component itself.
+        Component *copy = component.Copy();
+        owned_components_.push_back(copy);
+        step.component = copy;
+        step.output_dim = component.OutputDim();
+        step.context = component.LeftContext() + component.RightContext();
+        steps_.push_back(step);
+        c++;
+        continue;
+      }
+      // A step with no affine part; the op is added below.
+      step.name = "";
+      step.affine_dim = step.input_dim;
+    }
+    // Add the ops that follow, as long as there is at most one change of
+    // dimension (i.e. one PnormComponent).
+    bool have_pnorm = false;
+    int32 dim = step.affine_dim;
+    step.scratch_ops = -1;
+    Op op;
+    while (c < num_components && GetOp(nnet.GetComponent(c), &op)) {
+      if (op.type == kPnorm) {
+        if (have_pnorm) break;
+        have_pnorm = true;
+        step.scratch_ops = step.ops.size();
+      }
+      KALDI_ASSERT(nnet.GetComponent(c).InputDim() == dim);
+      dim = op.output_dim;
+      if (!step.name.empty()) step.name += "+";
+      step.name += nnet.GetComponent(c).Type();
+      step.ops.push_back(op);
+      c++;
+    }
+    if (!have_pnorm) step.scratch_ops = step.ops.size();
+    step.output_dim = dim;
+
+    // Choose the number of rows per block so that the input rows, the affine
+    // output and the output of the step take up half of the L2 cache.
+    int32 row_bytes = sizeof(BaseFloat) *
+        (step.input_dim + step.affine_dim + (have_pnorm ? step.output_dim : 0)),
+        context_bytes = sizeof(BaseFloat) * step.context * step.input_dim,
+        cache_bytes = opts.l2_cache_kb * 1024 / 2;
+    step.block_rows = std::max(opts.min_block_rows,
+                               (cache_bytes - context_bytes) / row_bytes);
+    steps_.push_back(step);
+  }
+
+  int32 tot_context = 0;
+  for (size_t i = 0; i < steps_.size(); i++) {
+    tot_context += steps_[i].context;
+    if (i > 0) KALDI_ASSERT(steps_[i].input_dim == steps_[i-1].output_dim);
+  }
+  KALDI_ASSERT(tot_context == left_context_ + right_context_);
+  step_times_.resize(steps_.size(), 0.0);
+  if (GetVerboseLevel() >= 1) {
+    for (size_t i = 0; i < steps_.size(); i++)
+      KALDI_VLOG(1) << "Step " << i << ": " << steps_[i].name << ", "
+                    << steps_[i].block_rows << " rows per block.";
+  }
+}
+
+NnetCpuPlan::~NnetCpuPlan() {
+  DeletePointers(&owned_components_);
+}
+
+void NnetCpuPlan::AddTimes(const std::vector<double> &step_times,
+                           int64 num_frames) const {
+  timing_mutex_.Lock();
+  KALDI_ASSERT(step_times.size() == step_times_.size());
+  for (size_t i = 0; i < step_times.size(); i++)
+    step_times_[i] += step_times[i];
+  num_frames_ += num_frames;
+  timing_mutex_.Unlock();
+}
+
+void NnetCpuPlan::PrintTimingReport() const {
+  timing_mutex_.Lock();
+  double tot_time = 0.0;
+  for (size_t i = 0; i < step_times_.size(); i++)
+    tot_time += step_times_[i];
+  KALDI_LOG << "Nnet computation took " << tot_time << " seconds for "
+            << num_frames_ << " frames, "
+            << (tot_time > 0.0 ? num_frames_ / tot_time : 0.0)
+            << " frames per second.";
+  for (size_t i = 0; i < step_times_.size(); i++)
+    KALDI_LOG << "Step " << i << " (" << steps_[i].name << "): "
+              << step_times_[i] << " seconds, "
+              << (tot_time > 0.0 ? 100.0 * step_times_[i] / tot_time : 0.0)
+              << "%";
+  timing_mutex_.Unlock();
+}
+
+
+NnetCpuComputer::NnetCpuComputer(const NnetCpuPlan &plan):
+    plan_(plan), step_times_(plan.NumSteps(), 0.0), num_frames_(0) { }
+
+NnetCpuComputer::~NnetCpuComputer() {
+  plan_.AddTimes(step_times_, num_frames_);
+}
+
+SubMatrix<BaseFloat> NnetCpuComputer::GetBuffer(int32 b, int32 num_rows,
+                                                int32 num_cols) {
+  Matrix<BaseFloat> &buffer = buffers_[b];
+  if (buffer.NumRows() < num_rows || buffer.NumCols() < num_cols)
+    buffer.Resize(std::max(buffer.NumRows(), num_rows),
+                  std::max(buffer.NumCols(), num_cols), kUndefined);
+  return SubMatrix<BaseFloat>(buffer, 0, num_rows, 0, num_cols);
+}
+
+void NnetCpuComputer::Compute(const MatrixBase<BaseFloat> &input,
+                              bool pad_input,
+                              MatrixBase<BaseFloat> *output) {
+  if (input.NumCols() != plan_.InputDim())
+    KALDI_ERR << "Feature dimension is " << input.NumCols()
+              << " but network expects " << plan_.InputDim();
+  int32 left_context = (pad_input ? plan_.LeftContext() : 0),
+      right_context = (pad_input ? plan_.RightContext() : 0),
+      num_rows = left_context + input.NumRows() + right_context;
+  KALDI_ASSERT(output->NumRows() ==
+               num_rows - plan_.LeftContext() - plan_.RightContext() &&
+               output->NumCols() == plan_.OutputDim() && input.NumRows() > 0);
+
+  // "cur" is the buffer that holds the input of the next step, or -1 if it is
+  // "input" itself.
+  int32 cur = -1, cur_cols = input.NumCols();
+  if (pad_input) {
+    SubMatrix<BaseFloat> padded(GetBuffer(0, num_rows, cur_cols));
+    padded.Range(left_context, input.NumRows(), 0, cur_cols).CopyFromMat(input);
+    for (int32 i = 0; i < left_context; i++)
+      padded.Row(i).CopyFromVec(input.Row(0));
+    int32 last_row = input.NumRows() - 1;
+    for (int32 i = 0; i < right_context; i++)
+      padded.Row(num_rows - i - 1).CopyFromVec(input.Row(last_row));
+    cur = 0;
+  }
+
+  int32 num_steps = plan_.NumSteps();
+  for (int32 i = 0; i < num_steps; i++) {
+    const Step &s = plan_.steps_[i];
+    int32 out_rows = num_rows - s.context;
+    Timer timer;
+    SubMatrix<BaseFloat> step_input(
+        cur == -1 ? SubMatrix<BaseFloat>(input, 0, num_rows, 0, cur_cols) :
+        SubMatrix<BaseFloat>(buffers_[cur], 0, num_rows, 0, cur_cols));
+    if (i + 1 == num_steps) {
+      DoStep(s, step_input, output);
+    } else {
+      int32 next = (cur == 0 ? 1 : 0);
+      SubMatrix<BaseFloat> step_output(GetBuffer(next, out_rows,
+                                                 s.output_dim));
+      DoStep(s, step_input, &step_output);
+      cur = next;
+    }
+    step_times_[i] += timer.Elapsed();
+    num_rows = out_rows;
+    cur_cols = s.output_dim;
+  }
+  num_frames_ += output->NumRows();
+}
+
+void NnetCpuComputer::DoStep(const Step &s,
+                             const MatrixBase<BaseFloat> &input,
+                             MatrixBase<BaseFloat> *output) {
+  KALDI_ASSERT(input.NumCols() == s.input_dim &&
+               output->NumCols() == s.output_dim &&
+               output->NumRows() == input.NumRows() - s.context);
+  if (s.component != NULL) {
+    CuMatrix<BaseFloat> cu_input(input), cu_output;
+    s.component->Propagate(cu_input, 1, &cu_output);
+    KALDI_ASSERT(cu_output.NumRows() == output->NumRows());
+    cu_output.CopyToMat(output);
+    return;
+  }
+
+  int32 num_rows = output->NumRows(), num_ops = s.ops.size();
+  bool use_scratch = (s.scratch_ops < num_ops);
+  if (use_scratch && (scratch_.NumRows() < s.block_rows ||
+                      scratch_.NumCols() < s.affine_dim))
+    scratch_.Resize(std::max(scratch_.NumRows(), s.block_rows),
+                    std::max(scratch_.NumCols(), s.affine_dim), kUndefined);
+  if (row_norms_.Dim() < s.block_rows)
+    row_norms_.Resize(s.block_rows, kUndefined);
+
+  for (int32 r = 0; r < num_rows; r += s.block_rows) {
+    int32 n = std::min(s.block_rows, num_rows - r);
+    SubMatrix<BaseFloat> out_block(*output, r, n, 0, s.output_dim),
+        affine_block(use_scratch ?
+                     SubMatrix<BaseFloat>(scratch_, 0, n, 0, s.affine_dim) :
+                     SubMatrix<BaseFloat>(*output, r, n, 0, s.affine_dim));
+    if (s.terms.empty()) {
+      affine_block.CopyFromMat(input.Range(r, n, 0, s.input_dim));
+    } else {
+      affine_block.CopyRowsFromVec(s.bias);
+      for (size_t k = 0; k < s.terms.size(); k++) {
+        const NnetCpuPlan::Term &term = s.terms[k];
+        affine_block.AddMatMat(1.0, input.Range(r + term.row_offset, n,
+                                                term.col_offset,
+                                                term.linear.NumCols()),
+                               kNoTrans, term.linear, kTrans, 1.0);
+      }
+    }
+    DoOpsInPlace(s, 0, s.scratch_ops, &affine_block);
+    if (use_scratch) {
+      KALDI_ASSERT(s.ops[s.scratch_ops].type == NnetCpuPlan::kPnorm);
+      out_block.GroupPnorm(affine_block, s.ops[s.scratch_ops].param);
+      DoOpsInPlace(s, s.scratch_ops + 1, num_ops, &out_block);
+    }
+  }
+}
+
+void NnetCpuComputer::DoOpsInPlace(const Step &s, int32 begin, int32 end,
+                                   MatrixBase<BaseFloat> *data) {
+  for (int32 i = begin; i < end; i++) {
+    const NnetCpuPlan::Op &op = s.ops[i];
+    switch (op.type) {
+      case NnetCpuPlan::kSigmoid:
+        data->Sigmoid(*data);
+        break;
+      case NnetCpuPlan::kTanh:
+        data->Tanh(*data);
+        break;
+      case NnetCpuPlan::kRectifiedLinear:
+        data->ApplyFloor(0.0);
+        break;
+      case NnetCpuPlan::kSoftHinge:
+        data->SoftHinge(*data);
+        break;
+      case NnetCpuPlan::kNormalize: {
+        SubVector<BaseFloat> norms(row_norms_, 0, data->NumRows());
+        norms.AddDiagMat2(1.0 / data->NumCols(), *data, kNoTrans, 0.0);
+        norms.ApplyFloor(op.param);
+        norms.ApplyPow(-0.5);
+        data->MulRowsVec(norms);
+        break;
+      }
+      case NnetCpuPlan::kSoftmax:
+        for (int32 r = 0; r < data->NumRows(); r++)
+          data->Row(r).ApplySoftMax();
+        // As in SoftmaxComponent, to avoid taking the log of zero later.
+        data->ApplyFloor(1.0e-20);
+        break;
+      case NnetCpuPlan::kFixedScale:
+        data->MulColsVec(op.vec);
+        break;
+      case NnetCpuPlan::kFixedBias:
+        data->AddVecToRows(1.0, op.vec);
+        break;
+      default:
+        KALDI_ERR << "Op " << op.type << " cannot be done in place.";
+    }
+  }
+}
+
+
+} // namespace nnet2
+} // namespace kaldi
@@ -0,0 +1,222 @@
+// nnet2/nnet-compute-cpu.h
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET2_NNET_COMPUTE_CPU_H_
+#define KALDI_NNET2_NNET_COMPUTE_CPU_H_
+
+#include <string>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "itf/options-itf.h"
+#include "matrix/kaldi-matrix.h"
+#include "nnet2/nnet-nnet.h"
+#include "thread/kaldi-mutex.h"
+
+namespace kaldi {
+namespace nnet2 {
+
+/* This header provides an inference-only version of the forward computation
+   in nnet-compute.h, for decoding on machines without a GPU.  Instead of
+   calling each Component's Propagate() function, which goes through the
+   CuMatrix code and allocates a new output matrix for every layer, the network
+   is "compiled" once into a short list of steps:
+
+    - an affine component, together with the nonlinearities and other
+      row-by-row operations that follow it (e.g. PnormComponent,
+      NormalizeComponent, SoftmaxComponent), is done as one step, one block of
+      rows at a time, so the output of the matrix multiplication is still in
+      the cache when the nonlinearity is applied to it;
+    - a SpliceComponent followed by an affine component is not done by copying:
+      the weight matrix is split into one block of columns per frame offset,
+      and the matrix multiplication reads the rows of the unspliced input at
+      each offset;
+    - the outputs of the steps alternate between two buffers that are kept
+      from one call to the next;
+    - anything else falls back to Component::Propagate().
+*/
+
+struct NnetCpuComputeOptions {
+  int32 l2_cache_kb;
+  int32 min_block_rows;
+
+  NnetCpuComputeOptions(): l2_cache_kb(256), min_block_rows(16) { }
+
+  void Register(OptionsItf *po) {
+    po->Register("cpu-l2-cache-kb", &l2_cache_kb, "Size in kilobytes of the "
+                 "per-core L2 cache, used to choose how many rows of the "
+                 "input go through each fused step at a time");
+    po->Register("cpu-min-block-rows", &min_block_rows, "Minimum number of "
+                 "rows per block in the fused steps (caps the effect of "
+                 "--cpu-l2-cache-kb for very wide layers)");
+  }
+};
+
+
+/**
+   NnetCpuPlan is the "compiled" form of an Nnet.  It holds its own copy of the
+   parameters (rearranged as needed), so the Nnet may be deleted afterwards.
+   It is not changed by the computation, so one plan can be shared by all the
+   threads of a program, each with its own NnetCpuComputer.  It also keeps the
+   total time spent in each step by all the computers that used it.
+*/
+class NnetCpuPlan {
+ public:
+  explicit NnetCpuPlan(const Nnet &nnet,
+                       const NnetCpuComputeOptions &opts =
+                       NnetCpuComputeOptions());
+
+  int32 InputDim() const { return input_dim_; }
+  int32 OutputDim() const { return output_dim_; }
+  int32 LeftContext() const { return left_context_; }
+  int32 RightContext() const { return right_context_; }
+
+  int32 NumSteps() const { return steps_.size(); }
+
+  /// Describes step "i", e.g. "SpliceComponent+AffineComponent+PnormComponent".
+  const std::string &StepName(int32 i) const { return steps_[i].name; }
+
+  /// Prints (with KALDI_LOG) the time spent in each step and the number of
+  /// frames, summed over all the NnetCpuComputers that have been destroyed.
+  void PrintTimingReport() const;
+
+  ~NnetCpuPlan();
+
+ private:
+  friend class NnetCpuComputer;
+
+  // A row-wise operation done after the affine part of a step, if any.
+  enum OpType { kSigmoid, kTanh, kRectifiedLinear, kSoftHinge, kPnorm,
+                kNormalize, kSoftmax, kFixedScale, kFixedBias };
+  struct Op {
+    OpType type;
+    int32 output_dim;
+    BaseFloat param;  // the power for kPnorm, or the floor for kNormalize.
+    Vector<BaseFloat> vec;  // scales or bias, for kFixedScale and kFixedBias.
+    Op(): type(kSigmoid), output_dim(0), param(0.0) { }
+  };
+
+  // One term of the affine part of a step: the product of the input rows
+  // "row_offset" onward, columns "col_offset" to "col_offset + linear.NumCols()
+  // - 1", with linear^T.
+  struct Term {
+    int32 row_offset;
+    int32 col_offset;
+    Matrix<BaseFloat> linear;
+  };
+
+  struct Step {
+    std::string name;
+    // If "component" is non-NULL this step is just component->Propagate().
+    const Component *component;
+    int32 input_dim;
+    int32 output_dim;
+    // The number of input rows minus the number of output rows.
+    int32 context;
+    // If "terms" is empty there is no affine part; the ops are applied to
+    // (a copy of) the input.
+    std::vector<Term> terms;
+    Vector<BaseFloat> bias;
+    int32 affine_dim;  // output dim of the affine part (or input_dim).
+    std::vector<Op> ops;
+    // The ops before this index are done on the affine output, in the
+    // scratch block, and op "scratch_ops" (a kPnorm) writes to the output; or
+    // scratch_ops == ops.size() if there is no change of dimension.
+    int32 scratch_ops;
+    int32 block_rows;
+    Step(): component(NULL), input_dim(0), output_dim(0), context(0),
+            affine_dim(0), scratch_ops(0), block_rows(0) { }
+  };
+
+  // Returns true and outputs the parameters if "c" is an affine component.
+  static bool GetAffineParams(const Component &c, Matrix<BaseFloat> *linear,
+                              Vector<BaseFloat> *bias);
+
+  // Returns true and fills in "op" if component "c" can be done as a
+  // row-wise op.
+  static bool GetOp(const Component &c, Op *op);
+
+  // Adds the timings of one computer.
+  void AddTimes(const std::vector<double> &step_times, int64 num_frames) const;
+
+  int32 input_dim_;
+  int32 output_dim_;
+  int32 left_context_;
+  int32 right_context_;
+  std::vector<Step> steps_;
+  // Components we keep for fallback steps (copies of those in the Nnet).
+  std::vector<Component*> owned_components_;
+
+  mutable Mutex timing_mutex_;
+  mutable std::vector<double> step_times_;
+  mutable int64 num_frames_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(NnetCpuPlan);
+};
+
+
+/**
+   NnetCpuComputer does the computation of an NnetCpuPlan.  It keeps the
+   buffers between calls, so it should be kept for as long as possible; but
+   it may only be used by one thread at a time.  When it is destroyed its
+   timings are added to those of the plan.
+*/
+class NnetCpuComputer {
+ public:
+  explicit NnetCpuComputer(const NnetCpuPlan &plan);
+
+  /// Does the same as NnetComputation() in nnet-compute.h.  If pad_input ==
+  /// true the first and last frames are duplicated to provide the context, and
+  /// "output" must have as many rows as "input"; otherwise it must have
+  /// plan.LeftContext() + plan.RightContext() fewer rows.
+  void Compute(const MatrixBase<BaseFloat> &input, bool pad_input,
+               MatrixBase<BaseFloat> *output);
+
+  ~NnetCpuComputer();
+
+ private:
+  typedef NnetCpuPlan::Step Step;
+
+  // Does step "s" of the plan.  "output" has input.NumRows() - s.context rows.
+  void DoStep(const Step &s, const MatrixBase<BaseFloat> &input,
+              MatrixBase<BaseFloat> *output);
+
+  // Does the ops of step "s" from "begin" to "end" - 1, in place.
+  void DoOpsInPlace(const Step &s, int32 begin, int32 end,
+                    MatrixBase<BaseFloat> *data);
+
+  // Returns a "num_rows" by "num_cols" view of buffer "b", resizing it if
+  // it's too small.
+  SubMatrix<BaseFloat> GetBuffer(int32 b, int32 num_rows, int32 num_cols);
+
+  const NnetCpuPlan &plan_;
+  Matrix<BaseFloat> buffers_[2];  // the ping-pong buffers.
+  Matrix<BaseFloat> scratch_;  // one block of the affine output, for kPnorm.
+  Vector<BaseFloat> row_norms_;  // for kNormalize.
+  std::vector<double> step_times_;
+  int64 num_frames_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(NnetCpuComputer);
+};
+
+
+} // namespace nnet2
+} // namespace kaldi
+
+#endif // KALDI_NNET2_NNET_COMPUTE_CPU_H_
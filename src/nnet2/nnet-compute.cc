@@ -164,6 +164,23 @@ void NnetComputation(const Nnet &nnet,
   output->CopyFromMat(nnet_computer.GetOutput());
 }
 
+void NnetComputationChunks(const Nnet &nnet,
+                           const CuMatrixBase<BaseFloat> &input,
+                           int32 num_chunks,
+                           CuMatrixBase<BaseFloat> *output) {
+  KALDI_ASSERT(num_chunks > 0 && input.NumRows() % num_chunks == 0);
+  if (input.NumCols() != nnet.InputDim()) {
+    KALDI_ERR << "Feature dimension is " << input.NumCols()
+              << " but network expects " << nnet.InputDim();
+  }
+  CuMatrix<BaseFloat> cur_input(input), cur_output;
+  for (int32 c = 0; c < nnet.NumComponents(); c++) {
+    nnet.GetComponent(c).Propagate(cur_input, num_chunks, &cur_output);
+    cur_input.Swap(&cur_output);
+  }
+  output->CopyFromMat(cur_input);
+}
+
 BaseFloat NnetGradientComputation(const Nnet &nnet,
                                   const CuMatrixBase<BaseFloat> &input,
                                   bool pad_input,
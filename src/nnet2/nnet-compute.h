@@ -46,6 +46,20 @@ void NnetComputation(const Nnet &nnet,
                      bool pad_input,
                      CuMatrixBase<BaseFloat> *output); // posteriors.
 
+/**
+  Does the forward computation for a batch of "num_chunks" separate pieces of
+  input of equal length, stacked one after another in the rows of "input"
+  (e.g. one piece from each of several audio streams).  No padding is done:
+  each piece must include nnet.LeftContext() and nnet.RightContext() frames of
+  context, and the output has that many fewer rows per piece, i.e. "output"
+  must have num_chunks * (input.NumRows() / num_chunks - nnet.LeftContext() -
+  nnet.RightContext()) rows.
+*/
+void NnetComputationChunks(const Nnet &nnet,
+                           const CuMatrixBase<BaseFloat> &input,  // features
+                           int32 num_chunks,
+                           CuMatrixBase<BaseFloat> *output); // posteriors.
+
 /** Does the neural net computation and backprop, given input and labels.
     Note: if pad_input==true the number of rows of input should be the
     same as the number of labels, and if false, you should omit
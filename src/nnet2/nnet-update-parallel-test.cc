@@ -0,0 +1,139 @@
+// nnet2/nnet-update-parallel-test.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <unistd.h>
+
+#include "nnet2/nnet-update.h"
+#include "nnet2/nnet-update-parallel.h"
+
+namespace kaldi {
+namespace nnet2 {
+
+// Returns "num_egs" random single-frame examples for "nnet".
+void GenRandomExamples(const Nnet &nnet, int32 num_egs,
+                       std::vector<NnetExample> *egs) {
+  int32 num_rows = nnet.LeftContext() + 1 + nnet.RightContext();
+  egs->resize(num_egs);
+  for (int32 i = 0; i < num_egs; i++) {
+    NnetExample &eg = (*egs)[i];
+    Matrix<BaseFloat> input(num_rows, nnet.InputDim());
+    input.SetRandn();
+    eg.input_frames = CompressedMatrix(input);
+    eg.left_context = nnet.LeftContext();
+    eg.SetLabelSingle(rand() % nnet.OutputDim(), 0.5 + RandUniform());
+  }
+}
+
+// Does on one thread what DoBackpropParallelAveraged() should do: in rounds
+// of num_threads * average_interval minibatches, replica t starts from "nnet"
+// and does SGD on minibatches t, t + num_threads, ... of the round, and "nnet"
+// is then set to the average of the replicas.  With num_threads == 1 this is
+// plain SGD on the minibatches in order.
+void DoBackpropAveragedSerial(const std::vector<NnetExample> &egs,
+                              int32 minibatch_size, int32 average_interval,
+                              int32 num_threads, Nnet *nnet) {
+  std::vector<std::vector<NnetExample> > minibatches;
+  for (size_t i = 0; i < egs.size(); i += minibatch_size)
+    minibatches.push_back(std::vector<NnetExample>(
+        egs.begin() + i,
+        egs.begin() + std::min(egs.size(), i + minibatch_size)));
+  int32 num_minibatches = minibatches.size(),
+      round_size = num_threads * average_interval;
+  for (int32 begin = 0; begin < num_minibatches; begin += round_size) {
+    int32 end = std::min(num_minibatches, begin + round_size),
+        num_replicas = std::min(num_threads, end - begin);
+    Nnet sum(*nnet);
+    Vector<BaseFloat> scales(nnet->NumUpdatableComponents());
+    sum.ScaleComponents(scales);  // Sets the parameters to zero.
+    scales.Set(1.0 / num_replicas);
+    for (int32 r = 0; r < num_replicas; r++) {
+      Nnet replica(*nnet);
+      for (int32 m = begin + r; m < end; m += num_threads)
+        DoBackprop(replica, minibatches[m], &replica);
+      sum.AddNnet(scales, replica);
+    }
+    *nnet = sum;
+  }
+}
+
+void UnitTestDoBackpropParallelAveraged() {
+  int32 input_dim = 5 + rand() % 10, output_dim = 3 + rand() % 10;
+  Nnet *nnet = GenRandomNnet(input_dim, output_dim);
+  // A larger learning rate than GenRandomNnet's, so that the parameters
+  // change noticeably.
+  nnet->SetLearningRates(0.01);
+
+  int32 num_egs = 20 + rand() % 100;
+  std::vector<NnetExample> egs;
+  GenRandomExamples(*nnet, num_egs, &egs);
+  {
+    NnetExampleWriter writer("ark:tmp.egs");
+    for (int32 i = 0; i < num_egs; i++) {
+      std::ostringstream key;
+      key << i;
+      writer.Write(key.str(), egs[i]);
+    }
+  }
+
+  NnetDataParallelConfig config;
+  config.average_interval = 1 + rand() % 3;
+  config.numa_aware = (rand() % 2 == 0);
+  int32 minibatch_size = 1 + rand() % 10,
+      num_threads = (rand() % 2 == 0 ? 1 : 2 + rand() % 3);
+
+  Nnet serial_nnet(*nnet), parallel_nnet(*nnet);
+  DoBackpropAveragedSerial(egs, minibatch_size, config.average_interval,
+                           num_threads, &serial_nnet);
+  double tot_weight;
+  {
+    SequentialNnetExampleReader reader("ark:tmp.egs");
+    DoBackpropParallelAveraged(config, minibatch_size, num_threads, &reader,
+                               &tot_weight, &parallel_nnet);
+  }
+  double expected_weight = 0.0;
+  for (int32 i = 0; i < num_egs; i++)
+    expected_weight += egs[i].labels[0].second;
+  KALDI_ASSERT(ApproxEqual(tot_weight, expected_weight));
+
+  int32 dim = nnet->GetParameterDim();
+  Vector<BaseFloat> params(dim), serial_params(dim), parallel_params(dim);
+  nnet->Vectorize(&params);
+  serial_nnet.Vectorize(&serial_params);
+  parallel_nnet.Vectorize(&parallel_params);
+  serial_params.AddVec(-1.0, params);  // The change made by training.
+  parallel_params.AddVec(-1.0, params);
+  KALDI_ASSERT(serial_params.Norm(2.0) > 0.0);
+  parallel_params.AddVec(-1.0, serial_params);
+  KALDI_ASSERT(parallel_params.Norm(2.0) <= 1.0e-03 * serial_params.Norm(2.0));
+
+  unlink("tmp.egs");
+  delete nnet;
+}
+
+}  // namespace nnet2
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  using namespace kaldi::nnet2;
+  for (int32 i = 0; i < 10; i++)
+    UnitTestDoBackpropParallelAveraged();
+  KALDI_LOG << "Test OK.";
+  return 0;
+}
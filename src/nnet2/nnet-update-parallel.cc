@@ -21,6 +21,8 @@
 #include "nnet2/nnet-update.h"
 #include "thread/kaldi-thread.h"
 #include "thread/kaldi-mutex.h"
+#include "thread/kaldi-affinity.h"
+#include "base/timer.h"
 #include <numeric>
 
 namespace kaldi {
@@ -199,6 +201,165 @@ double DoBackpropParallel(const Nnet &nnet,
 }
 
 
+// This class is used by DoBackpropParallelAveraged() for one round of
+// training: thread t sets replica t to "nnet" and trains it on minibatches t,
+// t + num_threads, ...
+class DoBackpropAveragedClass: public MultiThreadable {
+ public:
+  DoBackpropAveragedClass(
+      const Nnet &nnet,
+      bool numa_aware,
+      const std::vector<std::vector<NnetExample> > &minibatches,
+      std::vector<Nnet*> *replicas,
+      double *tot_weight_ptr,
+      double *log_prob_ptr):
+      nnet_(nnet), numa_aware_(numa_aware), minibatches_(minibatches),
+      replicas_(replicas), tot_weight_ptr_(tot_weight_ptr),
+      log_prob_ptr_(log_prob_ptr), tot_weight_(0.0), log_prob_(0.0) { }
+
+  void operator () () {
+    if (static_cast<size_t>(thread_id_) >= minibatches_.size())
+      return;  // Nothing to do in this (final, partial) round.
+    if (numa_aware_) {
+      // The replica is allocated or copied to after binding to the NUMA node,
+      // so its memory is local to the node.  Thread t always binds to the
+      // same node.  The binding is undone when "binding" goes out of scope,
+      // also if TrainReplica() throws.
+      ScopedNumaBinding binding(thread_id_);
+      TrainReplica();
+    } else {
+      TrainReplica();
+    }
+  }
+
+  ~DoBackpropAveragedClass() {
+    *tot_weight_ptr_ += tot_weight_;
+    *log_prob_ptr_ += log_prob_;
+  }
+ private:
+  // Sets this thread's replica to "nnet" and trains it on its minibatches.
+  void TrainReplica() {
+    Nnet *&replica = (*replicas_)[thread_id_];
+    if (replica == NULL)
+      replica = new Nnet(nnet_);
+    else
+      *replica = nnet_;
+    replica->ZeroStats();  // So that the stats can be summed.
+    for (size_t i = thread_id_; i < minibatches_.size(); i += num_threads_) {
+      log_prob_ += DoBackprop(*replica, minibatches_[i], replica);
+      tot_weight_ += TotalNnetTrainingWeight(minibatches_[i]);
+    }
+  }
+
+  const Nnet &nnet_;
+  bool numa_aware_;
+  const std::vector<std::vector<NnetExample> > &minibatches_;
+  std::vector<Nnet*> *replicas_;
+  double *tot_weight_ptr_;
+  double *log_prob_ptr_;
+  double tot_weight_;
+  double log_prob_;
+};
+
+// Reads up to "num_minibatches" minibatches of examples.
+static void ReadMinibatches(int32 minibatch_size,
+                            int32 num_minibatches,
+                            SequentialNnetExampleReader *example_reader,
+                            std::vector<std::vector<NnetExample> > *minibatches) {
+  minibatches->clear();
+  while (minibatches->size() < static_cast<size_t>(num_minibatches) &&
+         !example_reader->Done()) {
+    minibatches->resize(minibatches->size() + 1);
+    std::vector<NnetExample> &examples = minibatches->back();
+    examples.reserve(minibatch_size);
+    for (; examples.size() < static_cast<size_t>(minibatch_size) &&
+             !example_reader->Done(); example_reader->Next())
+      examples.push_back(example_reader->Value());
+  }
+}
+
+// Sets the parameters of the updatable components of "nnet" to the average of
+// those of the first "num_replicas" replicas, and adds the replicas' stats to
+// the stats of "nnet".
+static void AverageReplicas(const std::vector<Nnet*> &replicas,
+                            int32 num_replicas,
+                            Nnet *nnet) {
+  KALDI_ASSERT(num_replicas > 0);
+  Vector<BaseFloat> scales(nnet->NumUpdatableComponents());
+  nnet->ScaleComponents(scales);  // Sets the parameters to zero.
+  scales.Set(1.0 / num_replicas);
+  for (int32 r = 0; r < num_replicas; r++) {
+    const Nnet &replica = *(replicas[r]);
+    nnet->AddNnet(scales, replica);
+    for (int32 c = 0; c < nnet->NumComponents(); c++) {
+      NonlinearComponent *nc =
+          dynamic_cast<NonlinearComponent*>(&(nnet->GetComponent(c)));
+      if (nc != NULL)
+        nc->Add(1.0, dynamic_cast<const NonlinearComponent&>(
+            replica.GetComponent(c)));
+    }
+  }
+}
+
+
+double DoBackpropParallelAveraged(const NnetDataParallelConfig &config,
+                                  int32 minibatch_size,
+                                  int32 num_threads,
+                                  SequentialNnetExampleReader *example_reader,
+                                  double *tot_weight,
+                                  Nnet *nnet) {
+  KALDI_ASSERT(config.average_interval > 0 && minibatch_size > 0 &&
+               num_threads > 0);
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    KALDI_WARN << "Model averaging is not supported with a GPU; doing "
+               << "ordinary SGD.";
+    return DoBackpropParallel(*nnet, minibatch_size, example_reader,
+                              tot_weight, nnet);
+  }
+#endif
+  if (config.numa_aware)
+    KALDI_LOG << "Spreading the threads over " << NumNumaNodes()
+              << " NUMA node(s).";
+
+  int32 round_size = num_threads * config.average_interval;
+  std::vector<Nnet*> replicas(num_threads, NULL);
+  std::vector<std::vector<NnetExample> > minibatches, next_minibatches;
+  double tot_log_prob = 0.0, averaging_time = 0.0;
+  int32 num_rounds = 0;
+  *tot_weight = 0.0;
+
+  ReadMinibatches(minibatch_size, round_size, example_reader, &minibatches);
+  while (!minibatches.empty()) {
+    {
+      DoBackpropAveragedClass c(*nnet, config.numa_aware, minibatches,
+                                &replicas, tot_weight, &tot_log_prob);
+      // The initialization of the following class starts the jobs; while they
+      // run, we read the examples for the next round.  Its destructor waits
+      // for them.
+      MultiThreader<DoBackpropAveragedClass> m(num_threads, c);
+      ReadMinibatches(minibatch_size, round_size, example_reader,
+                      &next_minibatches);
+    }
+    Timer timer;
+    AverageReplicas(replicas, std::min<int32>(num_threads, minibatches.size()),
+                    nnet);
+    averaging_time += timer.Elapsed();
+    num_rounds++;
+    minibatches.swap(next_minibatches);
+  }
+  DeletePointers(&replicas);
+
+  KALDI_LOG << "Did backprop on " << *tot_weight << " examples in "
+            << num_rounds << " rounds of model averaging (" << averaging_time
+            << " seconds spent averaging), average log-prob per frame is "
+            << (tot_log_prob / *tot_weight);
+  KALDI_LOG << "[this line is to be parsed by a script:] log-prob-per-frame="
+            << (tot_log_prob / *tot_weight);
+  return tot_log_prob;
+}
+
+
 double DoBackpropSingleThreaded(const Nnet &nnet,
                                 int32 minibatch_size,
                                 const std::vector<NnetExample> &egs,
@@ -63,6 +63,42 @@ double DoBackpropParallel(const Nnet &nnet,
 
 
 
+/// Configuration for DoBackpropParallelAveraged().
+struct NnetDataParallelConfig {
+  int32 average_interval;
+  bool numa_aware;
+
+  NnetDataParallelConfig(): average_interval(0), numa_aware(false) { }
+
+  void Register(OptionsItf *po) {
+    po->Register("average-interval", &average_interval, "If >0, instead of "
+                 "the Hogwild update, each thread trains its own copy of the "
+                 "model on this many minibatches, and then the copies are "
+                 "averaged (synchronous data-parallel training).");
+    po->Register("numa-aware", &numa_aware, "If true (and --average-interval "
+                 "> 0), bind the threads to NUMA nodes in turn, so that each "
+                 "model copy stays in memory local to the thread training it.");
+  }
+};
+
+/// This is a synchronous, data-parallel alternative to the Hogwild update done
+/// by DoBackpropParallel() when nnet_to_update == &nnet, which scales badly to
+/// large numbers of threads because they all write to the same parameters.
+/// Each of "num_threads" threads keeps its own replica of "nnet".  The examples
+/// are read in rounds of num_threads * config.average_interval minibatches;
+/// in each round, each replica starts from the current "nnet" and does SGD on
+/// its share of the minibatches, and then "nnet" is set to the average of the
+/// replicas' parameters (as nnet-am-average would do).  The stats of the
+/// nonlinear components are summed over the replicas, not averaged.  Returns
+/// the total log-prob of the examples and outputs their total weight.
+double DoBackpropParallelAveraged(const NnetDataParallelConfig &config,
+                                  int32 minibatch_size,
+                                  int32 num_threads,
+                                  SequentialNnetExampleReader *example_reader,
+                                  double *tot_weight,
+                                  Nnet *nnet);
+
+
 /// This is basically to clarify the fact that DoBackpropParallel will
 /// also work with nnet_to_update == NULL, and will compute the objf.
 /// Both versions of the function will support it, but this
@@ -82,8 +82,23 @@ void UnitTestNnetDecodable() {
                                     opts.pad_input,
                                     opts.acoustic_scale);
 
+  // The same two, with the computation done by NnetCpuComputer.
+  NnetCpuPlan cpu_plan(am_nnet.GetNnet());
+  NnetCpuComputer cpu_computer(cpu_plan);
+  OnlineMatrixFeature matrix_feature2(input_feats);
+  DecodableNnet2Online online_cpu_decodable(am_nnet, trans_model,
+                                            opts, &matrix_feature2,
+                                            &cpu_computer);
+  DecodableAmNnet offline_cpu_decodable(trans_model, am_nnet,
+                                        CuMatrix<BaseFloat>(input_feats),
+                                        &cpu_computer,
+                                        opts.pad_input,
+                                        opts.acoustic_scale);
+
   KALDI_ASSERT(online_decodable.NumFramesReady() ==
                offline_decodable.NumFramesReady());
+  KALDI_ASSERT(online_cpu_decodable.NumFramesReady() ==
+               offline_cpu_decodable.NumFramesReady());
   int32 num_frames = online_decodable.NumFramesReady(),
       num_tids = trans_model.NumTransitionIds();
   
@@ -91,8 +106,11 @@ void UnitTestNnetDecodable() {
 
     int32 t = rand() % num_frames, tid = 1 + rand() % num_tids;
     BaseFloat l1 = online_decodable.LogLikelihood(t, tid),
-        l2 = offline_decodable.LogLikelihood(t, tid);
+        l2 = offline_decodable.LogLikelihood(t, tid),
+        l3 = online_cpu_decodable.LogLikelihood(t, tid),
+        l4 = offline_cpu_decodable.LogLikelihood(t, tid);
     KALDI_ASSERT(ApproxEqual(l1, l2));
+    KALDI_ASSERT(ApproxEqual(l1, l3) && ApproxEqual(l1, l4));
   }
 }
 
@@ -26,9 +26,11 @@ DecodableNnet2Online::DecodableNnet2Online(
     const AmNnet &nnet,
     const TransitionModel &trans_model,
     const DecodableNnet2OnlineOptions &opts,
-    OnlineFeatureInterface *input_feats):
+    OnlineFeatureInterface *input_feats,
+    NnetCpuComputer *cpu_computer):
     features_(input_feats),
     nnet_(nnet),
+    cpu_computer_(cpu_computer),
     trans_model_(trans_model),
     opts_(opts),
     feat_dim_(input_feats->Dim()),
@@ -42,6 +44,10 @@ DecodableNnet2Online::DecodableNnet2Online(
                "Priors in neural network not set up (or mismatch "
                "with transition model).");
   log_priors_.ApplyLog();
+  if (cpu_computer_ != NULL) {
+    log_priors_cpu_.Resize(log_priors_.Dim(), kUndefined);
+    log_priors_.CopyToVec(&log_priors_cpu_);
+  }
 }
 
 
@@ -112,13 +118,25 @@ void DecodableNnet2Online::ComputeForFrame(int32 frame) {
       t_modified = features_ready - 1;
     features_->GetFrame(t_modified, &row);
   }
+  int32 num_frames_out = input_frame_end - input_frame_begin -
+      left_context_ - right_context_;
+
+  if (cpu_computer_ != NULL) {
+    // Everything stays in system memory.
+    scaled_loglikes_.Resize(num_frames_out, num_pdfs_, kUndefined);
+    cpu_computer_->Compute(features, false, &scaled_loglikes_);
+    scaled_loglikes_.ApplyFloor(1.0e-20);
+    scaled_loglikes_.ApplyLog();
+    scaled_loglikes_.AddVecToRows(-1.0, log_priors_cpu_);
+    scaled_loglikes_.Scale(opts_.acoustic_scale);
+    begin_frame_ = frame;
+    return;
+  }
+
   CuMatrix<BaseFloat> cu_features; 
   cu_features.Swap(&features);  // Copy to GPU, if we're using one.
   
 
-  int32 num_frames_out = input_frame_end - input_frame_begin -
-      left_context_ - right_context_;
-  
   CuMatrix<BaseFloat> cu_posteriors(num_frames_out, num_pdfs_);
   
   // The "false" below tells it not to pad the input: we've already done
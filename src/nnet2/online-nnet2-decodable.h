@@ -25,6 +25,7 @@
 #include "itf/decodable-itf.h"
 #include "nnet2/am-nnet.h"
 #include "nnet2/nnet-compute.h"
+#include "nnet2/nnet-compute-cpu.h"
 #include "hmm/transition-model.h"
 
 namespace kaldi {
@@ -57,10 +58,14 @@ struct DecodableNnet2OnlineOptions {
 
 class DecodableNnet2Online: public DecodableInterface {
  public:
+  /// If "cpu_computer" is non-NULL the neural net computation is done with it
+  /// (see nnet-compute-cpu.h) instead of with NnetComputation(); it must have
+  /// been set up with the network in "nnet", and must outlive this object.
   DecodableNnet2Online(const AmNnet &nnet,
                        const TransitionModel &trans_model,
                        const DecodableNnet2OnlineOptions &opts,
-                       OnlineFeatureInterface *input_feats);
+                       OnlineFeatureInterface *input_feats,
+                       NnetCpuComputer *cpu_computer = NULL);
   
   
   /// Returns the scaled log likelihood
@@ -81,9 +86,11 @@ class DecodableNnet2Online: public DecodableInterface {
   
   OnlineFeatureInterface *features_;
   const AmNnet &nnet_;
+  NnetCpuComputer *cpu_computer_;  // May be NULL.
   const TransitionModel &trans_model_;
   DecodableNnet2OnlineOptions opts_;
   CuVector<BaseFloat> log_priors_;  // log-priors taken from the model.
+  Vector<BaseFloat> log_priors_cpu_;  // the same, if cpu_computer_ != NULL.
   int32 feat_dim_;  // dimensionality of the input features.
   int32 left_context_;  // Left context of the network (cached here)
   int32 right_context_;  // Right context of the network (cached here)
@@ -46,15 +46,20 @@ int main(int argc, char *argv[]) {
         " <lattice-wspecifier> [ <words-wspecifier> [<alignments-wspecifier>] ]\n";
     ParseOptions po(usage);
     Timer timer;
-    bool allow_partial = false;
+    bool allow_partial = false, use_cpu_plan = false;
     BaseFloat acoustic_scale = 0.1;
     LatticeFasterDecoderConfig config;
+    NnetCpuComputeOptions cpu_opts;
     
     std::string word_syms_filename;
     config.Register(&po);
+    cpu_opts.Register(&po);
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
     po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
     po.Register("allow-partial", &allow_partial, "If true, produce output even if end state was not reached.");
+    po.Register("use-cpu-plan", &use_cpu_plan, "If true, do the neural net "
+                "computation with the fused CPU code in nnet2/nnet-compute-cpu.h, "
+                "and print the time taken by each of its steps at the end.");
     
     po.Read(argc, argv);
     
@@ -79,6 +84,13 @@ int main(int argc, char *argv[]) {
       am_nnet.Read(ki.Stream(), binary);
     }
 
+    NnetCpuPlan *cpu_plan = NULL;
+    NnetCpuComputer *cpu_computer = NULL;
+    if (use_cpu_plan) {
+      cpu_plan = new NnetCpuPlan(am_nnet.GetNnet(), cpu_opts);
+      cpu_computer = new NnetCpuComputer(*cpu_plan);
+    }
+
     bool determinize = config.determinize_lattice;
     CompactLatticeWriter compact_lattice_writer;
     LatticeWriter lattice_writer;
@@ -106,7 +118,7 @@ int main(int argc, char *argv[]) {
       SequentialBaseFloatCuMatrixReader feature_reader(feature_rspecifier);
       
       // Input FST is just one FST, not a table of FSTs.
-      VectorFst<StdArc> *decode_fst = fst::ReadFstKaldi(fst_in_str);
+      fst::Fst<StdArc> *decode_fst = fst::ReadFstKaldiGeneric(fst_in_str);
 
       {
         LatticeFasterDecoder decoder(*decode_fst, config);
@@ -123,6 +135,7 @@ int main(int argc, char *argv[]) {
           DecodableAmNnet nnet_decodable(trans_model,
                                          am_nnet,
                                          features,
+                                         cpu_computer,
                                          pad_input,
                                          acoustic_scale);
           double like;
@@ -162,6 +175,7 @@ int main(int argc, char *argv[]) {
         DecodableAmNnet nnet_decodable(trans_model,
                                        am_nnet,
                                        features,
+                                       cpu_computer,
                                        pad_input,
                                        acoustic_scale);
         double like;
@@ -177,6 +191,12 @@ int main(int argc, char *argv[]) {
       }
     }
       
+    if (cpu_plan != NULL) {
+      delete cpu_computer;  // this adds its timings to the plan.
+      cpu_plan->PrintTimingReport();
+      delete cpu_plan;
+    }
+
     double elapsed = timer.Elapsed();
     KALDI_LOG << "Time taken "<< elapsed
               << "s: real-time factor assuming 100 frames/sec is "
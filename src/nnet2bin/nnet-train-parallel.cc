@@ -18,6 +18,7 @@
 // limitations under the License.
 
 #include "base/kaldi-common.h"
+#include "base/timer.h"
 #include "util/common-utils.h"
 #include "hmm/transition-model.h"
 #include "nnet2/nnet-update-parallel.h"
@@ -35,16 +36,21 @@ int main(int argc, char *argv[]) {
         "Train the neural network parameters with backprop and stochastic\n"
         "gradient descent using minibatches.  As nnet-train-simple, but\n"
         "uses multiple threads in a Hogwild type of update (for CPU, not GPU).\n"
+        "With --average-interval > 0, the threads instead train separate copies\n"
+        "of the model that are averaged every --average-interval minibatches.\n"
         "\n"
         "Usage:  nnet-train-parallel [options] <model-in> <training-examples-in> <model-out>\n"
         "\n"
         "e.g.:\n"
-        "nnet-train-parallel --num-threads=8 1.nnet ark:1.1.egs 2.nnet\n";
+        "nnet-train-parallel --num-threads=8 1.nnet ark:1.1.egs 2.nnet\n"
+        "nnet-train-parallel --num-threads=64 --average-interval=4 --numa-aware=true \\\n"
+        "  1.nnet ark:1.1.egs 2.nnet\n";
     
     bool binary_write = true;
     bool zero_stats = true;
     int32 minibatch_size = 1024;
     int32 srand_seed = 0;
+    NnetDataParallelConfig parallel_config;
     
     ParseOptions po(usage);
     po.Register("binary", &binary_write, "Write output in binary mode");
@@ -57,6 +63,7 @@ int main(int argc, char *argv[]) {
                 "implementation of BLAS, the actual number of threads may be larger.]");
     po.Register("minibatch-size", &minibatch_size, "Number of examples to use for "
                 "each minibatch during training.");
+    parallel_config.Register(&po);
     
     po.Read(argc, argv);
     srand(srand_seed);
@@ -87,11 +94,24 @@ int main(int argc, char *argv[]) {
     SequentialNnetExampleReader example_reader(examples_rspecifier);
     
 
-    DoBackpropParallel(am_nnet.GetNnet(),
-                       minibatch_size,
-                       &example_reader,
-                       &num_examples,
-                       &(am_nnet.GetNnet()));
+    Timer timer;
+    if (parallel_config.average_interval > 0)
+      DoBackpropParallelAveraged(parallel_config,
+                                 minibatch_size,
+                                 g_num_threads,
+                                 &example_reader,
+                                 &num_examples,
+                                 &(am_nnet.GetNnet()));
+    else
+      DoBackpropParallel(am_nnet.GetNnet(),
+                         minibatch_size,
+                         &example_reader,
+                         &num_examples,
+                         &(am_nnet.GetNnet()));
+    double elapsed = timer.Elapsed();
+    KALDI_LOG << "Training with " << g_num_threads << " threads took "
+              << elapsed << " seconds, " << (num_examples / elapsed)
+              << " frames per second.";
     
     {
       Output ko(nnet_wxfilename, binary_write);
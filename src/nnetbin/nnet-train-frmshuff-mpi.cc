@@ -98,6 +98,9 @@ int main(int argc, char *argv[]) {
 
     std::string reduce_content = "model";
     po.Register("reduce-content", &reduce_content, "Reduce model, gradient, momentum or all (including model and momentum) (default = model)");
+
+    bool overlap_reduce = false;
+    po.Register("overlap-reduce", &overlap_reduce, "With --reduce-type=allreduce, do the averaging in the background while training on the next minibatch, and then add the local update of that minibatch to the average (not for --reduce-content=gradient)");
     
     
     po.Read(argc, argv);
@@ -124,6 +127,10 @@ int main(int argc, char *argv[]) {
       // we only support 2^N jobs for butterfly mixing
       KALDI_ASSERT(is_power_of_two(mpi_jobs));
     }
+    if (overlap_reduce && (reduce_type != "allreduce" || reduce_content == "gradient")) {
+      KALDI_ERR << "--overlap-reduce=true needs --reduce-type=allreduce and "
+                << "--reduce-content other than gradient";
+    }
 
     std::string rank_str;
     {
@@ -197,6 +204,9 @@ int main(int argc, char *argv[]) {
     
     CuMatrix<BaseFloat> feats_transf, nnet_out, obj_diff;
 
+    MpiReduceTransport transport;
+    NnetModelAverager averager(&transport, &nnet);
+
     Timer time;
     Timer mpi_timer;
     double mpi_time = 0;
@@ -353,6 +363,14 @@ int main(int argc, char *argv[]) {
           }
        }
 
+        // finish the averaging started after the previous minibatch, which
+        // ran while we were training on this one
+        if (averager.InProgress()) {
+          mpi_timer.Reset();
+          averager.Finish();
+          mpi_time += mpi_timer.Elapsed();
+        }
+
         // 1st minibatch : show what happens in network 
         if (kaldi::g_kaldi_verbose_level >= 1 && total_frames == 0 && mpi_rank == 0) { // vlog-1
           KALDI_VLOG(1) << "### After " << total_frames << " frames,";
@@ -396,10 +414,13 @@ int main(int argc, char *argv[]) {
             if (mpi_rank == 0)
               KALDI_LOG << "### MPI " << reduce_type << " reducing after " << total_frames+nnet_in.NumRows() << " frames.";
             
-            nnet.PrepSendBuffer();
+            if (!overlap_reduce)
+              nnet.PrepSendBuffer();  // (the averager does this itself)
             if (reduce_type == "butterfly") {
               int32 friend_id = get_butterfly_friend_id(mpi_rank, mpi_jobs, reduce_count);
               share_nnet_buffer(nnet, mpi_rank, friend_id, friend_id);
+            } else if (reduce_type == "allreduce" && overlap_reduce) {
+              averager.Start();  // finished after the next minibatch
             } else if (reduce_type == "allreduce") {
               all_reduce_nnet_buffer(nnet, mpi_jobs);
             } else if (reduce_type == "ring") {
@@ -430,6 +451,12 @@ int main(int argc, char *argv[]) {
       }
     }
 
+    if (averager.InProgress()) {
+      mpi_timer.Reset();
+      averager.Finish();
+      mpi_time += mpi_timer.Elapsed();
+    }
+
     // Avoid WARNINGs from pipe
     feature_reader.Close();
     targets_reader.Close();
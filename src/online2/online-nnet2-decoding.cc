@@ -28,11 +28,13 @@ SingleUtteranceNnet2Decoder::SingleUtteranceNnet2Decoder(
     const TransitionModel &tmodel,
     const nnet2::AmNnet &model,
     const fst::Fst<fst::StdArc> &fst,
-    OnlineNnet2FeaturePipeline *feature_pipeline):
+    OnlineNnet2FeaturePipeline *feature_pipeline,
+    nnet2::NnetCpuComputer *cpu_computer):
     config_(config),
     feature_pipeline_(feature_pipeline),
     tmodel_(tmodel),
-    decodable_(model, tmodel, config.decodable_opts, feature_pipeline),
+    decodable_(model, tmodel, config.decodable_opts, feature_pipeline,
+               cpu_computer),
     decoder_(fst, config.decoder_opts) {
   decoder_.InitDecoding();
 }
@@ -68,11 +68,14 @@ class SingleUtteranceNnet2Decoder {
  public:
   // Constructor.  The feature_pipeline_ pointer is not owned in this
   // class, it's owned externally.
+  /// If "cpu_computer" is non-NULL it is used for the neural net computation
+  /// (see nnet2/nnet-compute-cpu.h).
   SingleUtteranceNnet2Decoder(const OnlineNnet2DecodingConfig &config,
                               const TransitionModel &tmodel,
                               const nnet2::AmNnet &model,
                               const fst::Fst<fst::StdArc> &fst,
-                              OnlineNnet2FeaturePipeline *feature_pipeline);
+                              OnlineNnet2FeaturePipeline *feature_pipeline,
+                              nnet2::NnetCpuComputer *cpu_computer = NULL);
   
   /// advance the decoding as far as we can.
   void AdvanceDecoding();
@@ -0,0 +1,502 @@
+// online2/online-nnet2-multi-stream.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstring>
+#include "online2/online-nnet2-multi-stream.h"
+#include "nnet2/nnet-compute.h"
+#include "lat/lattice-functions.h"
+#include "lat/determinize-lattice-pruned.h"
+
+namespace kaldi {
+
+void OnlineNnet2MultiStreamConfig::Check() {
+  KALDI_ASSERT(num_threads > 0 && num_threads <= ThreadPool::kMaxThreads);
+  KALDI_ASSERT(frames_per_chunk > 0);
+  KALDI_ASSERT(max_batch_streams > 0);
+}
+
+
+OnlineNnet2StreamDecoder::OnlineNnet2StreamDecoder(
+    OnlineNnet2MultiStreamEngine *engine,
+    const OnlineIvectorExtractorAdaptationState &adaptation_state):
+    engine_(engine), sampling_rate_(0.0), num_samples_received_(0),
+    input_finished_(false), feature_pipeline_(engine->feature_info_),
+    features_finished_(false), num_frames_computed_(0), chunk_frames_(0),
+    nnet_finished_(false), num_frames_decoded_(0),
+    decodable_(engine->tmodel_),
+    decoder_(engine->fst_, engine->config_.decoder_opts),
+    finished_(false), error_(false), waited_(false) {
+  feature_pipeline_.SetAdaptationState(adaptation_state);
+  decoder_.InitDecoding();
+}
+
+OnlineNnet2StreamDecoder::~OnlineNnet2StreamDecoder() {
+  // After this, the engine's threads won't touch this object.
+  engine_->RemoveStream(this);
+  DeletePointers(&input_waveform_);
+}
+
+void OnlineNnet2StreamDecoder::AcceptWaveform(
+    BaseFloat sampling_rate,
+    const VectorBase<BaseFloat> &wave_part) {
+  if (sampling_rate_ <= 0.0)
+    sampling_rate_ = sampling_rate;
+  else {
+    KALDI_ASSERT(sampling_rate == sampling_rate_);
+  }
+  num_samples_received_ += wave_part.Dim();
+
+  if (wave_part.Dim() == 0) return;
+  Vector<BaseFloat> *new_part = new Vector<BaseFloat>(wave_part);
+  input_mutex_.Lock();
+  KALDI_ASSERT(!input_finished_ &&
+               "AcceptWaveform called after InputFinished");
+  input_waveform_.push_back(new_part);
+  input_mutex_.Unlock();
+  engine_->NotifyInput();
+}
+
+void OnlineNnet2StreamDecoder::InputFinished() {
+  input_mutex_.Lock();
+  KALDI_ASSERT(!input_finished_ && "InputFinished called twice");
+  input_finished_ = true;
+  input_mutex_.Unlock();
+  engine_->NotifyInput();
+}
+
+bool OnlineNnet2StreamDecoder::IsFinished() const {
+  // we'll make an exception to the normal const rules, for mutexes, since
+  // we're not really changing the class.
+  const_cast<Mutex&>(decoder_mutex_).Lock();
+  bool ans = finished_;
+  const_cast<Mutex&>(decoder_mutex_).Unlock();
+  return ans;
+}
+
+void OnlineNnet2StreamDecoder::Wait() {
+  input_mutex_.Lock();
+  bool input_finished = input_finished_;
+  input_mutex_.Unlock();
+  if (!input_finished)
+    KALDI_ERR << "You cannot call Wait() before calling InputFinished().";
+  if (!waited_) {
+    finished_semaphore_.Wait();
+    waited_ = true;
+  }
+  if (error_)
+    KALDI_ERR << "Error encountered during decoding.  See above.";
+}
+
+void OnlineNnet2StreamDecoder::FinalizeDecoding() {
+  Wait();
+  decoder_mutex_.Lock();
+  decoder_.FinalizeDecoding();
+  decoder_mutex_.Unlock();
+}
+
+int32 OnlineNnet2StreamDecoder::NumFramesReceivedApprox() const {
+  if (sampling_rate_ <= 0.0) return 0;
+  return num_samples_received_ /
+      (sampling_rate_ * feature_pipeline_.FrameShiftInSeconds());
+}
+
+int32 OnlineNnet2StreamDecoder::NumFramesDecoded() const {
+  const_cast<Mutex&>(decoder_mutex_).Lock();
+  int32 ans = decoder_.NumFramesDecoded();
+  const_cast<Mutex&>(decoder_mutex_).Unlock();
+  return ans;
+}
+
+void OnlineNnet2StreamDecoder::GetLattice(
+    bool end_of_utterance,
+    CompactLattice *clat,
+    BaseFloat *final_relative_cost) const {
+  clat->DeleteStates();
+  const_cast<Mutex&>(decoder_mutex_).Lock();
+  if (final_relative_cost != NULL)
+    *final_relative_cost = decoder_.FinalRelativeCost();
+  if (decoder_.NumFramesDecoded() == 0) {
+    const_cast<Mutex&>(decoder_mutex_).Unlock();
+    clat->SetFinal(clat->AddState(),
+                   CompactLatticeWeight::One());
+    return;
+  }
+  Lattice raw_lat;
+  decoder_.GetRawLattice(&raw_lat, end_of_utterance);
+  const_cast<Mutex&>(decoder_mutex_).Unlock();
+
+  const LatticeFasterDecoderConfig &decoder_opts =
+      engine_->config_.decoder_opts;
+  if (!decoder_opts.determinize_lattice)
+    KALDI_ERR << "--determinize-lattice=false option is not supported at the moment";
+
+  DeterminizeLatticePhonePrunedWrapper(
+      engine_->tmodel_, &raw_lat, decoder_opts.lattice_beam, clat,
+      decoder_opts.det_opts);
+}
+
+void OnlineNnet2StreamDecoder::GetBestPath(
+    bool end_of_utterance,
+    Lattice *best_path,
+    BaseFloat *final_relative_cost) const {
+  const_cast<Mutex&>(decoder_mutex_).Lock();
+  if (decoder_.NumFramesDecoded() == 0) {
+    best_path->DeleteStates();
+    best_path->SetFinal(best_path->AddState(),
+                        LatticeWeight::One());
+    if (final_relative_cost != NULL)
+      *final_relative_cost = std::numeric_limits<BaseFloat>::infinity();
+  } else {
+    decoder_.GetBestPath(best_path,
+                         end_of_utterance);
+    if (final_relative_cost != NULL)
+      *final_relative_cost = decoder_.FinalRelativeCost();
+  }
+  const_cast<Mutex&>(decoder_mutex_).Unlock();
+}
+
+bool OnlineNnet2StreamDecoder::EndpointDetected(
+    const OnlineEndpointConfig &config) {
+  decoder_mutex_.Lock();
+  bool ans = kaldi::EndpointDetected(config, engine_->tmodel_,
+                                     feature_pipeline_.FrameShiftInSeconds(),
+                                     decoder_);
+  decoder_mutex_.Unlock();
+  return ans;
+}
+
+void OnlineNnet2StreamDecoder::GetAdaptationState(
+    OnlineIvectorExtractorAdaptationState *adaptation_state) {
+  if (!waited_)
+    KALDI_ERR << "You cannot call GetAdaptationState() before Wait().";
+  feature_pipeline_.GetAdaptationState(adaptation_state);
+}
+
+void OnlineNnet2StreamDecoder::SetFinished(bool error) {
+  decoder_mutex_.Lock();
+  if (error)
+    error_ = true;
+  bool was_finished = finished_;
+  finished_ = true;
+  decoder_mutex_.Unlock();
+  if (!was_finished)
+    finished_semaphore_.Signal();
+}
+
+void OnlineNnet2StreamDecoder::Process() {
+  // First decode any log-likelihoods computed in the previous round.
+  if (decodable_.NumFramesReady() > num_frames_decoded_) {
+    decoder_mutex_.Lock();
+    decoder_.AdvanceDecoding(&decodable_);
+    num_frames_decoded_ = decoder_.NumFramesDecoded();
+    decoder_mutex_.Unlock();
+  }
+  chunk_frames_ = 0;
+  if (nnet_finished_) {
+    if (num_frames_decoded_ == decodable_.NumFramesReady())
+      SetFinished(false);
+    return;
+  }
+
+  // Next give any new waveform to the feature pipeline.
+  std::vector<Vector<BaseFloat>* > waveform;
+  input_mutex_.Lock();
+  waveform.swap(input_waveform_);
+  bool input_finished = input_finished_;
+  input_mutex_.Unlock();
+  for (size_t i = 0; i < waveform.size(); i++)
+    feature_pipeline_.AcceptWaveform(sampling_rate_, *(waveform[i]));
+  DeletePointers(&waveform);
+  if (input_finished && !features_finished_) {
+    // flush out the last few frames, e.g. if there is latency due to pitch.
+    feature_pipeline_.InputFinished();
+    features_finished_ = true;
+  }
+
+  // Work out whether we have enough features to evaluate another chunk.  As
+  // with DecodableNnet2Online with pad_input == true, at the start and the
+  // end of the utterance we pad with copies of the first and last frames.
+  int32 num_frames_ready = feature_pipeline_.NumFramesReady(),
+      frames_per_chunk = engine_->config_.frames_per_chunk;
+  if (features_finished_) {
+    chunk_frames_ = std::min(frames_per_chunk,
+                             num_frames_ready - num_frames_computed_);
+    if (chunk_frames_ == 0) {
+      // Nothing more to evaluate; the next round will decode the remaining
+      // frames and mark the stream as finished.
+      nnet_finished_ = true;
+      decodable_.InputIsFinished();
+    }
+  } else if (num_frames_ready - num_frames_computed_ >=
+             frames_per_chunk + engine_->right_context_) {
+    chunk_frames_ = frames_per_chunk;
+  }
+}
+
+
+OnlineNnet2MultiStreamEngine::OnlineNnet2MultiStreamEngine(
+    const OnlineNnet2MultiStreamConfig &config,
+    const TransitionModel &tmodel,
+    const nnet2::AmNnet &am_nnet,
+    const fst::Fst<fst::StdArc> &fst,
+    const OnlineNnet2FeaturePipelineInfo &feature_info):
+    config_(config), tmodel_(tmodel), am_nnet_(am_nnet), fst_(fst),
+    feature_info_(feature_info),
+    left_context_(am_nnet.GetNnet().LeftContext()),
+    right_context_(am_nnet.GetNnet().RightContext()),
+    pool_(config.num_threads), work_pending_(false), in_round_(false),
+    num_removing_(0), stop_(false) {
+  config_.Check();
+  log_priors_ = am_nnet_.Priors();
+  KALDI_ASSERT(log_priors_.Dim() == tmodel_.NumPdfs() &&
+               "Priors in neural network not set up (or mismatch "
+               "with transition model).");
+  log_priors_.ApplyLog();
+
+  if (pthread_mutex_init(&mutex_, NULL) != 0)
+    KALDI_ERR << "Cannot initialize pthread mutex";
+  if (pthread_cond_init(&cond_, NULL) != 0)
+    KALDI_ERR << "Cannot initialize pthread conditional variable";
+  int32 ret;
+  if ((ret = pthread_create(&scheduler_thread_, NULL, RunScheduler,
+                            static_cast<void*>(this))) != 0) {
+    const char *c = strerror(ret);
+    KALDI_ERR << "Error creating thread, errno was: " << (c ? c : "[NULL]");
+  }
+}
+
+OnlineNnet2MultiStreamEngine::~OnlineNnet2MultiStreamEngine() {
+  pthread_mutex_lock(&mutex_);
+  KALDI_ASSERT(streams_.empty() &&
+               "All streams must be deleted before the engine");
+  stop_ = true;
+  pthread_cond_broadcast(&cond_);
+  pthread_mutex_unlock(&mutex_);
+  if (pthread_join(scheduler_thread_, NULL))
+    KALDI_ERR << "Error rejoining thread.";
+  pthread_mutex_destroy(&mutex_);
+  pthread_cond_destroy(&cond_);
+}
+
+OnlineNnet2StreamDecoder *OnlineNnet2MultiStreamEngine::NewStream(
+    const OnlineIvectorExtractorAdaptationState &adaptation_state) {
+  OnlineNnet2StreamDecoder *stream =
+      new OnlineNnet2StreamDecoder(this, adaptation_state);
+  pthread_mutex_lock(&mutex_);
+  streams_.push_back(stream);
+  pthread_mutex_unlock(&mutex_);
+  return stream;
+}
+
+int32 OnlineNnet2MultiStreamEngine::NumStreams() {
+  pthread_mutex_lock(&mutex_);
+  int32 ans = streams_.size();
+  pthread_mutex_unlock(&mutex_);
+  return ans;
+}
+
+void OnlineNnet2MultiStreamEngine::NotifyInput() {
+  pthread_mutex_lock(&mutex_);
+  work_pending_ = true;
+  pthread_cond_broadcast(&cond_);
+  pthread_mutex_unlock(&mutex_);
+}
+
+void OnlineNnet2MultiStreamEngine::RemoveStream(
+    OnlineNnet2StreamDecoder *stream) {
+  pthread_mutex_lock(&mutex_);
+  // num_removing_ stops the background thread from starting a new round
+  // before we get the chance to remove the stream.
+  num_removing_++;
+  while (in_round_)
+    pthread_cond_wait(&cond_, &mutex_);
+  std::vector<OnlineNnet2StreamDecoder*>::iterator iter =
+      std::find(streams_.begin(), streams_.end(), stream);
+  KALDI_ASSERT(iter != streams_.end());
+  streams_.erase(iter);
+  num_removing_--;
+  pthread_cond_broadcast(&cond_);
+  pthread_mutex_unlock(&mutex_);
+}
+
+void *OnlineNnet2MultiStreamEngine::RunScheduler(void *engine_in) {
+  OnlineNnet2MultiStreamEngine *engine =
+      static_cast<OnlineNnet2MultiStreamEngine*>(engine_in);
+  engine->SchedulerLoop();
+  return NULL;
+}
+
+void OnlineNnet2MultiStreamEngine::SchedulerLoop() {
+  while (true) {
+    std::vector<OnlineNnet2StreamDecoder*> streams;
+    pthread_mutex_lock(&mutex_);
+    while (!stop_ && (!work_pending_ || num_removing_ > 0))
+      pthread_cond_wait(&cond_, &mutex_);
+    if (stop_) {
+      pthread_mutex_unlock(&mutex_);
+      return;
+    }
+    work_pending_ = false;
+    in_round_ = true;
+    for (size_t i = 0; i < streams_.size(); i++)
+      if (!streams_[i]->IsFinished())
+        streams.push_back(streams_[i]);
+    pthread_mutex_unlock(&mutex_);
+
+    bool more_work = ProcessStreams(streams);
+
+    pthread_mutex_lock(&mutex_);
+    in_round_ = false;
+    if (more_work)
+      work_pending_ = true;
+    pthread_cond_broadcast(&cond_);
+    pthread_mutex_unlock(&mutex_);
+  }
+}
+
+bool OnlineNnet2MultiStreamEngine::ProcessStreams(
+    const std::vector<OnlineNnet2StreamDecoder*> &streams) {
+  // First decode the log-likelihoods from the previous round and extract the
+  // features for the new input, one task per stream.
+  TaskGroup group;
+  for (size_t i = 0; i < streams.size(); i++)
+    pool_.Submit(ProcessStreamTask, static_cast<void*>(streams[i]), &group);
+  group.Wait();
+
+  bool more_work = false;
+  std::vector<OnlineNnet2StreamDecoder*> ready;
+  for (size_t i = 0; i < streams.size(); i++) {
+    OnlineNnet2StreamDecoder *stream = streams[i];
+    if (stream->IsFinished())
+      continue;
+    if (stream->chunk_frames_ > 0)
+      ready.push_back(stream);
+    else if (stream->nnet_finished_)
+      more_work = true;  // The next round will finish it.
+  }
+  if (ready.empty())
+    return more_work;
+
+  // Now evaluate the neural net on one chunk of each of the streams that have
+  // enough features.  We use at least as many batches as threads (if there
+  // are enough streams), so that all the threads are kept busy.
+  int32 num_ready = ready.size(),
+      num_batches = std::max((num_ready + config_.max_batch_streams - 1) /
+                             config_.max_batch_streams,
+                             std::min(config_.num_threads, num_ready));
+  std::vector<NnetBatch> batches(num_batches);
+  for (int32 i = 0; i < num_ready; i++) {
+    NnetBatch &batch = batches[(i * static_cast<int64>(num_batches)) /
+                               num_ready];
+    batch.engine = this;
+    batch.streams.push_back(ready[i]);
+  }
+  for (int32 b = 0; b < num_batches; b++)
+    pool_.Submit(NnetBatchTask, static_cast<void*>(&(batches[b])), &group);
+  group.Wait();
+  // The new log-likelihoods need to be decoded, and some of these streams may
+  // have more chunks ready.
+  return true;
+}
+
+void *OnlineNnet2MultiStreamEngine::ProcessStreamTask(void *stream_in) {
+  OnlineNnet2StreamDecoder *stream =
+      static_cast<OnlineNnet2StreamDecoder*>(stream_in);
+  try {
+    stream->Process();
+  } catch(const std::exception &e) {
+    KALDI_WARN << "Caught exception: " << e.what();
+    bool error = true;
+    stream->SetFinished(error);
+  }
+  return NULL;
+}
+
+void *OnlineNnet2MultiStreamEngine::NnetBatchTask(void *batch_in) {
+  NnetBatch *batch = static_cast<NnetBatch*>(batch_in);
+  try {
+    batch->engine->ComputeNnetBatch(batch->streams);
+  } catch(const std::exception &e) {
+    KALDI_WARN << "Caught exception: " << e.what();
+    bool error = true;
+    for (size_t i = 0; i < batch->streams.size(); i++)
+      batch->streams[i]->SetFinished(error);
+  }
+  return NULL;
+}
+
+void OnlineNnet2MultiStreamEngine::ComputeNnetBatch(
+    const std::vector<OnlineNnet2StreamDecoder*> &streams) {
+  KALDI_ASSERT(!streams.empty());
+  int32 num_streams = streams.size(),
+      frames_per_chunk = config_.frames_per_chunk,
+      input_chunk_size = left_context_ + frames_per_chunk + right_context_,
+      feat_dim = streams[0]->feature_pipeline_.Dim();
+
+  // Each stream contributes a chunk of input_chunk_size rows; for streams that
+  // are at the start or end of the utterance, we pad with copies of the first
+  // or last frame.
+  Matrix<BaseFloat> feats(num_streams * input_chunk_size, feat_dim,
+                          kUndefined);
+  for (int32 s = 0; s < num_streams; s++) {
+    OnlineNnet2StreamDecoder *stream = streams[s];
+    int32 num_frames_ready = stream->feature_pipeline_.NumFramesReady(),
+        input_frame_begin = stream->num_frames_computed_ - left_context_;
+    for (int32 i = 0; i < input_chunk_size; i++) {
+      int32 t = std::max<int32>(0, std::min<int32>(num_frames_ready - 1,
+                                                   input_frame_begin + i));
+      SubVector<BaseFloat> row(feats, s * input_chunk_size + i);
+      stream->feature_pipeline_.GetFrame(t, &row);
+    }
+  }
+  CuMatrix<BaseFloat> cu_feats;
+  cu_feats.Swap(&feats);  // Copy to GPU, if we're using one.
+
+  CuMatrix<BaseFloat> cu_loglikes(num_streams * frames_per_chunk,
+                                  am_nnet_.GetNnet().OutputDim());
+  nnet2::NnetComputationChunks(am_nnet_.GetNnet(), cu_feats, num_streams,
+                               &cu_loglikes);
+  KALDI_VLOG(4) << "Computed chunks of " << frames_per_chunk << " frames "
+                << "of nnet for " << num_streams << " streams.";
+  cu_loglikes.ApplyFloor(1.0e-20);  // Avoid log of zero which leads to NaN.
+  cu_loglikes.ApplyLog();
+  // take the log-posteriors and turn them into pseudo-log-likelihoods by
+  // dividing by the pdf priors; then scale by the acoustic scale.
+  cu_loglikes.AddVecToRows(-1.0, log_priors_);
+  cu_loglikes.Scale(config_.acoustic_scale);
+
+  Matrix<BaseFloat> loglikes;
+  loglikes.Swap(&cu_loglikes);
+
+  for (int32 s = 0; s < num_streams; s++) {
+    OnlineNnet2StreamDecoder *stream = streams[s];
+    int32 num_frames = stream->chunk_frames_;
+    Matrix<BaseFloat> this_loglikes(
+        loglikes.RowRange(s * frames_per_chunk, num_frames));
+    // The decoder won't need the frames it has already decoded.
+    int32 frames_to_discard = stream->num_frames_decoded_ -
+        stream->decodable_.FirstAvailableFrame();
+    stream->decodable_.AcceptLoglikes(&this_loglikes, frames_to_discard);
+    stream->num_frames_computed_ += num_frames;
+  }
+}
+
+
+}  // namespace kaldi
@@ -0,0 +1,331 @@
+// online2/online-nnet2-multi-stream.h
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_ONLINE2_ONLINE_NNET2_MULTI_STREAM_H_
+#define KALDI_ONLINE2_ONLINE_NNET2_MULTI_STREAM_H_
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+#include "matrix/matrix-lib.h"
+#include "util/common-utils.h"
+#include "base/kaldi-error.h"
+#include "decoder/decodable-matrix.h"
+#include "nnet2/am-nnet.h"
+#include "online2/online-nnet2-feature-pipeline.h"
+#include "online2/online-endpoint.h"
+#include "decoder/lattice-faster-online-decoder.h"
+#include "hmm/transition-model.h"
+#include "thread/kaldi-mutex.h"
+#include "thread/kaldi-semaphore.h"
+#include "thread/kaldi-thread-pool.h"
+
+namespace kaldi {
+/// @addtogroup  onlinedecoding OnlineDecoding
+/// @{
+
+/**
+   This file provides a decoding "engine" for servers that decode many
+   concurrent audio streams (e.g. telephone calls) with the same nnet2 model.
+   SingleUtteranceNnet2DecoderThreaded creates three threads per utterance and
+   evaluates the neural net separately for each stream, so with hundreds of
+   concurrent streams we would have hundreds of threads, each doing small
+   matrix multiplies.  Here, a single OnlineNnet2MultiStreamEngine owns a fixed
+   pool of threads.  It collects the pending frames of all its streams,
+   evaluates the neural net on them in a few large batches (one chunk of
+   frames per stream, see NnetComputationChunks() in nnet2/nnet-compute.h),
+   and runs the feature extraction and the graph search for each stream as
+   tasks on the same pool.
+
+   Usage is something like:
+   \code
+   OnlineNnet2MultiStreamEngine engine(config, trans_model, am_nnet, fst,
+                                       feature_info);
+   // for each new call (in any thread):
+   OnlineNnet2StreamDecoder *stream = engine.NewStream(adaptation_state);
+   // ... as audio arrives:
+   stream->AcceptWaveform(samp_freq, wave_part);
+   // ... at the end:
+   stream->InputFinished();
+   stream->Wait();
+   stream->FinalizeDecoding();
+   stream->GetLattice(true, &clat, NULL);
+   delete stream;
+   \endcode
+*/
+
+// This is the configuration class for OnlineNnet2MultiStreamEngine.  As for
+// OnlineNnet2DecodingThreadedConfig, the OnlineNnet2FeaturePipelineConfig and
+// OnlineEndpointConfig are created separately.
+struct OnlineNnet2MultiStreamConfig {
+  LatticeFasterDecoderConfig decoder_opts;
+
+  BaseFloat acoustic_scale;
+
+  int32 num_threads;  // Number of threads in the engine's thread pool.
+
+  int32 frames_per_chunk;  // Number of frames of each stream that we evaluate
+                           // in the neural net at a time.  Larger values make
+                           // the evaluation more efficient (there is less
+                           // overhead from the network's context frames) but
+                           // increase the latency.
+
+  int32 max_batch_streams;  // Maximum number of streams whose chunks we put
+                            // into a single neural-net evaluation.
+
+  OnlineNnet2MultiStreamConfig():
+      acoustic_scale(0.1), num_threads(4), frames_per_chunk(20),
+      max_batch_streams(64) { }
+
+  void Check();
+
+  void Register(OptionsItf *po) {
+    decoder_opts.Register(po);
+    po->Register("acoustic-scale", &acoustic_scale, "Scale used on acoustics "
+                 "when decoding");
+    po->Register("num-threads", &num_threads, "Number of threads used to "
+                 "decode all the streams");
+    po->Register("frames-per-chunk", &frames_per_chunk, "Number of frames "
+                 "of each stream evaluated in the neural net at a time "
+                 "(affects latency and efficiency)");
+    po->Register("max-batch-streams", &max_batch_streams, "Maximum number of "
+                 "streams evaluated together in a single neural-net "
+                 "computation");
+  }
+};
+
+class OnlineNnet2MultiStreamEngine;
+
+/**
+   This class represents a single utterance being decoded by an
+   OnlineNnet2MultiStreamEngine.  You get it from
+   OnlineNnet2MultiStreamEngine::NewStream(), and you delete it when you are
+   done with it.  The interface is similar to that of
+   SingleUtteranceNnet2DecoderThreaded; all calls to its public interface
+   should happen from a single thread (but different streams may be used from
+   different threads).
+*/
+class OnlineNnet2StreamDecoder {
+ public:
+  /// You call this to provide this class with more waveform to decode.  This
+  /// call is non-blocking.
+  void AcceptWaveform(BaseFloat samp_freq,
+                      const VectorBase<BaseFloat> &wave_part);
+
+  /// You call this to inform the class that no more waveform will be provided.
+  /// After calling InputFinished() you cannot call AcceptWaveform any more.
+  void InputFinished();
+
+  /// Returns true if InputFinished() has been called and all the data has been
+  /// decoded (or decoding stopped because of an error); does not block.
+  bool IsFinished() const;
+
+  /// Blocks until all the data has been decoded; it is an error to call this
+  /// before InputFinished().
+  void Wait();
+
+  /// Finalizes the decoding.  Cleans up and prunes remaining tokens, so the
+  /// final lattice is faster to obtain.  Calls Wait() first.
+  void FinalizeDecoding();
+
+  /// Returns *approximately* (ignoring end effects), the number of frames of
+  /// data that we expect given the amount of data that we have received via
+  /// AcceptWaveform().
+  int32 NumFramesReceivedApprox() const;
+
+  /// Returns the number of frames currently decoded.
+  int32 NumFramesDecoded() const;
+
+  /// Gets the lattice; see SingleUtteranceNnet2DecoderThreaded::GetLattice().
+  void GetLattice(bool end_of_utterance,
+                  CompactLattice *clat,
+                  BaseFloat *final_relative_cost) const;
+
+  /// Gets the best path; see SingleUtteranceNnet2DecoderThreaded::GetBestPath().
+  void GetBestPath(bool end_of_utterance,
+                   Lattice *best_path,
+                   BaseFloat *final_relative_cost) const;
+
+  /// This function calls EndpointDetected from online-endpoint.h,
+  /// with the required arguments.
+  bool EndpointDetected(const OnlineEndpointConfig &config);
+
+  /// Outputs the adaptation state of the feature pipeline to
+  /// "adaptation_state".  You may only call this after Wait().
+  void GetAdaptationState(OnlineIvectorExtractorAdaptationState *adaptation_state);
+
+  /// Stops decoding this stream (if it has not finished) and removes it from
+  /// the engine.
+  ~OnlineNnet2StreamDecoder();
+
+ private:
+  friend class OnlineNnet2MultiStreamEngine;
+
+  OnlineNnet2StreamDecoder(
+      OnlineNnet2MultiStreamEngine *engine,
+      const OnlineIvectorExtractorAdaptationState &adaptation_state);
+
+  // The following functions are called from the engine's threads.
+
+  // Decodes any frames of log-likelihoods we have; then passes any waveform
+  // we were given to the feature pipeline, and works out how many frames
+  // (chunk_frames_) we can evaluate in the neural net in the next batch.
+  void Process();
+
+  // Marks the stream as finished (because of an error if "error" is true),
+  // and wakes up Wait().
+  void SetFinished(bool error);
+
+  OnlineNnet2MultiStreamEngine *engine_;
+
+  // sampling_rate_ is set the first time AcceptWaveform is called, and
+  // num_samples_received_ is a record of how many samples we have been given;
+  // these are only accessed by the user's thread.
+  BaseFloat sampling_rate_;
+  int64 num_samples_received_;
+
+  // The waveform given to AcceptWaveform() and not yet passed to the feature
+  // pipeline, and whether InputFinished() was called; guarded by input_mutex_.
+  std::vector<Vector<BaseFloat>* > input_waveform_;
+  bool input_finished_;
+  Mutex input_mutex_;
+
+  // The variables from here to decodable_ are only accessed by the engine's
+  // threads (by one thread at a time), except that the user's thread accesses
+  // feature_pipeline_ in GetAdaptationState() after decoding is finished.
+  OnlineNnet2FeaturePipeline feature_pipeline_;
+  bool features_finished_;  // True once we've called InputFinished() on
+                            // feature_pipeline_.
+  int32 num_frames_computed_;  // Number of frames of log-likelihoods computed.
+  int32 chunk_frames_;  // Number of frames to compute in the next batch; zero
+                        // if we have to wait for more features.
+  bool nnet_finished_;  // True once all log-likelihoods have been computed.
+  int32 num_frames_decoded_;  // Copy of decoder_.NumFramesDecoded().
+  DecodableMatrixMappedOffset decodable_;
+
+  // decoder_mutex_ guards decoder_, finished_ and error_, since decoder_ is
+  // used from the engine's threads and from the user's thread (e.g. in
+  // NumFramesDecoded()).
+  LatticeFasterOnlineDecoder decoder_;
+  bool finished_;
+  bool error_;
+  Mutex decoder_mutex_;
+
+  Semaphore finished_semaphore_;  // Signaled once, when finished_ is set.
+  bool waited_;  // True once the user's thread has waited on
+                 // finished_semaphore_.
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(OnlineNnet2StreamDecoder);
+};
+
+
+/**
+   This class decodes any number of concurrent streams (see
+   OnlineNnet2StreamDecoder) on a fixed pool of threads, evaluating the neural
+   net for many streams at once.  A background thread repeatedly (1) runs the
+   graph search and feature extraction of each stream as a task on the pool,
+   and (2) evaluates the neural net on one chunk from each stream that has
+   enough features, in batches of up to config.max_batch_streams streams that
+   are again run on the pool.  The engine must outlive its streams.
+*/
+class OnlineNnet2MultiStreamEngine {
+ public:
+  OnlineNnet2MultiStreamEngine(
+      const OnlineNnet2MultiStreamConfig &config,
+      const TransitionModel &tmodel,
+      const nnet2::AmNnet &am_nnet,
+      const fst::Fst<fst::StdArc> &fst,
+      const OnlineNnet2FeaturePipelineInfo &feature_info);
+
+  /// Starts decoding a new utterance.  The adaptation_state is used to
+  /// initialize the stream's feature pipeline.  The caller owns the returned
+  /// object.  This function may be called from any thread.
+  OnlineNnet2StreamDecoder *NewStream(
+      const OnlineIvectorExtractorAdaptationState &adaptation_state);
+
+  /// Returns the number of streams that currently exist.
+  int32 NumStreams();
+
+  /// All streams must have been deleted before the engine is destroyed.
+  ~OnlineNnet2MultiStreamEngine();
+
+ private:
+  friend class OnlineNnet2StreamDecoder;
+
+  // A batch of streams whose next chunk we evaluate in one neural-net
+  // computation.
+  struct NnetBatch {
+    OnlineNnet2MultiStreamEngine *engine;
+    std::vector<OnlineNnet2StreamDecoder*> streams;
+  };
+
+  // Called from OnlineNnet2StreamDecoder, when it gets new input.
+  void NotifyInput();
+
+  // Called from the destructor of OnlineNnet2StreamDecoder; waits until the
+  // background thread is not using the stream.
+  void RemoveStream(OnlineNnet2StreamDecoder *stream);
+
+  static void *RunScheduler(void *engine_in);
+  void SchedulerLoop();
+
+  // Does one round of processing of the given streams; returns true if we
+  // should do another round without waiting for new input.
+  bool ProcessStreams(const std::vector<OnlineNnet2StreamDecoder*> &streams);
+
+  // Pool task that calls Process() on a stream.
+  static void *ProcessStreamTask(void *stream_in);
+
+  // Pool task that evaluates a NnetBatch.
+  static void *NnetBatchTask(void *batch_in);
+  void ComputeNnetBatch(const std::vector<OnlineNnet2StreamDecoder*> &streams);
+
+  OnlineNnet2MultiStreamConfig config_;
+  const TransitionModel &tmodel_;
+  const nnet2::AmNnet &am_nnet_;
+  const fst::Fst<fst::StdArc> &fst_;
+  const OnlineNnet2FeaturePipelineInfo &feature_info_;
+
+  int32 left_context_;  // Left context of the network (cached here)
+  int32 right_context_;  // Right context of the network (cached here)
+  CuVector<BaseFloat> log_priors_;  // log-priors taken from the model.
+
+  ThreadPool pool_;
+  pthread_t scheduler_thread_;
+
+  // The following variables are guarded by mutex_.
+  std::vector<OnlineNnet2StreamDecoder*> streams_;
+  bool work_pending_;  // True if some stream has new input.
+  bool in_round_;  // True while the background thread is processing streams.
+  int32 num_removing_;  // Number of threads waiting in RemoveStream().
+  bool stop_;  // Set by the destructor.
+  pthread_mutex_t mutex_;
+  pthread_cond_t cond_;  // Signaled when any of the variables above change.
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(OnlineNnet2MultiStreamEngine);
+};
+
+
+/// @} End of "addtogroup onlinedecoding"
+
+}  // namespace kaldi
+
+#endif  // KALDI_ONLINE2_ONLINE_NNET2_MULTI_STREAM_H_
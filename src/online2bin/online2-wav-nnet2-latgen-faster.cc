@@ -105,6 +105,8 @@ int main(int argc, char *argv[]) {
     BaseFloat chunk_length_secs = 0.05;
     bool do_endpointing = false;
     bool online = true;
+    bool use_cpu_plan = false;
+    nnet2::NnetCpuComputeOptions cpu_opts;
     
     po.Register("chunk-length", &chunk_length_secs,
                 "Length of chunk size in seconds, that we process.  Set to <= 0 "
@@ -122,10 +124,15 @@ int main(int argc, char *argv[]) {
                 "--use-most-recent-ivector=true and --greedy-ivector-extractor=true "
                 "in the file given to --ivector-extraction-config, and "
                 "--chunk-length=-1.");
+    po.Register("use-cpu-plan", &use_cpu_plan,
+                "If true, do the neural net computation with the fused CPU "
+                "code in nnet2/nnet-compute-cpu.h, and print the time taken "
+                "by each of its steps at the end.");
     
     feature_config.Register(&po);
     nnet2_decoding_config.Register(&po);
     endpoint_config.Register(&po);
+    cpu_opts.Register(&po);
     
     po.Read(argc, argv);
     
@@ -156,6 +163,13 @@ int main(int argc, char *argv[]) {
       trans_model.Read(ki.Stream(), binary);
       nnet.Read(ki.Stream(), binary);
     }
+
+    nnet2::NnetCpuPlan *cpu_plan = NULL;
+    nnet2::NnetCpuComputer *cpu_computer = NULL;
+    if (use_cpu_plan) {
+      cpu_plan = new nnet2::NnetCpuPlan(nnet.GetNnet(), cpu_opts);
+      cpu_computer = new nnet2::NnetCpuComputer(*cpu_plan);
+    }
     
     fst::Fst<fst::StdArc> *decode_fst = ReadFstKaldi(fst_rxfilename);
     
@@ -199,7 +213,8 @@ int main(int argc, char *argv[]) {
                                             trans_model,
                                             nnet,
                                             *decode_fst,
-                                            &feature_pipeline);
+                                            &feature_pipeline,
+                                            cpu_computer);
         OnlineTimer decoding_timer(utt);
         
         BaseFloat samp_freq = wave_data.SampFreq();
@@ -257,6 +272,11 @@ int main(int argc, char *argv[]) {
       }
     }
     timing_stats.Print(online);
+    if (cpu_plan != NULL) {
+      delete cpu_computer;  // this adds its timings to the plan.
+      cpu_plan->PrintTimingReport();
+      delete cpu_plan;
+    }
     
     KALDI_LOG << "Decoded " << num_done << " utterances, "
               << num_err << " with errors.";
@@ -0,0 +1,231 @@
+// online2bin/online2-wav-nnet2-multi-stream-bench.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include "feat/wave-reader.h"
+#include "online2/online-nnet2-multi-stream.h"
+#include "base/timer.h"
+#include "fstext/fstext-lib.h"
+
+namespace kaldi {
+
+// Returns the value below which a fraction "p" of the values lie.
+double Percentile(std::vector<double> *values, double p) {
+  if (values->empty()) return 0.0;
+  std::sort(values->begin(), values->end());
+  size_t i = static_cast<size_t>(p * values->size());
+  return (*values)[std::min(i, values->size() - 1)];
+}
+
+// One simulated call.
+struct BenchSession {
+  OnlineNnet2StreamDecoder *stream;
+  const Vector<BaseFloat> *wave;
+  double start_time;  // Time at which the call starts.
+  int32 samp_offset;  // Number of samples sent so far.
+  double input_end_time;  // Time at which we called InputFinished().
+  bool done;
+};
+
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace fst;
+
+    typedef kaldi::int32 int32;
+    typedef kaldi::int64 int64;
+
+    const char *usage =
+        "Load generator for OnlineNnet2MultiStreamEngine: simulates many\n"
+        "concurrent calls, each playing an utterance from the wav input in\n"
+        "chunks (in real time unless --real-time=false), and decodes them all\n"
+        "with one shared nnet2 model.  For each number of concurrent sessions\n"
+        "it prints the real-time factor (time until the final result divided\n"
+        "by the audio duration, averaged over sessions), the throughput, and\n"
+        "percentiles of the decoding lag (audio received but not yet decoded,\n"
+        "sampled whenever a chunk is sent) and of the end-of-utterance latency\n"
+        "(time from the end of the audio to the final result).\n"
+        "\n"
+        "Usage: online2-wav-nnet2-multi-stream-bench [options] <nnet2-in> "
+        "<fst-in> <wav-rspecifier>\n"
+        "e.g.: online2-wav-nnet2-multi-stream-bench --num-sessions=1,10,100 \\\n"
+        "  --config=conf/online_nnet2_decoding.conf final.mdl HCLG.fst "
+        "scp:wav.scp\n";
+
+    ParseOptions po(usage);
+
+    OnlineNnet2FeaturePipelineConfig feature_config;
+    OnlineNnet2MultiStreamConfig engine_config;
+
+    std::string num_sessions_str = "1,10,50,100,200";
+    BaseFloat chunk_length_secs = 0.1;
+    bool real_time = true;
+    int32 max_utts = 100;
+
+    po.Register("num-sessions", &num_sessions_str, "Comma-separated list of "
+                "numbers of concurrent sessions to test");
+    po.Register("chunk-length", &chunk_length_secs, "Length in seconds of the "
+                "chunks of audio that each session sends");
+    po.Register("real-time", &real_time, "If true, send the audio of each "
+                "session at the rate it would arrive in a live call; if false, "
+                "send it as fast as possible.");
+    po.Register("max-utts", &max_utts, "Maximum number of utterances to read "
+                "from the wav input (sessions cycle through them)");
+
+    feature_config.Register(&po);
+    engine_config.Register(&po);
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 3) {
+      po.PrintUsage();
+      return 1;
+    }
+
+    std::string nnet2_rxfilename = po.GetArg(1),
+        fst_rxfilename = po.GetArg(2),
+        wav_rspecifier = po.GetArg(3);
+
+    std::vector<int32> num_sessions_list;
+    if (!SplitStringToIntegers(num_sessions_str, ",", false,
+                               &num_sessions_list) ||
+        num_sessions_list.empty())
+      KALDI_ERR << "Invalid --num-sessions option " << num_sessions_str;
+    KALDI_ASSERT(chunk_length_secs > 0.0);
+
+    OnlineNnet2FeaturePipelineInfo feature_info(feature_config);
+
+    TransitionModel trans_model;
+    nnet2::AmNnet nnet;
+    {
+      bool binary;
+      Input ki(nnet2_rxfilename, &binary);
+      trans_model.Read(ki.Stream(), binary);
+      nnet.Read(ki.Stream(), binary);
+    }
+
+    fst::Fst<fst::StdArc> *decode_fst = ReadFstKaldi(fst_rxfilename);
+
+    // Read the audio into memory, so that reading it is not part of the
+    // timing.
+    std::vector<Vector<BaseFloat>* > waves;
+    BaseFloat samp_freq = 0.0;
+    SequentialTableReader<WaveHolder> wav_reader(wav_rspecifier);
+    for (; !wav_reader.Done() && static_cast<int32>(waves.size()) < max_utts;
+         wav_reader.Next()) {
+      const WaveData &wave_data = wav_reader.Value();
+      if (samp_freq == 0.0)
+        samp_freq = wave_data.SampFreq();
+      else if (wave_data.SampFreq() != samp_freq)
+        KALDI_ERR << "All utterances must have the same sampling frequency.";
+      // we only take the first channel.
+      waves.push_back(new Vector<BaseFloat>(wave_data.Data().Row(0)));
+    }
+    if (waves.empty())
+      KALDI_ERR << "No audio was read from " << wav_rspecifier;
+    int32 chunk_length = std::max<int32>(1, samp_freq * chunk_length_secs);
+    BaseFloat frame_shift = feature_info.FrameShiftInSeconds();
+
+    OnlineNnet2MultiStreamEngine engine(engine_config, trans_model, nnet,
+                                        *decode_fst, feature_info);
+    OnlineIvectorExtractorAdaptationState adaptation_state(
+        feature_info.ivector_extractor_info);
+
+    for (size_t n = 0; n < num_sessions_list.size(); n++) {
+      int32 num_sessions = num_sessions_list[n];
+      KALDI_ASSERT(num_sessions > 0);
+      std::vector<BenchSession> sessions(num_sessions);
+      // Stagger the starts of the calls over one chunk, as the chunks of real
+      // calls would not arrive all at the same time.
+      for (int32 i = 0; i < num_sessions; i++) {
+        BenchSession &session = sessions[i];
+        session.stream = engine.NewStream(adaptation_state);
+        session.wave = waves[i % waves.size()];
+        session.start_time = (real_time ?
+                              chunk_length_secs * i / num_sessions : 0.0);
+        session.samp_offset = 0;
+        session.input_end_time = -1.0;
+        session.done = false;
+      }
+
+      std::vector<double> lags, latencies;
+      double tot_audio = 0.0, tot_rtf = 0.0;
+      int32 num_done = 0;
+      Timer timer;
+      while (num_done < num_sessions) {
+        double now = timer.Elapsed();
+        for (int32 i = 0; i < num_sessions; i++) {
+          BenchSession &session = sessions[i];
+          const Vector<BaseFloat> &wave = *(session.wave);
+          while (session.input_end_time < 0.0 &&
+                 (!real_time || session.start_time +
+                  session.samp_offset / samp_freq <= now)) {
+            lags.push_back(session.samp_offset / samp_freq -
+                           session.stream->NumFramesDecoded() * frame_shift);
+            int32 num_samp = std::min(chunk_length,
+                                      wave.Dim() - session.samp_offset);
+            SubVector<BaseFloat> wave_part(wave, session.samp_offset,
+                                           num_samp);
+            session.stream->AcceptWaveform(samp_freq, wave_part);
+            session.samp_offset += num_samp;
+            if (session.samp_offset == wave.Dim()) {
+              session.stream->InputFinished();
+              session.input_end_time = timer.Elapsed();
+            }
+          }
+          if (session.input_end_time >= 0.0 && !session.done &&
+              session.stream->IsFinished()) {
+            double finish_time = timer.Elapsed(),
+                duration = wave.Dim() / samp_freq;
+            session.done = true;
+            num_done++;
+            latencies.push_back(finish_time - session.input_end_time);
+            tot_rtf += (finish_time - session.start_time) / duration;
+            tot_audio += duration;
+          }
+        }
+        if (num_done < num_sessions)
+          Sleep(0.005);
+      }
+      double elapsed = timer.Elapsed();
+
+      for (int32 i = 0; i < num_sessions; i++) {
+        sessions[i].stream->Wait();  // Will report any error.
+        delete sessions[i].stream;
+      }
+      KALDI_LOG << "Sessions " << num_sessions << ": real-time factor "
+                << (tot_rtf / num_sessions) << ", throughput "
+                << (tot_audio / elapsed) << " seconds of audio per second; "
+                << "decoding lag 50/90/99% = " << Percentile(&lags, 0.5)
+                << '/' << Percentile(&lags, 0.9) << '/'
+                << Percentile(&lags, 0.99) << " s; end-of-utterance latency "
+                << "50/90/99% = " << Percentile(&latencies, 0.5) << '/'
+                << Percentile(&latencies, 0.9) << '/'
+                << Percentile(&latencies, 0.99) << " s.";
+    }
+    DeletePointers(&waves);
+    delete decode_fst;
+    return 0;
+  } catch(const std::exception& e) {
+    std::cerr << e.what();
+    return -1;
+  }
+} // main()
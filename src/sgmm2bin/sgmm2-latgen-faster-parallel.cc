@@ -164,7 +164,7 @@ int main(int argc, char *argv[]) {
     kaldi::int64 frame_count = 0;    
     int num_done = 0, num_err = 0;
     Timer timer;
-    VectorFst<StdArc> *decode_fst = NULL;
+    fst::Fst<StdArc> *decode_fst = NULL;
     fst::SymbolTable *word_syms = NULL;
     
     TaskSequencer<DecodeUtteranceLatticeFasterClass> sequencer(
@@ -206,7 +206,7 @@ int main(int argc, char *argv[]) {
       // It has to do with what happens on UNIX systems if you call fork() on a
       // large process: the page-table entries are duplicated, which requires a
       // lot of virtual memory.
-      decode_fst = fst::ReadFstKaldi(fst_in_str);
+      decode_fst = fst::ReadFstKaldiGeneric(fst_in_str);
       timer.Reset(); // exclude graph loading time.
       
       {
@@ -0,0 +1,74 @@
+// thread/kaldi-affinity-test.cc
+
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "thread/kaldi-affinity.h"
+#include "thread/kaldi-thread.h"
+
+namespace kaldi {
+
+// Each job binds itself to a node, checks that it is then running on a CPU of
+// that node (as far as we can tell), and checks that its original affinity is
+// restored afterwards.
+class AffinityTestClass: public MultiThreadable {
+ public:
+  void operator () () {
+#ifdef __linux__
+    cpu_set_t before, after;
+    KALDI_ASSERT(pthread_getaffinity_np(pthread_self(), sizeof(before),
+                                        &before) == 0);
+    {
+      ScopedNumaBinding binding(thread_id_);
+      KALDI_ASSERT(binding.Node() == -1 ||
+                   binding.Node() == thread_id_ % NumNumaNodes());
+      cpu_set_t during;
+      KALDI_ASSERT(pthread_getaffinity_np(pthread_self(), sizeof(during),
+                                          &during) == 0);
+      KALDI_ASSERT(CPU_COUNT(&during) > 0 &&
+                   CPU_COUNT(&during) <= CPU_COUNT(&before));
+    }
+    KALDI_ASSERT(pthread_getaffinity_np(pthread_self(), sizeof(after),
+                                        &after) == 0);
+    KALDI_ASSERT(CPU_EQUAL(&before, &after));
+#else
+    ScopedNumaBinding binding(thread_id_);
+    KALDI_ASSERT(binding.Node() == -1);
+#endif
+  }
+};
+
+void TestScopedNumaBinding() {
+  int32 num_nodes = NumNumaNodes();
+  KALDI_ASSERT(num_nodes >= 1);
+  KALDI_LOG << "This machine has " << num_nodes << " NUMA node(s).";
+  AffinityTestClass c;
+  MultiThreader<AffinityTestClass> m(2 * num_nodes + 1, c);
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 3; i++)
+    TestScopedNumaBinding();
+  KALDI_LOG << "Test OK.";
+  return 0;
+}
@@ -0,0 +1,117 @@
+// thread/kaldi-affinity.cc
+
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include "thread/kaldi-affinity.h"
+#include "util/text-utils.h"
+
+namespace kaldi {
+
+#ifdef __linux__
+
+static std::vector<cpu_set_t> *g_numa_node_cpus = NULL;
+static pthread_once_t g_numa_once = PTHREAD_ONCE_INIT;
+
+// Parses a list of CPUs in the format of the "cpulist" files in sysfs,
+// e.g. "0-7,16-23", into "cpus"; returns false if the format is wrong.
+static bool ParseCpuList(const std::string &str, cpu_set_t *cpus) {
+  CPU_ZERO(cpus);
+  std::vector<std::string> ranges;
+  SplitStringToVector(str, ",", true, &ranges);
+  for (size_t i = 0; i < ranges.size(); i++) {
+    std::vector<int32> range;
+    if (!SplitStringToIntegers(ranges[i], "-", false, &range) ||
+        range.size() < 1 || range.size() > 2 || range[0] < 0 ||
+        range.back() < range[0])
+      return false;
+    for (int32 cpu = range[0]; cpu <= range.back(); cpu++)
+      if (cpu < CPU_SETSIZE) CPU_SET(cpu, cpus);
+  }
+  return CPU_COUNT(cpus) > 0;
+}
+
+static void ReadNumaTopology() {
+  g_numa_node_cpus = new std::vector<cpu_set_t>();
+  // Node numbers need not be contiguous, but there won't be many of them.
+  for (int32 node = 0, num_missing = 0; num_missing < 64; node++) {
+    std::ostringstream name;
+    name << "/sys/devices/system/node/node" << node << "/cpulist";
+    std::ifstream is(name.str().c_str());
+    std::string line;
+    if (!is.good() || !std::getline(is, line)) {
+      num_missing++;
+      continue;
+    }
+    Trim(&line);
+    cpu_set_t cpus;
+    if (ParseCpuList(line, &cpus))  // Memory-only nodes have no CPUs.
+      g_numa_node_cpus->push_back(cpus);
+  }
+}
+
+static const std::vector<cpu_set_t> &NumaNodeCpus() {
+  pthread_once(&g_numa_once, ReadNumaTopology);
+  return *g_numa_node_cpus;
+}
+
+int32 NumNumaNodes() {
+  return std::max<int32>(1, NumaNodeCpus().size());
+}
+
+ScopedNumaBinding::ScopedNumaBinding(int32 index): node_(-1) {
+  KALDI_ASSERT(index >= 0);
+  const std::vector<cpu_set_t> &node_cpus = NumaNodeCpus();
+  if (node_cpus.size() <= 1) return;  // Nothing to gain.
+  pthread_t self = pthread_self();
+  if (pthread_getaffinity_np(self, sizeof(saved_), &saved_) != 0) {
+    KALDI_WARN << "Could not get the CPU affinity of a thread.";
+    return;
+  }
+  int32 node = index % node_cpus.size();
+  // Stay within the CPUs we were allowed to use (e.g. by taskset).
+  cpu_set_t cpus;
+  CPU_AND(&cpus, &(node_cpus[node]), &saved_);
+  if (CPU_COUNT(&cpus) == 0) return;
+  if (pthread_setaffinity_np(self, sizeof(cpus), &cpus) != 0) {
+    KALDI_WARN << "Could not bind a thread to NUMA node " << node;
+    return;
+  }
+  node_ = node;
+}
+
+ScopedNumaBinding::~ScopedNumaBinding() {
+  if (node_ != -1 &&
+      pthread_setaffinity_np(pthread_self(), sizeof(saved_), &saved_) != 0)
+    KALDI_WARN << "Could not restore the CPU affinity of a thread.";
+}
+
+#else  // __linux__
+
+int32 NumNumaNodes() { return 1; }
+
+ScopedNumaBinding::ScopedNumaBinding(int32 index): node_(-1) { }
+
+ScopedNumaBinding::~ScopedNumaBinding() { }
+
+#endif  // __linux__
+
+}  // namespace kaldi
@@ -0,0 +1,72 @@
+// thread/kaldi-affinity.h
+
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_THREAD_KALDI_AFFINITY_H_
+#define KALDI_THREAD_KALDI_AFFINITY_H_ 1
+
+#include <pthread.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#include "base/kaldi-common.h"
+
+namespace kaldi {
+
+/**
+   This file provides a way to keep a thread, and the memory it allocates, on
+   one NUMA node (i.e. one socket) of a multi-socket machine.  A thread that
+   keeps its own copy of some large object (e.g. a replica of a neural net) can
+   bind itself to a node and then allocate the copy; since Linux places pages
+   on the node of the thread that first touches them, the copy will be in
+   memory local to the CPUs that use it.
+
+   The NUMA topology is read from /sys/devices/system/node, so no NUMA library
+   is needed.  On other systems, or if that information is not there, there is
+   one node containing all the CPUs and binding does nothing.
+ */
+
+/// Returns the number of NUMA nodes that have CPUs (at least 1).
+int32 NumNumaNodes();
+
+/// Restricts the calling thread to the CPUs of NUMA node "index % NumNumaNodes()"
+/// for the lifetime of this object, and restores its previous CPU affinity in
+/// the destructor.  Restoring matters for threads of the ThreadPool, which go
+/// on to run unrelated tasks.  Typically "index" is the thread_id_ of a
+/// MultiThreadable, so the jobs are spread evenly over the nodes, and a given
+/// job index always goes to the same node.
+class ScopedNumaBinding {
+ public:
+  explicit ScopedNumaBinding(int32 index);
+  ~ScopedNumaBinding();
+
+  /// The node we bound to, or -1 if we did not bind.
+  int32 Node() const { return node_; }
+ private:
+  int32 node_;
+#ifdef __linux__
+  cpu_set_t saved_;
+#endif
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ScopedNumaBinding);
+};
+
+
+}  // namespace kaldi
+
+#endif  // KALDI_THREAD_KALDI_AFFINITY_H_
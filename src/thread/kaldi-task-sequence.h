@@ -21,9 +21,12 @@
 #define KALDI_THREAD_KALDI_TASK_SEQUENCE_H_ 1
 
 #include <pthread.h>
+#include <deque>
 #include "thread/kaldi-thread.h"
 #include "itf/options-itf.h"
+#include "thread/kaldi-mutex.h"
 #include "thread/kaldi-semaphore.h"
+#include "thread/kaldi-thread-pool.h"
 
 
 namespace kaldi {
@@ -46,9 +49,9 @@ namespace kaldi {
    does some kind of output).  We have a templated class TaskSequencer<C> which
    is responsible for running the jobs in parallel.  It has a function Run()
    that will accept a new object of class C; this will block until a thread is
-   free, at which time it will spawn a thread that starts running the operator
-   () of the class.  When classes are finished running, the objects will be
-   deleted.  Class TaskSequencer guarantees that the destructors will be called
+   free, at which time it will start running the operator () of the class on
+   the process-wide thread pool (see kaldi-thread-pool.h).  When classes are
+   finished running, the objects will be deleted.  Class TaskSequencer guarantees that the destructors will be called
    sequentially (not in parallel) and in the same order the objects were given
    to the Run() function, so that it is safe for the destructor to have side
    effects such as outputting data.
@@ -82,104 +85,92 @@ class TaskSequencer {
       threads_avail_(config.num_threads),
       tot_threads_avail_(config.num_threads_total > 0 ? config.num_threads_total :
                          config.num_threads + 20),
-      thread_list_(NULL) {
+      pool_(ThreadPool::Global()),
+      finishing_(false) {
     KALDI_ASSERT((config.num_threads_total <= 0 ||
                   config.num_threads_total >= config.num_threads) &&
                  "num-threads-total, if specified, must be >= num-threads");
+    pool_->Reserve(config.num_threads);
   }
 
   /// This function takes ownership of the pointer "c", and will delete it
   /// in the same sequence as Run was called on the jobs.
   void Run(C *c) {
     threads_avail_.Wait(); // wait till we have a thread for computation free.
-    tot_threads_avail_.Wait(); // this ensures we don't have too many threads
-    // waiting on I/O, and consume too much memory.
-    
-    // put the new RunTaskArgsList object at head of the singly
-    // linked list thread_list_.
-    thread_list_ = new RunTaskArgsList(this, c, thread_list_);
-    int32 ret;
-    if ((ret=pthread_create(&(thread_list_->thread),
-                            NULL, // default attributes
-                            TaskSequencer<C>::RunTask,
-                            static_cast<void*>(thread_list_)))) {
-      const char *c = strerror(ret);
-      KALDI_ERR << "Error creating thread, errno was: " << (c ? c : "[NULL]");
-    }
+    tot_threads_avail_.Wait(); // this ensures we don't have too many tasks
+    // waiting to produce their output, and consume too much memory.
+
+    // Append the task to the queue of tasks that are waiting to be deleted,
+    // which is in the order Run() was called.
+    RunTaskArgs *args = new RunTaskArgs(this, c);
+    mutex_.Lock();
+    queue_.push_back(args);
+    mutex_.Unlock();
+    pool_->Submit(TaskSequencer<C>::RunTask, static_cast<void*>(args),
+                  &group_);
   }
 
   void Wait() { // You call this at the end if it's more convenient
     // than waiting for the destructor.  It waits for all tasks to finish.
-    if (thread_list_ != NULL) {
-      int ret = pthread_join(thread_list_->thread, NULL);
-      if (ret != 0) {
-        const char *c = strerror(ret);
-        KALDI_ERR << "Error joining thread, errno was: " << (c ? c : "[NULL]");
-      }
-      KALDI_ASSERT(thread_list_->tail == NULL); // thread would not
-      // have exited without setting tail to NULL.
-      delete thread_list_;
-      thread_list_ = NULL;
-    }
+    group_.Wait();
+    KALDI_ASSERT(queue_.empty()); // The last task to finish would have
+    // deleted all the objects.
   }
-  
-  /// The destructor waits for the last thread to exit.
+
+  /// The destructor waits for the last task to finish.
   ~TaskSequencer() {
-    Wait();      
+    Wait();
   }
  private:
-  struct RunTaskArgsList {
+  struct RunTaskArgs {
     TaskSequencer *me; // Think of this as a "this" pointer.
-    C *c; // Clist element of the task we're expected
-    pthread_t thread;
-    RunTaskArgsList *tail;
-    RunTaskArgsList(TaskSequencer *me, C *c, RunTaskArgsList *tail):
-        me(me), c(c), tail(tail) {}
+    C *c; // The task we're expected to run.
+    bool done; // True once c's operator () has returned.
+    RunTaskArgs(TaskSequencer *me, C *c): me(me), c(c), done(false) {}
   };
-  // This static function gets run in the threads that we create.
+  // This static function gets run by the thread pool.
   static void* RunTask(void *input) {
-    RunTaskArgsList *args = static_cast<RunTaskArgsList*>(input);
-    
+    RunTaskArgs *args = static_cast<RunTaskArgs*>(input);
+    TaskSequencer *me = args->me;
+
     // (1) run the job.
     (*(args->c))(); // call operator () on args->c, which does the computation.
-    args->me->threads_avail_.Signal(); // Signal that the compute-intensive
-    // part of the thread is done (we want to run no more than
+    me->threads_avail_.Signal(); // Signal that the compute-intensive
+    // part of the task is done (we want to run no more than
     // config_.num_threads of these.)
-    
+
     // (2) we want to destroy the object "c" now, by deleting it.  But for
-    //     correct sequencing (this is the whole point of this class, it
-    //     is intended to ensure the output of the program is in correct order),
-    //     we first wait till the previous thread, whose details will be in "tail",
-    //     is finished.
-    if (args->tail != NULL) {
-      int ret = pthread_join(args->tail->thread, NULL);
-      if (ret != 0) {
-        const char *c = strerror(ret);
-        KALDI_ERR << "Error joining thread, errno was: " << (c ? c : "[NULL]");
-      }
+    //     correct sequencing (this is the whole point of this class, it is
+    //     intended to ensure the output of the program is in correct order),
+    //     objects are only deleted from the front of queue_, once their tasks
+    //     are done.  Rather than waiting for the earlier tasks, we mark this
+    //     one as done and leave it to whichever task finishes the one at the
+    //     front of the queue.  Only one thread at a time does the deleting
+    //     (the one that sets finishing_), so there is no risk of concurrent
+    //     access to the output stream.
+    me->mutex_.Lock();
+    args->done = true;
+    if (me->finishing_) {
+      me->mutex_.Unlock();
+      return NULL;  // The thread that is finishing will get to this task.
     }
-
-    delete args->c; // delete the object "c".  This may cause some output,
-    // e.g. to a stream.  We don't need to worry about concurrent access to
-    // the output stream, because each thread waits for the previous thread
-    // to be done, before doing this.  So there is no risk of concurrent
-    // access.
-    args->c = NULL;
-    
-    if (args->tail != NULL) {
-      KALDI_ASSERT(args->tail->tail == NULL); // Because we already
-      // did pthread_join on args->tail->thread, which means that
-      // thread was done, and before it exited, it would have
-      // deleted and set to NULL its tail (which is the next line of code).
-      delete args->tail;
-      args->tail = NULL;
+    me->finishing_ = true;
+    while (!me->queue_.empty() && me->queue_.front()->done) {
+      RunTaskArgs *front = me->queue_.front();
+      me->queue_.pop_front();
+      me->mutex_.Unlock();
+      delete front->c; // delete the object "c".  This may cause some output,
+      // e.g. to a stream.
+      delete front;
+      // Signal the "tot_threads_avail_" semaphore which is used to limit the
+      // total number of tasks that are alive, including not only those that
+      // are in active computation in c->operator (), but those that are
+      // waiting for earlier tasks to finish.
+      me->tot_threads_avail_.Signal();
+      me->mutex_.Lock();
     }
-    // At this point we are exiting from the thread.  Signal the
-    // "tot_threads_avail_" semaphore which is used to limit the total number of threads that are alive, including
-    // not onlhy those that are in active computation in c->operator (), but those
-    // that are waiting on I/O or other threads.
-    args->me->tot_threads_avail_.Signal();
-    // .. and exit the thread, by returning. 
+    me->finishing_ = false;
+    me->mutex_.Unlock();
     return NULL;
   }
 
@@ -188,8 +179,14 @@ class TaskSequencer {
 
   Semaphore tot_threads_avail_; // We use this semaphore to ensure we don't
   // consume too much memory...
-  RunTaskArgsList *thread_list_; 
-  
+
+  ThreadPool *pool_;
+  TaskGroup group_;  // The tasks we have submitted to pool_.
+
+  Mutex mutex_;  // Protects queue_, finishing_ and the "done" members.
+  std::deque<RunTaskArgs*> queue_;  // Tasks whose objects are not yet deleted,
+                                    // in the order Run() was called.
+  bool finishing_;  // True while some thread is deleting objects from queue_.
 };
 
 } // namespace kaldi
@@ -0,0 +1,261 @@
+// thread/kaldi-thread-pool-test.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "thread/kaldi-thread-pool.h"
+#include "thread/kaldi-thread.h"
+#include "thread/kaldi-mutex.h"
+#include "thread/kaldi-barrier.h"
+#include "thread/kaldi-semaphore.h"
+
+namespace kaldi {
+
+struct CountTask {  // Adds "value" to "*total" under a lock.
+  int32 value;
+  int32 *total;
+  Mutex *mutex;
+  static void *Run(void *t_in) {
+    CountTask *t = static_cast<CountTask*>(t_in);
+    int32 spin = Rand() % 1000;
+    for (int32 i = 0; i < spin; i++);
+    t->mutex->Lock();
+    *(t->total) += t->value;
+    t->mutex->Unlock();
+    return NULL;
+  }
+};
+
+void TestThreadPool() {
+  ThreadPool pool(1 + Rand() % 8);
+  int32 num_tasks = Rand() % 200, total = 0;
+  Mutex mutex;
+  std::vector<CountTask> tasks(num_tasks);
+  TaskGroup group;
+  for (int32 i = 0; i < num_tasks; i++) {
+    tasks[i].value = i;
+    tasks[i].total = &total;
+    tasks[i].mutex = &mutex;
+    pool.Submit(CountTask::Run, &(tasks[i]), &group);
+  }
+  group.Wait();
+  KALDI_ASSERT(group.NumPending() == 0);
+  KALDI_ASSERT(total == (num_tasks * (num_tasks - 1)) / 2);
+
+  // The group can be reused once Wait() has returned.
+  total = 0;
+  for (int32 i = 0; i < num_tasks; i++)
+    pool.Submit(CountTask::Run, &(tasks[i]), &group);
+  group.Wait();
+  KALDI_ASSERT(total == (num_tasks * (num_tasks - 1)) / 2);
+}
+
+
+// Each task submits "num_children" tasks of its own to the pool and waits for
+// them, to "depth" levels.  With a small pool this would deadlock if waiting
+// threads did not run queued tasks.
+struct TreeTask {
+  ThreadPool *pool;
+  int32 depth;
+  int32 num_children;
+  int32 *count;
+  Mutex *mutex;
+  static void *Run(void *t_in) {
+    TreeTask *t = static_cast<TreeTask*>(t_in);
+    t->mutex->Lock();
+    (*(t->count))++;
+    t->mutex->Unlock();
+    if (t->depth > 0) {
+      std::vector<TreeTask> children(t->num_children, *t);
+      TaskGroup group;
+      for (int32 i = 0; i < t->num_children; i++) {
+        children[i].depth = t->depth - 1;
+        t->pool->Submit(TreeTask::Run, &(children[i]), &group);
+      }
+      group.Wait();
+    }
+    return NULL;
+  }
+};
+
+void TestThreadPoolNested() {
+  ThreadPool pool(1 + Rand() % 3);
+  int32 count = 0, depth = Rand() % 4, num_children = 1 + Rand() % 4;
+  Mutex mutex;
+  TreeTask root;
+  root.pool = &pool;
+  root.depth = depth;
+  root.num_children = num_children;
+  root.count = &count;
+  root.mutex = &mutex;
+  TaskGroup group;
+  pool.Submit(TreeTask::Run, &root, &group);
+  group.Wait();
+  int32 expected = 0, level_size = 1;
+  for (int32 d = 0; d <= depth; d++, level_size *= num_children)
+    expected += level_size;
+  KALDI_ASSERT(count == expected);
+}
+
+
+class SumClass: public MultiThreadable {  // Sums up 0 .. max_to_count-1.
+ public:
+  SumClass(int32 max_to_count, int32 *total):
+      max_to_count_(max_to_count), total_(total), private_total_(0) { }
+  void operator() () {
+    for (int32 j = thread_id_; j < max_to_count_; j += num_threads_)
+      private_total_ += j;
+  }
+  ~SumClass() { *total_ += private_total_; }
+ private:
+  int32 max_to_count_;
+  int32 *total_;
+  int32 private_total_;
+};
+
+void TestGlobalPool() {
+  // Repeated calls to RunMultiThreaded reuse the global pool's threads.
+  for (int32 i = 0; i < 100; i++) {
+    g_num_threads = 1 + Rand() % 16;
+    int32 total = 0;
+    RunMultiThreaded(SumClass(1000, &total));
+    KALDI_ASSERT(total == (1000 * 999) / 2);
+    KALDI_ASSERT(ThreadPool::Global()->NumThreads() >= g_num_threads);
+  }
+  KALDI_ASSERT(!ThreadPool::Global()->InWorkerThread());
+}
+
+
+// Task "outer" submits "other" (in another group) and "inner", and waits for
+// "inner".  While it waits, its thread must not run "other".
+struct GroupTask {
+  ThreadPool *pool;
+  bool waiting;
+  pthread_t waiting_thread;
+  bool other_ran_while_waiting;
+  TaskGroup other_group;
+  static void *Inner(void *t_in) { return NULL; }
+  static void *Other(void *t_in) {
+    GroupTask *t = static_cast<GroupTask*>(t_in);
+    if (t->waiting && pthread_equal(t->waiting_thread, pthread_self()))
+      t->other_ran_while_waiting = true;
+    return NULL;
+  }
+  static void *Outer(void *t_in) {
+    GroupTask *t = static_cast<GroupTask*>(t_in);
+    TaskGroup group;
+    t->pool->Submit(GroupTask::Other, t, &(t->other_group));
+    t->pool->Submit(GroupTask::Inner, t, &group);
+    t->waiting_thread = pthread_self();
+    t->waiting = true;
+    group.Wait();
+    t->waiting = false;
+    return NULL;
+  }
+};
+
+void TestWaitRunsOnlyOwnGroup() {
+  ThreadPool pool(1);  // With one thread, "outer" must run "inner" itself.
+  GroupTask t;
+  t.pool = &pool;
+  t.waiting = false;
+  t.other_ran_while_waiting = false;
+  TaskGroup group;
+  pool.Submit(GroupTask::Outer, &t, &group);
+  group.Wait();
+  t.other_group.Wait();
+  KALDI_ASSERT(!t.other_ran_while_waiting);
+}
+
+
+class BarrierClass: public MultiThreadable {  // Jobs that wait for each other.
+ public:
+  BarrierClass(Barrier *barrier, int32 *count, Mutex *mutex):
+      barrier_(barrier), count_(count), mutex_(mutex) { }
+  void operator() () {
+    for (int32 i = 0; i < 3; i++)
+      barrier_->Wait();
+    mutex_->Lock();
+    (*count_)++;
+    mutex_->Unlock();
+  }
+ private:
+  Barrier *barrier_;
+  int32 *count_;
+  Mutex *mutex_;
+};
+
+// Runs a MultiThreader whose jobs wait on a Barrier, so it would hang if they
+// did not all run at the same time.
+static void *RunBarrierJobs(void *num_threads_in) {
+  int32 num_threads = *static_cast<int32*>(num_threads_in);
+  Barrier barrier(num_threads);
+  Mutex mutex;
+  int32 count = 0;
+  {
+    MultiThreader<BarrierClass> m(num_threads,
+                                  BarrierClass(&barrier, &count, &mutex));
+  }
+  KALDI_ASSERT(count == num_threads);
+  return NULL;
+}
+
+static void *WaitForSemaphore(void *semaphore_in) {
+  static_cast<Semaphore*>(semaphore_in)->Wait();
+  return NULL;
+}
+
+void TestMultiThreaderConcurrent() {
+  ThreadPool *pool = ThreadPool::Global();
+  int32 num_busy = 1 + Rand() % 4, num_threads = 2 + Rand() % 4;
+  pool->Reserve(num_busy);
+  // Occupy the pool's threads (or some of them) with tasks that only finish
+  // once the MultiThreader jobs are done, as a TaskSequencer might.
+  Semaphore semaphore(0);
+  TaskGroup busy_group;
+  for (int32 i = 0; i < num_busy; i++)
+    pool->Submit(WaitForSemaphore, &semaphore, &busy_group);
+  // The jobs are started from the calling thread, and from inside a task
+  // (which is started with SubmitConcurrent() so that it is not itself stuck
+  // behind the busy tasks).
+  RunBarrierJobs(&num_threads);
+  TaskGroup group;
+  pool->SubmitConcurrent(RunBarrierJobs,
+                         std::vector<void*>(1, &num_threads), &group);
+  group.Wait();
+  for (int32 i = 0; i < num_busy; i++)
+    semaphore.Signal();
+  busy_group.Wait();
+}
+
+
+}  // end namespace kaldi.
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 100; i++) {
+    TestThreadPool();
+    TestThreadPoolNested();
+    TestWaitRunsOnlyOwnGroup();
+  }
+  for (int32 i = 0; i < 10; i++)
+    TestMultiThreaderConcurrent();
+  TestGlobalPool();
+  KALDI_LOG << "Test OK.";
+}
@@ -0,0 +1,412 @@
+// thread/kaldi-thread-pool.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sys/time.h>
+#include <errno.h>
+#include <cstring>
+#include "thread/kaldi-thread-pool.h"
+
+namespace kaldi {
+
+// Thread-specific data holding the ThreadPool::Worker object of the calling
+// thread, for threads that are pool workers.
+static pthread_key_t worker_key;
+static pthread_once_t worker_key_once = PTHREAD_ONCE_INIT;
+
+static void CreateWorkerKey() {
+  if (pthread_key_create(&worker_key, NULL) != 0)
+    KALDI_ERR << "Cannot create pthread key";
+}
+
+static ThreadPool *global_pool = NULL;
+static pthread_once_t global_pool_once = PTHREAD_ONCE_INIT;
+
+static void CreateGlobalPool() {
+  global_pool = new ThreadPool(0);
+}
+
+
+TaskGroup::TaskGroup(): pool_(NULL), num_pending_(0) {
+  if (pthread_mutex_init(&mutex_, NULL) != 0)
+    KALDI_ERR << "Cannot initialize pthread mutex";
+  if (pthread_cond_init(&cond_, NULL) != 0)
+    KALDI_ERR << "Cannot initialize pthread conditional variable";
+}
+
+TaskGroup::~TaskGroup() {
+  Wait();
+  if (pthread_mutex_destroy(&mutex_) != 0)
+    KALDI_ERR << "Cannot destroy pthread mutex";
+  if (pthread_cond_destroy(&cond_) != 0)
+    KALDI_ERR << "Cannot destroy pthread conditional variable";
+}
+
+void TaskGroup::Add(ThreadPool *pool) {
+  int32 ret = 0;
+  ret |= pthread_mutex_lock(&mutex_);
+  KALDI_ASSERT(pool_ == NULL || pool_ == pool);
+  pool_ = pool;
+  num_pending_++;
+  ret |= pthread_mutex_unlock(&mutex_);
+  if (ret != 0)
+    KALDI_ERR << "Error in pthreads";
+}
+
+void TaskGroup::Done() {
+  int32 ret = 0;
+  ret |= pthread_mutex_lock(&mutex_);
+  KALDI_ASSERT(num_pending_ > 0);
+  if (--num_pending_ == 0)
+    ret |= pthread_cond_broadcast(&cond_);
+  ret |= pthread_mutex_unlock(&mutex_);
+  if (ret != 0)
+    KALDI_ERR << "Error in pthreads";
+}
+
+int32 TaskGroup::NumPending() {
+  int32 ret = 0, ans;
+  ret |= pthread_mutex_lock(&mutex_);
+  ans = num_pending_;
+  ret |= pthread_mutex_unlock(&mutex_);
+  if (ret != 0)
+    KALDI_ERR << "Error in pthreads";
+  return ans;
+}
+
+void TaskGroup::Wait() {
+  int32 ret = 0;
+  ret |= pthread_mutex_lock(&mutex_);
+  ThreadPool *pool = pool_;
+  bool done = (num_pending_ == 0);
+  ret |= pthread_mutex_unlock(&mutex_);
+  if (ret != 0)
+    KALDI_ERR << "Error in pthreads";
+  if (done) return;
+
+  if (pool->InWorkerThread()) {
+    // Don't just block: that would take a thread away from the pool, and if
+    // every worker did that, the tasks we are waiting for would never run.
+    pool->RunTasksUntilDone(this);
+    return;
+  }
+  ret |= pthread_mutex_lock(&mutex_);
+  while (num_pending_ > 0)
+    ret |= pthread_cond_wait(&cond_, &mutex_);
+  ret |= pthread_mutex_unlock(&mutex_);
+  if (ret != 0)
+    KALDI_ERR << "Error in pthreads";
+}
+
+
+ThreadPool::ThreadPool(int32 num_threads):
+    workers_(kMaxThreads, static_cast<Worker*>(NULL)), num_workers_(0),
+    num_queued_(0), next_worker_(0), stop_(false) {
+  pthread_once(&worker_key_once, CreateWorkerKey);
+  if (pthread_mutex_init(&mutex_, NULL) != 0)
+    KALDI_ERR << "Cannot initialize pthread mutex";
+  if (pthread_cond_init(&cond_, NULL) != 0)
+    KALDI_ERR << "Cannot initialize pthread conditional variable";
+  Reserve(num_threads);
+}
+
+ThreadPool::~ThreadPool() {
+  KALDI_ASSERT(!InWorkerThread() &&
+               "A ThreadPool cannot be destroyed from one of its own threads");
+  pthread_mutex_lock(&mutex_);
+  stop_ = true;
+  pthread_cond_broadcast(&cond_);
+  int32 num_workers = num_workers_;
+  pthread_mutex_unlock(&mutex_);
+  for (int32 i = 0; i < num_workers; i++)
+    if (pthread_join(workers_[i]->thread, NULL))
+      KALDI_ERR << "Error rejoining thread.";
+  // Only delete the workers once all have exited, as they look at each
+  // other's queues.
+  for (int32 i = 0; i < num_workers; i++) {
+    KALDI_ASSERT(workers_[i]->tasks.empty() && workers_[i]->assigned.empty());
+    delete workers_[i];
+  }
+  pthread_mutex_destroy(&mutex_);
+  pthread_cond_destroy(&cond_);
+}
+
+ThreadPool *ThreadPool::Global() {
+  pthread_once(&global_pool_once, CreateGlobalPool);
+  return global_pool;
+}
+
+void ThreadPool::Reserve(int32 num_threads) {
+  if (num_threads > kMaxThreads) {
+    KALDI_WARN << "Requested " << num_threads << " threads; limiting to "
+               << kMaxThreads;
+    num_threads = kMaxThreads;
+  }
+  pthread_mutex_lock(&mutex_);
+  while (num_workers_ < num_threads)
+    AddWorker(NULL);
+  pthread_mutex_unlock(&mutex_);
+}
+
+void ThreadPool::AddWorker(const Task *task) {
+  if (num_workers_ == kMaxThreads) {
+    pthread_mutex_unlock(&mutex_);
+    KALDI_ERR << "Cannot have more than " << kMaxThreads
+              << " threads in a pool.";
+  }
+  Worker *worker = new Worker();
+  worker->pool = this;
+  worker->index = num_workers_;
+  worker->idle = false;
+  if (task != NULL)
+    worker->assigned.push_back(*task);
+  int32 ret;
+  if ((ret = pthread_create(&(worker->thread), NULL,
+                            ThreadPool::WorkerThread, worker))) {
+    const char *c = strerror(ret);
+    delete worker;
+    pthread_mutex_unlock(&mutex_);
+    KALDI_ERR << "Error creating thread, errno was: " << (c ? c : "[NULL]");
+  }
+  workers_[num_workers_] = worker;
+  num_workers_++;
+}
+
+int32 ThreadPool::NumThreads() {
+  pthread_mutex_lock(&mutex_);
+  int32 ans = num_workers_;
+  pthread_mutex_unlock(&mutex_);
+  return ans;
+}
+
+ThreadPool::Worker *ThreadPool::CurrentWorker() const {
+  Worker *worker = static_cast<Worker*>(pthread_getspecific(worker_key));
+  return (worker != NULL && worker->pool == this ? worker : NULL);
+}
+
+bool ThreadPool::InWorkerThread() const {
+  return (CurrentWorker() != NULL);
+}
+
+void ThreadPool::Submit(TaskFunction func, void *arg, TaskGroup *group) {
+  KALDI_ASSERT(func != NULL && group != NULL);
+  Task task;
+  task.func = func;
+  task.arg = arg;
+  task.group = group;
+  group->Add(this);
+
+  Worker *worker = CurrentWorker();
+  pthread_mutex_lock(&mutex_);
+  KALDI_ASSERT(num_workers_ > 0 && !stop_);
+  if (worker == NULL) {  // Submitted from outside: spread over the queues.
+    worker = workers_[next_worker_ % num_workers_];
+    next_worker_ = (next_worker_ + 1) % num_workers_;
+  }
+  worker->mutex.Lock();
+  worker->tasks.push_back(task);
+  worker->mutex.Unlock();
+  num_queued_++;
+  pthread_cond_signal(&cond_);
+  pthread_mutex_unlock(&mutex_);
+}
+
+void ThreadPool::SubmitConcurrent(TaskFunction func,
+                                  const std::vector<void*> &args,
+                                  TaskGroup *group) {
+  KALDI_ASSERT(func != NULL && group != NULL);
+  Task task;
+  task.func = func;
+  task.group = group;
+  for (size_t i = 0; i < args.size(); i++)
+    group->Add(this);
+
+  pthread_mutex_lock(&mutex_);
+  KALDI_ASSERT(!stop_);
+  size_t i = 0;
+  // First give the tasks to workers that are asleep with nothing to do.
+  // Workers that are busy, including the calling thread if it is a worker,
+  // don't count, as they may not get round to the task for a long time.
+  for (int32 w = 0; w < num_workers_ && i < args.size(); w++) {
+    Worker *worker = workers_[w];
+    if (worker->idle) {
+      task.arg = args[i++];
+      worker->mutex.Lock();
+      worker->assigned.push_back(task);
+      worker->mutex.Unlock();
+      worker->idle = false;
+    }
+  }
+  if (i > 0)
+    pthread_cond_broadcast(&cond_);
+  // ... and start new workers for the rest.
+  for (; i < args.size(); i++) {
+    task.arg = args[i];
+    AddWorker(&task);
+  }
+  pthread_mutex_unlock(&mutex_);
+}
+
+bool ThreadPool::GetTask(Worker *self, Task *task) {
+  self->mutex.Lock();
+  if (!self->assigned.empty()) {
+    *task = self->assigned.front();
+    self->assigned.pop_front();
+    self->mutex.Unlock();
+    return true;
+  }
+  bool got_task = false;
+  if (!self->tasks.empty()) {
+    *task = self->tasks.back();
+    self->tasks.pop_back();
+    got_task = true;
+  }
+  self->mutex.Unlock();
+
+  if (!got_task) {
+    pthread_mutex_lock(&mutex_);
+    int32 num_workers = num_workers_, num_queued = num_queued_;
+    pthread_mutex_unlock(&mutex_);
+    for (int32 i = 1; i < num_workers && num_queued > 0 && !got_task; i++) {
+      Worker *victim = workers_[(self->index + i) % num_workers];
+      victim->mutex.Lock();
+      if (!victim->tasks.empty()) {
+        *task = victim->tasks.front();
+        victim->tasks.pop_front();
+        got_task = true;
+      }
+      victim->mutex.Unlock();
+    }
+  }
+  if (got_task) {
+    pthread_mutex_lock(&mutex_);
+    num_queued_--;
+    pthread_mutex_unlock(&mutex_);
+  }
+  return got_task;
+}
+
+bool ThreadPool::GetTaskOfGroup(Worker *self, const TaskGroup *group,
+                                Task *task) {
+  bool got_task = false;
+  pthread_mutex_lock(&mutex_);
+  int32 num_workers = num_workers_, num_queued = num_queued_;
+  pthread_mutex_unlock(&mutex_);
+  // Look at our own queue first, newest first, then at the others' queues,
+  // oldest first, as in GetTask().
+  for (int32 i = 0; i < num_workers && num_queued > 0 && !got_task; i++) {
+    Worker *victim = workers_[(self->index + i) % num_workers];
+    victim->mutex.Lock();
+    std::deque<Task> &tasks = victim->tasks;
+    if (i == 0) {
+      for (size_t j = tasks.size(); j > 0 && !got_task; j--) {
+        if (tasks[j - 1].group == group) {
+          *task = tasks[j - 1];
+          tasks.erase(tasks.begin() + (j - 1));
+          got_task = true;
+        }
+      }
+    } else {
+      for (size_t j = 0; j < tasks.size() && !got_task; j++) {
+        if (tasks[j].group == group) {
+          *task = tasks[j];
+          tasks.erase(tasks.begin() + j);
+          got_task = true;
+        }
+      }
+    }
+    victim->mutex.Unlock();
+  }
+  if (got_task) {
+    pthread_mutex_lock(&mutex_);
+    num_queued_--;
+    pthread_mutex_unlock(&mutex_);
+  }
+  return got_task;
+}
+
+void ThreadPool::RunTask(const Task &task) {
+  (*task.func)(task.arg);
+  task.group->Done();
+}
+
+void *ThreadPool::WorkerThread(void *worker_in) {
+  Worker *worker = static_cast<Worker*>(worker_in);
+  if (pthread_setspecific(worker_key, worker) != 0)
+    KALDI_ERR << "Cannot set pthread thread-specific data";
+  worker->pool->WorkerLoop(worker);
+  return NULL;
+}
+
+void ThreadPool::WorkerLoop(Worker *worker) {
+  Task task;
+  while (true) {
+    if (GetTask(worker, &task)) {
+      RunTask(task);
+      continue;
+    }
+    pthread_mutex_lock(&mutex_);
+    while (num_queued_ == 0 && worker->assigned.empty() && !stop_) {
+      worker->idle = true;
+      pthread_cond_wait(&cond_, &mutex_);
+    }
+    worker->idle = false;
+    bool finished = (stop_ && num_queued_ == 0 && worker->assigned.empty());
+    pthread_mutex_unlock(&mutex_);
+    if (finished) return;
+  }
+}
+
+void ThreadPool::RunTasksUntilDone(TaskGroup *group) {
+  Worker *worker = CurrentWorker();
+  KALDI_ASSERT(worker != NULL);
+  Task task;
+  while (group->NumPending() > 0) {
+    // Only run tasks of this group: a task of some other group could take
+    // much longer than the ones we are waiting for, or could itself be
+    // waiting for a task that needs this thread.
+    if (GetTaskOfGroup(worker, group, &task)) {
+      RunTask(task);
+      continue;
+    }
+    // Nothing to run: the remaining tasks of the group are running in other
+    // threads.  Wait for them, but wake up now and then in case more tasks
+    // were added to the group.
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    struct timespec timeout;
+    timeout.tv_sec = now.tv_sec;
+    timeout.tv_nsec = now.tv_usec * 1000 + 5000000;  // 5 ms.
+    if (timeout.tv_nsec >= 1000000000) {
+      timeout.tv_sec++;
+      timeout.tv_nsec -= 1000000000;
+    }
+    pthread_mutex_lock(&group->mutex_);
+    if (group->num_pending_ > 0) {
+      int ret = pthread_cond_timedwait(&group->cond_, &group->mutex_, &timeout);
+      if (ret != 0 && ret != ETIMEDOUT) {
+        pthread_mutex_unlock(&group->mutex_);
+        KALDI_ERR << "Error in pthreads";
+      }
+    }
+    pthread_mutex_unlock(&group->mutex_);
+  }
+}
+
+
+}  // namespace kaldi
@@ -0,0 +1,204 @@
+// thread/kaldi-thread-pool.h
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_THREAD_KALDI_THREAD_POOL_H_
+#define KALDI_THREAD_KALDI_THREAD_POOL_H_ 1
+
+#include <pthread.h>
+#include <deque>
+#include <vector>
+#include "base/kaldi-common.h"
+#include "thread/kaldi-mutex.h"
+
+namespace kaldi {
+
+/**
+   This file provides a persistent pool of worker threads, on which
+   MultiThreader (kaldi-thread.h) and TaskSequencer (kaldi-task-sequence.h) run
+   their jobs, so that we don't pay the cost of creating and joining threads
+   each time they are used.
+
+   Each worker thread has its own queue of tasks.  A task submitted from a
+   worker thread goes on that worker's own queue, and the worker takes its most
+   recently added task first; tasks submitted from other threads are
+   distributed over the workers' queues in turn.  A worker whose queue is empty
+   "steals" the oldest task from another worker's queue, and if there is
+   nothing to steal it sleeps until a task is submitted.  This keeps the
+   workers busy without all of them contending for a single lock.
+
+   Queued tasks may run in any order and need not run at the same time as each
+   other, so they must not wait for one another except through TaskGroup.
+   Jobs that do need to run at the same time (e.g. the jobs of MultiThreader,
+   which may synchronize on a Barrier or hand data between each other) are
+   started with SubmitConcurrent(), which gives each of them a worker of its
+   own that was idle, adding threads to the pool if there are not enough idle
+   ones.
+
+   Tasks are plain functions taking a void* argument, the same as the functions
+   given to pthread_create() (e.g. MultiThreadable::run); we don't look at the
+   return value.  Each submitted task belongs to a TaskGroup, which acts as a
+   "future" for the tasks in it: TaskGroup::Wait() returns once they have all
+   finished.  If Wait() is called from one of the worker threads, that thread
+   runs the queued tasks of that group while it waits, so jobs that start and
+   wait for other jobs cannot deadlock the pool by occupying all of its
+   threads.  It does not run tasks of other groups, which might block it for
+   much longer than the tasks it is waiting for.
+
+   As with threads created directly, an exception that escapes from a task
+   will terminate the program.
+ */
+
+class ThreadPool;
+
+/// A set of tasks submitted to a ThreadPool, whose completion we can wait for.
+/// A TaskGroup may be reused once Wait() has returned.
+class TaskGroup {
+ public:
+  TaskGroup();
+
+  /// Waits for the tasks in the group to finish (see Wait()).
+  ~TaskGroup();
+
+  /// Returns once all tasks submitted with this group have finished.
+  void Wait();
+
+  /// Returns the number of tasks in the group that have not yet finished.
+  int32 NumPending();
+
+ private:
+  friend class ThreadPool;
+  void Add(ThreadPool *pool);  // Called when a task is submitted.
+  void Done();  // Called when a task has finished.
+
+  ThreadPool *pool_;  // The pool the tasks were submitted to (for helping out
+                      // while waiting); NULL if nothing was ever submitted.
+  int32 num_pending_;
+  pthread_mutex_t mutex_;
+  pthread_cond_t cond_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(TaskGroup);
+};
+
+
+class ThreadPool {
+ public:
+  typedef void* (*TaskFunction)(void*);
+
+  /// Creates a pool with "num_threads" worker threads (may be zero; see
+  /// Reserve()).
+  explicit ThreadPool(int32 num_threads);
+
+  /// Runs any tasks still queued, then stops and joins the worker threads.
+  ~ThreadPool();
+
+  /// Returns the process-wide pool used by MultiThreader and TaskSequencer.
+  /// It starts with no threads and is grown by calls to Reserve() and
+  /// SubmitConcurrent(); it is never destroyed.
+  static ThreadPool *Global();
+
+  /// Makes sure the pool has at least "num_threads" worker threads (it never
+  /// shrinks).  This counts threads that are busy, so it does not guarantee
+  /// that submitted tasks will run at the same time; see SubmitConcurrent().
+  void Reserve(int32 num_threads);
+
+  int32 NumThreads();
+
+  /// Queues a call to func(arg) as part of "group".  Requires NumThreads() > 0.
+  void Submit(TaskFunction func, void *arg, TaskGroup *group);
+
+  /// Starts func(args[i]) for each i as part of "group", each on a different
+  /// worker thread that was idle, creating new worker threads for any that
+  /// there were not enough idle threads for.  So, unlike tasks queued by
+  /// Submit(), these are guaranteed to run at the same time, and may wait for
+  /// each other.  Used by MultiThreader.
+  void SubmitConcurrent(TaskFunction func, const std::vector<void*> &args,
+                        TaskGroup *group);
+
+  /// Returns true if the calling thread is one of this pool's workers.
+  bool InWorkerThread() const;
+
+  /// Upper limit on the number of threads in a pool.
+  static const int32 kMaxThreads = 1024;
+
+ private:
+  friend class TaskGroup;
+
+  struct Task {
+    TaskFunction func;
+    void *arg;
+    TaskGroup *group;
+  };
+
+  struct Worker {
+    ThreadPool *pool;
+    int32 index;
+    pthread_t thread;
+    Mutex mutex;  // Protects "tasks" and "assigned".
+    std::deque<Task> tasks;
+    // Tasks from SubmitConcurrent() that only this worker may run; they are
+    // run before anything in "tasks".  Changed with both this->mutex and the
+    // pool's mutex_ held.
+    std::deque<Task> assigned;
+    // True while the worker is asleep waiting for tasks (protected by the
+    // pool's mutex_).
+    bool idle;
+  };
+
+  static void *WorkerThread(void *worker_in);
+
+  void WorkerLoop(Worker *worker);
+
+  // Creates and starts a new worker; if "task" is non-NULL, it is assigned to
+  // the new worker before it starts.  Called with mutex_ held.
+  void AddWorker(const Task *task);
+
+  // Gets a task for worker "self": a task assigned to it, else the newest task
+  // from its own queue, or failing that the oldest one from another worker's
+  // queue.  Returns false if there were no tasks.
+  bool GetTask(Worker *self, Task *task);
+
+  // Like GetTask(), but only takes queued tasks belonging to "group".
+  bool GetTaskOfGroup(Worker *self, const TaskGroup *group, Task *task);
+
+  // Called while waiting on "group" from one of our workers: runs queued tasks
+  // of that group until the group is finished.
+  void RunTasksUntilDone(TaskGroup *group);
+
+  static void RunTask(const Task &task);
+
+  // Returns the Worker object of the calling thread if it belongs to this
+  // pool, else NULL.
+  Worker *CurrentWorker() const;
+
+  std::vector<Worker*> workers_;  // Sized kMaxThreads, so that the workers can
+                                  // look at it without locking while it grows.
+  int32 num_workers_;  // Number of entries of workers_ in use.
+  int32 num_queued_;   // Number of tasks in the workers' queues (not
+                       // counting assigned tasks).
+  int32 next_worker_;  // Queue that the next task from outside will go to.
+  bool stop_;          // Set by the destructor.
+  pthread_mutex_t mutex_;  // Protects the variables above.
+  pthread_cond_t cond_;    // Signaled when a task is queued or assigned, or
+                           // on stop.
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+};
+
+
+}  // namespace kaldi
+
+#endif  // KALDI_THREAD_KALDI_THREAD_POOL_H_
@@ -0,0 +1,162 @@
+// util/archive-index.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "util/archive-index.h"
+#include "util/kaldi-io.h"
+
+namespace kaldi {
+
+static const char kArchiveIndexMagic[8] = { 'K', 'A', 'L', 'D', 'I', 'I', 'D',
+                                            'X' };
+static const int32 kArchiveIndexVersion = 1;
+
+const char *ArchiveIndexSuffix() { return ".idx"; }
+
+// Returns the size of a file in bytes, or -1 on error.
+static int64 GetFileSize(const std::string &filename) {
+  std::ifstream is(filename.c_str(), std::ios_base::in|std::ios_base::binary);
+  if (!is.is_open()) return -1;
+  is.seekg(0, std::ios_base::end);
+  if (is.fail()) return -1;
+  return static_cast<int64>(is.tellg());
+}
+
+bool ArchiveIndexWriter::Write(const std::string &filename,
+                               int64 archive_size) {
+  std::sort(entries_.begin(), entries_.end());
+  for (size_t i = 0; i + 1 < entries_.size(); i++) {
+    if (entries_[i].first == entries_[i+1].first) {
+      KALDI_WARN << "Cannot write archive index " << filename
+                 << ": the archive contains duplicate key "
+                 << entries_[i].first;
+      return false;
+    }
+  }
+  ArchiveIndex::Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kArchiveIndexMagic, sizeof(kArchiveIndexMagic));
+  header.version = kArchiveIndexVersion;
+  header.num_keys = entries_.size();
+  header.archive_size = archive_size;
+  std::vector<ArchiveIndex::Entry> entries(entries_.size());
+  for (size_t i = 0; i < entries_.size(); i++) {
+    ArchiveIndex::Entry &entry = entries[i];
+    memset(&entry, 0, sizeof(entry));
+    entry.offset = entries_[i].second;
+    entry.key_offset = header.strings_size;
+    entry.key_length = entries_[i].first.size();
+    header.strings_size += entry.key_length;
+  }
+
+  bool binary = true, write_header = false;
+  Output ko;
+  if (!ko.Open(filename, binary, write_header)) {
+    KALDI_WARN << "Could not open archive index " << filename
+               << " for writing.";
+    return false;
+  }
+  std::ostream &os = ko.Stream();
+  os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  if (!entries.empty())
+    os.write(reinterpret_cast<const char*>(&(entries[0])),
+             sizeof(ArchiveIndex::Entry) * entries.size());
+  for (size_t i = 0; i < entries_.size(); i++)
+    os.write(entries_[i].first.data(), entries_[i].first.size());
+  if (!os.good() || !ko.Close()) {
+    KALDI_WARN << "Error writing archive index " << filename;
+    return false;
+  }
+  return true;
+}
+
+bool ArchiveIndex::Open(const std::string &index_filename,
+                        const std::string &archive_filename) {
+  Close();
+  if (!file_.Open(index_filename))
+    return false;  // will have printed a warning.
+  const Header *header = reinterpret_cast<const Header*>(file_.Data());
+  if (file_.Size() < sizeof(Header) ||
+      memcmp(header->magic, kArchiveIndexMagic,
+             sizeof(kArchiveIndexMagic)) != 0) {
+    KALDI_WARN << "File " << index_filename << " is not an archive index.";
+    Close();
+    return false;
+  }
+  if (header->version != kArchiveIndexVersion) {
+    KALDI_WARN << "Archive index " << index_filename
+               << " has unsupported version " << header->version;
+    Close();
+    return false;
+  }
+  if (file_.Size() != sizeof(Header) + sizeof(Entry) * header->num_keys +
+      header->strings_size) {
+    KALDI_WARN << "Archive index " << index_filename << " has size "
+               << file_.Size() << ", inconsistent with its header "
+               << "(truncated file?)";
+    Close();
+    return false;
+  }
+  int64 archive_size = GetFileSize(archive_filename);
+  if (archive_size != header->archive_size) {
+    KALDI_WARN << "Archive index " << index_filename << " is out of date: "
+               << "archive " << archive_filename << " has size "
+               << archive_size << ", expected " << header->archive_size;
+    Close();
+    return false;
+  }
+  num_keys_ = header->num_keys;
+  entries_ = reinterpret_cast<const Entry*>(file_.Data() + sizeof(Header));
+  strings_ = file_.Data() + sizeof(Header) + sizeof(Entry) * num_keys_;
+  return true;
+}
+
+void ArchiveIndex::Close() {
+  file_.Close();
+  num_keys_ = 0;
+  entries_ = NULL;
+  strings_ = NULL;
+}
+
+bool ArchiveIndex::Lookup(const std::string &key, int64 *offset) const {
+  KALDI_ASSERT(IsOpen());
+  // Binary search for the key, comparing in the same order as std::string
+  // does (which is the order in which the writer sorted them).
+  int64 lo = 0, hi = num_keys_;
+  while (lo < hi) {
+    int64 mid = lo + (hi - lo) / 2;
+    const Entry &entry = entries_[mid];
+    int c = key.compare(0, std::string::npos, strings_ + entry.key_offset,
+                        entry.key_length);
+    if (c == 0) {
+      *offset = entry.offset;
+      return true;
+    } else if (c < 0) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return false;
+}
+
+}  // namespace kaldi
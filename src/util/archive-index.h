@@ -0,0 +1,130 @@
+// util/archive-index.h
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_ARCHIVE_INDEX_H_
+#define KALDI_UTIL_ARCHIVE_INDEX_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "base/kaldi-common.h"
+#include "util/mapped-file.h"
+
+namespace kaldi {
+
+/// \addtogroup table_group
+/// @{
+
+/*
+   An archive index is a small binary file that lives next to an archive (with
+   the same name plus ArchiveIndexSuffix(), e.g. foo.ark.idx), and maps each
+   key in the archive to the byte offset of its object, in the same way as the
+   scp file written by an "ark,scp:" wspecifier does.  Unlike an scp file it is
+   sorted and memory-mapped, so a RandomAccessTableReader opened with the "idx"
+   option (e.g. "ark,idx:foo.ark") does not need to read anything into memory
+   at startup, and each lookup is a binary search in the mapped index followed
+   by a seek in the archive.  It is written by TableWriter when given the "idx"
+   option, e.g. "ark,idx:foo.ark".
+
+   The format is in the machine's native byte order:
+     a header (see ArchiveIndex::Header),
+     an array of num_keys Entry structs, sorted on key,
+     the keys, concatenated (not null-terminated).
+*/
+
+/// Returns the suffix appended to an archive's filename to get its index,
+/// i.e. ".idx".
+const char *ArchiveIndexSuffix();
+
+/// ArchiveIndexWriter accumulates (key, offset) pairs while an archive is
+/// being written, and writes the index when the archive is finished.
+class ArchiveIndexWriter {
+ public:
+  ArchiveIndexWriter() { }
+
+  void Add(const std::string &key, int64 offset) {
+    entries_.push_back(std::make_pair(key, offset));
+  }
+
+  /// Sorts the entries and writes the index to "filename"; "archive_size" is
+  /// the size of the finished archive in bytes, which is stored so that
+  /// readers can detect an index that is out of date.  Returns false (and
+  /// prints a warning) on error, including if there were duplicate keys.
+  bool Write(const std::string &filename, int64 archive_size);
+
+  void Clear() { entries_.clear(); }
+
+ private:
+  std::vector<std::pair<std::string, int64> > entries_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ArchiveIndexWriter);
+};
+
+/// ArchiveIndex gives read-only access to an archive index written by
+/// ArchiveIndexWriter.
+class ArchiveIndex {
+ public:
+  ArchiveIndex(): num_keys_(0), entries_(NULL), strings_(NULL) { }
+
+  /// Maps the index "index_filename" and checks that it is consistent with
+  /// the archive "archive_filename" (i.e. that the archive has the size it had
+  /// when the index was written).  Returns false (and prints a warning) on
+  /// error.
+  bool Open(const std::string &index_filename,
+            const std::string &archive_filename);
+
+  bool IsOpen() const { return file_.IsOpen(); }
+
+  void Close();
+
+  /// Looks up the key; if found, puts the byte offset of its object in the
+  /// archive in *offset and returns true.
+  bool Lookup(const std::string &key, int64 *offset) const;
+
+  int64 NumKeys() const { return num_keys_; }
+
+  // The following structs describe the on-disk layout; they are public only
+  // so that ArchiveIndexWriter can use them.
+  struct Header {
+    char magic[8];
+    int32 version;
+    int32 reserved;
+    int64 num_keys;
+    int64 archive_size;
+    int64 strings_size;
+  };
+  struct Entry {
+    int64 offset;  // byte offset of the object in the archive.
+    int64 key_offset;  // offset of the key in the string area.
+    int32 key_length;
+    int32 reserved;
+  };
+
+ private:
+  MappedFile file_;
+  int64 num_keys_;
+  const Entry *entries_;
+  const char *strings_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ArchiveIndex);
+};
+
+/// @} end "addtogroup table_group"
+
+}  // namespace kaldi
+
+#endif  // KALDI_UTIL_ARCHIVE_INDEX_H_
@@ -61,6 +61,8 @@ template<class KaldiType> class KaldiObjectHolder {
     }
   }
 
+  void Swap(KaldiObjectHolder<T> *other) { std::swap(t_, other->t_); }
+
   // Reads into the holder.
   bool Read(std::istream &is) {
     if (t_) delete t_;
@@ -127,6 +129,8 @@ template<class BasicType> class BasicHolder {
 
   void Clear() { }
 
+  void Swap(BasicHolder<T> *other) { std::swap(t_, other->t_); }
+
   // Reads into the holder.
   bool Read(std::istream &is) {
     bool is_binary;
@@ -225,6 +229,8 @@ template<class BasicType> class BasicVectorHolder {
 
   void Clear() { t_.clear(); }
 
+  void Swap(BasicVectorHolder<BasicType> *other) { t_.swap(other->t_); }
+
   // Reads into the holder.
   bool Read(std::istream &is) {
     t_.clear();
@@ -343,6 +349,8 @@ template<class BasicType> class BasicVectorVectorHolder {
 
   void Clear() { t_.clear(); }
 
+  void Swap(BasicVectorVectorHolder<BasicType> *other) { t_.swap(other->t_); }
+
   // Reads into the holder.
   bool Read(std::istream &is) {
     t_.clear();
@@ -469,6 +477,8 @@ template<class BasicType> class BasicPairVectorHolder {
   
   void Clear() { t_.clear(); }
 
+  void Swap(BasicPairVectorHolder<BasicType> *other) { t_.swap(other->t_); }
+
   // Reads into the holder.
   bool Read(std::istream &is) {
     t_.clear();
@@ -573,6 +583,8 @@ class TokenHolder {
 
   void Clear() { t_.clear(); }
 
+  void Swap(TokenHolder *other) { t_.swap(other->t_); }
+
   // Reads into the holder.
   bool Read(std::istream &is) {
     is >> t_;
@@ -622,6 +634,8 @@ class TokenVectorHolder {
 
   void Clear() { t_.clear(); }
 
+  void Swap(TokenVectorHolder *other) { t_.swap(other->t_); }
+
 
   // Reads into the holder.
   bool Read(std::istream &is) {
@@ -670,6 +684,11 @@ class HtkMatrixHolder {
 
   void Clear() { t_.first.Resize(0, 0); }
 
+  void Swap(HtkMatrixHolder *other) {
+    t_.first.Swap(&(other->t_.first));
+    std::swap(t_.second, other->t_.second);
+  }
+
   // Reads into the holder.
   bool Read(std::istream &is) {
     bool ans = ReadHtk(is, &t_.first, &t_.second);
@@ -711,6 +730,8 @@ template<int kFeatDim> class SphinxMatrixHolder {
 
   void Clear() { feats_.Resize(0, 0); }
 
+  void Swap(SphinxMatrixHolder *other) { feats_.Swap(&(other->feats_)); }
+
   // Writes Sphinx-format features
   static bool Write(std::ostream &os, bool binary, const T &m) {
     if (!binary) {
@@ -127,6 +127,11 @@ template<class SomeType> class GenericHolder {
   /// allow the object to free resources if they're no longer needed.
   void Clear() { }
 
+  /// Swaps the contents of this holder with another holder of the same type,
+  /// without copying the objects; it is used by the background-reading code
+  /// (the "bg" rspecifier option) to hand objects from one thread to another.
+  void Swap(GenericHolder<T> *other) { std::swap(t_, other->t_); }
+
   /// If the object held pointers, the destructor would free them.
   ~GenericHolder() { }
 
@@ -23,11 +23,16 @@
 namespace kaldi {
 
 bool Input::Open(const std::string &rxfilename, bool *binary) {
-  return OpenInternal(rxfilename, true, binary);
+  return OpenInternal(rxfilename, true, binary, false);
+}
+
+bool Input::OpenMapped(const std::string &rxfilename, bool *binary,
+                       bool sequential) {
+  return OpenInternal(rxfilename, true, binary, true, sequential);
 }
 
 bool Input::OpenTextMode(const std::string &rxfilename) {
-  return OpenInternal(rxfilename, false, NULL);
+  return OpenInternal(rxfilename, false, NULL, false);
 }
 
 bool Input::IsOpen() {
@@ -158,6 +158,52 @@ void UnitTestIoNew(bool binary) {
   }
 }
 
+void UnitTestIoMapped(bool binary) {
+  const char *filename = "tmpf";
+  std::vector<std::vector<int32> > vecs(5);
+  std::vector<size_t> offsets;
+  {
+    Output ko(filename, binary);
+    std::ostream &outfile = ko.Stream();
+    for (size_t i = 0; i < vecs.size(); i++) {
+      for (int32 j = Rand() % 5; j > 0; j--)
+        vecs[i].push_back(Rand() % 100);
+      offsets.push_back(outfile.tellp());
+      WriteIntegerVector(outfile, binary, vecs[i]);
+    }
+    KALDI_ASSERT(ko.Close());
+  }
+  {  // Read the whole file sequentially.
+    bool binary_in;
+    Input ki;
+    KALDI_ASSERT(ki.OpenMapped(filename, &binary_in) && binary_in == binary);
+    for (size_t i = 0; i < vecs.size(); i++) {
+      if (binary)  // in text mode, whitespace may not have been consumed.
+        KALDI_ASSERT(ki.Stream().tellg() == std::streampos(offsets[i]));
+      std::vector<int32> vec;
+      ReadIntegerVector(ki.Stream(), binary_in, &vec);
+      KALDI_ASSERT(vec == vecs[i]);
+    }
+    KALDI_ASSERT(Peek(ki.Stream(), binary_in) == -1);
+  }
+  {  // Read at offsets, in random order, re-using the same Input object.
+    Input ki;
+    for (int32 n = 0; n < 10; n++) {
+      size_t i = Rand() % vecs.size();
+      std::ostringstream rxfilename;
+      rxfilename << filename << ':' << offsets[i];
+      KALDI_ASSERT(ki.OpenMapped(rxfilename.str()));
+      std::vector<int32> vec;
+      ReadIntegerVector(ki.Stream(), binary, &vec);
+      KALDI_ASSERT(vec == vecs[i]);
+    }
+    std::ostringstream rxfilename;  // offset past the end of the file.
+    rxfilename << filename << ':' << (offsets.back() + 1000);
+    KALDI_ASSERT(!ki.OpenMapped(rxfilename.str()));
+  }
+  unlink(filename);
+}
+
 void UnitTestIoPipe(bool binary) {
   // This is as UnitTestIoNew except with different filenames.
   {
@@ -307,6 +353,8 @@ int main() {
 
   UnitTestIoNew(false);
   UnitTestIoNew(true);
+  UnitTestIoMapped(false);
+  UnitTestIoMapped(true);
   UnitTestIoPipe(true);
   UnitTestIoPipe(false);
   UnitTestIoStandard();
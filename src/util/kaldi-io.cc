@@ -23,6 +23,7 @@
 #include <errno.h>
 
 #include "util/kaldi-pipebuf.h"
+#include "util/mapped-file.h"
 namespace kaldi {
 
 #ifndef _MSC_VER // on VS, we don't need this type.
@@ -313,6 +314,11 @@ class InputImplBase {
   // on close for input streams.
   virtual InputType MyType() = 0;  // Because if it's kOffsetFileInput, we may call Open twice
   // (has efficiency benefits).
+  virtual bool IsMapped() { return false; }  // true for MappedFileInputImpl.
+  // The following are only implemented by MappedFileInputImpl; see
+  // Input::OpenMapped() and Input::DiscardReadData().
+  virtual void AdviseSequential() { }
+  virtual void DiscardReadData() { }
 
   virtual ~InputImplBase() { }
 };
@@ -584,6 +590,96 @@ class OffsetFileInputImpl: public InputImplBase {
 };
 
 
+// A read-only stream buffer over a block of memory; reads are served directly
+// from that memory, with no buffering of its own.  It supports seeking, which
+// is needed for offsets into files and for tellg().
+class MemoryInputStreambuf: public std::streambuf {
+ public:
+  void SetData(const char *data, size_t size) {
+    char *begin = const_cast<char*>(data);  // we never write to it.
+    setg(begin, begin, begin + size);
+  }
+  // Returns the current read position.
+  size_t Position() const { return gptr() - eback(); }
+ protected:
+  virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                           std::ios_base::openmode which) {
+    if (!(which & std::ios_base::in))
+      return pos_type(off_type(-1));
+    off_type pos = off;
+    if (dir == std::ios_base::cur) pos += gptr() - eback();
+    else if (dir == std::ios_base::end) pos += egptr() - eback();
+    if (pos < 0 || pos > egptr() - eback())
+      return pos_type(off_type(-1));
+    setg(eback(), eback() + pos, egptr());
+    return pos_type(pos);
+  }
+  virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which) {
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+  }
+};
+
+// This class reads ordinary files and offsets into files (kFileInput and
+// kOffsetFileInput) from a memory-mapped copy of the file; see
+// Input::OpenMapped().  Like OffsetFileInputImpl, it can be re-opened with a
+// different offset into the same file, in which case it just seeks.
+class MappedFileInputImpl: public InputImplBase {
+ public:
+  MappedFileInputImpl(): type_(kNoInput), is_(&buf_) { }
+
+  virtual bool Open(const std::string &rxfilename, bool binary) {
+    // "binary" is ignored: memory-mapped files have no text mode.
+    std::string filename;
+    size_t offset = 0;
+    type_ = ClassifyRxfilename(rxfilename);
+    if (type_ == kOffsetFileInput)
+      OffsetFileInputImpl::SplitFilename(rxfilename, &filename, &offset);
+    else
+      filename = rxfilename;
+    if (!file_.IsOpen() || filename != filename_) {
+      filename_.clear();
+      if (!file_.Open(filename))
+        return false;  // MappedFile will have printed a warning.
+      filename_ = filename;
+      buf_.SetData(file_.Data(), file_.Size());
+    }
+    is_.clear();
+    is_.seekg(offset, std::ios_base::beg);
+    if (is_.fail()) {  // offset past the end of the file.
+      Close();
+      return false;
+    }
+    return true;
+  }
+
+  virtual std::istream &Stream() {
+    if (!file_.IsOpen())
+      KALDI_ERR << "MappedFileInputImpl::Stream(), file is not open.";
+    return is_;
+  }
+
+  virtual void Close() {
+    file_.Close();
+    filename_.clear();
+  }
+
+  virtual InputType MyType() { return type_; }
+
+  virtual bool IsMapped() { return true; }
+
+  virtual void AdviseSequential() { file_.AdviseSequential(); }
+
+  virtual void DiscardReadData() { file_.Discard(buf_.Position()); }
+
+ private:
+  InputType type_;
+  std::string filename_;  // the actual filename, without any offset.
+  MappedFile file_;
+  MemoryInputStreambuf buf_;
+  std::istream is_;  // must be declared after buf_.
+};
+
+
 Output::Output(const std::string &rxfilename, bool binary, bool write_header): impl_(NULL) {
   if (!Open(rxfilename, binary, write_header))  {
     if (impl_) {
@@ -685,11 +781,17 @@ void Input::Close() {
 
 bool Input::OpenInternal(const std::string &rxfilename,
                          bool file_binary,
-                         bool *contents_binary) {
+                         bool *contents_binary,
+                         bool mapped,
+                         bool sequential) {
   InputType type = ClassifyRxfilename(rxfilename);
+  // Only actual files can be memory-mapped; for other types of input the
+  // "mapped" option is ignored.
+  if (type != kFileInput && type != kOffsetFileInput) mapped = false;
   if (IsOpen()) {
     // May have to close the stream first.
-    if (type == kOffsetFileInput && impl_->MyType() == kOffsetFileInput) {
+    if (type == kOffsetFileInput && impl_->MyType() == kOffsetFileInput &&
+        impl_->IsMapped() == mapped) {
       // We want to use the same object to Open... this is in case
       // the files are the same, so we can just seek.
       if (!impl_->Open(rxfilename, file_binary)) {  // true is binary mode-- always open in binary.
@@ -706,7 +808,9 @@ bool Input::OpenInternal(const std::string &rxfilename,
       // and fall through to code below which actually opens the file.
     }
   }
-  if (type ==  kFileInput) {
+  if (mapped) {
+    impl_ = new MappedFileInputImpl();
+  } else if (type ==  kFileInput) {
     impl_ = new FileInputImpl();
   } else if (type == kStandardInput) {
     impl_ = new StandardInputImpl();
@@ -724,6 +828,8 @@ bool Input::OpenInternal(const std::string &rxfilename,
     impl_ = NULL;
     return false;
   }
+  if (sequential)
+    impl_->AdviseSequential();
   if (contents_binary != NULL)
     return InitKaldiInputStream(impl_->Stream(), contents_binary);
   else return true;
@@ -732,6 +838,10 @@ bool Input::OpenInternal(const std::string &rxfilename,
 
 Input::~Input() { if (impl_) Close(); }
 
+void Input::DiscardReadData() {
+  if (impl_) impl_->DiscardReadData();
+}
+
 
 std::istream &Input::Stream() {
   if (!IsOpen()) KALDI_ERR << "Input::Stream(), not open.";
@@ -201,6 +201,18 @@ class Input {
   // will throw).
   inline bool Open(const std::string &rxfilename, bool *contents_binary = NULL);
 
+  // As Open, but if rxfilename is an actual file or an offset into a file,
+  // the file is memory-mapped (see util/mapped-file.h) and the stream reads
+  // directly from the mapped pages, rather than through a file buffer; for
+  // other types of rxfilename this is the same as Open.  This is used by the
+  // Table code when the "mmap" option is given (see kaldi-table.h).  If
+  // "sequential" is true, the file will be read in order: the kernel is told
+  // to read ahead, and the caller should call DiscardReadData() from time to
+  // time.
+  inline bool OpenMapped(const std::string &rxfilename,
+                         bool *contents_binary = NULL,
+                         bool sequential = false);
+
   // As Open but (if the file system has text/binary modes) opens in text mode;
   // you shouldn't ever have to use this as in Kaldi we read even text files in
   // binary mode (and ignore the \r).
@@ -218,11 +230,18 @@ class Input {
   // Returns the underlying stream. Throws if !IsOpen()
   std::istream &Stream();
 
+  // For memory-mapped input (see OpenMapped()), tells the system that what
+  // comes before the current read position will not be read again, so its
+  // pages can be dropped from memory; otherwise does nothing.
+  void DiscardReadData();
+
   // Destructor does not throw: input streams may legitimately fail so we
   // don't worry about the status when we close them.
   ~Input();
  private:
-  bool OpenInternal(const std::string &rxfilename, bool file_binary, bool *contents_binary);
+  bool OpenInternal(const std::string &rxfilename, bool file_binary,
+                    bool *contents_binary, bool mapped,
+                    bool sequential = false);
   InputImplBase *impl_;
   KALDI_DISALLOW_COPY_AND_ASSIGN(Input);
 };
@@ -22,10 +22,12 @@
 #ifndef KALDI_UTIL_KALDI_TABLE_INL_H_
 #define KALDI_UTIL_KALDI_TABLE_INL_H_
 
+#include <pthread.h>
 #include <algorithm>
 #include "util/kaldi-io.h"
 #include "util/text-utils.h"
 #include "util/stl-utils.h" // for StringHasher.
+#include "util/archive-index.h"
 
 
 namespace kaldi {
@@ -45,6 +47,13 @@ template<class Holder> class SequentialTableReaderImplBase {
   virtual void FreeCurrent() = 0;
   virtual void Next() = 0;
   virtual bool Close() = 0;
+  // SwapHolder() is only called when Done() is false and Value() has just been
+  // called successfully.  It swaps the contents of this class's holder with
+  // "other_holder" (which will generally be empty), and leaves this class in
+  // the same state as if FreeCurrent() had been called.  It is used by
+  // SequentialTableReaderBackgroundImpl to take objects from the class that
+  // does the actual reading without copying them.
+  virtual void SwapHolder(Holder *other_holder) = 0;
   SequentialTableReaderImplBase() { }
   virtual ~SequentialTableReaderImplBase() { }
  private:
@@ -161,6 +170,13 @@ template<class Holder>  class SequentialTableReaderScriptImpl:
       KALDI_WARN << "TableReader: FreeCurrent called at the wrong time.";
     }
   }
+  virtual void SwapHolder(Holder *other_holder) {
+    if (state_ != kLoadSucceeded)
+      KALDI_ERR << "TableReader: SwapHolder called at the wrong time.";
+    holder_.Swap(other_holder);
+    holder_.Clear();
+    state_ = kLoadFailed;  // as for FreeCurrent().
+  }
   void Next() {
     while (1) {
       NextScpLine();
@@ -216,8 +232,12 @@ template<class Holder>  class SequentialTableReaderScriptImpl:
       KALDI_ERR << "TableReader: LoadCurrent() called at the wrong time.";
     bool ans;
     // note, NULL means it doesn't read the binary-mode header
-    if (Holder::IsReadInBinary()) ans = data_input_.Open(data_rxfilename_, NULL);
-    else ans = data_input_.OpenTextMode(data_rxfilename_);
+    if (!Holder::IsReadInBinary())
+      ans = data_input_.OpenTextMode(data_rxfilename_);
+    else if (opts_.mmap)
+      ans = data_input_.OpenMapped(data_rxfilename_, NULL);
+    else
+      ans = data_input_.Open(data_rxfilename_, NULL);
     if (!ans) {
       // May want to make this warning a VLOG at some point
       KALDI_WARN << "TableReader: failed to open file "
@@ -328,10 +348,12 @@ template<class Holder>  class SequentialTableReaderArchiveImpl:
 
     bool ans;
     // NULL means don't expect binary-mode header
-    if (Holder::IsReadInBinary())
-      ans = input_.Open(archive_rxfilename_, NULL);
-    else
+    if (!Holder::IsReadInBinary())
       ans = input_.OpenTextMode(archive_rxfilename_);
+    else if (opts_.mmap)  // true means we read the archive in order.
+      ans = input_.OpenMapped(archive_rxfilename_, NULL, true);
+    else
+      ans = input_.Open(archive_rxfilename_, NULL);
     if (!ans) {  // header.
       KALDI_WARN << "TableReader: failed to open stream "
                  << PrintableRxfilename(archive_rxfilename_);
@@ -360,6 +382,10 @@ template<class Holder>  class SequentialTableReaderArchiveImpl:
       default:
         KALDI_ERR << "TableReader: Next() called wrongly.";
     }
+    // If the archive is memory-mapped, this lets the pages of the objects
+    // already read be dropped, so the resident memory doesn't grow to the
+    // size of the archive.
+    input_.DiscardReadData();
     std::istream &is = input_.Stream();
     is.clear();  // Clear any fail bits that may have been set... just in case
     // this happened in the Read function.
@@ -448,6 +474,13 @@ template<class Holder>  class SequentialTableReaderArchiveImpl:
     } else
       KALDI_WARN << "TableReader: FreeCurernt called at the wrong time.";
   }
+  virtual void SwapHolder(Holder *other_holder) {
+    if (state_ != kHaveObject)
+      KALDI_ERR << "TableReader: SwapHolder called at the wrong time.";
+    holder_.Swap(other_holder);
+    holder_.Clear();
+    state_ = kFreedObject;  // as for FreeCurrent().
+  }
 
   virtual bool Close() {
     if (! this->IsOpen())
@@ -502,6 +535,226 @@ template<class Holder>  class SequentialTableReaderArchiveImpl:
 };
 
 
+// SequentialTableReaderBackgroundImpl is the implementation for
+// SequentialTableReader when the "bg" rspecifier option is given.  It wraps
+// one of the other implementations (the "base reader"), which it calls from a
+// background thread that keeps up to kLookahead objects ready beyond the one
+// the user is currently looking at, so that reading and parsing the data
+// overlaps with whatever the calling code does with each object.  Objects are
+// moved from the base reader into our own holders with SwapHolder(), so they
+// are never copied.  After Open() returns, the base reader is only accessed
+// from the background thread.
+template<class Holder>
+class SequentialTableReaderBackgroundImpl:
+      public SequentialTableReaderImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
+
+  SequentialTableReaderBackgroundImpl(): base_reader_(NULL), head_(0),
+                                         num_ready_(0), have_object_(false),
+                                         finished_(false), stop_(false),
+                                         thread_running_(false),
+                                         base_ok_(true), thread_error_(false) {
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&ready_cond_, NULL);
+    pthread_cond_init(&free_cond_, NULL);
+  }
+
+  virtual bool Open(const std::string &rspecifier) {
+    if (base_reader_ != NULL)  // SequentialTableReader never re-opens us.
+      KALDI_ERR << "TableReader::Open, background reader already open.";
+    RspecifierType rs = ClassifyRspecifier(rspecifier, &rxfilename_, NULL);
+    if (rs == kArchiveRspecifier) {
+      base_reader_ = new SequentialTableReaderArchiveImpl<Holder>();
+    } else {
+      KALDI_ASSERT(rs == kScriptRspecifier);
+      base_reader_ = new SequentialTableReaderScriptImpl<Holder>();
+    }
+    if (!base_reader_->Open(rspecifier)) {
+      delete base_reader_;
+      base_reader_ = NULL;
+      return false;  // base reader will have printed warnings.
+    }
+    holders_.resize(kLookahead + 1);
+    keys_.resize(kLookahead + 1);
+    for (size_t i = 0; i < holders_.size(); i++)
+      holders_[i] = new Holder;
+    if (pthread_create(&thread_, NULL, RunThread, this) != 0)
+      KALDI_ERR << "TableReader: could not create background thread.";
+    thread_running_ = true;
+    WaitForObject();
+    return true;
+  }
+
+  virtual bool IsOpen() const { return (base_reader_ != NULL); }
+
+  virtual bool Done() const {
+    if (base_reader_ == NULL)
+      KALDI_ERR << "Done() called on TableReader object at the wrong time.";
+    return !have_object_;
+  }
+
+  virtual std::string Key() {
+    if (!have_object_)
+      KALDI_ERR << "Key() called on TableReader object at the wrong time.";
+    return keys_[head_];
+  }
+
+  virtual const T &Value() {
+    if (!have_object_)
+      KALDI_ERR << "Value() called on TableReader object at the wrong time.";
+    return holders_[head_]->Value();
+  }
+
+  virtual void FreeCurrent() {
+    if (have_object_)
+      holders_[head_]->Clear();
+    else
+      KALDI_WARN << "TableReader: FreeCurrent called at the wrong time.";
+  }
+
+  virtual void SwapHolder(Holder *other_holder) {
+    if (!have_object_)
+      KALDI_ERR << "TableReader: SwapHolder called at the wrong time.";
+    holders_[head_]->Swap(other_holder);
+    holders_[head_]->Clear();
+  }
+
+  virtual void Next() {
+    if (!have_object_)
+      KALDI_ERR << "TableReader: Next() called wrongly.";
+    holders_[head_]->Clear();
+    pthread_mutex_lock(&mutex_);
+    head_ = (head_ + 1) % holders_.size();
+    num_ready_--;
+    pthread_cond_signal(&free_cond_);
+    pthread_mutex_unlock(&mutex_);
+    WaitForObject();
+  }
+
+  virtual bool Close() {
+    if (base_reader_ == NULL)
+      KALDI_ERR << "Close() called on TableReader twice or otherwise wrongly.";
+    StopThread();
+    delete base_reader_;  // The thread will have closed it.
+    base_reader_ = NULL;
+    have_object_ = false;
+    for (size_t i = 0; i < holders_.size(); i++)
+      holders_[i]->Clear();
+    return (base_ok_ && !thread_error_);
+  }
+
+  virtual ~SequentialTableReaderBackgroundImpl() {
+    StopThread();
+    bool failed = (base_reader_ != NULL && !(base_ok_ && !thread_error_));
+    delete base_reader_;
+    for (size_t i = 0; i < holders_.size(); i++)
+      delete holders_[i];
+    pthread_cond_destroy(&free_cond_);
+    pthread_cond_destroy(&ready_cond_);
+    pthread_mutex_destroy(&mutex_);
+    // If you don't want this exception to be thrown you can
+    // call Close() and check the status.
+    if (failed)
+      KALDI_ERR << "TableReader: reading failed: "
+                << PrintableRxfilename(rxfilename_);
+  }
+
+ private:
+  static const size_t kLookahead = 2;
+
+  static void *RunThread(void *arg) {
+    static_cast<SequentialTableReaderBackgroundImpl<Holder>*>(arg)->ReadLoop();
+    return NULL;
+  }
+
+  // This is what the background thread runs.  It fills the slot after the
+  // last ready one, which the main thread never looks at until num_ready_ is
+  // incremented.
+  void ReadLoop() {
+    bool ok = true, error = false;
+    try {
+      while (true) {
+        pthread_mutex_lock(&mutex_);
+        while (num_ready_ == holders_.size() && !stop_)
+          pthread_cond_wait(&free_cond_, &mutex_);
+        bool stop = stop_;
+        size_t slot = (head_ + num_ready_) % holders_.size();
+        pthread_mutex_unlock(&mutex_);
+        if (stop || base_reader_->Done()) break;
+        keys_[slot] = base_reader_->Key();
+        base_reader_->Value();  // For scp files, this is where we load it.
+        base_reader_->SwapHolder(holders_[slot]);
+        base_reader_->Next();
+        pthread_mutex_lock(&mutex_);
+        num_ready_++;
+        pthread_cond_signal(&ready_cond_);
+        pthread_mutex_unlock(&mutex_);
+      }
+      ok = base_reader_->Close();
+    } catch (const std::exception &e) {
+      // The error message will already have been printed.
+      error = true;
+      try {
+        if (base_reader_->IsOpen()) base_reader_->Close();
+      } catch (...) { }
+    }
+    pthread_mutex_lock(&mutex_);
+    finished_ = true;
+    base_ok_ = ok;
+    thread_error_ = error;
+    pthread_cond_signal(&ready_cond_);
+    pthread_mutex_unlock(&mutex_);
+  }
+
+  // Called from the main thread: waits until the object at head_ is ready or
+  // the background thread has finished.
+  void WaitForObject() {
+    pthread_mutex_lock(&mutex_);
+    while (num_ready_ == 0 && !finished_)
+      pthread_cond_wait(&ready_cond_, &mutex_);
+    have_object_ = (num_ready_ > 0);
+    bool error = thread_error_;
+    pthread_mutex_unlock(&mutex_);
+    if (!have_object_ && error)
+      KALDI_ERR << "TableReader: error reading "
+                << PrintableRxfilename(rxfilename_) << " in background thread.";
+  }
+
+  void StopThread() {
+    if (!thread_running_) return;
+    pthread_mutex_lock(&mutex_);
+    stop_ = true;
+    pthread_cond_signal(&free_cond_);
+    pthread_mutex_unlock(&mutex_);
+    if (pthread_join(thread_, NULL) != 0)
+      KALDI_WARN << "TableReader: error joining background thread.";
+    thread_running_ = false;
+  }
+
+  SequentialTableReaderImplBase<Holder> *base_reader_;
+  std::string rxfilename_;  // for error messages.
+  // holders_ and keys_ are a circular buffer of objects; the one the user is
+  // looking at (if have_object_) is at head_, and num_ready_ objects from
+  // head_ onward have been read.
+  std::vector<Holder*> holders_;
+  std::vector<std::string> keys_;
+  size_t head_;
+  size_t num_ready_;  // protected by mutex_.
+  bool have_object_;  // only accessed by the main thread.
+  bool finished_;  // true when the background thread has finished; protected
+                   // by mutex_, as are the next four variables.
+  bool stop_;  // set by the main thread to ask the background thread to stop.
+  bool thread_running_;
+  bool base_ok_;  // return status of the base reader's Close().
+  bool thread_error_;  // true if the background thread caught an exception.
+  pthread_t thread_;
+  pthread_mutex_t mutex_;
+  pthread_cond_t ready_cond_;  // signaled when an object becomes ready.
+  pthread_cond_t free_cond_;  // signaled when a slot becomes free.
+};
+
+
 template<class Holder>
 SequentialTableReader<Holder>::SequentialTableReader(const std::string &rspecifier): impl_(NULL) {
   if (rspecifier != "" && !Open(rspecifier))
@@ -515,13 +768,20 @@ bool SequentialTableReader<Holder>::Open(const std::string &rspecifier) {
       KALDI_ERR << "SequentialTableReader<Holder>::Open(), could not close previously open object.";
   // now impl_ will be NULL.
 
-  RspecifierType wt = ClassifyRspecifier(rspecifier, NULL, NULL);
+  RspecifierOptions opts;
+  RspecifierType wt = ClassifyRspecifier(rspecifier, NULL, &opts);
   switch (wt) {
     case kArchiveRspecifier:
-      impl_ = new SequentialTableReaderArchiveImpl<Holder>();
+      if (opts.background)
+        impl_ = new SequentialTableReaderBackgroundImpl<Holder>();
+      else
+        impl_ = new SequentialTableReaderArchiveImpl<Holder>();
       break;
     case kScriptRspecifier:
-      impl_ = new SequentialTableReaderScriptImpl<Holder>();
+      if (opts.background)
+        impl_ = new SequentialTableReaderBackgroundImpl<Holder>();
+      else
+        impl_ = new SequentialTableReaderScriptImpl<Holder>();
       break;
     case kNoRspecifier: default:
       KALDI_WARN << "Invalid rspecifier " << rspecifier;
@@ -650,6 +910,14 @@ class TableWriterArchiveImpl: public TableWriterImplBase<Holder> {
                                            NULL,
                                            &opts_);
     KALDI_ASSERT(ws == kArchiveWspecifier);  // or wrongly called.
+    if (opts_.write_index &&
+        ClassifyWxfilename(archive_wxfilename_) != kFileOutput) {
+      KALDI_WARN << "TableWriter: the idx option requires the archive to be "
+          "an actual file: wspecifier = " << wspecifier;
+      state_ = kUninitialized;
+      return false;
+    }
+    index_writer_.Clear();
 
     if (output_.Open(archive_wxfilename_, opts_.binary, false)) {  // false means no binary header.
       state_ = kOpen;
@@ -689,6 +957,8 @@ class TableWriterArchiveImpl: public TableWriterImplBase<Holder> {
     if (!IsToken(key)) // e.g. empty string or has spaces...
       KALDI_ERR << "TableWriter: using invalid key " << key;
     output_.Stream() << key << ' ';
+    if (opts_.write_index)  // record position at start of object.
+      index_writer_.Add(key, static_cast<int64>(output_.Stream().tellp()));
     if (!Holder::Write(output_.Stream(), opts_.binary, value)) {
       KALDI_WARN << "TableWriter: write failure to "
                  << PrintableWxfilename(archive_wxfilename_);
@@ -719,6 +989,8 @@ class TableWriterArchiveImpl: public TableWriterImplBase<Holder> {
   virtual bool Close() {
     if (!this->IsOpen() || !output_.IsOpen())
       KALDI_ERR << "TableWriter: Close called on a stream that was not open." << this->IsOpen() << ", " << output_.IsOpen();
+    int64 archive_size = (opts_.write_index ?
+                          static_cast<int64>(output_.Stream().tellp()) : 0);
     bool close_success = output_.Close();
     if (!close_success) {
       KALDI_WARN << "TableWriter: error closing stream: "
@@ -733,6 +1005,10 @@ class TableWriterArchiveImpl: public TableWriterImplBase<Holder> {
       return false;
     }
     state_ = kUninitialized;
+    if (opts_.write_index &&
+        !index_writer_.Write(archive_wxfilename_ + ArchiveIndexSuffix(),
+                             archive_size))
+      return false;  // will have printed a warning.
     return true;
   }
 
@@ -750,6 +1026,7 @@ class TableWriterArchiveImpl: public TableWriterImplBase<Holder> {
   Output output_;
   WspecifierOptions opts_;
   std::string archive_wxfilename_;
+  ArchiveIndexWriter index_writer_;  // only used if opts_.write_index.
   enum {               // is stream open?
     kUninitialized,    // no
     kOpen,             // yes
@@ -936,10 +1213,18 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
                                            &script_wxfilename_,
                                            &opts_);
     KALDI_ASSERT(ws == kBothWspecifier);  // or wrongly called.
-    if (ClassifyWxfilename(archive_wxfilename_) != kFileOutput)
+    if (ClassifyWxfilename(archive_wxfilename_) != kFileOutput) {
+      if (opts_.write_index) {
+        KALDI_WARN << "TableWriter: the idx option requires the archive to be "
+            "an actual file: wspecifier = " << wspecifier;
+        state_ = kUninitialized;
+        return false;
+      }
       KALDI_WARN << "When writing to both archive and script, the script file "
           "will generally not be interpreted correctly unless the archive is "
           "an actual file: wspecifier = " << wspecifier;
+    }
+    index_writer_.Clear();
 
     if (!archive_output_.Open(archive_wxfilename_, opts_.binary, false)) {  // false means no binary header.
       state_ = kUninitialized;
@@ -1000,6 +1285,8 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
     std::string offset_rxfilename;  // rxfilename with offset into the archive,
     // e.g. some_archive_name.ark:431541423
     MakeFilename(archive_os_pos, &offset_rxfilename);
+    if (opts_.write_index)
+      index_writer_.Add(key, static_cast<int64>(archive_os_pos));
 
     // Write to the script file first.
     // The idea is that we want to get all the information possible into the
@@ -1054,12 +1341,20 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
     if (!this->IsOpen())
       KALDI_ERR << "TableWriter: Close called on a stream that was not open.";
     bool close_success = true;
-    if (archive_output_.IsOpen())
+    int64 archive_size = 0;
+    if (archive_output_.IsOpen()) {
+      if (opts_.write_index)
+        archive_size = static_cast<int64>(archive_output_.Stream().tellp());
       if (!archive_output_.Close()) close_success = false;
+    }
     if (script_output_.IsOpen())
       if (!script_output_.Close()) close_success = false;
     bool ans = close_success && (state_ != kWriteError);
     state_ = kUninitialized;
+    if (ans && opts_.write_index &&
+        !index_writer_.Write(archive_wxfilename_ + ArchiveIndexSuffix(),
+                             archive_size))
+      ans = false;  // will have printed a warning.
     return ans;
   }
 
@@ -1081,6 +1376,7 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
   std::string archive_wxfilename_;
   std::string script_wxfilename_;
   std::string wspecifier_;
+  ArchiveIndexWriter index_writer_;  // only used if opts_.write_index.
   enum {               // is stream open?
     kUninitialized,    // no
     kOpen,             // yes
@@ -1183,7 +1479,10 @@ TableWriter<Holder>::~TableWriter() {
 // on disk somewhere, why you wouldn't access it via its associated scp.
 // [i.e. write it as ark, scp].  The main reason to read archives directly
 // is if they are part of a pipe, and in this case it's not seekable, so
-// we implement only this case.
+// we implement only this case.  The exception is when the archive was
+// written with an index (the "idx" option), in which case we store nothing
+// and look up file offsets in the memory-mapped index; see
+// RandomAccessTableReaderIndexedArchiveImpl.
 //
 // Note that we will rarely in practice have to keep in memory everything in
 // the archive, as long as things are only read once from the archive (the
@@ -1355,7 +1654,9 @@ class RandomAccessTableReaderScriptImpl:
       if (!preload)
         return true;  // we have the key.
       else {  // preload specified, so we have to pre-load the object before returning true.
-        if (!input_.Open(script_[key_pos].second)) {
+        bool ans = (opts_.mmap ? input_.OpenMapped(script_[key_pos].second) :
+                    input_.Open(script_[key_pos].second));
+        if (!ans) {
           KALDI_WARN << "RandomAccessTableReader: error opening stream " << PrintableRxfilename(script_[key_pos].second);
           return false;
         } else {
@@ -1449,6 +1750,133 @@ class RandomAccessTableReaderScriptImpl:
 
 
 
+// Implementation of RandomAccessTableReader for an archive that has an index
+// (see archive-index.h), used when the "idx" rspecifier option is given.  The
+// index is memory-mapped, so opening is cheap however large the archive is,
+// and we only ever hold the most recently read object in memory: for each new
+// key we look up its offset in the index, seek to it in the archive (which we
+// keep open) and read the object.  Since objects are never stored, the
+// "once", "sorted" and "called-sorted" options make no difference.
+template<class Holder>
+class RandomAccessTableReaderIndexedArchiveImpl:
+      public RandomAccessTableReaderImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
+
+  RandomAccessTableReaderIndexedArchiveImpl(): state_(kUninitialized) { }
+
+  virtual bool Open(const std::string &rspecifier) {
+    if (state_ != kUninitialized)
+      KALDI_ERR << " Opening already open RandomAccessTableReader: call Close first.";
+    RspecifierType rs = ClassifyRspecifier(rspecifier, &archive_rxfilename_,
+                                           &opts_);
+    KALDI_ASSERT(rs == kArchiveRspecifier && opts_.use_index);
+    rspecifier_ = rspecifier;
+    if (ClassifyRxfilename(archive_rxfilename_) != kFileInput) {
+      KALDI_WARN << "RandomAccessTableReader: the idx option requires the "
+                 << "archive to be an actual file: rspecifier is "
+                 << rspecifier;
+      return false;
+    }
+    if (!index_.Open(archive_rxfilename_ + ArchiveIndexSuffix(),
+                     archive_rxfilename_))
+      return false;  // will have printed a warning.
+    state_ = kNoObject;
+    return true;
+  }
+
+  virtual bool HasKey(const std::string &key) {
+    // In permissive mode, we have to check that we can read the object
+    // before we assert that the key is there.
+    return HasKeyInternal(key, opts_.permissive);
+  }
+
+  virtual const T &Value(const std::string &key) {
+    if (!(state_ == kHaveObject && key == current_key_)) {
+      if (!HasKeyInternal(key, true))  // preload.
+        KALDI_ERR << "RandomAccessTableReader::Value(), could not get item for key "
+                  << key << ", rspecifier is " << rspecifier_;
+      KALDI_ASSERT(state_ == kHaveObject && key == current_key_);
+    }
+    return holder_.Value();
+  }
+
+  virtual bool Close() {
+    if (state_ == kUninitialized)
+      KALDI_ERR << "Close() called on RandomAccessTableReader that was not open.";
+    holder_.Clear();
+    if (input_.IsOpen())
+      input_.Close();
+    index_.Close();
+    current_key_ = "";
+    state_ = kUninitialized;
+    // Errors in reading individual objects are reported as they happen, so
+    // there is nothing to report here.
+    return true;
+  }
+
+  virtual ~RandomAccessTableReaderIndexedArchiveImpl() {
+    if (state_ == kHaveObject)
+      holder_.Clear();
+  }
+
+ private:
+  // With preload == false, this just tells us whether the key is in the
+  // index.  With preload == true it also reads the object into holder_, and
+  // only returns true if that succeeds.
+  bool HasKeyInternal(const std::string &key, bool preload) {
+    if (state_ == kUninitialized)
+      KALDI_ERR << "HasKey called on RandomAccessTableReader object that is not open.";
+    if (state_ == kHaveObject && key == current_key_)
+      return true;
+    int64 offset;
+    if (!index_.Lookup(key, &offset))
+      return false;
+    if (!preload)
+      return true;
+    std::ostringstream rxfilename;
+    rxfilename << archive_rxfilename_ << ':' << offset;
+    // When the archive is already open, Input just seeks in it.
+    bool ans;
+    if (!Holder::IsReadInBinary())
+      ans = input_.OpenTextMode(rxfilename.str());
+    else if (opts_.mmap)
+      ans = input_.OpenMapped(rxfilename.str(), NULL);
+    else
+      ans = input_.Open(rxfilename.str(), NULL);
+    if (!ans) {
+      KALDI_WARN << "RandomAccessTableReader: error opening stream "
+                 << PrintableRxfilename(rxfilename.str());
+      return false;
+    }
+    if (state_ == kHaveObject)
+      holder_.Clear();
+    state_ = kNoObject;
+    if (!holder_.Read(input_.Stream())) {
+      KALDI_WARN << "RandomAccessTableReader: error reading object from "
+                 << "stream " << PrintableRxfilename(rxfilename.str());
+      return false;
+    }
+    state_ = kHaveObject;
+    current_key_ = key;
+    return true;
+  }
+
+  ArchiveIndex index_;
+  Input input_;  // The archive; kept open between reads.
+  RspecifierOptions opts_;
+  std::string rspecifier_;  // used in debug messages.
+  std::string archive_rxfilename_;
+  std::string current_key_;  // Key of object in holder_.
+  Holder holder_;
+  enum {
+    kUninitialized,  // not open.
+    kNoObject,       // open; holder_ is empty.
+    kHaveObject      // open; holder_ has the object for current_key_.
+  } state_;
+};
+
+
 // This is the base-class (with some implemented functions) for the
 // implementations of RandomAccessTableReader when it's an archive.  This
 // base-class handles opening the files, storing the state of the reading
@@ -1475,10 +1903,12 @@ template<class Holder>  class RandomAccessTableReaderArchiveImplBase:
 
     // NULL means don't expect binary-mode header
     bool ans;
-    if (Holder::IsReadInBinary())
-      ans = input_.Open(archive_rxfilename_, NULL);
-    else
+    if (!Holder::IsReadInBinary())
       ans = input_.OpenTextMode(archive_rxfilename_);
+    else if (opts_.mmap)
+      ans = input_.OpenMapped(archive_rxfilename_, NULL);
+    else
+      ans = input_.Open(archive_rxfilename_, NULL);
     if (!ans) {  // header.
       KALDI_WARN << "TableReader: failed to open stream "
                  << PrintableRxfilename(archive_rxfilename_);
@@ -2075,7 +2505,9 @@ bool RandomAccessTableReader<Holder>::Open(const std::string &rspecifier) {
       impl_ = new RandomAccessTableReaderScriptImpl<Holder>();
       break;
     case kArchiveRspecifier:
-      if (opts.sorted) {
+      if (opts.use_index) {
+        impl_ = new RandomAccessTableReaderIndexedArchiveImpl<Holder>();
+      } else if (opts.sorted) {
         if (opts.called_sorted) // "doubly" sorted case.
           impl_ = new RandomAccessTableReaderDSortedArchiveImpl<Holder>();
         else
@@ -167,6 +167,13 @@ void UnitTestClassifyWspecifier() {
     KALDI_ASSERT(ans == kBothWspecifier && ark == "" && scp == "" && opts.binary == true && opts.flush == false);
   }
 
+  {
+    std::string a = "ark,idx:foo.ark";
+    std::string ark = "x", scp = "y"; WspecifierOptions opts;
+    WspecifierType ans = ClassifyWspecifier(a, &ark, &scp, &opts);
+    KALDI_ASSERT(ans == kArchiveWspecifier && ark == "foo.ark" && scp == "" && opts.write_index == true);
+  }
+
 
 }
 
@@ -178,7 +185,15 @@ void UnitTestClassifyRspecifier() {
     std::string fname = "x";
     RspecifierOptions opts;
     RspecifierType ans = ClassifyRspecifier(a, &fname, &opts);
-    KALDI_ASSERT(ans == kArchiveRspecifier && fname == "foo|");
+    KALDI_ASSERT(ans == kArchiveRspecifier && fname == "foo|" && !opts.use_index);
+  }
+
+  {
+    std::string a = "ark,idx:foo.ark";
+    std::string fname = "x";
+    RspecifierOptions opts;
+    RspecifierType ans = ClassifyRspecifier(a, &fname, &opts);
+    KALDI_ASSERT(ans == kArchiveRspecifier && fname == "foo.ark" && opts.use_index);
   }
 
 
@@ -628,6 +643,47 @@ void UnitTestTableSequentialInt32Script(bool binary) {
   KALDI_ASSERT(v2 == v);
 }
 
+// Writing as both and reading with the background ("bg") option.
+void UnitTestTableSequentialBackground(bool binary, bool read_scp) {
+  int32 sz = Rand() % 10;
+  std::vector<std::string> k;
+  std::vector<Matrix<double> > v(sz);
+
+  for (int32 i = 0; i < sz; i++) {
+    k.push_back("key" + CharToString('a' + static_cast<char>(i)));
+    v[i].Resize(1 + Rand() % 3, 1 + Rand() % 3);
+    v[i].SetRandn();
+  }
+
+  DoubleMatrixWriter bw(binary ? "b,ark,scp:tmpf,tmpf.scp" :
+                        "t,ark,scp:tmpf,tmpf.scp");
+  for (int32 i = 0; i < sz; i++)
+    bw.Write(k[i], v[i]);
+  KALDI_ASSERT(bw.Close());
+
+  {
+    SequentialDoubleMatrixReader sbr(read_scp ? "scp,bg:tmpf.scp" :
+                                     "ark,bg:tmpf");
+    int32 i = 0;
+    for (; !sbr.Done(); sbr.Next(), i++) {
+      KALDI_ASSERT(i < sz && sbr.Key() == k[i]);
+      KALDI_ASSERT(v[i].ApproxEqual(sbr.Value(), binary ? 1.0e-10 : 0.01));
+      if (Rand() % 2 == 0) sbr.FreeCurrent();
+    }
+    KALDI_ASSERT(i == sz);
+    KALDI_ASSERT(sbr.Close());
+  }
+  if (sz > 1) {  // Stop part of the way through.
+    SequentialDoubleMatrixReader sbr(read_scp ? "scp,bg:tmpf.scp" :
+                                     "ark,bg:tmpf");
+    KALDI_ASSERT(sbr.Key() == k[0]);
+    sbr.Next();
+    KALDI_ASSERT(sbr.Key() == k[1]);
+  }
+  unlink("tmpf");
+  unlink("tmpf.scp");
+}
+
 // Writing as both and reading as archive.
 void UnitTestTableSequentialDoubleMatrixBoth(bool binary, bool read_scp) {
   int32 sz = Rand() % 10;
@@ -846,6 +902,7 @@ void UnitTestTableRandomBothDoubleMatrix(bool binary, bool read_scp,
   else if (Rand()%2 == 0) name += "ncs,";
   if (once) name += "o,";
   else if (Rand()%2 == 0) name += "no,";
+  if (Rand()%2 == 0) name += "mmap,";
   name += std::string(read_scp ? "scp:tmpf.scp" : "ark:tmpf");
   
   RandomAccessDoubleMatrixReader sbr(name);
@@ -882,6 +939,132 @@ void UnitTestTableRandomBothDoubleMatrix(bool binary, bool read_scp,
 }
 
 
+// Reads compressed matrices as ordinary matrices, with the "mmap" option.
+void UnitTestTableCompressedMatrixMapped(bool read_scp) {
+  int32 sz = Rand() % 10;
+  std::vector<std::string> k;
+  std::vector<CompressedMatrix> v(sz);
+
+  for (int32 i = 0; i < sz; i++) {
+    k.push_back("key" + CharToString('a' + static_cast<char>(i)));
+    // Sometimes 8 rows or fewer, which uses a different compression format.
+    Matrix<BaseFloat> mat(1 + Rand() % 20, 1 + Rand() % 4);
+    mat.SetRandn();
+    v[i].CopyFromMat(mat);
+  }
+
+  CompressedMatrixWriter bw("ark,scp:tmpf,tmpf.scp");
+  for (int32 i = 0; i < sz; i++)
+    bw.Write(k[i], v[i]);
+  KALDI_ASSERT(bw.Close());
+
+  std::string rspecifier = (read_scp ? "scp,mmap:tmpf.scp" : "ark,mmap:tmpf");
+  SequentialBaseFloatMatrixReader sbr(rspecifier);
+  int32 i = 0;
+  for (; !sbr.Done(); sbr.Next(), i++) {
+    KALDI_ASSERT(i < sz && sbr.Key() == k[i]);
+    Matrix<BaseFloat> mat(v[i].NumRows(), v[i].NumCols());
+    v[i].CopyToMat(&mat);
+    AssertEqual(mat, sbr.Value());
+  }
+  KALDI_ASSERT(i == sz && sbr.Close());
+
+  RandomAccessBaseFloatMatrixReader rbr(rspecifier);
+  for (int32 n = 0; n < 10 && sz != 0; n++) {
+    int32 i = Rand() % sz;
+    Matrix<BaseFloat> mat(v[i].NumRows(), v[i].NumCols());
+    v[i].CopyToMat(&mat);
+    AssertEqual(mat, rbr.Value(k[i]));
+  }
+  unlink("tmpf");
+  unlink("tmpf.scp");
+}
+
+// Returns the resident memory of this process in bytes, or -1 if this is not
+// available (we read it from /proc, which only exists on Linux).
+int64 ResidentMemory() {
+  std::ifstream is("/proc/self/statm");
+  int64 size, resident;
+  if (!(is >> size >> resident)) return -1;
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+// Reads a large archive sequentially with the "mmap" option, and checks that
+// the resident memory does not grow with the amount read, since the pages
+// already read are released.
+void UnitTestTableSequentialMappedMemory() {
+  int32 num_mats = 64, num_rows = 1024, num_cols = 256;  // 64MB in all.
+  {
+    BaseFloatMatrixWriter bw("ark:tmpf");
+    Matrix<BaseFloat> mat(num_rows, num_cols);
+    for (int32 i = 0; i < num_mats; i++) {
+      mat.Set(i);
+      bw.Write("key" + CharToString('a' + static_cast<char>(i % 26)), mat);
+    }
+  }
+  int64 start_memory = ResidentMemory(), max_memory = start_memory;
+  SequentialBaseFloatMatrixReader sbr("ark,mmap:tmpf");
+  int32 i = 0;
+  for (; !sbr.Done(); sbr.Next(), i++) {
+    const Matrix<BaseFloat> &mat = sbr.Value();
+    KALDI_ASSERT(mat.NumRows() == num_rows && mat(num_rows - 1, 0) == i);
+    max_memory = std::max(max_memory, ResidentMemory());
+  }
+  KALDI_ASSERT(i == num_mats && sbr.Close());
+  if (start_memory != -1) {
+    int64 growth = max_memory - start_memory,
+        archive_size = static_cast<int64>(num_mats) * num_rows * num_cols *
+        sizeof(BaseFloat);
+    KALDI_LOG << "Resident memory grew by " << growth << " bytes while reading "
+              << "a memory-mapped archive of " << archive_size << " bytes.";
+    KALDI_ASSERT(growth < archive_size / 4);
+  }
+  unlink("tmpf");
+}
+
+void UnitTestTableRandomIndexedArchive(bool binary, bool write_scp) {
+  int32 sz = Rand() % 10;
+  std::vector<std::string> k;
+  std::vector<Vector<BaseFloat> > v(sz);
+
+  for (int32 i = 0; i < sz; i++) {
+    k.push_back("key" + CharToString('a' + static_cast<char>(i)));
+    v[i].Resize(Rand() % 5);
+    v[i].SetRandn();
+  }
+  RandomizeVector(&k);  // the archive need not be sorted.
+
+  std::string wspecifier = std::string(binary ? "b," : "t,") +
+      (write_scp ? "ark,scp,idx:tmpf,tmpf.scp" : "ark,idx:tmpf");
+  BaseFloatVectorWriter bw(wspecifier);
+  for (int32 i = 0; i < sz; i++)
+    bw.Write(k[i], v[i]);
+  KALDI_ASSERT(bw.Close());
+
+  RandomAccessBaseFloatVectorReader sbr(Rand() % 2 == 0 ? "ark,idx:tmpf" :
+                                        "ark,idx,mmap:tmpf");
+  KALDI_ASSERT(!sbr.HasKey("foo"));
+  for (int32 n = 0; n < 20 && sz != 0; n++) {
+    int32 i = Rand() % sz;
+    if (Rand() % 2 == 0)
+      KALDI_ASSERT(sbr.HasKey(k[i]));
+    KALDI_ASSERT(v[i].ApproxEqual(sbr.Value(k[i]), binary ? 1.0e-10 : 0.01));
+  }
+  KALDI_ASSERT(sbr.Close());
+
+  {  // If the archive changes, the index is out of date and should be
+     // rejected.
+    std::ofstream os("tmpf", std::ios_base::out|std::ios_base::app);
+    os << "extra ";
+  }
+  RandomAccessBaseFloatVectorReader sbr2;
+  KALDI_ASSERT(!sbr2.Open("ark,idx:tmpf"));
+
+  unlink("tmpf");
+  unlink("tmpf.idx");
+  unlink("tmpf.scp");
+}
+
 
 }  // end namespace kaldi.
 
@@ -890,16 +1073,21 @@ int main() {
   UnitTestReadScriptFile();
   UnitTestClassifyWspecifier();
   UnitTestClassifyRspecifier();
+  UnitTestTableSequentialMappedMemory();
   for (int i = 0; i < 10; i++) {
     bool b = (i == 0);
     UnitTestTableSequentialBool(b);
     UnitTestTableSequentialInt32(b);
     UnitTestTableSequentialInt32Script(b);
     UnitTestTableSequentialDouble(b);
+    UnitTestTableRandomIndexedArchive(b, false);
+    UnitTestTableRandomIndexedArchive(b, true);
     for (int j = 0; j < 2; j++) {
       bool c = (j == 0);
       UnitTestTableSequentialDoubleBoth(b, c);
       UnitTestTableSequentialDoubleMatrixBoth(b, c);
+      UnitTestTableSequentialBackground(b, c);
+      UnitTestTableCompressedMatrixMapped(c);
       UnitTestTableSequentialInt32VectorBoth(b, c);
       UnitTestTableSequentialInt32PairVectorBoth(b, c);
       UnitTestTableSequentialInt32VectorVectorBoth(b, c);
@@ -140,6 +140,8 @@ WspecifierType ClassifyWspecifier(const std::string &wspecifier,
   //  ark,scp,f:filename, wxfilename ->  kBothWspecifier
   // or:
   //  scp,t,nf:rxfilename -> kScriptWspecifier
+  // and the index option (idx), e.g.:
+  //  ark,idx:filename -> kArchiveWspecifier
 
   if (archive_wxfilename) archive_wxfilename->clear();
   if (script_wxfilename) script_wxfilename->clear();
@@ -173,6 +175,8 @@ WspecifierType ClassifyWspecifier(const std::string &wspecifier,
       if (opts) opts->binary = false;
     } else if (!strcmp(c, "p")) {
       if (opts) opts->permissive = true;
+    } else if (!strcmp(c, "idx")) {
+      if (opts) opts->write_index = true;
     } else if (!strcmp(c, "ark")) {
       if (ws == kNoWspecifier) ws = kArchiveWspecifier;
       else return kNoWspecifier;  // We do not allow "scp, ark", only "ark, scp".
@@ -218,8 +222,9 @@ RspecifierType ClassifyRspecifier(const std::string &rspecifier,
   //
   // We also allow the meaningless prefixes b, and t,
   // plus the options o (once), no (not-once),
-  // s (sorted) and ns (not-sorted), p (permissive)
-  // and np (not-permissive).
+  // s (sorted) and ns (not-sorted), p (permissive),
+  // np (not-permissive), idx (use archive index), bg (read in a
+  // background thread) and mmap (memory-map the files read).
   // so the following would be valid:
   //
   // f, o, b, np, ark:rxfilename  ->  kArchiveRspecifier
@@ -276,6 +281,12 @@ RspecifierType ClassifyRspecifier(const std::string &rspecifier,
       if (opts) opts->called_sorted = true;
     } else if (!strcmp(c, "ncs")) {
       if (opts) opts->called_sorted = false;
+    } else if (!strcmp(c, "idx")) {
+      if (opts) opts->use_index = true;
+    } else if (!strcmp(c, "bg")) {
+      if (opts) opts->background = true;
+    } else if (!strcmp(c, "mmap")) {
+      if (opts) opts->mmap = true;
     } else if (!strcmp(c, "ark")) {
       if (rs == kNoRspecifier) rs = kArchiveRspecifier;
       else return kNoRspecifier;  // Repeated or combined ark and scp options invalid.
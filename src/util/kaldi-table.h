@@ -70,9 +70,14 @@ typedef std::vector<std::string> KeyList;
 //  p means permissive mode, when writing to an "scp" file only: will ignore
 //     missing scp entries, i.e. won't write anything for those files but will
 //     return success status).
+//  idx means also write an index of the archive (see archive-index.h), with
+//     the archive's filename plus ".idx", for fast random access with the
+//     "idx" rspecifier option.  Only for "ark" and "ark,scp" wspecifiers where
+//     the archive is an actual file.
 //
 //  So the following are valid wspecifiers:
 //  ark,b,f:foo
+//  ark,idx:foo.ark
 //  "ark,b,b:| gzip -c > foo"
 //  "ark,scp,t,nf:foo.ark,|gzip -c > foo.scp.gz"
 //  ark,b:-
@@ -113,7 +118,9 @@ struct WspecifierOptions {
   bool binary;
   bool flush;
   bool permissive; // will ignore absent scp entries.
-  WspecifierOptions(): binary(true), flush(false), permissive(false) { }
+  bool write_index;  // will write an index of the archive.
+  WspecifierOptions(): binary(true), flush(false), permissive(false),
+                       write_index(false) { }
 };
 
 // ClassifyWspecifier returns the type of the wspecifier string,
@@ -179,13 +186,37 @@ bool WriteScriptFile(std::ostream &os,
 //      [any of the above options can be prefixed by n to negate them, e.g. no, ns,
 //       ncs, np; but these aren't currently useful as you could just omit the option].
 //
+//   idx means that the archive has an index (written with the "idx" wspecifier
+//       option; see archive-index.h), which RandomAccessTableReader will use
+//       to seek directly to the objects it is asked for, so it never has to
+//       read the archive sequentially or hold objects in memory.  The archive
+//       must be an actual file.  The o, s and cs options make no difference
+//       in this case.
+//
+//   bg  means "background": SequentialTableReader will read ahead in a
+//       background thread, so that reading and parsing the next objects
+//       overlaps with the processing of the current one.  It does not affect
+//       RandomAccessTableReader.
+//
+//   mmap  means the archive, or the files the scp file points to, are
+//       memory-mapped (where they are actual files), and objects are read
+//       directly from the mapped pages rather than through a file buffer; see
+//       Input::OpenMapped().  Compressed matrices are then uncompressed
+//       straight from the mapped pages into the Matrix being read, which
+//       reduces peak memory for very large archives.  When an archive is read
+//       sequentially, the pages already read are released as reading
+//       proceeds, so the resident memory does not grow with the archive size.
+//
 //   b   is ignored [for scripting convenience]
 //   t   is ignored [for scripting convenience]
 //
 //
-//  So for instance the following would be a valid rspecifier:
+//  So for instance the following would be valid rspecifiers:
 //
 //   "o, s, p, ark:gunzip -c foo.gz|"
+//   "ark,idx:foo.ark"
+//   "ark,bg:feats.ark"
+//   "ark,mmap:egs.ark"
 
 struct  RspecifierOptions {
   // These options only make a difference for the RandomAccessTableReader class.
@@ -198,9 +229,16 @@ struct  RspecifierOptions {
   // For archive files it will suppress errors getting thrown if the archive
   
   // is corrupted and can't be read to the end.
+  bool use_index;  // we assert that the archive has an index, and we should
+  // use it for random access.
+  bool background;  // For SequentialTableReader only: read ahead in a
+  // background thread.
+  bool mmap;  // read files by memory-mapping them.
 
   RspecifierOptions(): once(false), sorted(false),
-                       called_sorted(false), permissive(false) { }
+                       called_sorted(false), permissive(false),
+                       use_index(false), background(false),
+                       mmap(false) { }
 };
 
 enum RspecifierType  {
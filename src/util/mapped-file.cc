@@ -0,0 +1,161 @@
+// util/mapped-file.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "util/mapped-file.h"
+#include "util/kaldi-io.h"
+
+namespace kaldi {
+
+bool MappedFile::Open(const std::string &filename) {
+  Close();
+  if (ClassifyRxfilename(filename) != kFileInput) {
+    KALDI_WARN << "Only ordinary files can be memory-mapped, not "
+               << PrintableRxfilename(filename);
+    return false;
+  }
+#ifndef _MSC_VER
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    KALDI_WARN << "Could not open " << filename << ": " << strerror(errno);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    KALDI_WARN << "Could not stat " << filename << ": " << strerror(errno);
+    close(fd);
+    return false;
+  }
+  if (st.st_size == 0) {  // mmap fails on empty files; treat specially.
+    close(fd);
+    data_ = new char[1];
+    size_ = 0;
+    mapped_ = false;
+    return true;
+  }
+  void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);  // the mapping stays valid after the descriptor is closed.
+  if (data == MAP_FAILED) {
+    KALDI_WARN << "Could not mmap " << filename << ": " << strerror(errno);
+    return false;
+  }
+  data_ = static_cast<char*>(data);
+  size_ = st.st_size;
+  mapped_ = true;
+#else
+  // No mmap available; fall back to reading the whole file into memory.
+  FILE *f = fopen(filename.c_str(), "rb");
+  if (f == NULL) {
+    KALDI_WARN << "Could not open " << filename;
+    return false;
+  }
+  fseek(f, 0, SEEK_END);
+  size_t size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  data_ = new char[size + 1];
+  size_ = size;
+  mapped_ = false;
+  size_t size_read = fread(data_, 1, size, f);
+  fclose(f);
+  if (size_read != size) {
+    KALDI_WARN << "Error reading " << filename;
+    Close();
+    return false;
+  }
+#endif
+  return true;
+}
+
+bool MappedFile::Advise(bool random_access, bool huge_pages) {
+  bool ans = true;
+#ifndef _MSC_VER
+  if (!mapped_) return true;
+  if (random_access && madvise(data_, size_, MADV_RANDOM) != 0) {
+    KALDI_WARN << "madvise(MADV_RANDOM) failed: " << strerror(errno);
+    ans = false;
+  }
+  if (huge_pages) {
+#ifdef MADV_HUGEPAGE
+    if (madvise(data_, size_, MADV_HUGEPAGE) != 0) {
+      KALDI_WARN << "madvise(MADV_HUGEPAGE) failed: " << strerror(errno);
+      ans = false;
+    }
+#else
+    KALDI_WARN << "Huge pages are not supported on this system.";
+    ans = false;
+#endif
+  }
+#endif
+  return ans;
+}
+
+bool MappedFile::AdviseSequential() {
+#ifndef _MSC_VER
+  if (mapped_ && madvise(data_, size_, MADV_SEQUENTIAL) != 0) {
+    KALDI_WARN << "madvise(MADV_SEQUENTIAL) failed: " << strerror(errno);
+    return false;
+  }
+#endif
+  return true;
+}
+
+void MappedFile::Discard(size_t size) {
+#ifndef _MSC_VER
+  if (!mapped_) return;
+  // Release memory in blocks of at least this size.
+  const size_t kMinDiscardSize = 1 << 22;
+  size_t page_size = sysconf(_SC_PAGESIZE),
+      end = std::min(size, size_) / page_size * page_size;
+  if (end < discarded_ + kMinDiscardSize) return;
+  // data_ is page-aligned as it came from mmap.
+  if (madvise(data_ + discarded_, end - discarded_, MADV_DONTNEED) != 0)
+    KALDI_WARN << "madvise(MADV_DONTNEED) failed: " << strerror(errno);
+  discarded_ = end;
+#endif
+}
+
+void MappedFile::Close() {
+  if (data_ == NULL) return;
+#ifndef _MSC_VER
+  if (mapped_) {
+    if (munmap(data_, size_) != 0)
+      KALDI_WARN << "Error unmapping file: " << strerror(errno);
+  } else {
+    delete [] data_;
+  }
+#else
+  delete [] data_;
+#endif
+  data_ = NULL;
+  size_ = 0;
+  mapped_ = false;
+  discarded_ = 0;
+}
+
+}  // namespace kaldi
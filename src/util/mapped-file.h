@@ -0,0 +1,98 @@
+// util/mapped-file.h
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_MAPPED_FILE_H_
+#define KALDI_UTIL_MAPPED_FILE_H_
+
+#include <string>
+#include "base/kaldi-common.h"
+
+namespace kaldi {
+
+/// \addtogroup io_group
+/// @{
+
+/**
+   MappedFile gives read-only access to the whole contents of an ordinary file
+   as a block of memory.  Where mmap is available the file is memory-mapped, so
+   opening it is cheap even for very large files, pages are only read from
+   disk when they are accessed, and processes on the same machine that map the
+   same file share its pages; elsewhere (e.g. on Windows) the file is just read
+   into memory.  Only ordinary filenames are accepted (not pipes, standard
+   input or offsets into files).
+*/
+class MappedFile {
+ public:
+  MappedFile(): data_(NULL), size_(0), mapped_(false), discarded_(0) { }
+
+  /// Opens (maps) the file; returns true on success.  On failure, prints a
+  /// warning and returns false.  If already open, it is closed first.
+  bool Open(const std::string &filename);
+
+  bool IsOpen() const { return data_ != NULL; }
+
+  /// Returns the start of the file contents, or NULL if not open.
+  const char *Data() const { return data_; }
+
+  /// Returns the size of the file in bytes.
+  size_t Size() const { return size_; }
+
+  /// Gives the kernel hints about how the contents will be accessed; they
+  /// only affect speed.  If "random_access" is true, read-ahead is turned off
+  /// (good for large tables accessed at random, such as language models).  If
+  /// "huge_pages" is true, asks for the mapping to be backed by huge pages
+  /// (madvise(MADV_HUGEPAGE)), which reduces TLB misses on large files; the
+  /// kernel honours this only for file systems that support it (e.g. tmpfs
+  /// mounted with huge=always or huge=advise; files on hugetlbfs always use
+  /// huge pages).  Returns false, with a warning, if a hint was refused.
+  /// Does nothing if the file is not memory-mapped.
+  bool Advise(bool random_access, bool huge_pages);
+
+  /// Tells the kernel that the contents will be read in order, so that it
+  /// reads ahead more aggressively.  Returns false, with a warning, if the
+  /// hint was refused.  Does nothing if the file is not memory-mapped.
+  bool AdviseSequential();
+
+  /// Tells the kernel that the first "size" bytes of the contents will not be
+  /// needed again, so their pages can be dropped from this process's memory;
+  /// this keeps the resident memory of a long sequential read bounded.  (If
+  /// they are accessed again they are just re-read from the file).  Only whole
+  /// pages are released, and nothing is done until a reasonably large block
+  /// can be released, to save system calls.  Does nothing if the file is not
+  /// memory-mapped.
+  void Discard(size_t size);
+
+  /// Unmaps the file.  It is not an error to call this if not open.
+  void Close();
+
+  ~MappedFile() { Close(); }
+
+ private:
+  char *data_;
+  size_t size_;
+  bool mapped_;  // true if data_ came from mmap, false if from new [].
+  size_t discarded_;  // number of bytes at the start released by Discard().
+  KALDI_DISALLOW_COPY_AND_ASSIGN(MappedFile);
+};
+
+/// @} end "addtogroup io_group"
+
+}  // namespace kaldi
+
+#endif  // KALDI_UTIL_MAPPED_FILE_H_
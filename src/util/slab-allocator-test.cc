@@ -0,0 +1,81 @@
+// util/slab-allocator-test.cc
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/slab-allocator.h"
+
+namespace kaldi {
+
+struct TestObject {
+  float cost;
+  int32 label;
+  TestObject *next;
+  TestObject(float cost, int32 label, TestObject *next):
+      cost(cost), label(label), next(next) { }
+};
+
+void TestSlabAllocator() {
+  SlabAllocator<TestObject> allocator(1 + Rand() % 20);
+  std::vector<TestObject*> objects;
+  std::vector<int32> labels;
+  for (int32 i = 0; i < 1000; i++) {
+    if (objects.empty() || Rand() % 3 != 0) {
+      int32 label = Rand();
+      TestObject *t = new (allocator.Allocate()) TestObject(0.5, label, NULL);
+      objects.push_back(t);
+      labels.push_back(label);
+    } else {  // free a random object.
+      size_t n = Rand() % objects.size();
+      allocator.Free(objects[n]);
+      objects[n] = objects.back();
+      objects.pop_back();
+      labels[n] = labels.back();
+      labels.pop_back();
+    }
+    KALDI_ASSERT(allocator.NumInUse() == objects.size());
+  }
+  // Check that no two live objects share memory.
+  for (size_t i = 0; i < objects.size(); i++)
+    KALDI_ASSERT(objects[i]->label == labels[i]);
+  KALDI_ASSERT(allocator.BytesReserved() >=
+               objects.size() * sizeof(TestObject));
+  int64 num_allocations = allocator.NumAllocations();
+  KALDI_ASSERT(num_allocations >= static_cast<int64>(objects.size()));
+  for (size_t i = 0; i < objects.size(); i++)
+    allocator.Free(objects[i]);
+  KALDI_ASSERT(allocator.NumInUse() == 0);
+
+  // Memory should be reused, not reserved again.
+  size_t bytes_reserved = allocator.BytesReserved();
+  allocator.ResetStats();
+  for (size_t i = 0; i < objects.size(); i++)
+    objects[i] = new (allocator.Allocate()) TestObject(1.0, i, NULL);
+  KALDI_ASSERT(allocator.BytesReserved() == bytes_reserved);
+  KALDI_ASSERT(allocator.NumAllocations() ==
+               static_cast<int64>(objects.size()));
+  for (size_t i = 0; i < objects.size(); i++)
+    allocator.Free(objects[i]);
+}
+
+}  // namespace kaldi
+
+int main() {
+  for (int i = 0; i < 10; i++)
+    kaldi::TestSlabAllocator();
+  std::cout << "Test OK.\n";
+}
@@ -0,0 +1,135 @@
+// util/slab-allocator.h
+
+// Copyright 2014  International Computer Science Institute
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_SLAB_ALLOCATOR_H_
+#define KALDI_UTIL_SLAB_ALLOCATOR_H_
+
+#include <new>
+#include <vector>
+#include "base/kaldi-common.h"
+
+namespace kaldi {
+
+/**
+   SlabAllocator is a simple allocator for many small objects of a single type
+   T, which are allocated and freed very frequently (e.g. the tokens and
+   forward-links in the decoders).  It allocates memory in large blocks
+   ("slabs") and keeps freed objects in a singly linked free list for reuse, in
+   the same way that class HashList does for its elements; memory is only
+   returned to the system when the allocator is destroyed.  This avoids the
+   cost of calling malloc and free for each object.
+
+   Allocate() returns uninitialized memory, so the caller should construct the
+   object with placement new, e.g.
+     Token *tok = new (token_allocator.Allocate()) Token(cost, ...);
+   and Free() does not call the destructor, so T should be a type with a
+   trivial destructor.  This class is not thread-safe.
+*/
+template<class T>
+class SlabAllocator {
+ public:
+  /// "objects_per_slab" is the number of objects allocated at one time.
+  explicit SlabAllocator(size_t objects_per_slab = 1024):
+      objects_per_slab_(objects_per_slab), free_head_(NULL),
+      num_in_use_(0), num_allocations_(0) {
+    KALDI_ASSERT(objects_per_slab > 0);
+  }
+
+  /// Returns uninitialized memory sufficient for one object of type T.
+  inline void *Allocate() {
+    if (free_head_ == NULL) AllocateSlab();
+    FreeObject *ans = free_head_;
+    free_head_ = free_head_->next;
+    num_in_use_++;
+    num_allocations_++;
+    return ans;
+  }
+
+  /// Returns an object to the allocator for reuse.  The object must have been
+  /// obtained from Allocate() of this same allocator.
+  inline void Free(T *t) {
+    FreeObject *f = reinterpret_cast<FreeObject*>(t);
+    f->next = free_head_;
+    free_head_ = f;
+    num_in_use_--;
+  }
+
+  /// Size in bytes of the memory used by one object.
+  static size_t ObjectSize() { return sizeof(Slot); }
+
+  /// The number of objects currently allocated and not freed.
+  size_t NumInUse() const { return num_in_use_; }
+
+  /// The number of calls to Allocate() since construction or the last call to
+  /// ResetStats().
+  int64 NumAllocations() const { return num_allocations_; }
+
+  /// Resets the count returned by NumAllocations().
+  void ResetStats() { num_allocations_ = 0; }
+
+  /// The total memory held by this allocator, in bytes, including memory
+  /// in the free list.
+  size_t BytesReserved() const {
+    return slabs_.size() * objects_per_slab_ * sizeof(Slot);
+  }
+
+  ~SlabAllocator() {
+    if (num_in_use_ != 0)
+      KALDI_WARN << "SlabAllocator destroyed with " << num_in_use_
+                 << " objects still in use (possible memory leak).";
+    for (size_t i = 0; i < slabs_.size(); i++)
+      delete [] slabs_[i];
+  }
+
+ private:
+  // FreeObject is how we view the memory of an object while it is on the free
+  // list.
+  struct FreeObject {
+    FreeObject *next;
+  };
+  // Slot is big enough, and suitably aligned, to hold either a T or a
+  // FreeObject.
+  union Slot {
+    char t[sizeof(T)];
+    FreeObject f;
+    double align_double;
+    int64 align_int64;
+  };
+
+  void AllocateSlab() {
+    Slot *slab = new Slot[objects_per_slab_];
+    for (size_t i = 0; i + 1 < objects_per_slab_; i++)
+      slab[i].f.next = &(slab[i+1].f);
+    slab[objects_per_slab_ - 1].f.next = free_head_;
+    free_head_ = &(slab[0].f);
+    slabs_.push_back(slab);
+  }
+
+  size_t objects_per_slab_;
+  FreeObject *free_head_;  // head of the list of free objects.
+  std::vector<Slot*> slabs_;  // the slabs we have allocated.
+  size_t num_in_use_;
+  int64 num_allocations_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(SlabAllocator);
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_UTIL_SLAB_ALLOCATOR_H_